@@ -0,0 +1,8 @@
+// Uniform blocks shared by every shader, bound once after linking.
+
+// Values that stay constant for the whole frame.
+layout(std140) uniform FrameConstants
+{
+	mat4 view;
+	mat4 proj;
+};
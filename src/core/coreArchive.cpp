@@ -0,0 +1,488 @@
+#include "core/coreArchive.h"
+#include "core/coreJobSystem.h"
+#include "core/coreLZ4.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <utility>
+
+static const uint64_t FNVOffset64 = 14695981039346656037ull;
+static const uint64_t FNVPrime64 = 1099511628211ull;
+static const uint32_t BlockStored = 0x80000000;	///< in the block table, the block is kept as is.
+
+static uint64_t hashBytes(const void* data, uint64_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint64_t hash = FNVOffset64;
+	for (uint64_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= FNVPrime64;
+	}
+	return hash;
+}
+
+static uint64_t alignOffset(uint64_t offset)
+{
+	return (offset + CoreArchive::DataAlignment - 1) & ~(uint64_t)(CoreArchive::DataAlignment - 1);
+}
+
+static char foldNameChar(char c)
+{
+	if (c == '\\')
+		return '/';
+	return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+static bool namesEqual(const char* a, const char* b)
+{
+	for (; *a && *b; a++, b++)
+	{
+		if (foldNameChar(*a) != foldNameChar(*b))
+			return false;
+	}
+	return *a == *b;
+}
+
+static uint32_t getBlockCount(uint64_t size)
+{
+	return (uint32_t)((size + CoreArchive::BlockSize - 1) / CoreArchive::BlockSize);
+}
+
+//-------------------------------------------------------------
+// extraction
+//-------------------------------------------------------------
+
+struct ArchiveBlock
+{
+	const uint8_t*	src;
+	uint32_t		srcSize;
+	uint32_t		dstSize;
+	uint8_t*		dst;
+	bool			stored;
+};
+
+// about this many bytes of blocks go to one job.
+static const uint32_t ExtractJobBytes = 1 << 20;
+
+struct ArchiveExtractJob
+{
+	const ArchiveBlock*		blocks;
+	uint8_t*				extracted;	///< per block, set once it's been written out.
+};
+
+static void extractJob(void* data, uint32_t begin, uint32_t end)
+{
+	ArchiveExtractJob& job = *(ArchiveExtractJob*)data;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		const ArchiveBlock& block = job.blocks[i];
+		if (block.stored)
+		{
+			if (block.srcSize != block.dstSize)
+				continue;
+			memcpy(block.dst, block.src, block.dstSize);
+		}
+		else if (!coreLZ4Decompress(block.src, block.srcSize, block.dst, block.dstSize))
+			continue;
+		job.extracted[i] = 1;
+	}
+}
+
+//-------------------------------------------------------------
+// packing
+//-------------------------------------------------------------
+
+struct ArchivePacked
+{
+	std::vector<uint8_t>	data;		///< what goes in the file.
+	uint64_t				size;
+	uint64_t				hash;
+	bool					compressed;
+	bool					read;
+};
+
+struct ArchivePackJob
+{
+	const CoreArchiveSource*	sources;
+	ArchivePacked*				packed;
+};
+
+static void packJob(void* data, uint32_t begin, uint32_t end)
+{
+	ArchivePackJob& job = *(ArchivePackJob*)data;
+	std::vector<uint8_t> scratch(coreLZ4Bound(CoreArchive::BlockSize));
+
+	for (uint32_t i = begin; i < end; i++)
+	{
+		const CoreArchiveSource& source = job.sources[i];
+		ArchivePacked& packed = job.packed[i];
+		packed.read = false;
+
+		PlatformMappedFile file;
+		if (!file.open(source.path))
+		{
+			printf("Archive: can't read %s.\n", source.path);
+			continue;
+		}
+
+		const uint8_t* contents = file.getData();
+		packed.size = file.getSize();
+		packed.hash = hashBytes(contents, packed.size);
+		packed.compressed = false;
+		packed.read = true;
+
+		if (source.compress)
+		{
+			// block size table first, then the blocks.
+			const uint32_t blockCount = getBlockCount(packed.size);
+			std::vector<uint8_t>& out = packed.data;
+			out.resize(blockCount * sizeof(uint32_t));
+			out.reserve((size_t)packed.size);
+			for (uint32_t b = 0; b < blockCount; b++)
+			{
+				const uint64_t offset = (uint64_t)b * CoreArchive::BlockSize;
+				const uint32_t blockSize = (uint32_t)std::min<uint64_t>(CoreArchive::BlockSize, packed.size - offset);
+				const uint32_t compressedSize = coreLZ4Compress(contents + offset, blockSize, &scratch[0], (uint32_t)scratch.size());
+
+				uint32_t entry;
+				if (compressedSize && compressedSize < blockSize)
+				{
+					entry = compressedSize;
+					out.insert(out.end(), &scratch[0], &scratch[0] + compressedSize);
+				}
+				else
+				{
+					entry = blockSize | BlockStored;
+					out.insert(out.end(), contents + offset, contents + offset + blockSize);
+				}
+				memcpy(&out[b * sizeof(uint32_t)], &entry, sizeof(entry));
+			}
+
+			// not worth a decompress when it saves less than an eighth.
+			packed.compressed = out.size() < packed.size - packed.size / 8;
+		}
+
+		if (!packed.compressed)
+			packed.data.assign(contents, contents + packed.size);
+	}
+}
+
+//-------------------------------------------------------------
+// archive
+//-------------------------------------------------------------
+
+CoreArchive::CoreArchive()
+{
+	mHeader = NULL;
+	mEntries = NULL;
+	mNames = NULL;
+}
+
+CoreArchive::~CoreArchive()
+{
+	close();
+}
+
+bool CoreArchive::open(const char* path)
+{
+	close();
+
+	if (!mFile.open(path))
+		return false;
+
+	const uint8_t* data = mFile.getData();
+	const uint64_t size = mFile.getSize();
+	const Header* header = (const Header*)data;
+	bool valid = size >= sizeof(Header) && header->magic == FileMagic && header->version == FileVersion &&
+		header->fileSize == size &&
+		sizeof(Header) + (uint64_t)header->entryCount * sizeof(Entry) + header->namesSize <= size;
+
+	// every name ends before the table does.
+	const char* names = valid ? (const char*)data + sizeof(Header) + (uint64_t)header->entryCount * sizeof(Entry) : NULL;
+	if (valid && header->entryCount)
+		valid = header->namesSize > 0 && names[header->namesSize - 1] == 0;
+
+	if (!valid)
+	{
+		printf("Archive %s is not a version %d archive.\n", path, FileVersion);
+		mFile.close();
+		return false;
+	}
+
+	mHeader = header;
+	mEntries = (const Entry*)(data + sizeof(Header));
+	mNames = names;
+	return true;
+}
+
+void CoreArchive::close()
+{
+	mFile.close();
+	mHeader = NULL;
+	mEntries = NULL;
+	mNames = NULL;
+}
+
+uint64_t CoreArchive::hashName(const char* name)
+{
+	uint64_t hash = FNVOffset64;
+	for (; *name; name++)
+	{
+		hash ^= (uint8_t)foldNameChar(*name);
+		hash *= FNVPrime64;
+	}
+	return hash;
+}
+
+uint32_t CoreArchive::find(const char* name) const
+{
+	if (!mHeader)
+		return NotFound;
+
+	const uint64_t hash = hashName(name);
+	uint32_t low = 0;
+	uint32_t high = mHeader->entryCount;
+	while (low < high)
+	{
+		const uint32_t mid = (low + high) / 2;
+		if (mEntries[mid].nameHash < hash)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	for (uint32_t i = low; i < mHeader->entryCount && mEntries[i].nameHash == hash; i++)
+	{
+		if (mEntries[i].nameOffset < mHeader->namesSize && namesEqual(mNames + mEntries[i].nameOffset, name))
+			return checkEntry(i) ? i : NotFound;
+	}
+	return NotFound;
+}
+
+// the index is only trusted as far as an entry is used.
+bool CoreArchive::checkEntry(uint32_t index) const
+{
+	const Entry& entry = mEntries[index];
+	bool valid = (entry.offset % DataAlignment) == 0 && entry.offset <= mHeader->fileSize &&
+		entry.storedSize <= mHeader->fileSize - entry.offset;
+	if (valid && (entry.flags & EntryCompressed))
+		valid = (uint64_t)getBlockCount(entry.size) * sizeof(uint32_t) <= entry.storedSize;
+	else if (valid)
+		valid = entry.storedSize == entry.size;
+
+	if (!valid)
+		printf("Archive entry %s is broken.\n", getName(index));
+	return valid;
+}
+
+const uint8_t* CoreArchive::getData(uint32_t index) const
+{
+	if (isCompressed(index))
+		return NULL;
+	return mFile.getData() + mEntries[index].offset;
+}
+
+bool CoreArchive::extract(uint32_t index, void* out, CoreJobSystem* jobs) const
+{
+	return extract(&index, 1, &out, jobs);
+}
+
+bool CoreArchive::extract(const uint32_t* indices, uint32_t count, void* const* outs, CoreJobSystem* jobs) const
+{
+	// every block of every entry becomes a work item, so one big entry
+	// spreads over the workers as well as many small ones.
+	std::vector<ArchiveBlock> blocks;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Entry& entry = mEntries[indices[i]];
+		const uint8_t* data = mFile.getData() + entry.offset;
+		uint8_t* out = (uint8_t*)outs[i];
+		const uint32_t blockCount = getBlockCount(entry.size);
+
+		if (!(entry.flags & EntryCompressed))
+		{
+			for (uint32_t b = 0; b < blockCount; b++)
+			{
+				const uint64_t offset = (uint64_t)b * BlockSize;
+				const uint32_t size = (uint32_t)std::min<uint64_t>(BlockSize, entry.size - offset);
+				const ArchiveBlock block = { data + offset, size, size, out + offset, true };
+				blocks.push_back(block);
+			}
+			continue;
+		}
+
+		const uint8_t* table = data;
+		uint64_t position = (uint64_t)blockCount * sizeof(uint32_t);
+		for (uint32_t b = 0; b < blockCount; b++)
+		{
+			uint32_t stored;
+			memcpy(&stored, table + b * sizeof(uint32_t), sizeof(stored));
+
+			const uint64_t offset = (uint64_t)b * BlockSize;
+			const uint32_t srcSize = stored & ~BlockStored;
+			if (srcSize > entry.storedSize - position)
+			{
+				printf("Archive entry %s is broken.\n", getName(indices[i]));
+				return false;
+			}
+
+			const ArchiveBlock block = { data + position, srcSize, (uint32_t)std::min<uint64_t>(BlockSize, entry.size - offset),
+				out + offset, (stored & BlockStored) != 0 };
+			blocks.push_back(block);
+			position += srcSize;
+		}
+	}
+
+	if (blocks.empty())
+		return true;
+
+	// a block that failed or never ran stays at 0.
+	std::vector<uint8_t> extracted(blocks.size(), 0);
+	ArchiveExtractJob job;
+	job.blocks = &blocks[0];
+	job.extracted = &extracted[0];
+
+	const uint32_t grain = ExtractJobBytes / BlockSize;
+	if (jobs && blocks.size() > grain)
+		jobs->parallelFor((uint32_t)blocks.size(), grain, extractJob, &job);
+	else
+		extractJob(&job, 0, (uint32_t)blocks.size());
+
+	const uint32_t missing = (uint32_t)std::count(extracted.begin(), extracted.end(), 0);
+	if (missing)
+	{
+		printf("Archive: can't extract %d entries, %d of %d blocks failed.\n", count, missing, (uint32_t)blocks.size());
+		return false;
+	}
+	return true;
+}
+
+bool CoreArchive::read(const char* name, std::string& out) const
+{
+	const uint32_t index = find(name);
+	if (index == NotFound)
+		return false;
+
+	out.resize((size_t)getSize(index));
+	return out.empty() || extract(index, &out[0]);
+}
+
+bool CoreArchive::read(const char* name, std::vector<uint8_t>& out) const
+{
+	const uint32_t index = find(name);
+	if (index == NotFound)
+		return false;
+
+	out.resize((size_t)getSize(index));
+	return out.empty() || extract(index, &out[0]);
+}
+
+bool CoreArchive::verify(CoreJobSystem* jobs) const
+{
+	if (!mHeader)
+		return false;
+
+	std::vector<uint8_t> contents;
+	for (uint32_t i = 0; i < mHeader->entryCount; i++)
+	{
+		if (mEntries[i].nameOffset >= mHeader->namesSize || !checkEntry(i))
+			return false;
+
+		contents.resize((size_t)mEntries[i].size);
+		if (!contents.empty() && !extract(i, &contents[0], jobs))
+			return false;
+		if (hashBytes(contents.empty() ? NULL : &contents[0], contents.size()) != mEntries[i].hash)
+			return false;
+	}
+	return true;
+}
+
+bool CoreArchive::write(const char* path, const CoreArchiveSource* sources, uint32_t count, CoreJobSystem* jobs)
+{
+	std::vector<ArchivePacked> packed(count);
+	ArchivePackJob job = { sources, count ? &packed[0] : NULL };
+	if (jobs && count > 1)
+		jobs->parallelFor(count, 1, packJob, &job);
+	else
+		packJob(&job, 0, count);
+
+	// the index is sorted by name hash, a tie is a real collision or the
+	// same file twice and either way find() can't tell them apart.
+	std::vector<std::pair<uint64_t, uint32_t> > order(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (!packed[i].read)
+			return false;
+		order[i] = std::make_pair(hashName(sources[i].name), i);
+	}
+	std::sort(order.begin(), order.end());
+	for (uint32_t i = 1; i < count; i++)
+	{
+		if (order[i].first == order[i - 1].first)
+		{
+			printf("Archive: %s and %s have the same name hash.\n", sources[order[i - 1].second].name, sources[order[i].second].name);
+			return false;
+		}
+	}
+
+	std::string names;
+	std::vector<Entry> entries(count);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		entries[i].nameOffset = (uint32_t)names.size();
+		names += sources[order[i].second].name;
+		names += '\0';
+	}
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = FileMagic;
+	header.version = FileVersion;
+	header.entryCount = count;
+	header.namesSize = (uint32_t)names.size();
+
+	uint64_t offset = sizeof(Header) + (uint64_t)count * sizeof(Entry) + names.size();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const ArchivePacked& source = packed[order[i].second];
+		Entry& entry = entries[i];
+		entry.nameHash = order[i].first;
+		entry.offset = alignOffset(offset);
+		entry.storedSize = source.data.size();
+		entry.size = source.size;
+		entry.hash = source.hash;
+		entry.flags = source.compressed ? EntryCompressed : 0;
+		offset = entry.offset + entry.storedSize;
+	}
+	header.fileSize = offset;
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		printf("Can't write archive %s.\n", path);
+		return false;
+	}
+
+	static const uint8_t padding[DataAlignment] = { 0 };
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		(count == 0 || fwrite(&entries[0], sizeof(Entry), count, file) == count) &&
+		(names.empty() || fwrite(names.data(), 1, names.size(), file) == names.size());
+	uint64_t position = sizeof(Header) + (uint64_t)count * sizeof(Entry) + names.size();
+	for (uint32_t i = 0; i < count && written; i++)
+	{
+		const std::vector<uint8_t>& data = packed[order[i].second].data;
+		written = fwrite(padding, 1, (size_t)(entries[i].offset - position), file) == (size_t)(entries[i].offset - position) &&
+			(data.empty() || fwrite(&data[0], 1, data.size(), file) == data.size());
+		position = entries[i].offset + entries[i].storedSize;
+	}
+	fclose(file);
+
+	if (!written)
+	{
+		printf("Can't write archive %s.\n", path);
+		remove(path);
+	}
+	return written;
+}
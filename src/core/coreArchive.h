@@ -0,0 +1,126 @@
+#ifndef COREARCHIVE_H_
+#define COREARCHIVE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "platform/platformMappedFile.h"
+
+class CoreJobSystem;
+
+// a file to pack: its name in the archive and where it is on disk.
+struct CoreArchiveSource
+{
+	const char*	name;
+	const char*	path;
+	bool		compress;	///< kept as is anyway when LZ4 doesn't save enough.
+};
+
+//-------------------------------------------------------------
+// Asset archive
+//-------------------------------------------------------------
+// Many assets in one file, so startup maps a single file instead of
+// opening every asset. The file is a header, an index sorted by the
+// 64 bit hash of each name, the names and then the entries' data, each
+// on a DataAlignment boundary.
+//
+// find() is a binary search over the mapped index, the name is only
+// compared when the hash matches. Names are hashed and compared with
+// '\' as '/' and ASCII case folded, so a path finds its entry however
+// it's spelled on Windows.
+//
+// An entry is either stored as is, and getData() points straight into
+// the mapping, or cut into BlockSize blocks compressed as LZ4 blocks on
+// their own. A compressed entry starts with a table of the compressed
+// block sizes, the top bit set on blocks that didn't compress. Blocks
+// don't depend on each other, so extract() spreads them over the job
+// system, a big entry as well as a batch of small ones.
+//
+// Everything is little endian. Bump FileVersion when the header, an
+// index entry or the block layout changes.
+class CoreArchive
+{
+public:
+	enum
+	{
+		FileMagic = 0x4B415047,		///< 'GPAK'
+		FileVersion = 1,
+		DataAlignment = 64,
+		BlockSize = 64 << 10,
+		NotFound = 0xFFFFFFFF,
+	};
+
+	CoreArchive();
+	~CoreArchive();
+
+	bool open(const char* path);
+	void close();
+
+	// index of the entry, NotFound when there's none.
+	uint32_t	find(const char* name) const;
+
+	bool		isOpen() const { return mHeader != NULL; }
+	uint32_t	getEntryCount() const { return mHeader ? mHeader->entryCount : 0; }
+	const char*	getName(uint32_t index) const { return mNames + mEntries[index].nameOffset; }
+	uint64_t	getSize(uint32_t index) const { return mEntries[index].size; }
+	bool		isCompressed(uint32_t index) const { return (mEntries[index].flags & EntryCompressed) != 0; }
+
+	// stored entries, straight from the mapping and valid until close().
+	// NULL when the entry is compressed.
+	const uint8_t* getData(uint32_t index) const;
+
+	// decompresses or copies an entry into out, getSize() bytes. jobs
+	// may be NULL, otherwise only its threads may call.
+	bool		extract(uint32_t index, void* out, CoreJobSystem* jobs = NULL) const;
+	bool		extract(const uint32_t* indices, uint32_t count, void* const* outs, CoreJobSystem* jobs = NULL) const;
+
+	// the whole entry of that name, e.g. a shader source.
+	bool		read(const char* name, std::string& out) const;
+	bool		read(const char* name, std::vector<uint8_t>& out) const;
+
+	// extracts every entry and compares it with its hash, for tools.
+	bool		verify(CoreJobSystem* jobs = NULL) const;
+
+	static uint64_t hashName(const char* name);
+
+	// sources are read and compressed on the job system, jobs may be
+	// NULL. Fails when two names hash the same.
+	static bool write(const char* path, const CoreArchiveSource* sources, uint32_t count, CoreJobSystem* jobs = NULL);
+
+private:
+	enum
+	{
+		EntryCompressed = 1 << 0,
+	};
+
+	struct Header
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint32_t	entryCount;
+		uint32_t	namesSize;		///< bytes, right after the index.
+		uint64_t	fileSize;
+	};
+
+	struct Entry
+	{
+		uint64_t	nameHash;
+		uint64_t	offset;			///< from the start of the file.
+		uint64_t	storedSize;		///< bytes in the file, block table and all.
+		uint64_t	size;			///< bytes once extracted.
+		uint64_t	hash;			///< FNV-1a of the extracted contents.
+		uint32_t	nameOffset;
+		uint32_t	flags;
+	};
+
+	bool		checkEntry(uint32_t index) const;
+
+	PlatformMappedFile	mFile;
+	const Header*		mHeader;
+	const Entry*		mEntries;
+	const char*			mNames;
+};
+
+#endif
@@ -0,0 +1,385 @@
+#include "core/coreAssetStreamer.h"
+#include "platform/platformThread.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+CoreAssetStreamer::CoreAssetStreamer()
+{
+	mJobs = NULL;
+	mSlots = NULL;
+	mMaxAssets = 0;
+	mStagingBytes = 0;
+	mRunning = false;
+}
+
+CoreAssetStreamer::~CoreAssetStreamer()
+{
+	destroy();
+}
+
+bool CoreAssetStreamer::init(CoreJobSystem* jobs, uint32_t maxAssets, uint32_t ioThreadCount)
+{
+	destroy();
+	if (!maxAssets || !ioThreadCount)
+		return false;
+
+	mJobs = jobs;
+	mMaxAssets = maxAssets;
+	mSlots = new Slot[maxAssets];
+	mFree.reserve(maxAssets);
+	for (uint32_t i = maxAssets; i > 0; i--)
+	{
+		mSlots[i - 1].state.store(CoreAssetFree, std::memory_order_relaxed);
+		mSlots[i - 1].stagingBytes = 0;
+		mFree.push_back(i - 1);
+	}
+
+	mStagingBytes = 0;
+	mRunning = true;
+	for (uint32_t i = 0; i < ioThreadCount; i++)
+		mThreads.push_back(std::thread(&CoreAssetStreamer::ioMain, this, i));
+	return true;
+}
+
+void CoreAssetStreamer::destroy()
+{
+	if (!mSlots)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mRunning = false;
+	}
+	mWake.notify_all();
+	for (size_t i = 0; i < mThreads.size(); i++)
+		mThreads[i].join();
+	mThreads.clear();
+
+	for (uint32_t i = 0; i < mMaxAssets; i++)
+	{
+		if (mJobs && !mSlots[i].counter.isDone())
+			mJobs->wait(&mSlots[i].counter);
+	}
+
+	delete[] mSlots;
+	mSlots = NULL;
+	mMaxAssets = 0;
+	mFree.clear();
+	mActive.clear();
+	mReadQueue.clear();
+	mReadDone.clear();
+	mStagingBytes = 0;
+	mJobs = NULL;
+}
+
+uint32_t CoreAssetStreamer::request(const CoreAssetDesc& desc)
+{
+	if (mFree.empty() || !desc.path || !desc.upload)
+		return InvalidId;
+
+	const uint32_t id = mFree.back();
+	mFree.pop_back();
+
+	Slot& slot = mSlots[id];
+	slot.desc = desc;
+	slot.path = desc.path;
+	slot.asset.path = slot.path.c_str();
+	slot.asset.data = NULL;
+	slot.asset.size = 0;
+	slot.asset.userData = desc.userData;
+	slot.asset.uploads.clear();
+	slot.upload = 0;
+	slot.uploadOffset = 0;
+	slot.stagingBytes = 0;
+	slot.finished = false;
+	mActive.push_back(id);
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		slot.state.store(CoreAssetQueued, std::memory_order_release);
+		mReadQueue.push_back(id);
+	}
+	mWake.notify_one();
+	return id;
+}
+
+void CoreAssetStreamer::ioMain(uint32_t index)
+{
+	char threadName[32];
+	snprintf(threadName, sizeof(threadName), "Asset IO %u", index);
+	platformSetThreadName(threadName);
+
+	for (;;)
+	{
+		uint32_t id;
+		{
+			// hold off while too much is read but not uploaded, unless
+			// nothing is, so one huge asset still gets through.
+			std::unique_lock<std::mutex> lock(mMutex);
+			while (mRunning && (mReadQueue.empty() || (mStagingBytes >= MaxStagingBytes)))
+				mWake.wait(lock);
+			if (!mRunning)
+				return;
+
+			id = mReadQueue.front();
+			mReadQueue.pop_front();
+			mSlots[id].state.store(CoreAssetReading, std::memory_order_release);
+		}
+
+		Slot& slot = mSlots[id];
+		const bool read = readFile(slot);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStagingBytes += slot.stagingBytes;
+		slot.state.store(read ? CoreAssetRead : CoreAssetFailed, std::memory_order_release);
+		mReadDone.push_back(id);
+	}
+}
+
+bool CoreAssetStreamer::readFile(Slot& slot)
+{
+	const uint32_t index = slot.desc.archive ? slot.desc.archive->find(slot.path.c_str()) : CoreArchive::NotFound;
+	if (index != CoreArchive::NotFound)
+		return readArchive(slot, index);
+
+	if (slot.desc.mapped)
+	{
+		if (!slot.mapping.open(slot.path.c_str()))
+		{
+			printf("Asset streamer: can't map %s.\n", slot.path.c_str());
+			return false;
+		}
+
+		// fault every page in here, so decode and upload never wait on
+		// the disk. The read ahead hint lets the OS do it in big reads.
+		const uint8_t* data = slot.mapping.getData();
+		const uint64_t size = slot.mapping.getSize();
+		slot.mapping.prefetch(0, size);
+		volatile uint8_t sink = 0;
+		for (uint64_t offset = 0; offset < size; offset += 4096)
+			sink ^= data[offset];
+		(void)sink;
+
+		slot.asset.data = data;
+		slot.asset.size = size;
+		slot.stagingBytes = size;
+		return true;
+	}
+
+	FILE* file = fopen(slot.path.c_str(), "rb");
+	if (!file)
+	{
+		printf("Asset streamer: can't open %s.\n", slot.path.c_str());
+		return false;
+	}
+
+	fseek(file, 0, SEEK_END);
+	const long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	bool read = size > 0;
+	if (read)
+	{
+		slot.staging.resize((size_t)size);
+		read = fread(&slot.staging[0], 1, slot.staging.size(), file) == slot.staging.size();
+	}
+	fclose(file);
+
+	if (!read)
+	{
+		printf("Asset streamer: can't read %s.\n", slot.path.c_str());
+		std::vector<uint8_t>().swap(slot.staging);
+		return false;
+	}
+
+	slot.asset.data = &slot.staging[0];
+	slot.asset.size = slot.staging.size();
+	slot.stagingBytes = slot.staging.size();
+	return true;
+}
+
+bool CoreAssetStreamer::readArchive(Slot& slot, uint32_t index)
+{
+	const CoreArchive& archive = *slot.desc.archive;
+	const uint64_t size = archive.getSize(index);
+	if (size == 0)
+	{
+		printf("Asset streamer: %s is empty.\n", slot.path.c_str());
+		return false;
+	}
+
+	// stored entries are in the archive's mapping already, touched here
+	// like a mapped file.
+	const uint8_t* data = archive.getData(index);
+	if (data)
+	{
+		volatile uint8_t sink = 0;
+		for (uint64_t offset = 0; offset < size; offset += 4096)
+			sink ^= data[offset];
+		(void)sink;
+
+		slot.asset.data = data;
+		slot.asset.size = size;
+		slot.stagingBytes = size;
+		return true;
+	}
+
+	// IO threads aren't job threads, the blocks are decompressed here.
+	slot.staging.resize((size_t)size);
+	if (!archive.extract(index, &slot.staging[0]))
+	{
+		printf("Asset streamer: can't extract %s.\n", slot.path.c_str());
+		std::vector<uint8_t>().swap(slot.staging);
+		return false;
+	}
+
+	slot.asset.data = &slot.staging[0];
+	slot.asset.size = slot.staging.size();
+	slot.stagingBytes = slot.staging.size();
+	return true;
+}
+
+void CoreAssetStreamer::decodeJob(void* data, uint32_t, uint32_t)
+{
+	Slot& slot = *(Slot*)data;
+	CoreAsset& asset = slot.asset;
+	asset.uploads.clear();
+
+	bool decoded = true;
+	if (slot.desc.decode)
+		decoded = slot.desc.decode(asset);
+	else
+	{
+		// no decode step, the file goes up as is.
+		CoreAssetUpload upload = { 0, asset.data, asset.size };
+		asset.uploads.push_back(upload);
+	}
+
+	slot.state.store(decoded ? CoreAssetUploading : CoreAssetFailed, std::memory_order_release);
+}
+
+void CoreAssetStreamer::finish(Slot& slot, bool loaded)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStagingBytes -= slot.stagingBytes;
+		slot.stagingBytes = 0;
+	}
+	mWake.notify_all();
+
+	slot.state.store(loaded ? CoreAssetReady : CoreAssetFailed, std::memory_order_release);
+	slot.finished = true;
+	if (slot.desc.done)
+		slot.desc.done(slot.asset, loaded);
+}
+
+uint64_t CoreAssetStreamer::update(uint64_t uploadBudget)
+{
+	if (!mSlots)
+		return 0;
+
+	// read assets go to the workers.
+	std::vector<uint32_t> read;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		read.swap(mReadDone);
+	}
+	for (size_t i = 0; i < read.size(); i++)
+	{
+		Slot& slot = mSlots[read[i]];
+		if (slot.state.load(std::memory_order_acquire) != CoreAssetRead)
+			continue;
+
+		slot.state.store(CoreAssetDecoding, std::memory_order_release);
+		if (mJobs)
+			mJobs->run(decodeJob, &slot, &slot.counter);
+		else
+			decodeJob(&slot, 0, 0);
+	}
+
+	// then uploads in request order until the budget is gone.
+	uint64_t uploaded = 0;
+	size_t active = 0;
+	for (size_t i = 0; i < mActive.size(); i++)
+	{
+		const uint32_t id = mActive[i];
+		Slot& slot = mSlots[id];
+		const uint32_t state = slot.state.load(std::memory_order_acquire);
+
+		if (state == CoreAssetFailed && !slot.finished)
+			finish(slot, false);
+		else if (state == CoreAssetUploading)
+		{
+			CoreAsset& asset = slot.asset;
+			while (slot.upload < asset.uploads.size() && uploaded < uploadBudget)
+			{
+				const CoreAssetUpload& upload = asset.uploads[slot.upload];
+				const uint64_t size = std::min(upload.size - slot.uploadOffset, uploadBudget - uploaded);
+				if (size)
+					slot.desc.upload(asset, upload, slot.uploadOffset, size);
+
+				uploaded += size;
+				slot.uploadOffset += size;
+				if (slot.uploadOffset == upload.size)
+				{
+					slot.upload++;
+					slot.uploadOffset = 0;
+				}
+			}
+
+			if (slot.upload == asset.uploads.size())
+				finish(slot, true);
+		}
+
+		if (!slot.finished)
+			mActive[active++] = id;
+	}
+	mActive.resize(active);
+
+	return uploaded;
+}
+
+void CoreAssetStreamer::release(uint32_t id)
+{
+	if (!mSlots || id >= mMaxAssets || getState(id) == CoreAssetFree)
+		return;
+
+	Slot& slot = mSlots[id];
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::deque<uint32_t>::iterator queued = std::find(mReadQueue.begin(), mReadQueue.end(), id);
+		if (queued != mReadQueue.end())
+			mReadQueue.erase(queued);
+	}
+
+	// an IO thread is on it, let it finish.
+	while (getState(id) == CoreAssetReading)
+		std::this_thread::yield();
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::vector<uint32_t>::iterator done = std::find(mReadDone.begin(), mReadDone.end(), id);
+		if (done != mReadDone.end())
+			mReadDone.erase(done);
+		mStagingBytes -= slot.stagingBytes;
+		slot.stagingBytes = 0;
+	}
+	mWake.notify_all();
+
+	if (mJobs && !slot.counter.isDone())
+		mJobs->wait(&slot.counter);
+
+	std::vector<uint32_t>::iterator active = std::find(mActive.begin(), mActive.end(), id);
+	if (active != mActive.end())
+		mActive.erase(active);
+
+	std::vector<uint8_t>().swap(slot.staging);
+	slot.mapping.close();
+	slot.asset.uploads.clear();
+	slot.asset.data = NULL;
+	slot.asset.size = 0;
+	slot.state.store(CoreAssetFree, std::memory_order_release);
+	mFree.push_back(id);
+}
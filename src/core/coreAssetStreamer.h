@@ -0,0 +1,162 @@
+#ifndef COREASSETSTREAMER_H_
+#define COREASSETSTREAMER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "core/coreArchive.h"
+#include "core/coreJobSystem.h"
+#include "platform/platformMappedFile.h"
+
+enum CoreAssetState
+{
+	CoreAssetFree,
+	CoreAssetQueued,		///< waiting for an IO thread.
+	CoreAssetReading,
+	CoreAssetRead,			///< in staging memory, waiting for a worker.
+	CoreAssetDecoding,
+	CoreAssetUploading,		///< decoded, uploaded a piece per update().
+	CoreAssetReady,
+	CoreAssetFailed,
+};
+
+// a piece of the decoded asset that goes to the gpu. target is up to
+// the asset's owner, e.g. vertices or indices.
+struct CoreAssetUpload
+{
+	uint32_t		target;
+	const uint8_t*	data;
+	uint64_t		size;
+};
+
+// what the callbacks see of a streamed asset.
+struct CoreAsset
+{
+	const char*		path;
+	const uint8_t*	data;		///< the whole file, staging memory or a mapping.
+	uint64_t		size;
+	void*			userData;
+	std::vector<CoreAssetUpload> uploads;	///< filled in by decode.
+};
+
+// on a job worker: check and decode asset.data and add what has to be
+// uploaded. Return false to fail the asset.
+typedef bool (*CoreAssetDecodeFunc)(CoreAsset& asset);
+
+// on the update() thread: upload size bytes at offset into upload.
+// Pieces of one upload come in order, offset 0 first.
+typedef void (*CoreAssetUploadFunc)(CoreAsset& asset, const CoreAssetUpload& upload, uint64_t offset, uint64_t size);
+
+// on the update() thread, once every upload is done or the asset failed.
+typedef void (*CoreAssetDoneFunc)(CoreAsset& asset, bool loaded);
+
+struct CoreAssetDesc
+{
+	const char*			path;
+	const CoreArchive*	archive;	///< path is looked up in here first, may be NULL.
+	bool				mapped;		///< map the file instead of reading it, zero copy.
+	CoreAssetDecodeFunc	decode;
+	CoreAssetUploadFunc	upload;
+	CoreAssetDoneFunc	done;		///< may be NULL.
+	void*				userData;
+};
+
+//-------------------------------------------------------------
+// Asset streamer
+//-------------------------------------------------------------
+// Loads assets in the background in three steps, each on the thread
+// suited to it:
+//
+//  - IO threads read the file into staging memory, or map it and fault
+//    its pages in, so no later step waits on the disk. Reads stop once
+//    MaxStagingBytes are read but not yet uploaded. An asset in the
+//    archive is used in place when it's stored as is and decompressed
+//    into staging memory otherwise.
+//  - update() hands read assets to the job system, decode runs on a
+//    worker and lists the uploads.
+//  - update() then uploads decoded assets in request order, at most
+//    uploadBudget bytes a call, splitting big uploads into pieces so a
+//    large asset is spread over several frames instead of causing a
+//    hitch.
+//
+// update() and everything but the IO threads' own work runs on the
+// thread that owns the job system, which is also the one with the
+// graphics context. The file data stays around until release(), so
+// the owner can keep pointing into it.
+class CoreAssetStreamer
+{
+public:
+	enum
+	{
+		DefaultIOThreads = 2,
+		MaxStagingBytes = 256 << 20,
+		InvalidId = 0xFFFFFFFF,
+	};
+
+	CoreAssetStreamer();
+	~CoreAssetStreamer();
+
+	// jobs may be NULL, assets are then decoded inside update().
+	bool init(CoreJobSystem* jobs, uint32_t maxAssets, uint32_t ioThreadCount = DefaultIOThreads);
+	void destroy();
+
+	// returns an id, InvalidId when every slot is taken.
+	uint32_t request(const CoreAssetDesc& desc);
+
+	// advances the pipeline, uploads at most uploadBudget bytes. Returns
+	// the bytes uploaded.
+	uint64_t update(uint64_t uploadBudget);
+
+	// frees the file data and the slot. Waits for a decode in flight.
+	void release(uint32_t id);
+
+	CoreAssetState	getState(uint32_t id) const { return (CoreAssetState)mSlots[id].state.load(std::memory_order_acquire); }
+	const CoreAsset& getAsset(uint32_t id) const { return mSlots[id].asset; }
+	bool			isIdle() const { return mActive.empty(); }
+
+private:
+	struct Slot
+	{
+		CoreAsset				asset;
+		CoreAssetDesc			desc;
+		std::string				path;
+		std::atomic<uint32_t>	state;
+		std::vector<uint8_t>	staging;
+		PlatformMappedFile		mapping;
+		CoreJobCounter			counter;
+		uint32_t				upload;			///< next upload to send.
+		uint64_t				uploadOffset;	///< bytes of it sent so far.
+		uint64_t				stagingBytes;	///< counted against MaxStagingBytes.
+		bool					finished;		///< done callback sent.
+	};
+
+	void		ioMain(uint32_t index);
+	bool		readFile(Slot& slot);
+	bool		readArchive(Slot& slot, uint32_t index);
+	void		finish(Slot& slot, bool loaded);
+
+	static void	decodeJob(void* data, uint32_t begin, uint32_t end);
+
+	CoreJobSystem*				mJobs;
+	Slot*						mSlots;
+	uint32_t					mMaxAssets;
+	std::vector<uint32_t>		mFree;
+	std::vector<uint32_t>		mActive;		///< in request order.
+
+	std::vector<std::thread>	mThreads;
+	std::mutex					mMutex;			///< guards the queues and mStagingBytes.
+	std::condition_variable		mWake;
+	std::deque<uint32_t>		mReadQueue;
+	std::vector<uint32_t>		mReadDone;
+	uint64_t					mStagingBytes;
+	bool						mRunning;
+};
+
+#endif
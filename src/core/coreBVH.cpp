@@ -0,0 +1,827 @@
+#include "core/coreBVH.h"
+#include "core/coreJobSystem.h"
+
+#include <stdio.h>
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+// child encoding, leaves hold a run of mIndices.
+static const uint32_t LeafBit = 0x80000000u;
+static const uint32_t LeafCountShift = 27;
+static const uint32_t LeafFirstMask = (1u << LeafCountShift) - 1;
+static const uint32_t EmptyChild = 0xFFFFFFFFu;
+
+// ranges bigger than this get their bounds and bins on several threads.
+static const uint32_t ParallelPassThreshold = 65536;
+static const uint32_t MaxPassChunks = 64;
+
+static inline Box3 emptyBox()
+{
+	return Box3(Vector3(FLT_MAX, FLT_MAX, FLT_MAX), Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+}
+
+static inline float getArea(const Box3& box)
+{
+	const Vector3 d = box.maxExtents - box.minExtents;
+	if (d.x < 0.0f)
+		return 0.0f;
+	return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+// half the surface area, all SAH needs.
+static inline float getHalfArea(__m128 minExtents, __m128 maxExtents)
+{
+	const __m128 d = _mm_max_ps(_mm_sub_ps(maxExtents, minExtents), _mm_setzero_ps());
+	const __m128 rotated = _mm_shuffle_ps(d, d, _MM_SHUFFLE(3, 0, 2, 1));
+	const __m128 products = _mm_mul_ps(d, rotated);
+	float p[4];
+	_mm_storeu_ps(p, products);
+	return p[0] + p[1] + p[2];
+}
+
+static inline Box3 toBox(__m128 minExtents, __m128 maxExtents)
+{
+	float lo[4], hi[4];
+	_mm_storeu_ps(lo, minExtents);
+	_mm_storeu_ps(hi, maxExtents);
+	return Box3(Vector3(lo[0], lo[1], lo[2]), Vector3(hi[0], hi[1], hi[2]));
+}
+
+namespace
+{
+	// SSE bounds, min/max of the boxes and of their centroids.
+	struct SIMDBounds
+	{
+		__m128	minExtents;
+		__m128	maxExtents;
+		__m128	minCentroid;
+		__m128	maxCentroid;
+
+		void clear()
+		{
+			minExtents = minCentroid = _mm_set1_ps(FLT_MAX);
+			maxExtents = maxCentroid = _mm_set1_ps(-FLT_MAX);
+		}
+
+		void add(__m128 lo, __m128 hi, __m128 centroid)
+		{
+			minExtents = _mm_min_ps(minExtents, lo);
+			maxExtents = _mm_max_ps(maxExtents, hi);
+			minCentroid = _mm_min_ps(minCentroid, centroid);
+			maxCentroid = _mm_max_ps(maxCentroid, centroid);
+		}
+
+		void merge(const SIMDBounds& other)
+		{
+			minExtents = _mm_min_ps(minExtents, other.minExtents);
+			maxExtents = _mm_max_ps(maxExtents, other.maxExtents);
+			minCentroid = _mm_min_ps(minCentroid, other.minCentroid);
+			maxCentroid = _mm_max_ps(maxCentroid, other.maxCentroid);
+		}
+	};
+
+	// results go out as plain floats, the heap doesn't align __m128 on
+	// every platform.
+	struct Bin
+	{
+		float		bounds[4][4];	///< SIMDBounds fields.
+		uint32_t	count;
+
+		void store(const SIMDBounds& b)
+		{
+			_mm_storeu_ps(bounds[0], b.minExtents);
+			_mm_storeu_ps(bounds[1], b.maxExtents);
+			_mm_storeu_ps(bounds[2], b.minCentroid);
+			_mm_storeu_ps(bounds[3], b.maxCentroid);
+		}
+
+		SIMDBounds load() const
+		{
+			SIMDBounds b;
+			b.minExtents = _mm_loadu_ps(bounds[0]);
+			b.maxExtents = _mm_loadu_ps(bounds[1]);
+			b.minCentroid = _mm_loadu_ps(bounds[2]);
+			b.maxCentroid = _mm_loadu_ps(bounds[3]);
+			return b;
+		}
+	};
+
+	// bins for all three axes per chunk, merged after the pass. The
+	// bounds pass is the same with a single bin.
+	struct BinPass
+	{
+		const float*	prims;		///< BuildPrim array, 8 floats each.
+		uint32_t		begin;
+		uint32_t		end;
+		uint32_t		chunkCount;
+		uint32_t		binCount;	///< per axis, 1 for the bounds pass.
+		float			binOrigin[4];
+		float			binScale[4];
+		Bin*			bins;		///< chunk * 3 * binCount, local or heap.
+		Bin				local[3 * CoreBVH::BinCount];	///< enough for one chunk.
+		std::vector<Bin>	heap;
+
+		void allocate()
+		{
+			if (chunkCount > 1)
+			{
+				heap.resize(chunkCount * 3 * binCount);
+				bins = &heap[0];
+			}
+			else
+				bins = local;
+		}
+	};
+}
+
+static void binChunks(void* data, uint32_t first, uint32_t last)
+{
+	BinPass* pass = (BinPass*)data;
+	const uint32_t binCount = pass->binCount;
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 origin = _mm_loadu_ps(pass->binOrigin);
+	const __m128 scale = _mm_loadu_ps(pass->binScale);
+	const __m128i maxBin = _mm_set1_epi32((int)binCount - 1);
+	const __m128i zeroBin = _mm_setzero_si128();
+
+	SIMDBounds bins[3 * CoreBVH::BinCount];
+	uint32_t counts[3 * CoreBVH::BinCount];
+
+	for (uint32_t chunk = first; chunk < last; chunk++)
+	{
+		for (uint32_t b = 0; b < 3 * binCount; b++)
+		{
+			bins[b].clear();
+			counts[b] = 0;
+		}
+
+		const uint32_t size = (pass->end - pass->begin + pass->chunkCount - 1) / pass->chunkCount;
+		const uint32_t begin = std::min(pass->begin + chunk * size, pass->end);
+		const uint32_t end = std::min(begin + size, pass->end);
+
+		for (uint32_t i = begin; i < end; i++)
+		{
+			const float* prim = pass->prims + i * 8;
+			const __m128 lo = _mm_loadu_ps(prim);
+			const __m128 hi = _mm_loadu_ps(prim + 4);
+			const __m128 centroid = _mm_mul_ps(_mm_add_ps(lo, hi), half);
+
+			// bin index for x, y and z in one go.
+			__m128i index = _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(centroid, origin), scale));
+			index = _mm_max_epi16(_mm_min_epi16(index, maxBin), zeroBin);
+			int binIndex[4];
+			_mm_storeu_si128((__m128i*)binIndex, index);
+
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const uint32_t b = axis * binCount + (uint32_t)binIndex[axis];
+				bins[b].add(lo, hi, centroid);
+				counts[b]++;
+			}
+		}
+
+		Bin* out = &pass->bins[chunk * 3 * binCount];
+		for (uint32_t b = 0; b < 3 * binCount; b++)
+		{
+			out[b].store(bins[b]);
+			out[b].count = counts[b];
+		}
+	}
+}
+
+struct CoreBVH::BuildChildren
+{
+	CoreBVH*	bvh;
+	Range		ranges[Width];
+	uint32_t	nodes[Width];	///< EmptyChild for leaves.
+};
+
+CoreBVH::CoreBVH()
+{
+	mJobs = NULL;
+	mNextNode = 0;
+	mNodeMemory = NULL;
+	mNodes = NULL;
+	mNodeCapacity = 0;
+	mNodeCount = 0;
+	mBounds = emptyBox();
+	mBuildTime = 0.0;
+}
+
+CoreBVH::~CoreBVH()
+{
+	destroy();
+}
+
+void CoreBVH::destroy()
+{
+	delete[] mNodeMemory;
+	mNodeMemory = NULL;
+	mNodes = NULL;
+	mNodeCapacity = 0;
+	mNodeCount = 0;
+
+	mBuildPrims.clear();
+	mIndices.clear();
+	mPrimitives.clear();
+	mBoxes.clear();
+	mTriangles.clear();
+	mBounds = emptyBox();
+}
+
+void CoreBVH::allocateNodes(uint32_t count)
+{
+	if (count > mNodeCapacity)
+	{
+		delete[] mNodeMemory;
+		mNodeMemory = new uint8_t[count * sizeof(Node) + 64];
+		mNodeCapacity = count;
+	}
+
+	// two whole cache lines a node.
+	mNodes = (Node*)(((uintptr_t)mNodeMemory + 63) & ~(uintptr_t)63);
+}
+
+void CoreBVH::setChild(Node& node, uint32_t slot, const Box3& bounds, uint32_t child)
+{
+	node.minX[slot] = bounds.minExtents.x;
+	node.minY[slot] = bounds.minExtents.y;
+	node.minZ[slot] = bounds.minExtents.z;
+	node.maxX[slot] = bounds.maxExtents.x;
+	node.maxY[slot] = bounds.maxExtents.y;
+	node.maxZ[slot] = bounds.maxExtents.z;
+	node.children[slot] = child;
+}
+
+void CoreBVH::setBuildPrim(uint32_t index, const Box3& box)
+{
+	BuildPrim& prim = mBuildPrims[index];
+	prim.minExtents[0] = box.minExtents.x;
+	prim.minExtents[1] = box.minExtents.y;
+	prim.minExtents[2] = box.minExtents.z;
+	prim.minExtents[3] = 0.0f;
+	prim.maxExtents[0] = box.maxExtents.x;
+	prim.maxExtents[1] = box.maxExtents.y;
+	prim.maxExtents[2] = box.maxExtents.z;
+	prim.maxExtents[3] = 0.0f;
+}
+
+bool CoreBVH::buildBoxes(const Box3* boxes, uint32_t count, CoreJobSystem* jobs)
+{
+	destroy();
+	if (!count)
+		return false;
+
+	mBuildPrims.resize(count);
+	mBoxes.assign(boxes, boxes + count);
+	for (uint32_t i = 0; i < count; i++)
+		setBuildPrim(i, boxes[i]);
+
+	return build(count, jobs);
+}
+
+bool CoreBVH::buildTriangles(const float* positions, uint32_t stride, const uint32_t* indices, uint32_t triangleCount, CoreJobSystem* jobs)
+{
+	destroy();
+	if (!triangleCount)
+		return false;
+
+	mBuildPrims.resize(triangleCount);
+	mBoxes.resize(triangleCount);
+	mTriangles.resize(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; i++)
+	{
+		const float* p0 = (const float*)((const uint8_t*)positions + indices[i * 3 + 0] * stride);
+		const float* p1 = (const float*)((const uint8_t*)positions + indices[i * 3 + 1] * stride);
+		const float* p2 = (const float*)((const uint8_t*)positions + indices[i * 3 + 2] * stride);
+		const Vector3 v0(p0[0], p0[1], p0[2]);
+		const Vector3 v1(p1[0], p1[1], p1[2]);
+		const Vector3 v2(p2[0], p2[1], p2[2]);
+
+		mTriangles[i].v0 = v0;
+		mTriangles[i].edge1 = v1 - v0;
+		mTriangles[i].edge2 = v2 - v0;
+
+		Box3 box(v0, v0);
+		box.merge(Box3(v1, v1));
+		box.merge(Box3(v2, v2));
+		mBoxes[i] = box;
+		setBuildPrim(i, box);
+	}
+
+	return build(triangleCount, jobs);
+}
+
+bool CoreBVH::build(uint32_t count, CoreJobSystem* jobs)
+{
+	if (count > LeafFirstMask)
+	{
+		printf("BVH: %d primitives, at most %d fit.\n", count, LeafFirstMask);
+		destroy();
+		return false;
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	mJobs = jobs;
+	mIndices.resize(count);
+	for (uint32_t i = 0; i < count; i++)
+		mIndices[i] = i;
+
+	// every inner node but the root has more than a leaf's worth, so
+	// there are never more nodes than primitives.
+	allocateNodes(count);
+	mNextNode = 1;
+
+	Range root;
+	root.begin = 0;
+	root.end = count;
+	computeBounds(root);
+	mBounds = root.bounds;
+	buildNode(0, root);
+	mNodeCount = mNextNode.load();
+
+	// boxes and triangles into leaf order.
+	mPrimitives.swap(mIndices);
+	std::vector<Box3> boxes(count);
+	for (uint32_t i = 0; i < count; i++)
+		boxes[i] = mBoxes[mPrimitives[i]];
+	mBoxes.swap(boxes);
+
+	if (!mTriangles.empty())
+	{
+		std::vector<Triangle> triangles(count);
+		for (uint32_t i = 0; i < count; i++)
+			triangles[i] = mTriangles[mPrimitives[i]];
+		mTriangles.swap(triangles);
+	}
+
+	mBuildPrims.clear();
+	mBuildPrims.shrink_to_fit();
+	mJobs = NULL;
+
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+	mBuildTime = elapsed.count();
+	return true;
+}
+
+void CoreBVH::computeBounds(Range& range)
+{
+	// a single bin per axis, everything lands in it.
+	BinPass pass;
+	pass.prims = mBuildPrims[0].minExtents;
+	pass.begin = range.begin;
+	pass.end = range.end;
+	pass.binCount = 1;
+	memset(pass.binOrigin, 0, sizeof(pass.binOrigin));
+	memset(pass.binScale, 0, sizeof(pass.binScale));
+	pass.chunkCount = 1;
+	if (mJobs && range.end - range.begin > ParallelPassThreshold)
+		pass.chunkCount = std::min(mJobs->getThreadCount(), MaxPassChunks);
+	pass.allocate();
+
+	if (pass.chunkCount > 1)
+		mJobs->parallelFor(pass.chunkCount, 1, binChunks, &pass);
+	else
+		binChunks(&pass, 0, 1);
+
+	SIMDBounds bounds = pass.bins[0].load();
+	for (uint32_t i = 1; i < pass.chunkCount; i++)
+		bounds.merge(pass.bins[i * 3].load());
+
+	range.bounds = toBox(bounds.minExtents, bounds.maxExtents);
+	range.centroidBounds = toBox(bounds.minCentroid, bounds.maxCentroid);
+}
+
+// halves by position in the range, always leaves both sides non empty
+// for two or more prims.
+void CoreBVH::splitMedian(const Range& range, Range& left, Range& right)
+{
+	const uint32_t mid = range.begin + (range.end - range.begin) / 2;
+	left.begin = range.begin;
+	left.end = mid;
+	right.begin = mid;
+	right.end = range.end;
+	computeBounds(left);
+	computeBounds(right);
+}
+
+void CoreBVH::splitRange(const Range& range, Range& left, Range& right)
+{
+	const Vector3 extent = range.centroidBounds.maxExtents - range.centroidBounds.minExtents;
+	if (extent.x <= 0.0f && extent.y <= 0.0f && extent.z <= 0.0f)
+	{
+		// every centroid in the same spot, any split is as good.
+		splitMedian(range, left, right);
+		return;
+	}
+
+	// small ranges don't need all the bins.
+	const uint32_t binCount = std::min(range.end - range.begin, (uint32_t)BinCount);
+
+	BinPass pass;
+	pass.prims = mBuildPrims[0].minExtents;
+	pass.begin = range.begin;
+	pass.end = range.end;
+	pass.binCount = binCount;
+	pass.chunkCount = 1;
+	if (mJobs && range.end - range.begin > ParallelPassThreshold)
+		pass.chunkCount = std::min(mJobs->getThreadCount(), MaxPassChunks);
+
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		pass.binOrigin[axis] = range.centroidBounds.minExtents[axis];
+		pass.binScale[axis] = extent[axis] > 0.0f ? binCount * 0.9999f / extent[axis] : 0.0f;
+	}
+	pass.binOrigin[3] = 0.0f;
+	pass.binScale[3] = 0.0f;
+	pass.allocate();
+
+	if (pass.chunkCount > 1)
+		mJobs->parallelFor(pass.chunkCount, 1, binChunks, &pass);
+	else
+		binChunks(&pass, 0, 1);
+
+	SIMDBounds bins[3 * BinCount];
+	uint32_t counts[3 * BinCount];
+	for (uint32_t b = 0; b < 3 * binCount; b++)
+	{
+		bins[b] = pass.bins[b].load();
+		counts[b] = pass.bins[b].count;
+		for (uint32_t chunk = 1; chunk < pass.chunkCount; chunk++)
+		{
+			bins[b].merge(pass.bins[chunk * 3 * binCount + b].load());
+			counts[b] += pass.bins[chunk * 3 * binCount + b].count;
+		}
+	}
+
+	// SAH, cost of a split after bin b is area * count on either side.
+	float bestCost = FLT_MAX;
+	uint32_t bestAxis = 0;
+	uint32_t bestBin = 0;
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		if (extent[axis] <= 0.0f)
+			continue;
+
+		const SIMDBounds* axisBins = &bins[axis * binCount];
+		const uint32_t* axisCounts = &counts[axis * binCount];
+		float rightCost[BinCount];
+		SIMDBounds box;
+		box.clear();
+		uint32_t count = 0;
+		for (uint32_t b = binCount - 1; b > 0; b--)
+		{
+			box.merge(axisBins[b]);
+			count += axisCounts[b];
+			rightCost[b] = count ? getHalfArea(box.minExtents, box.maxExtents) * count : FLT_MAX;
+		}
+
+		box.clear();
+		count = 0;
+		for (uint32_t b = 0; b < binCount - 1; b++)
+		{
+			box.merge(axisBins[b]);
+			count += axisCounts[b];
+			if (!count || rightCost[b + 1] == FLT_MAX)
+				continue;
+
+			const float cost = getHalfArea(box.minExtents, box.maxExtents) * count + rightCost[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+
+	// no usable SAH split: the costs overflowed or the centroids are
+	// huge or NaN, so the bins can't tell the prims apart.
+	if (bestCost == FLT_MAX)
+	{
+		splitMedian(range, left, right);
+		return;
+	}
+
+	// prims move with their index so the next passes read them in order.
+	const float origin = pass.binOrigin[bestAxis];
+	const float scale = pass.binScale[bestAxis];
+	uint32_t mid = range.begin;
+	uint32_t end = range.end;
+	while (mid < end)
+	{
+		const BuildPrim& prim = mBuildPrims[mid];
+		const float centroid = (prim.minExtents[bestAxis] + prim.maxExtents[bestAxis]) * 0.5f;
+		if ((int)((centroid - origin) * scale) <= (int)bestBin)
+		{
+			mid++;
+			continue;
+		}
+
+		end--;
+		std::swap(mBuildPrims[mid], mBuildPrims[end]);
+		std::swap(mIndices[mid], mIndices[end]);
+	}
+
+	// every prim on one side after all, e.g. centroids binned by NaN.
+	if (mid == range.begin || mid == range.end)
+	{
+		splitMedian(range, left, right);
+		return;
+	}
+
+	left.begin = range.begin;
+	left.end = mid;
+	right.begin = left.end;
+	right.end = range.end;
+
+	SIMDBounds sides[2];
+	sides[0].clear();
+	sides[1].clear();
+	for (uint32_t b = 0; b < binCount; b++)
+		sides[b <= bestBin ? 0 : 1].merge(bins[bestAxis * binCount + b]);
+
+	left.bounds = toBox(sides[0].minExtents, sides[0].maxExtents);
+	left.centroidBounds = toBox(sides[0].minCentroid, sides[0].maxCentroid);
+	right.bounds = toBox(sides[1].minExtents, sides[1].maxExtents);
+	right.centroidBounds = toBox(sides[1].minCentroid, sides[1].maxCentroid);
+}
+
+void CoreBVH::buildNode(uint32_t nodeIndex, const Range& range)
+{
+	BuildChildren work;
+	work.bvh = this;
+	work.ranges[0] = range;
+	uint32_t count = 1;
+
+	// keep splitting the child with the biggest area until there are four.
+	while (count < Width)
+	{
+		// an infinite or NaN area still gets its range split.
+		int split = -1;
+		float splitArea = -1.0f;
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const float area = getArea(work.ranges[i].bounds);
+			if (work.ranges[i].end - work.ranges[i].begin > MaxLeafSize && (split < 0 || area > splitArea))
+			{
+				split = (int)i;
+				splitArea = area;
+			}
+		}
+
+		if (split < 0)
+			break;
+
+		// both sides always get prims, so no child is ever built again
+		// over the range it came from.
+		Range left, right;
+		splitRange(work.ranges[split], left, right);
+
+		work.ranges[split] = left;
+		work.ranges[count++] = right;
+	}
+
+	Node& node = mNodes[nodeIndex];
+	for (uint32_t i = 0; i < Width; i++)
+		setChild(node, i, emptyBox(), EmptyChild);
+	memset(node.pad, 0, sizeof(node.pad));
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const Range& child = work.ranges[i];
+		const uint32_t size = child.end - child.begin;
+		if (size <= MaxLeafSize)
+		{
+			work.nodes[i] = EmptyChild;
+			setChild(node, i, child.bounds, LeafBit | (size << LeafCountShift) | child.begin);
+		}
+		else
+		{
+			work.nodes[i] = mNextNode.fetch_add(1);
+			setChild(node, i, child.bounds, work.nodes[i]);
+		}
+	}
+
+	if (mJobs && range.end - range.begin > ParallelThreshold)
+		mJobs->parallelFor(count, 1, buildChildJob, &work);
+	else
+		buildChildJob(&work, 0, count);
+}
+
+void CoreBVH::buildChildJob(void* data, uint32_t begin, uint32_t end)
+{
+	BuildChildren* work = (BuildChildren*)data;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		if (work->nodes[i] != EmptyChild)
+			work->bvh->buildNode(work->nodes[i], work->ranges[i]);
+	}
+}
+
+bool CoreBVH::hitLeaf(uint32_t child, const Vector3& origin, const Vector3& direction, CoreBVHHit& hit) const
+{
+	const uint32_t first = child & LeafFirstMask;
+	const uint32_t count = (child & ~LeafBit) >> LeafCountShift;
+	bool found = false;
+
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		if (!mTriangles.empty())
+		{
+			// Moller-Trumbore.
+			const Triangle& tri = mTriangles[i];
+			const Vector3 p = direction.cross(tri.edge2);
+			const float det = tri.edge1.dot(p);
+			if (fabsf(det) < 1e-12f)
+				continue;
+
+			const float invDet = 1.0f / det;
+			const Vector3 s = origin - tri.v0;
+			const float u = s.dot(p) * invDet;
+			if (u < 0.0f || u > 1.0f)
+				continue;
+
+			const Vector3 q = s.cross(tri.edge1);
+			const float v = direction.dot(q) * invDet;
+			if (v < 0.0f || u + v > 1.0f)
+				continue;
+
+			const float t = tri.edge2.dot(q) * invDet;
+			if (t < 0.0f || t >= hit.distance)
+				continue;
+
+			hit.primitive = mPrimitives[i];
+			hit.distance = t;
+			hit.u = u;
+			hit.v = v;
+			found = true;
+		}
+		else
+		{
+			const Box3& box = mBoxes[i];
+			float tmin = 0.0f;
+			float tmax = hit.distance;
+			bool miss = false;
+			for (int axis = 0; axis < 3 && !miss; axis++)
+			{
+				const float inv = 1.0f / direction[axis];
+				float t0 = (box.minExtents[axis] - origin[axis]) * inv;
+				float t1 = (box.maxExtents[axis] - origin[axis]) * inv;
+				if (t0 > t1)
+					std::swap(t0, t1);
+				tmin = std::max(tmin, t0);
+				tmax = std::min(tmax, t1);
+				miss = tmin > tmax;
+			}
+
+			if (miss || tmin >= hit.distance)
+				continue;
+
+			hit.primitive = mPrimitives[i];
+			hit.distance = tmin;
+			hit.u = hit.v = 0.0f;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+bool CoreBVH::raycast(const Vector3& origin, const Vector3& direction, float maxDistance, CoreBVHHit& hit) const
+{
+	if (!mNodeCount)
+		return false;
+
+	hit.primitive = 0;
+	hit.distance = maxDistance;
+	hit.u = hit.v = 0.0f;
+	bool found = false;
+
+	const __m128 ox = _mm_set1_ps(origin.x);
+	const __m128 oy = _mm_set1_ps(origin.y);
+	const __m128 oz = _mm_set1_ps(origin.z);
+	const __m128 ix = _mm_set1_ps(1.0f / direction.x);
+	const __m128 iy = _mm_set1_ps(1.0f / direction.y);
+	const __m128 iz = _mm_set1_ps(1.0f / direction.z);
+	const __m128 zero = _mm_setzero_ps();
+
+	uint32_t stack[StackSize];
+	float stackDistance[StackSize];
+	uint32_t top = 0;
+	stack[top] = 0;
+	stackDistance[top++] = 0.0f;
+
+	while (top)
+	{
+		top--;
+		if (stackDistance[top] > hit.distance)
+			continue;
+
+		const uint32_t child = stack[top];
+		if (child & LeafBit)
+		{
+			found |= hitLeaf(child, origin, direction, hit);
+			continue;
+		}
+
+		// slab test against all four children at once.
+		const Node& node = mNodes[child];
+		const __m128 tx0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix);
+		const __m128 tx1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+		const __m128 ty0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy);
+		const __m128 ty1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+		const __m128 tz0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz);
+		const __m128 tz1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+
+		const __m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)), _mm_max_ps(_mm_min_ps(tz0, tz1), zero));
+		const __m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)), _mm_min_ps(_mm_max_ps(tz0, tz1), _mm_set1_ps(hit.distance)));
+		const int mask = _mm_movemask_ps(_mm_cmple_ps(tmin, tmax));
+		if (!mask)
+			continue;
+
+		float distances[Width];
+		_mm_storeu_ps(distances, tmin);
+
+		// push far to near so the nearest child is visited first.
+		uint32_t order[Width];
+		uint32_t hits = 0;
+		for (uint32_t i = 0; i < Width; i++)
+		{
+			if (!(mask & (1 << i)) || node.children[i] == EmptyChild)
+				continue;
+
+			uint32_t j = hits++;
+			while (j > 0 && distances[order[j - 1]] < distances[i])
+			{
+				order[j] = order[j - 1];
+				j--;
+			}
+			order[j] = i;
+		}
+
+		for (uint32_t i = 0; i < hits && top < StackSize; i++)
+		{
+			stack[top] = node.children[order[i]];
+			stackDistance[top++] = distances[order[i]];
+		}
+	}
+
+	return found;
+}
+
+uint32_t CoreBVH::queryBox(const Box3& box, std::vector<uint32_t>& out) const
+{
+	if (!mNodeCount)
+		return 0;
+
+	const size_t start = out.size();
+	const __m128 bminX = _mm_set1_ps(box.minExtents.x);
+	const __m128 bminY = _mm_set1_ps(box.minExtents.y);
+	const __m128 bminZ = _mm_set1_ps(box.minExtents.z);
+	const __m128 bmaxX = _mm_set1_ps(box.maxExtents.x);
+	const __m128 bmaxY = _mm_set1_ps(box.maxExtents.y);
+	const __m128 bmaxZ = _mm_set1_ps(box.maxExtents.z);
+
+	uint32_t stack[StackSize];
+	uint32_t top = 0;
+	stack[top++] = 0;
+
+	while (top)
+	{
+		const uint32_t child = stack[--top];
+		if (child & LeafBit)
+		{
+			const uint32_t first = child & LeafFirstMask;
+			const uint32_t count = (child & ~LeafBit) >> LeafCountShift;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				const Box3& prim = mBoxes[i];
+				if (prim.minExtents.x <= box.maxExtents.x && prim.maxExtents.x >= box.minExtents.x &&
+					prim.minExtents.y <= box.maxExtents.y && prim.maxExtents.y >= box.minExtents.y &&
+					prim.minExtents.z <= box.maxExtents.z && prim.maxExtents.z >= box.minExtents.z)
+					out.push_back(mPrimitives[i]);
+			}
+			continue;
+		}
+
+		const Node& node = mNodes[child];
+		__m128 overlap = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minX), bmaxX), _mm_cmpge_ps(_mm_load_ps(node.maxX), bminX));
+		overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minY), bmaxY), _mm_cmpge_ps(_mm_load_ps(node.maxY), bminY)));
+		overlap = _mm_and_ps(overlap, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minZ), bmaxZ), _mm_cmpge_ps(_mm_load_ps(node.maxZ), bminZ)));
+		const int mask = _mm_movemask_ps(overlap);
+
+		for (uint32_t i = 0; i < Width && top < StackSize; i++)
+		{
+			if ((mask & (1 << i)) && node.children[i] != EmptyChild)
+				stack[top++] = node.children[i];
+		}
+	}
+
+	return (uint32_t)(out.size() - start);
+}
@@ -0,0 +1,141 @@
+#ifndef COREBVH_H_
+#define COREBVH_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+#include "math/box3.h"
+
+class CoreJobSystem;
+
+struct CoreBVHHit
+{
+	uint32_t	primitive;	///< index into the boxes or triangles the tree was built from.
+	float		distance;	///< along the ray, in units of the direction's length.
+	float		u, v;		///< barycentrics of the hit, 0 for boxes.
+};
+
+//-------------------------------------------------------------
+// Bounding volume hierarchy
+//-------------------------------------------------------------
+// 4-wide BVH over boxes or triangles. Every node holds the bounds of
+// its four children as SoA floats, so one SSE pass tests a ray or a
+// box against all four. Nodes are 128 bytes, two cache lines, stored
+// in one aligned array with the root first.
+//
+// The builder is top-down binned SAH: a node's primitives are split
+// in two at the cheapest of BinCount candidate planes per axis, and
+// the biggest child is split again until there are four. Subtrees
+// over ParallelThreshold primitives build on the job system, as do
+// the bounds and binning passes over big ranges.
+//
+// Leaves hold up to MaxLeafSize primitives. Triangles and boxes are
+// copied into leaf order at the end of the build so queries walk
+// memory forward.
+class CoreBVH
+{
+public:
+	enum
+	{
+		Width = 4,
+		MaxLeafSize = 4,
+		BinCount = 16,
+		ParallelThreshold = 4096,	///< subtrees smaller than this build on one thread.
+		StackSize = 256,
+	};
+
+	struct Node
+	{
+		float		minX[Width];
+		float		minY[Width];
+		float		minZ[Width];
+		float		maxX[Width];
+		float		maxY[Width];
+		float		maxZ[Width];
+		uint32_t	children[Width];	///< inner node index, or leaf bit | count | first.
+		uint32_t	pad[Width];
+	};
+
+	CoreBVH();
+	~CoreBVH();
+
+	bool buildBoxes(const Box3* boxes, uint32_t count, CoreJobSystem* jobs = NULL);
+
+	// stride in bytes between positions, three floats each.
+	bool buildTriangles(const float* positions, uint32_t stride, const uint32_t* indices, uint32_t triangleCount, CoreJobSystem* jobs = NULL);
+	void destroy();
+
+	// nearest hit closer than maxDistance. Boxes are hit on entry, or
+	// at 0 when the origin is inside.
+	bool raycast(const Vector3& origin, const Vector3& direction, float maxDistance, CoreBVHHit& hit) const;
+
+	// every primitive whose bounds touch box, appended to out. Returns
+	// the number added.
+	uint32_t queryBox(const Box3& box, std::vector<uint32_t>& out) const;
+
+	bool		isEmpty() const { return mNodeCount == 0; }
+	uint32_t	getNodeCount() const { return mNodeCount; }
+	uint32_t	getPrimitiveCount() const { return (uint32_t)mPrimitives.size(); }
+	Box3		getBounds() const { return mBounds; }
+	double		getBuildTime() const { return mBuildTime; }	///< ms.
+
+private:
+	// w unused, so bounds load as one SSE register each.
+	struct BuildPrim
+	{
+		float	minExtents[4];
+		float	maxExtents[4];
+	};
+
+	struct Triangle
+	{
+		Vector3	v0;
+		Vector3	edge1;
+		Vector3	edge2;
+	};
+
+	struct Range
+	{
+		uint32_t	begin;
+		uint32_t	end;
+		Box3		bounds;
+		Box3		centroidBounds;
+	};
+
+	struct BuildChildren;
+
+	void setBuildPrim(uint32_t index, const Box3& box);
+	bool build(uint32_t count, CoreJobSystem* jobs);
+	void buildNode(uint32_t nodeIndex, const Range& range);
+	void splitRange(const Range& range, Range& left, Range& right);
+	void splitMedian(const Range& range, Range& left, Range& right);
+	void computeBounds(Range& range);
+	static void buildChildJob(void* data, uint32_t begin, uint32_t end);
+
+	void allocateNodes(uint32_t count);
+	void setChild(Node& node, uint32_t slot, const Box3& bounds, uint32_t child);
+
+	bool hitLeaf(uint32_t child, const Vector3& origin, const Vector3& direction, CoreBVHHit& hit) const;
+
+	// build input, partitioned in place together, ends up in leaf order.
+	std::vector<BuildPrim>	mBuildPrims;
+	std::vector<uint32_t>	mIndices;		///< original index of each build prim.
+	CoreJobSystem*			mJobs;
+	std::atomic<uint32_t>	mNextNode;
+
+	uint8_t*				mNodeMemory;
+	Node*					mNodes;			///< 64 byte aligned.
+	uint32_t				mNodeCapacity;
+	uint32_t				mNodeCount;
+
+	// leaf order.
+	std::vector<uint32_t>	mPrimitives;	///< original index of every leaf entry.
+	std::vector<Box3>		mBoxes;
+	std::vector<Triangle>	mTriangles;
+	Box3					mBounds;
+	double					mBuildTime;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#include "core/coreBVHBenchmark.h"
+#include "core/coreBVH.h"
+#include "core/coreJobSystem.h"
+
+#include <stdio.h>
+#include <float.h>
+#include <chrono>
+#include <vector>
+
+void coreRunBVHBenchmark(CoreJobSystem* jobs, uint32_t gridSize, uint32_t rayCount)
+{
+	// rolling hills, so the tree has some depth to it.
+	const uint32_t rowSize = gridSize + 1;
+	std::vector<float> positions(rowSize * rowSize * 3);
+	for (uint32_t z = 0; z < rowSize; z++)
+	{
+		for (uint32_t x = 0; x < rowSize; x++)
+		{
+			float* p = &positions[(z * rowSize + x) * 3];
+			p[0] = (float)x;
+			p[1] = sinf(x * 0.1f) * cosf(z * 0.1f) * 5.0f;
+			p[2] = (float)z;
+		}
+	}
+
+	std::vector<uint32_t> indices;
+	indices.reserve(gridSize * gridSize * 6);
+	for (uint32_t z = 0; z < gridSize; z++)
+	{
+		for (uint32_t x = 0; x < gridSize; x++)
+		{
+			const uint32_t corner = z * rowSize + x;
+			const uint32_t quad[6] = { corner, corner + rowSize, corner + 1, corner + 1, corner + rowSize, corner + rowSize + 1 };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+
+	const uint32_t triangleCount = (uint32_t)indices.size() / 3;
+	CoreBVH bvh;
+	bvh.buildTriangles(&positions[0], 3 * sizeof(float), &indices[0], triangleCount, jobs);
+	printf("BVH benchmark: %d triangles, %d nodes, built in %.2f ms on %d threads.\n",
+		triangleCount, bvh.getNodeCount(), bvh.getBuildTime(), jobs ? jobs->getThreadCount() : 1);
+
+	// slightly tilted rays from above, spread over the whole field.
+	uint32_t seed = 12345;
+	uint32_t hits = 0;
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < rayCount; i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		const float u = (seed >> 8) * (1.0f / 16777216.0f);
+		seed = seed * 1664525u + 1013904223u;
+		const float v = (seed >> 8) * (1.0f / 16777216.0f);
+
+		const Vector3 origin(u * gridSize, 50.0f, v * gridSize);
+		const Vector3 direction(0.1f * (u - 0.5f), -1.0f, 0.1f * (v - 0.5f));
+		CoreBVHHit hit;
+		if (bvh.raycast(origin, direction, FLT_MAX, hit))
+			hits++;
+	}
+	std::chrono::duration<double, std::micro> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	printf("  %d rays, %d hits, %.3f us a ray.\n", rayCount, hits, elapsed.count() / rayCount);
+}
@@ -0,0 +1,16 @@
+#ifndef COREBVHBENCHMARK_H_
+#define COREBVHBENCHMARK_H_
+
+#include <stdint.h>
+
+class CoreJobSystem;
+
+//-------------------------------------------------------------
+// BVH benchmark
+//-------------------------------------------------------------
+// Builds a BVH over a gridSize x gridSize height field, two triangles
+// a cell, and prints the build time and the average time of
+// rayCount picking rays cast down at it.
+void coreRunBVHBenchmark(CoreJobSystem* jobs, uint32_t gridSize = 1024, uint32_t rayCount = 100000);
+
+#endif
@@ -0,0 +1,216 @@
+#include "core/coreJobBenchmark.h"
+#include "core/coreJobSystem.h"
+#include "platform/platformThread.h"
+#include "math/matrix.h"
+#include "math/frustum.h"
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// objects a job handles at least, small enough to balance a 4K scene
+// over many cores.
+static const uint32_t BenchmarkGrain = 64;
+
+namespace
+{
+	struct BenchmarkScene
+	{
+		Matrix4					parent;		///< animated every frame.
+		Frustum					frustum;
+		std::vector<Matrix4>	locals;
+		std::vector<Matrix4>	worlds;
+		std::vector<float>		radii;
+		std::vector<uint8_t>	visible;
+	};
+}
+
+static void updateObjects(void* data, uint32_t begin, uint32_t end)
+{
+	BenchmarkScene* scene = (BenchmarkScene*)data;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		scene->worlds[i] = scene->parent * scene->locals[i];
+		const Vector3 center = scene->worlds[i] * Vector3(0.0f, 0.0f, 0.0f);
+		scene->visible[i] = scene->frustum.intersectsSphere(center, scene->radii[i]) ? 1 : 0;
+	}
+}
+
+// ms per frame.
+static double runFrames(CoreJobSystem& jobs, BenchmarkScene& scene, uint32_t frameCount, uint32_t& visibleCount)
+{
+	const uint32_t count = (uint32_t)scene.locals.size();
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	for (uint32_t frame = 0; frame < frameCount; frame++)
+	{
+		scene.parent.identity();
+		scene.parent.rotateY((float)frame);
+		jobs.parallelFor(count, BenchmarkGrain, updateObjects, &scene);
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+	visibleCount = 0;
+	for (uint32_t i = 0; i < count; i++)
+		visibleCount += scene.visible[i];
+
+	return elapsed.count() / frameCount;
+}
+
+void coreRunJobBenchmark(uint32_t objectCount, uint32_t frameCount)
+{
+	BenchmarkScene scene;
+	scene.locals.resize(objectCount);
+	scene.worlds.resize(objectCount);
+	scene.radii.resize(objectCount);
+	scene.visible.resize(objectCount);
+
+	// a square grid of boxes like the box field, seen from above.
+	uint32_t dim = 1;
+	while (dim * dim < objectCount)
+		dim++;
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		scene.locals[i].identity();
+		scene.locals[i].rotateY((float)(i * 37 % 360));
+		scene.locals[i].translate(((float)(i % dim) - dim * 0.5f) * 3.0f, 0.0f, ((float)(i / dim) - dim * 0.5f) * 3.0f);
+		scene.radii[i] = 0.87f;
+	}
+
+	Matrix4 proj;
+	proj.setFrustum(45.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+	Matrix4 view;
+	view.lookAt(Vector3(0.0f, dim * 1.5f, dim * 1.5f), Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f));
+	// our projection matrix is stored transposed.
+	proj.transpose();
+	scene.frustum.set(proj * view);
+
+	printf("Job benchmark: %d objects, %d frames.\n", objectCount, frameCount);
+
+	const uint32_t cores = platformGetCoreCount();
+	double single = 0.0;
+	for (uint32_t threads = 1; threads <= cores; threads++)
+	{
+		CoreJobSystem jobs;
+		jobs.init(threads - 1, true, "Benchmark worker");
+
+		// once to warm up caches and wake the workers.
+		uint32_t visibleCount;
+		runFrames(jobs, scene, 10, visibleCount);
+		const double ms = runFrames(jobs, scene, frameCount, visibleCount);
+		if (threads == 1)
+			single = ms;
+
+		printf("  %2d threads: %.3f ms, %.2fx, %d visible\n", threads, ms, single / ms, visibleCount);
+		jobs.destroy();
+	}
+}
+
+//-------------------------------------------------------------
+// stress test
+//-------------------------------------------------------------
+
+namespace
+{
+	struct StressRun
+	{
+		CoreJobSystem*			jobs;
+		std::atomic<uint32_t>*	hits;
+		uint32_t				innerCount;		///< for the nested loops.
+	};
+}
+
+static void countRange(void* data, uint32_t begin, uint32_t end)
+{
+	StressRun* run = (StressRun*)data;
+	for (uint32_t i = begin; i < end; i++)
+		run->hits[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+static void countNested(void* data, uint32_t begin, uint32_t end)
+{
+	StressRun* outer = (StressRun*)data;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		StressRun inner = { outer->jobs, outer->hits + (size_t)i * outer->innerCount, 0 };
+		outer->jobs->parallelFor(outer->innerCount, 1, countRange, &inner);
+	}
+}
+
+static void countOne(void* data, uint32_t, uint32_t)
+{
+	((std::atomic<uint32_t>*)data)->fetch_add(1, std::memory_order_relaxed);
+}
+
+// indices that didn't run exactly once, the counts are cleared.
+static uint32_t countMistakes(std::vector<std::atomic<uint32_t> >& hits, uint32_t count)
+{
+	uint32_t mistakes = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (hits[i].load(std::memory_order_relaxed) != 1)
+			mistakes++;
+		hits[i].store(0, std::memory_order_relaxed);
+	}
+	return mistakes;
+}
+
+bool coreRunJobStressTest(uint32_t rounds)
+{
+	CoreJobSystem jobs;
+	jobs.init();
+
+	const uint32_t maxCount = 1 << 20;
+	std::vector<std::atomic<uint32_t> > hits(maxCount);
+	for (uint32_t i = 0; i < maxCount; i++)
+		hits[i].store(0, std::memory_order_relaxed);
+
+	// leaf ranges far beyond MaxJobsPerThread.
+	const uint32_t loops[][2] = { { 9000, 1 }, { 200000, 1 }, { 200000, 16 }, { maxCount, 1 } };
+	const uint32_t loopCount = sizeof(loops) / sizeof(loops[0]);
+	const uint32_t runCount = 4 * CoreJobSystem::MaxJobsPerThread + 123;
+	const uint32_t nestedCount = 64;
+	const uint32_t innerCount = 8192;
+
+	printf("Job stress test: %d threads, %d rounds.\n", jobs.getThreadCount(), rounds);
+	bool passed = true;
+	for (uint32_t round = 0; round < rounds; round++)
+	{
+		for (uint32_t i = 0; i < loopCount; i++)
+		{
+			StressRun run = { &jobs, &hits[0], 0 };
+			jobs.parallelFor(loops[i][0], loops[i][1], countRange, &run);
+			const uint32_t mistakes = countMistakes(hits, loops[i][0]);
+			if (mistakes)
+			{
+				printf("  parallelFor(%d, %d): %d indices not run exactly once.\n", loops[i][0], loops[i][1], mistakes);
+				passed = false;
+			}
+		}
+
+		StressRun nested = { &jobs, &hits[0], innerCount };
+		jobs.parallelFor(nestedCount, 1, countNested, &nested);
+		uint32_t mistakes = countMistakes(hits, nestedCount * innerCount);
+		if (mistakes)
+		{
+			printf("  nested parallelFor: %d indices not run exactly once.\n", mistakes);
+			passed = false;
+		}
+
+		CoreJobCounter counter;
+		for (uint32_t i = 0; i < runCount; i++)
+			jobs.run(countOne, &hits[i], &counter);
+		jobs.wait(&counter);
+		mistakes = countMistakes(hits, runCount);
+		if (mistakes)
+		{
+			printf("  run(): %d of %d jobs not run exactly once.\n", mistakes, runCount);
+			passed = false;
+		}
+	}
+
+	printf("Job stress test %s.\n", passed ? "passed" : "FAILED");
+	jobs.destroy();
+	return passed;
+}
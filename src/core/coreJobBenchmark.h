@@ -0,0 +1,21 @@
+#ifndef COREJOBBENCHMARK_H_
+#define COREJOBBENCHMARK_H_
+
+#include <stdint.h>
+
+//-------------------------------------------------------------
+// Job system benchmark
+//-------------------------------------------------------------
+// Times a frame's worth of synthetic scene work, a world transform and
+// a frustum sphere test per object, on 1 up to every core and prints
+// the time per frame and the speedup over one thread. Each thread
+// count gets a job system of its own with pinned workers.
+void coreRunJobBenchmark(uint32_t objectCount, uint32_t frameCount = 200);
+
+// Floods the job system with far more jobs than a thread has slots,
+// parallelFor ranges split down to single indices, parallelFor inside
+// jobs and a long run of run() calls, and checks every index ran
+// exactly once. Returns false and prints what went wrong otherwise.
+bool coreRunJobStressTest(uint32_t rounds = 4);
+
+#endif
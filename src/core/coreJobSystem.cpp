@@ -0,0 +1,350 @@
+#include "core/coreJobSystem.h"
+#include "platform/platformThread.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+
+// spins before an idle worker goes to sleep.
+static const uint32_t IdleSpins = 256;
+
+// set on worker threads only, the owning thread is found by id so
+// several systems can share it.
+static thread_local CoreJobSystem* sWorkerSystem = NULL;
+static thread_local uint32_t sWorkerIndex = 0;
+
+CoreJobSystem::CoreJobSystem()
+{
+	mRunning = false;
+	mSleeping = 0;
+}
+
+CoreJobSystem::~CoreJobSystem()
+{
+	destroy();
+}
+
+bool CoreJobSystem::init(uint32_t workerCount, bool pin, const char* name)
+{
+	destroy();
+
+	if (workerCount == 0)
+		workerCount = platformGetCoreCount() - 1;
+	if (workerCount > MaxWorkers)
+		workerCount = MaxWorkers;
+
+	for (uint32_t i = 0; i < workerCount + 1; i++)
+	{
+		ThreadState* state = new ThreadState;
+		state->jobs = new CoreJob[MaxJobsPerThread];
+		for (uint32_t j = 0; j < MaxJobsPerThread; j++)
+			state->jobs[j].inUse.store(0, std::memory_order_relaxed);
+		state->nextJob = 0;
+		state->stealSeed = 0x9E3779B9u * (i + 1);
+		mStates.push_back(state);
+	}
+
+	mOwner = std::this_thread::get_id();
+	mRunning = true;
+	for (uint32_t i = 1; i <= workerCount; i++)
+		mThreads.push_back(std::thread(&CoreJobSystem::workerMain, this, i, pin, name));
+
+	return true;
+}
+
+void CoreJobSystem::destroy()
+{
+	if (!mRunning && mStates.empty())
+		return;
+
+	mRunning = false;
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mSleepCondition.notify_all();
+	}
+
+	for (size_t i = 0; i < mThreads.size(); i++)
+		mThreads[i].join();
+	mThreads.clear();
+
+	for (size_t i = 0; i < mStates.size(); i++)
+	{
+		delete[] mStates[i]->jobs;
+		delete mStates[i];
+	}
+	mStates.clear();
+}
+
+void CoreJobSystem::workerMain(uint32_t index, bool pin, const char* name)
+{
+	sWorkerSystem = this;
+	sWorkerIndex = index;
+
+	char threadName[64];
+	snprintf(threadName, sizeof(threadName), "%s %d", name, index);
+	platformSetThreadName(threadName);
+	if (pin)
+		platformPinThread(index % platformGetCoreCount());
+
+	uint32_t idle = 0;
+	while (mRunning.load(std::memory_order_relaxed))
+	{
+		CoreJob* job = findJob();
+		if (job)
+		{
+			execute(job);
+			idle = 0;
+			continue;
+		}
+
+		if (++idle < IdleSpins)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		// a push that slips in before we sleep is picked up on the
+		// timeout at worst.
+		mSleeping.fetch_add(1);
+		{
+			std::unique_lock<std::mutex> lock(mSleepMutex);
+			if (mRunning.load())
+				mSleepCondition.wait_for(lock, std::chrono::milliseconds(1));
+		}
+		mSleeping.fetch_sub(1);
+		idle = 0;
+	}
+}
+
+CoreJobSystem::ThreadState* CoreJobSystem::getThreadState()
+{
+	if (sWorkerSystem == this)
+		return mStates[sWorkerIndex];
+	if (!mStates.empty() && std::this_thread::get_id() == mOwner)
+		return mStates[0];
+	return NULL;
+}
+
+CoreJob* CoreJobSystem::allocateJob()
+{
+	ThreadState* state = getThreadState();
+	if (!state)
+		return NULL;
+
+	// the slot's last job may still be queued, parked or running.
+	CoreJob* job = &state->jobs[state->nextJob & (MaxJobsPerThread - 1)];
+	if (job->inUse.load(std::memory_order_acquire))
+		return NULL;
+
+	state->nextJob++;
+	job->inUse.store(1, std::memory_order_relaxed);
+	return job;
+}
+
+void CoreJobSystem::schedule(CoreJob* job)
+{
+	ThreadState* state = getThreadState();
+
+	// not one of ours or the queue is full, do it right here.
+	if (!state || !state->queue.push(job))
+	{
+		execute(job);
+		return;
+	}
+
+	if (mSleeping.load(std::memory_order_relaxed) > 0)
+		mSleepCondition.notify_one();
+}
+
+void CoreJobSystem::submit(CoreJob* job)
+{
+	if (job->counter)
+		job->counter->mPending.fetch_add(1);
+	schedule(job);
+}
+
+void CoreJobSystem::run(CoreJobFunc func, void* data, CoreJobCounter* counter, CoreJobCounter* dependency)
+{
+	if (!getThreadState())
+	{
+		printf("Jobs can only be submitted from job system threads.\n");
+		return;
+	}
+
+	// every slot in flight, help out until the oldest one is done.
+	CoreJob* job;
+	while ((job = allocateJob()) == NULL)
+	{
+		CoreJob* other = findJob();
+		if (other)
+			execute(other);
+		else
+			std::this_thread::yield();
+	}
+
+	job->func = func;
+	job->data = data;
+	job->begin = 0;
+	job->end = 0;
+	job->counter = counter;
+	job->nextWaiting = NULL;
+
+	if (counter)
+		counter->mPending.fetch_add(1);
+
+	// park it on the dependency, whoever finishes that one queues it.
+	if (dependency)
+	{
+		std::unique_lock<std::mutex> lock(dependency->mMutex);
+		if (dependency->mPending.load() > 0)
+		{
+			job->nextWaiting = dependency->mWaiting;
+			dependency->mWaiting = job;
+			return;
+		}
+	}
+
+	schedule(job);
+}
+
+void CoreJobSystem::finish(CoreJobCounter* counter)
+{
+	if (!counter)
+		return;
+
+	// busy keeps isDone() false until we stop touching the counter.
+	counter->mBusy.fetch_add(1);
+	if (counter->mPending.fetch_sub(1) == 1)
+	{
+		CoreJob* waiting;
+		{
+			std::unique_lock<std::mutex> lock(counter->mMutex);
+			waiting = counter->mWaiting;
+			counter->mWaiting = NULL;
+		}
+
+		while (waiting)
+		{
+			CoreJob* next = waiting->nextWaiting;
+			schedule(waiting);
+			waiting = next;
+		}
+	}
+	counter->mBusy.fetch_sub(1);
+}
+
+void CoreJobSystem::execute(CoreJob* job)
+{
+	job->func(job->data, job->begin, job->end);
+
+	// the slot can be reused from here on, keep what finish() needs.
+	CoreJobCounter* counter = job->counter;
+	job->inUse.store(0, std::memory_order_release);
+	finish(counter);
+}
+
+CoreJob* CoreJobSystem::findJob()
+{
+	ThreadState* state = getThreadState();
+	if (!state)
+		return NULL;
+
+	CoreJob* job = state->queue.pop();
+	if (job)
+		return job;
+
+	// steal, starting at a random victim so thieves spread out.
+	const uint32_t count = (uint32_t)mStates.size();
+	state->stealSeed ^= state->stealSeed << 13;
+	state->stealSeed ^= state->stealSeed >> 17;
+	state->stealSeed ^= state->stealSeed << 5;
+	const uint32_t start = state->stealSeed % count;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		ThreadState* victim = mStates[(start + i) % count];
+		if (victim == state)
+			continue;
+
+		job = victim->queue.steal();
+		if (job)
+			return job;
+	}
+
+	return NULL;
+}
+
+void CoreJobSystem::wait(CoreJobCounter* counter)
+{
+	while (!counter->isDone())
+	{
+		CoreJob* job = findJob();
+		if (job)
+			execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void CoreJobSystem::parallelForJob(void* data, uint32_t begin, uint32_t end)
+{
+	ParallelFor* loop = (ParallelFor*)data;
+
+	// hand off the upper half until the range is grain sized, thieves
+	// take the biggest halves first.
+	while (end - begin > loop->grain)
+	{
+		// no free slot means plenty is in flight already, the rest of
+		// the range runs here.
+		const uint32_t mid = begin + (end - begin) / 2;
+		CoreJob* job = loop->system->allocateJob();
+		if (!job)
+			break;
+
+		job->func = parallelForJob;
+		job->data = loop;
+		job->begin = mid;
+		job->end = end;
+		job->counter = &loop->counter;
+		job->nextWaiting = NULL;
+		loop->system->submit(job);
+		end = mid;
+	}
+
+	loop->func(loop->data, begin, end);
+}
+
+void CoreJobSystem::parallelFor(uint32_t count, uint32_t grain, CoreJobFunc func, void* data)
+{
+	if (count == 0)
+		return;
+
+	// one thread or nowhere to split, no point going through the queues.
+	if (mStates.size() < 2 || count <= grain || !getThreadState())
+	{
+		func(data, 0, count);
+		return;
+	}
+
+	ParallelFor loop;
+	loop.system = this;
+	loop.func = func;
+	loop.data = data;
+	loop.grain = grain ? grain : 1;
+
+	CoreJob* job = allocateJob();
+	if (!job)
+	{
+		func(data, 0, count);
+		return;
+	}
+
+	job->func = parallelForJob;
+	job->data = &loop;
+	job->begin = 0;
+	job->end = count;
+	job->counter = &loop.counter;
+	job->nextWaiting = NULL;
+	submit(job);
+
+	wait(&loop.counter);
+}
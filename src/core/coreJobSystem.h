@@ -0,0 +1,141 @@
+#ifndef COREJOBSYSTEM_H_
+#define COREJOBSYSTEM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#include "core/coreWorkStealingQueue.h"
+
+// begin/end is the index range for parallelFor jobs, 0/0 otherwise.
+typedef void (*CoreJobFunc)(void* data, uint32_t begin, uint32_t end);
+
+class CoreJobCounter;
+
+struct CoreJob
+{
+	CoreJobFunc		func;
+	void*			data;
+	uint32_t		begin;
+	uint32_t		end;
+	CoreJobCounter*	counter;	///< decremented when the job is done, may be NULL.
+	CoreJob*		nextWaiting;	///< chain of jobs waiting on a dependency.
+	std::atomic<uint32_t> inUse;	///< set from allocation until the job has run.
+};
+
+//-------------------------------------------------------------
+// Job counter
+//-------------------------------------------------------------
+// Counts unfinished jobs. Jobs are added to it when they're submitted
+// and it drops as they finish. A job can depend on a counter, it's
+// only queued once the counter reaches zero, and wait() on a counter
+// runs other jobs until it does.
+class CoreJobCounter
+{
+public:
+	CoreJobCounter() : mPending(0), mBusy(0), mWaiting(NULL) {}
+
+	// once true nothing touches the counter anymore, it can be reused
+	// or go out of scope.
+	bool isDone() const { return mPending.load(std::memory_order_acquire) == 0 && mBusy.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class CoreJobSystem;
+
+	std::atomic<int32_t>	mPending;
+	std::atomic<int32_t>	mBusy;		///< threads still inside finish().
+	std::mutex				mMutex;		///< guards mWaiting.
+	CoreJob*				mWaiting;	///< jobs that depend on this counter.
+};
+
+//-------------------------------------------------------------
+// Job system
+//-------------------------------------------------------------
+// A worker thread per core plus the thread that calls init(), which
+// takes part whenever it waits. Every thread owns a Chase-Lev deque,
+// runs its own jobs newest first and steals the oldest job of another
+// thread when it runs dry. Idle workers spin briefly, then sleep until
+// new work is pushed.
+//
+// Jobs come from a per thread ring of MaxJobsPerThread slots. A slot is
+// only handed out again once its job has run: when the next one is
+// still busy parallelFor stops splitting and runs the rest of its range
+// itself, run() runs other jobs until the slot frees up.
+//
+// Everything but init()/destroy() can be called from jobs as well as
+// from the owning thread, but only threads of this system may submit.
+class CoreJobSystem
+{
+public:
+	enum
+	{
+		MaxWorkers = 64,
+		MaxJobsPerThread = CoreWorkStealingQueue::Capacity,
+	};
+
+	CoreJobSystem();
+	~CoreJobSystem();
+
+	// workerCount 0 means one per core minus the calling thread. Workers
+	// are named "<name> n" and, with pin, locked to core n.
+	bool init(uint32_t workerCount = 0, bool pin = false, const char* name = "Job worker");
+	void destroy();
+
+	// run func(data, 0, 0) on some thread. With a dependency the job
+	// waits for that counter to reach zero before it is queued.
+	void run(CoreJobFunc func, void* data, CoreJobCounter* counter, CoreJobCounter* dependency = NULL);
+
+	// func(data, begin, end) over [0, count), split down to grain sized
+	// ranges as threads steal. Returns when the whole range is done.
+	void parallelFor(uint32_t count, uint32_t grain, CoreJobFunc func, void* data);
+
+	// runs jobs until the counter reaches zero.
+	void wait(CoreJobCounter* counter);
+
+	uint32_t getThreadCount() const { return (uint32_t)mThreads.size() + 1; }	///< workers plus the owner.
+	bool isRunning() const { return mRunning; }
+
+private:
+	struct ThreadState
+	{
+		CoreWorkStealingQueue	queue;
+		CoreJob*				jobs;		///< MaxJobsPerThread slots used as a ring.
+		uint32_t				nextJob;
+		uint32_t				stealSeed;
+	};
+
+	struct ParallelFor
+	{
+		CoreJobSystem*	system;
+		CoreJobFunc		func;
+		void*			data;
+		uint32_t		grain;
+		CoreJobCounter	counter;
+	};
+
+	static void parallelForJob(void* data, uint32_t begin, uint32_t end);
+
+	void workerMain(uint32_t index, bool pin, const char* name);
+	ThreadState* getThreadState();
+	CoreJob* allocateJob();
+	void submit(CoreJob* job);
+	void schedule(CoreJob* job);
+	CoreJob* findJob();
+	void execute(CoreJob* job);
+	void finish(CoreJobCounter* counter);
+
+	std::vector<ThreadState*>	mStates;		///< 0 is the owning thread.
+	std::vector<std::thread>	mThreads;
+	std::thread::id				mOwner;
+	std::atomic<bool>			mRunning;
+
+	std::mutex					mSleepMutex;
+	std::condition_variable		mSleepCondition;
+	std::atomic<uint32_t>		mSleeping;
+};
+
+#endif
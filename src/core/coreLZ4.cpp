@@ -0,0 +1,186 @@
+#include "core/coreLZ4.h"
+
+#include <string.h>
+
+static const uint32_t MinMatch = 4;
+static const uint32_t LastLiterals = 5;		///< the block ends in at least this many literals.
+static const uint32_t MatchFindLimit = 12;	///< no match starts in the last 12 bytes.
+static const uint32_t MaxOffset = 65535;
+static const uint32_t HashBits = 12;
+
+static uint32_t read32(const uint8_t* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint32_t hashSequence(uint32_t sequence)
+{
+	return (sequence * 2654435761u) >> (32 - HashBits);
+}
+
+// 15 in the token, then 255s, then the rest.
+static uint8_t* writeLength(uint8_t* op, uint32_t length)
+{
+	for (length -= 15; length >= 255; length -= 255)
+		*op++ = 255;
+	*op++ = (uint8_t)length;
+	return op;
+}
+
+uint32_t coreLZ4Bound(uint32_t size)
+{
+	return size + size / 255 + 16;
+}
+
+uint32_t coreLZ4Compress(const uint8_t* src, uint32_t size, uint8_t* dst, uint32_t capacity)
+{
+	uint8_t* op = dst;
+	uint8_t* const opEnd = dst + capacity;
+	uint32_t anchor = 0;
+
+	if (size > MatchFindLimit)
+	{
+		uint32_t table[1 << HashBits];
+		memset(table, 0, sizeof(table));
+
+		const uint32_t matchLimit = size - LastLiterals;
+		const uint32_t findLimit = size - MatchFindLimit;
+		uint32_t ip = 0;
+		while (ip < findLimit)
+		{
+			const uint32_t sequence = read32(src + ip);
+			const uint32_t h = hashSequence(sequence);
+			uint32_t candidate = table[h];
+			table[h] = ip;
+
+			if (candidate >= ip || ip - candidate > MaxOffset || read32(src + candidate) != sequence)
+			{
+				ip++;
+				continue;
+			}
+
+			// grow the match back into the literals, then forward.
+			while (ip > anchor && candidate > 0 && src[ip - 1] == src[candidate - 1])
+			{
+				ip--;
+				candidate--;
+			}
+
+			uint32_t length = MinMatch;
+			while (ip + length < matchLimit && src[ip + length] == src[candidate + length])
+				length++;
+
+			const uint32_t literals = ip - anchor;
+			if ((size_t)(opEnd - op) < 1 + literals + literals / 255 + 1 + 2 + (length - MinMatch) / 255 + 1)
+				return 0;
+
+			uint8_t* token = op++;
+			*token = (uint8_t)((literals < 15 ? literals : 15) << 4);
+			if (literals >= 15)
+				op = writeLength(op, literals);
+			memcpy(op, src + anchor, literals);
+			op += literals;
+
+			const uint32_t offset = ip - candidate;
+			*op++ = (uint8_t)offset;
+			*op++ = (uint8_t)(offset >> 8);
+
+			const uint32_t matchLength = length - MinMatch;
+			*token |= (uint8_t)(matchLength < 15 ? matchLength : 15);
+			if (matchLength >= 15)
+				op = writeLength(op, matchLength);
+
+			// the positions inside the match are skipped, only its end
+			// goes in the table.
+			ip += length;
+			anchor = ip;
+			if (ip - 2 < findLimit)
+				table[hashSequence(read32(src + ip - 2))] = ip - 2;
+		}
+	}
+
+	// the rest goes out as a last sequence with no match.
+	const uint32_t literals = size - anchor;
+	if ((size_t)(opEnd - op) < 1 + literals + literals / 255 + 1)
+		return 0;
+
+	*op++ = (uint8_t)((literals < 15 ? literals : 15) << 4);
+	if (literals >= 15)
+		op = writeLength(op, literals);
+	if (literals)
+		memcpy(op, src + anchor, literals);
+	op += literals;
+	return (uint32_t)(op - dst);
+}
+
+bool coreLZ4Decompress(const uint8_t* src, uint32_t srcSize, uint8_t* dst, uint32_t dstSize)
+{
+	uint32_t s = 0;
+	uint32_t d = 0;
+	for (;;)
+	{
+		if (s >= srcSize)
+			return false;
+
+		const uint8_t token = src[s++];
+		uint32_t literals = token >> 4;
+		if (literals == 15)
+		{
+			uint8_t b;
+			do
+			{
+				if (s >= srcSize || literals > srcSize)
+					return false;
+				b = src[s++];
+				literals += b;
+			} while (b == 255);
+		}
+
+		if (literals > srcSize - s || literals > dstSize - d)
+			return false;
+		memcpy(dst + d, src + s, literals);
+		s += literals;
+		d += literals;
+
+		// the last sequence is only literals.
+		if (s == srcSize)
+			return d == dstSize;
+
+		if (srcSize - s < 2)
+			return false;
+		const uint32_t offset = src[s] | (src[s + 1] << 8);
+		s += 2;
+		if (offset == 0 || offset > d)
+			return false;
+
+		uint32_t length = token & 15;
+		if (length == 15)
+		{
+			uint8_t b;
+			do
+			{
+				if (s >= srcSize || length > dstSize)
+					return false;
+				b = src[s++];
+				length += b;
+			} while (b == 255);
+		}
+		length += MinMatch;
+
+		if (length > dstSize - d)
+			return false;
+
+		// an offset shorter than the match repeats the bytes just written.
+		const uint8_t* match = dst + d - offset;
+		if (offset >= length)
+			memcpy(dst + d, match, length);
+		else
+		{
+			for (uint32_t i = 0; i < length; i++)
+				dst[d + i] = match[i];
+		}
+		d += length;
+	}
+}
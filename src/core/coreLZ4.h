@@ -0,0 +1,28 @@
+#ifndef CORELZ4_H_
+#define CORELZ4_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------
+// LZ4 blocks
+//-------------------------------------------------------------
+// The LZ4 block format, without the frame around it: a block is a run
+// of sequences, each some literals and a match of at least 4 bytes at
+// most 64KB back. The compressor is the simple greedy one, a single
+// hash table probe per position, fast but not the smallest output. The
+// decompressor checks every length and offset against both buffers, so
+// a broken block fails instead of reading or writing out of bounds.
+//
+// Neither keeps state between blocks, every block decodes on its own.
+
+// worst case compressed size of size bytes.
+uint32_t coreLZ4Bound(uint32_t size);
+
+// returns the compressed size, 0 when it doesn't fit in capacity.
+uint32_t coreLZ4Compress(const uint8_t* src, uint32_t size, uint8_t* dst, uint32_t capacity);
+
+// the block has to decode to exactly dstSize bytes.
+bool coreLZ4Decompress(const uint8_t* src, uint32_t srcSize, uint8_t* dst, uint32_t dstSize);
+
+#endif
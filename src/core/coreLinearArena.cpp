@@ -0,0 +1,92 @@
+#include "core/coreLinearArena.h"
+
+#include <stdlib.h>
+
+CoreLinearArena::CoreLinearArena()
+{
+	mBlockSize = DefaultBlockSize;
+	mBlock = 0;
+	mOffset = 0;
+	mUsed = 0;
+	mReserved = 0;
+}
+
+CoreLinearArena::~CoreLinearArena()
+{
+	destroy();
+}
+
+void CoreLinearArena::init(size_t blockSize)
+{
+	destroy();
+	mBlockSize = blockSize;
+}
+
+void CoreLinearArena::destroy()
+{
+	for (size_t i = 0; i < mBlocks.size(); i++)
+		free(mBlocks[i].data);
+
+	mBlocks.clear();
+	mBlock = 0;
+	mOffset = 0;
+	mUsed = 0;
+	mReserved = 0;
+}
+
+void CoreLinearArena::reset()
+{
+	mBlock = 0;
+	mOffset = 0;
+	mUsed = 0;
+}
+
+// move on to the next block that can hold size bytes, reusing the ones
+// kept from earlier frames first.
+bool CoreLinearArena::nextBlock(size_t size)
+{
+	size_t next = mBlocks.empty() ? 0 : mBlock + 1;
+	while (next < mBlocks.size() && mBlocks[next].size < size)
+		next++;
+
+	if (next >= mBlocks.size())
+	{
+		Block block;
+		block.size = size > mBlockSize ? size : mBlockSize;
+		block.data = (uint8_t*)malloc(block.size);
+		if (!block.data)
+			return false;
+
+		mBlocks.push_back(block);
+		mReserved += block.size;
+		next = mBlocks.size() - 1;
+	}
+
+	mBlock = next;
+	mOffset = 0;
+	return true;
+}
+
+void* CoreLinearArena::allocate(size_t size, size_t alignment)
+{
+	if (!mBlocks.empty())
+	{
+		const Block& block = mBlocks[mBlock];
+		uintptr_t address = (uintptr_t)(block.data + mOffset);
+		size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+		if (mOffset + padding + size <= block.size)
+		{
+			mOffset += padding + size;
+			mUsed += padding + size;
+			return block.data + mOffset - size;
+		}
+	}
+
+	// malloc's alignment covers the start of a fresh block.
+	if (!nextBlock(size))
+		return NULL;
+
+	mOffset = size;
+	mUsed += size;
+	return mBlocks[mBlock].data;
+}
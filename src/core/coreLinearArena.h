@@ -0,0 +1,50 @@
+#ifndef CORELINEARARENA_H_
+#define CORELINEARARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+//-------------------------------------------------------------
+// Linear arena
+//-------------------------------------------------------------
+// Bump allocator over a list of fixed size blocks. allocate() moves a
+// pointer forward, nothing is freed on its own and reset() rewinds the
+// whole arena while keeping the blocks, so a steady state frame never
+// touches the heap. Requests bigger than a block get a block of their
+// own. Not thread safe, give each thread its own arena.
+class CoreLinearArena
+{
+public:
+	enum { DefaultBlockSize = 64 * 1024 };
+
+	CoreLinearArena();
+	~CoreLinearArena();
+
+	void init(size_t blockSize = DefaultBlockSize);
+	void destroy();
+
+	void* allocate(size_t size, size_t alignment = 16);
+	void reset();
+
+	size_t getUsed() const { return mUsed; }			///< bytes handed out since reset().
+	size_t getReserved() const { return mReserved; }	///< bytes held in blocks.
+
+private:
+	struct Block
+	{
+		uint8_t*	data;
+		size_t		size;
+	};
+
+	bool nextBlock(size_t size);
+
+	std::vector<Block>	mBlocks;
+	size_t				mBlockSize;
+	size_t				mBlock;		///< block being filled.
+	size_t				mOffset;	///< into the current block.
+	size_t				mUsed;
+	size_t				mReserved;
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "core/coreRadixSort.h"
+#include "core/coreJobSystem.h"
+
+#include <string.h>
+#include <vector>
+
+// below this a single thread is faster than waking others.
+static const size_t ParallelThreshold = 16384;
+
+namespace
+{
+	struct SortJob
+	{
+		const uint64_t*	srcKeys;
+		const uint32_t*	srcValues;
+		uint64_t*		dstKeys;
+		uint32_t*		dstValues;
+		uint32_t		shift;
+		size_t			count;
+		uint32_t		chunkCount;
+		std::vector<size_t>	histograms;	///< 256 per chunk.
+	};
+}
+
+// which bytes differ between keys, one bit per byte.
+static uint32_t findVaryingBytes(const uint64_t* keys, size_t count)
+{
+	uint64_t diff = 0;
+	for (size_t i = 1; i < count; i++)
+		diff |= keys[i] ^ keys[0];
+
+	uint32_t varying = 0;
+	for (uint32_t b = 0; b < 8; b++)
+	{
+		if ((diff >> (b * 8)) & 0xFF)
+			varying |= 1u << b;
+	}
+	return varying;
+}
+
+static void getChunk(const SortJob* job, uint32_t chunk, size_t& begin, size_t& end)
+{
+	const size_t size = (job->count + job->chunkCount - 1) / job->chunkCount;
+	begin = chunk * size < job->count ? chunk * size : job->count;
+	end = begin + size < job->count ? begin + size : job->count;
+}
+
+static void countChunks(void* data, uint32_t first, uint32_t last)
+{
+	SortJob* job = (SortJob*)data;
+	for (uint32_t chunk = first; chunk < last; chunk++)
+	{
+		size_t begin, end;
+		getChunk(job, chunk, begin, end);
+
+		size_t* histogram = &job->histograms[chunk * 256];
+		memset(histogram, 0, 256 * sizeof(size_t));
+		for (size_t i = begin; i < end; i++)
+			histogram[(job->srcKeys[i] >> job->shift) & 0xFF]++;
+	}
+}
+
+static void scatterChunks(void* data, uint32_t first, uint32_t last)
+{
+	SortJob* job = (SortJob*)data;
+	for (uint32_t chunk = first; chunk < last; chunk++)
+	{
+		size_t begin, end;
+		getChunk(job, chunk, begin, end);
+
+		// our slice of every bucket comes after the whole of the lower
+		// buckets and after the lower chunks' part of the same bucket.
+		size_t offsets[256];
+		size_t total = 0;
+		for (uint32_t bucket = 0; bucket < 256; bucket++)
+		{
+			offsets[bucket] = total;
+			for (uint32_t c = 0; c < job->chunkCount; c++)
+			{
+				if (c == chunk)
+					offsets[bucket] = total;
+				total += job->histograms[c * 256 + bucket];
+			}
+		}
+
+		for (size_t i = begin; i < end; i++)
+		{
+			size_t dst = offsets[(job->srcKeys[i] >> job->shift) & 0xFF]++;
+			job->dstKeys[dst] = job->srcKeys[i];
+			job->dstValues[dst] = job->srcValues[i];
+		}
+	}
+}
+
+void coreRadixSort(uint64_t* keys, uint32_t* values, uint64_t* keyScratch, uint32_t* valueScratch, size_t count, CoreJobSystem* jobs)
+{
+	if (count < 2)
+		return;
+
+	uint32_t passes[8];
+	uint32_t passCount = 0;
+	const uint32_t varying = findVaryingBytes(keys, count);
+	for (uint32_t b = 0; b < 8; b++)
+	{
+		if (varying & (1u << b))
+			passes[passCount++] = b;
+	}
+
+	if (passCount == 0)
+		return;
+
+	SortJob job;
+	job.count = count;
+	job.chunkCount = count < ParallelThreshold || !jobs ? 1 : jobs->getThreadCount();
+	job.histograms.resize(job.chunkCount * 256);
+
+	uint64_t* keyBuffers[2] = { keys, keyScratch };
+	uint32_t* valueBuffers[2] = { values, valueScratch };
+	for (uint32_t p = 0; p < passCount; p++)
+	{
+		job.shift = passes[p] * 8;
+		job.srcKeys = keyBuffers[p & 1];
+		job.srcValues = valueBuffers[p & 1];
+		job.dstKeys = keyBuffers[(p & 1) ^ 1];
+		job.dstValues = valueBuffers[(p & 1) ^ 1];
+
+		// every chunk has to be counted before any of them can scatter.
+		if (job.chunkCount > 1)
+		{
+			jobs->parallelFor(job.chunkCount, 1, countChunks, &job);
+			jobs->parallelFor(job.chunkCount, 1, scatterChunks, &job);
+		}
+		else
+		{
+			countChunks(&job, 0, 1);
+			scatterChunks(&job, 0, 1);
+		}
+	}
+
+	// an odd number of passes leaves the result in the scratch arrays.
+	if (passCount & 1)
+	{
+		memcpy(keys, keyScratch, count * sizeof(uint64_t));
+		memcpy(values, valueScratch, count * sizeof(uint32_t));
+	}
+}
@@ -0,0 +1,26 @@
+#ifndef CORERADIXSORT_H_
+#define CORERADIXSORT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+class CoreJobSystem;
+
+//-------------------------------------------------------------
+// Radix sort
+//-------------------------------------------------------------
+// LSD radix sort of 64 bit keys, 8 bits a pass, values move with their
+// key and equal keys keep their order. Bytes that are the same in
+// every key are skipped, so keys that only use a few bits sort in a
+// few passes.
+//
+// With a job system each pass is split in a chunk per thread: all
+// chunks are counted in parallel, then every chunk turns the counts
+// into its own offsets and scatters. Small inputs, or jobs NULL, sort
+// on the calling thread.
+//
+// The scratch arrays hold count entries, the result ends up in keys
+// and values.
+void coreRadixSort(uint64_t* keys, uint32_t* values, uint64_t* keyScratch, uint32_t* valueScratch, size_t count, CoreJobSystem* jobs);
+
+#endif
@@ -0,0 +1,443 @@
+#include "core/coreSpatialGrid.h"
+#include "core/coreJobSystem.h"
+
+#include <stdio.h>
+#include <float.h>
+
+// Entry::bucket of objects in the large list.
+static const uint32_t LargeBucket = 0xFFFFFFFE;
+
+// cell coordinates stay well inside int32 and the cell count of a
+// range inside uint64.
+static const float MaxCellCoord = 1073741824.0f;
+
+static inline int32_t toCell(float value)
+{
+	value = floorf(value);
+	value = std::max(-MaxCellCoord, std::min(MaxCellCoord, value));
+	return (int32_t)value;
+}
+
+static inline bool boxesTouch(const Box3& a, const Box3& b)
+{
+	return a.minExtents.x <= b.maxExtents.x && a.maxExtents.x >= b.minExtents.x &&
+		a.minExtents.y <= b.maxExtents.y && a.maxExtents.y >= b.minExtents.y &&
+		a.minExtents.z <= b.maxExtents.z && a.maxExtents.z >= b.minExtents.z;
+}
+
+namespace
+{
+	// shapes a query can test, cullCells says whether testing the loose
+	// bounds of a cell can skip it.
+	struct BoxShape
+	{
+		enum { CullCells = false };
+		Box3 box;
+		bool touches(const Box3& bounds) const { return boxesTouch(box, bounds); }
+	};
+
+	struct SphereShape
+	{
+		enum { CullCells = true };
+		Vector3	center;
+		float	radiusSquared;
+
+		bool touches(const Box3& bounds) const
+		{
+			const float dx = std::max(0.0f, std::max(bounds.minExtents.x - center.x, center.x - bounds.maxExtents.x));
+			const float dy = std::max(0.0f, std::max(bounds.minExtents.y - center.y, center.y - bounds.maxExtents.y));
+			const float dz = std::max(0.0f, std::max(bounds.minExtents.z - center.z, center.z - bounds.maxExtents.z));
+			return dx * dx + dy * dy + dz * dz <= radiusSquared;
+		}
+	};
+
+	struct FrustumShape
+	{
+		enum { CullCells = true };
+		const Frustum* frustum;
+		bool touches(const Box3& bounds) const { return frustum->intersectsBox(bounds.minExtents, bounds.maxExtents); }
+	};
+}
+
+struct CoreSpatialGrid::UpdateJob
+{
+	CoreSpatialGrid*	grid;
+	const uint32_t*		ids;
+	const Box3*			boxes;
+	uint32_t			count;
+};
+
+CoreSpatialGrid::CoreSpatialGrid()
+{
+	mCellSize = 1.0f;
+	mInvCellSize = 1.0f;
+	mCapacity = 0;
+	mTableMask = 0;
+	mCount = 0;
+}
+
+CoreSpatialGrid::~CoreSpatialGrid()
+{
+	destroy();
+}
+
+bool CoreSpatialGrid::init(float cellSize, uint32_t capacity, uint32_t tableSize)
+{
+	destroy();
+
+	if (cellSize <= 0.0f || capacity == 0 || capacity >= LargeBucket)
+	{
+		printf("Spatial grid needs a positive cell size and capacity.\n");
+		return false;
+	}
+
+	// about one bucket per object keeps chains short.
+	if (tableSize == 0)
+		tableSize = capacity;
+
+	uint32_t size = 1;
+	while (size < tableSize && size < 0x80000000)
+		size <<= 1;
+
+	mCellSize = cellSize;
+	mInvCellSize = 1.0f / cellSize;
+	mCapacity = capacity;
+	mTableMask = size - 1;
+
+	mHeads.assign(size, InvalidId);
+	Entry empty;
+	empty.bucket = InvalidId;
+	empty.next = InvalidId;
+	empty.prev = InvalidId;
+	mEntries.assign(capacity, empty);
+
+	// room for every object being large or moving in one batch, so
+	// insert and update never grow these.
+	mLarge.reserve(capacity);
+	mMoved.resize((capacity + UpdateGrain - 1) / UpdateGrain);
+	for (size_t i = 0; i < mMoved.size(); i++)
+		mMoved[i].reserve(UpdateGrain);
+	return true;
+}
+
+void CoreSpatialGrid::destroy()
+{
+	mHeads.clear();
+	mEntries.clear();
+	mLarge.clear();
+	mMoved.clear();
+	mCapacity = 0;
+	mTableMask = 0;
+	mCount = 0;
+}
+
+bool CoreSpatialGrid::isLarge(const Box3& box) const
+{
+	// anything sticking out of its cell by more than the loose margin.
+	return box.maxExtents.x - box.minExtents.x > mCellSize ||
+		box.maxExtents.y - box.minExtents.y > mCellSize ||
+		box.maxExtents.z - box.minExtents.z > mCellSize;
+}
+
+CoreSpatialGrid::Cell CoreSpatialGrid::getCell(const Box3& box) const
+{
+	const Vector3 center = box.getCenter() * mInvCellSize;
+	Cell cell = { toCell(center.x), toCell(center.y), toCell(center.z) };
+	return cell;
+}
+
+uint32_t CoreSpatialGrid::getBucket(const Cell& cell) const
+{
+	// x only offsets, so a row of cells is a run of neighbouring buckets.
+	return ((((uint32_t)cell.y * 19349663u) ^ ((uint32_t)cell.z * 83492791u)) + (uint32_t)cell.x) & mTableMask;
+}
+
+CoreSpatialGrid::CellRange CoreSpatialGrid::getCellRange(const Box3& box) const
+{
+	// widened by the loose margin, objects in these cells may touch box.
+	const float margin = mCellSize * 0.5f;
+	CellRange range;
+	range.min.x = toCell((box.minExtents.x - margin) * mInvCellSize);
+	range.min.y = toCell((box.minExtents.y - margin) * mInvCellSize);
+	range.min.z = toCell((box.minExtents.z - margin) * mInvCellSize);
+	range.max.x = toCell((box.maxExtents.x + margin) * mInvCellSize);
+	range.max.y = toCell((box.maxExtents.y + margin) * mInvCellSize);
+	range.max.z = toCell((box.maxExtents.z + margin) * mInvCellSize);
+	return range;
+}
+
+uint64_t CoreSpatialGrid::getCellCount(const CellRange& range) const
+{
+	if (range.max.x < range.min.x || range.max.y < range.min.y || range.max.z < range.min.z)
+		return 0;
+
+	return (uint64_t)(range.max.x - range.min.x + 1) * (uint64_t)(range.max.y - range.min.y + 1) * (uint64_t)(range.max.z - range.min.z + 1);
+}
+
+Box3 CoreSpatialGrid::getLooseBounds(const Cell& cell) const
+{
+	const float margin = mCellSize * 0.5f;
+	const Vector3 corner(cell.x * mCellSize, cell.y * mCellSize, cell.z * mCellSize);
+	return Box3(corner - Vector3(margin, margin, margin), corner + Vector3(mCellSize + margin, mCellSize + margin, mCellSize + margin));
+}
+
+void CoreSpatialGrid::link(uint32_t id)
+{
+	Entry& entry = mEntries[id];
+	if (isLarge(entry.box))
+	{
+		entry.bucket = LargeBucket;
+		entry.prev = (uint32_t)mLarge.size();
+		mLarge.push_back(id);
+		return;
+	}
+
+	const uint32_t bucket = getBucket(entry.cell);
+	const uint32_t head = mHeads[bucket];
+	entry.bucket = bucket;
+	entry.prev = InvalidId;
+	entry.next = head;
+	if (head != InvalidId)
+		mEntries[head].prev = id;
+	mHeads[bucket] = id;
+}
+
+void CoreSpatialGrid::unlink(uint32_t id)
+{
+	Entry& entry = mEntries[id];
+	if (entry.bucket == LargeBucket)
+	{
+		// swap remove, the moved object takes over the slot.
+		const uint32_t last = mLarge.back();
+		mLarge[entry.prev] = last;
+		mEntries[last].prev = entry.prev;
+		mLarge.pop_back();
+	}
+	else
+	{
+		if (entry.prev != InvalidId)
+			mEntries[entry.prev].next = entry.next;
+		else
+			mHeads[entry.bucket] = entry.next;
+		if (entry.next != InvalidId)
+			mEntries[entry.next].prev = entry.prev;
+	}
+
+	entry.bucket = InvalidId;
+	entry.next = InvalidId;
+	entry.prev = InvalidId;
+}
+
+void CoreSpatialGrid::insert(uint32_t id, const Box3& box)
+{
+	if (id >= mCapacity)
+		return;
+
+	Entry& entry = mEntries[id];
+	if (entry.bucket != InvalidId)
+	{
+		update(id, box);
+		return;
+	}
+
+	entry.box = box;
+	entry.cell = getCell(box);
+	link(id);
+	mCount++;
+}
+
+void CoreSpatialGrid::remove(uint32_t id)
+{
+	if (!contains(id))
+		return;
+
+	unlink(id);
+	mCount--;
+}
+
+void CoreSpatialGrid::update(uint32_t id, const Box3& box)
+{
+	if (!contains(id))
+	{
+		insert(id, box);
+		return;
+	}
+
+	Entry& entry = mEntries[id];
+	const Cell cell = getCell(box);
+	const bool large = isLarge(box);
+	const bool wasLarge = entry.bucket == LargeBucket;
+	entry.box = box;
+
+	// most moves stay in the same cell, or in the large list.
+	if (large == wasLarge && (large || cell == entry.cell))
+		return;
+
+	unlink(id);
+	entry.cell = cell;
+	link(id);
+}
+
+void CoreSpatialGrid::updateJob(void* data, uint32_t begin, uint32_t end)
+{
+	UpdateJob* job = (UpdateJob*)data;
+	CoreSpatialGrid* grid = job->grid;
+
+	// bounds and cells are per id, so chunks never write the same
+	// entry. Links are shared between ids and left to the serial pass,
+	// which still needs the old buckets.
+	for (uint32_t chunk = begin; chunk < end; chunk++)
+	{
+		std::vector<uint32_t>& moved = grid->mMoved[chunk];
+		moved.clear();
+
+		const uint32_t first = chunk * UpdateGrain;
+		const uint32_t last = std::min(first + UpdateGrain, job->count);
+		for (uint32_t i = first; i < last; i++)
+		{
+			const uint32_t id = job->ids[i];
+			if (id >= grid->mCapacity)
+				continue;
+
+			const Box3& box = job->boxes[i];
+			const Cell cell = grid->getCell(box);
+			const bool large = grid->isLarge(box);
+			Entry& entry = grid->mEntries[id];
+			const bool changed = entry.bucket == InvalidId || large != (entry.bucket == LargeBucket) || (!large && cell != entry.cell);
+
+			entry.box = box;
+			entry.cell = cell;
+			if (changed)
+				moved.push_back(id);
+		}
+	}
+}
+
+void CoreSpatialGrid::updateBatch(const uint32_t* ids, const Box3* boxes, uint32_t count, CoreJobSystem* jobs)
+{
+	if (!count)
+		return;
+
+	const uint32_t chunkCount = (count + UpdateGrain - 1) / UpdateGrain;
+	if (mMoved.size() < chunkCount)
+		mMoved.resize(chunkCount);
+
+	UpdateJob job = { this, ids, boxes, count };
+	if (jobs && chunkCount > 1)
+		jobs->parallelFor(chunkCount, 1, updateJob, &job);
+	else
+		updateJob(&job, 0, chunkCount);
+
+	// relink in chunk order so the result doesn't depend on the threads.
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		const std::vector<uint32_t>& moved = mMoved[chunk];
+		for (size_t i = 0; i < moved.size(); i++)
+		{
+			const uint32_t id = moved[i];
+			if (mEntries[id].bucket != InvalidId)
+				unlink(id);
+			else
+				mCount++;
+			link(id);
+		}
+	}
+}
+
+template <class Shape>
+uint32_t CoreSpatialGrid::query(const Shape& shape, const Box3& bounds, std::vector<uint32_t>& out) const
+{
+	const size_t start = out.size();
+	if (!mCount)
+		return 0;
+
+	for (size_t i = 0; i < mLarge.size(); i++)
+	{
+		const uint32_t id = mLarge[i];
+		if (shape.touches(mEntries[id].box))
+			out.push_back(id);
+	}
+
+	// a query over more cells than there are objects is cheaper as a
+	// plain scan.
+	const CellRange range = getCellRange(bounds);
+	if (getCellCount(range) > mCount)
+	{
+		for (uint32_t id = 0; id < mCapacity; id++)
+		{
+			const Entry& entry = mEntries[id];
+			if (entry.bucket != InvalidId && entry.bucket != LargeBucket && shape.touches(entry.box))
+				out.push_back(id);
+		}
+		return (uint32_t)(out.size() - start);
+	}
+
+	Cell cell;
+	for (cell.z = range.min.z; cell.z <= range.max.z; cell.z++)
+	{
+		for (cell.y = range.min.y; cell.y <= range.max.y; cell.y++)
+		{
+			// whole rows first, most of a frustum's bounding box is outside it.
+			if (Shape::CullCells)
+			{
+				Cell rowEnd = { range.max.x, cell.y, cell.z };
+				cell.x = range.min.x;
+				Box3 row = getLooseBounds(cell);
+				row.maxExtents = getLooseBounds(rowEnd).maxExtents;
+				if (!shape.touches(row))
+					continue;
+			}
+
+			for (cell.x = range.min.x; cell.x <= range.max.x; cell.x++)
+			{
+				const uint32_t bucket = getBucket(cell);
+				uint32_t id = mHeads[bucket];
+				if (id == InvalidId)
+					continue;
+
+				if (Shape::CullCells && !shape.touches(getLooseBounds(cell)))
+					continue;
+
+				// other cells may hash to the same bucket.
+				for (; id != InvalidId; id = mEntries[id].next)
+				{
+					const Entry& entry = mEntries[id];
+					if (entry.cell == cell && shape.touches(entry.box))
+						out.push_back(id);
+				}
+			}
+		}
+	}
+
+	return (uint32_t)(out.size() - start);
+}
+
+uint32_t CoreSpatialGrid::queryBox(const Box3& box, std::vector<uint32_t>& out) const
+{
+	BoxShape shape = { box };
+	return query(shape, box, out);
+}
+
+uint32_t CoreSpatialGrid::querySphere(const Vector3& center, float radius, std::vector<uint32_t>& out) const
+{
+	SphereShape shape = { center, radius * radius };
+	const Vector3 half(radius, radius, radius);
+	return query(shape, Box3(center - half, center + half), out);
+}
+
+uint32_t CoreSpatialGrid::queryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const
+{
+	FrustumShape shape = { &frustum };
+
+	// an infinite or broken frustum has no corners, test everything.
+	Vector3 corners[8];
+	Box3 bounds(Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX), Vector3(FLT_MAX, FLT_MAX, FLT_MAX));
+	if (frustum.getCorners(corners))
+	{
+		bounds = Box3(corners[0], corners[0]);
+		for (int i = 1; i < 8; i++)
+			bounds.merge(Box3(corners[i], corners[i]));
+	}
+
+	return query(shape, bounds, out);
+}
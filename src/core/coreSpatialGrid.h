@@ -0,0 +1,125 @@
+#ifndef CORESPATIALGRID_H_
+#define CORESPATIALGRID_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "math/box3.h"
+#include "math/frustum.h"
+
+class CoreJobSystem;
+
+//-------------------------------------------------------------
+// Spatial grid
+//-------------------------------------------------------------
+// Loose uniform grid over moving boxes, hashed so the world has no
+// fixed size. An object lives in the one cell its center falls in and
+// may stick out of it by half a cell, queries widen their cell range
+// by that much. Objects bigger than that go in a separate list every
+// query tests.
+//
+// Cells are never stored, a cell is a bucket of the hash table and
+// objects chain through it with intrusive next/prev links, so insert,
+// remove and moving to another cell are O(1) and nothing allocates
+// after init(), as long as a batch isn't longer than the capacity.
+// Different cells can share a bucket, an object is only reported when
+// the cell being visited is its own.
+//
+// Ids are picked by the caller, below the capacity given to init(),
+// e.g. scene dense indices or handle slots. updateBatch() is the fast
+// path for moving many objects at once: bounds and cells are written
+// in parallel and only objects that changed cell are relinked.
+class CoreSpatialGrid
+{
+public:
+	enum
+	{
+		UpdateGrain = 2048,			///< objects an update job handles.
+		InvalidId = 0xFFFFFFFF,
+	};
+
+	CoreSpatialGrid();
+	~CoreSpatialGrid();
+
+	// tableSize is rounded up to a power of two, 0 picks one from capacity.
+	bool init(float cellSize, uint32_t capacity, uint32_t tableSize = 0);
+	void destroy();
+
+	void insert(uint32_t id, const Box3& box);
+	void remove(uint32_t id);
+	void update(uint32_t id, const Box3& box);
+
+	// moves ids[i] to boxes[i], inserting ids not in the grid yet. An id
+	// may appear only once per batch.
+	void updateBatch(const uint32_t* ids, const Box3* boxes, uint32_t count, CoreJobSystem* jobs = NULL);
+
+	// ids of every object whose box touches the shape, appended to out.
+	// Return the number added.
+	uint32_t queryBox(const Box3& box, std::vector<uint32_t>& out) const;
+	uint32_t querySphere(const Vector3& center, float radius, std::vector<uint32_t>& out) const;
+	uint32_t queryFrustum(const Frustum& frustum, std::vector<uint32_t>& out) const;
+
+	bool		contains(uint32_t id) const { return id < mCapacity && mEntries[id].bucket != InvalidId; }
+	uint32_t	getCount() const { return mCount; }
+	uint32_t	getLargeCount() const { return (uint32_t)mLarge.size(); }
+	float		getCellSize() const { return mCellSize; }
+
+private:
+	struct Cell
+	{
+		int32_t	x, y, z;
+
+		bool operator==(const Cell& rhs) const { return x == rhs.x && y == rhs.y && z == rhs.z; }
+		bool operator!=(const Cell& rhs) const { return !(*this == rhs); }
+	};
+
+	struct CellRange
+	{
+		Cell	min;
+		Cell	max;
+	};
+
+	// everything about an object a query walks past, in one cache line.
+	struct Entry
+	{
+		Box3		box;
+		Cell		cell;
+		uint32_t	bucket;		///< bucket linked into, LargeBucket or InvalidId.
+		uint32_t	next;
+		uint32_t	prev;		///< for large objects, index in mLarge.
+	};
+
+	struct UpdateJob;
+
+	bool		isLarge(const Box3& box) const;
+	Cell		getCell(const Box3& box) const;
+	uint32_t	getBucket(const Cell& cell) const;
+	CellRange	getCellRange(const Box3& box) const;
+	uint64_t	getCellCount(const CellRange& range) const;
+	Box3		getLooseBounds(const Cell& cell) const;
+
+	template <class Shape>
+	uint32_t	query(const Shape& shape, const Box3& bounds, std::vector<uint32_t>& out) const;
+
+	// place a box whose bounds are already written.
+	void link(uint32_t id);
+	void unlink(uint32_t id);
+
+	static void updateJob(void* data, uint32_t begin, uint32_t end);
+
+	float					mCellSize;
+	float					mInvCellSize;
+	uint32_t				mCapacity;
+	uint32_t				mTableMask;
+	uint32_t				mCount;
+
+	std::vector<uint32_t>	mHeads;			///< first object of each bucket.
+
+	std::vector<Entry>		mEntries;		///< per object id.
+
+	std::vector<uint32_t>	mLarge;
+	std::vector<std::vector<uint32_t> >	mMoved;	///< per update chunk, ids that changed cell.
+};
+
+#endif
@@ -0,0 +1,166 @@
+#include "core/coreSpatialGridBenchmark.h"
+#include "core/coreSpatialGrid.h"
+#include "core/coreBVH.h"
+#include "core/coreJobSystem.h"
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+// objects a move job handles at least.
+static const uint32_t MoveGrain = 1024;
+
+// queries of each kind a frame.
+static const uint32_t QueryCount = 256;
+
+namespace
+{
+	struct MovingObjects
+	{
+		float				worldSize;
+		float				deltaTime;
+		std::vector<Vector3>	centers;
+		std::vector<Vector3>	velocities;
+		std::vector<Vector3>	halfSizes;
+		std::vector<Box3>	boxes;
+	};
+}
+
+static void moveObjects(void* data, uint32_t begin, uint32_t end)
+{
+	MovingObjects* objects = (MovingObjects*)data;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		// bounce off the walls of the world cube.
+		Vector3& center = objects->centers[i];
+		Vector3& velocity = objects->velocities[i];
+		center += velocity * objects->deltaTime;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (center[axis] < 0.0f || center[axis] > objects->worldSize)
+				velocity[axis] = -velocity[axis];
+		}
+
+		objects->boxes[i] = Box3(center - objects->halfSizes[i], center + objects->halfSizes[i]);
+	}
+}
+
+static float random(uint32_t& seed)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return (seed >> 8) * (1.0f / 16777216.0f);
+}
+
+void coreRunSpatialGridBenchmark(CoreJobSystem* jobs, uint32_t objectCount, uint32_t frameCount)
+{
+	typedef std::chrono::high_resolution_clock Clock;
+	typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+	// about one object per cell, one in a thousand too big for a cell.
+	const float cellSize = 4.0f;
+	MovingObjects objects;
+	objects.worldSize = cbrtf((float)objectCount) * cellSize;
+	objects.deltaTime = 1.0f / 60.0f;
+	objects.centers.resize(objectCount);
+	objects.velocities.resize(objectCount);
+	objects.halfSizes.resize(objectCount);
+	objects.boxes.resize(objectCount);
+
+	uint32_t seed = 12345;
+	std::vector<uint32_t> ids(objectCount);
+	for (uint32_t i = 0; i < objectCount; i++)
+	{
+		const float size = (i % 1000 == 0) ? 8.0f : 0.25f + random(seed) * 1.5f;
+		objects.centers[i].set(random(seed) * objects.worldSize, random(seed) * objects.worldSize, random(seed) * objects.worldSize);
+		objects.velocities[i].set(random(seed) * 20.0f - 10.0f, random(seed) * 20.0f - 10.0f, random(seed) * 20.0f - 10.0f);
+		objects.halfSizes[i].set(size, size, size);
+		ids[i] = i;
+	}
+	moveObjects(&objects, 0, objectCount);
+
+	CoreSpatialGrid grid;
+	if (!grid.init(cellSize, objectCount))
+		return;
+	grid.updateBatch(&ids[0], &objects.boxes[0], objectCount, jobs);
+
+	Matrix4 proj;
+	proj.setFrustum(60.0f, 16.0f / 9.0f, 0.1f, objects.worldSize * 0.5f);
+	// our projection matrix is stored transposed.
+	proj.transpose();
+
+	printf("Spatial grid benchmark: %d objects, %d frames, %d threads.\n", objectCount, frameCount, jobs ? jobs->getThreadCount() : 1);
+
+	Milliseconds moveTime(0), updateTime(0), boxTime(0), sphereTime(0), frustumTime(0), bvhBuildTime(0), bvhBoxTime(0);
+	uint64_t boxHits = 0, sphereHits = 0, frustumHits = 0, bvhHits = 0;
+	std::vector<uint32_t> results;
+	CoreBVH bvh;
+	for (uint32_t frame = 0; frame < frameCount; frame++)
+	{
+		Clock::time_point start = Clock::now();
+		if (jobs)
+			jobs->parallelFor(objectCount, MoveGrain, moveObjects, &objects);
+		else
+			moveObjects(&objects, 0, objectCount);
+		Clock::time_point moved = Clock::now();
+		grid.updateBatch(&ids[0], &objects.boxes[0], objectCount, jobs);
+		Clock::time_point updated = Clock::now();
+		moveTime += moved - start;
+		updateTime += updated - moved;
+
+		// the same query boxes for the grid and the bvh.
+		std::vector<Box3> queries(QueryCount);
+		for (uint32_t i = 0; i < QueryCount; i++)
+		{
+			const Vector3 center(random(seed) * objects.worldSize, random(seed) * objects.worldSize, random(seed) * objects.worldSize);
+			queries[i] = Box3(center - Vector3(8.0f, 8.0f, 8.0f), center + Vector3(8.0f, 8.0f, 8.0f));
+		}
+
+		start = Clock::now();
+		for (uint32_t i = 0; i < QueryCount; i++)
+		{
+			results.clear();
+			boxHits += grid.queryBox(queries[i], results);
+		}
+		boxTime += Clock::now() - start;
+
+		start = Clock::now();
+		for (uint32_t i = 0; i < QueryCount; i++)
+		{
+			results.clear();
+			sphereHits += grid.querySphere(queries[i].getCenter(), 8.0f, results);
+		}
+		sphereTime += Clock::now() - start;
+
+		// a camera circling the world, looking at its middle.
+		const float angle = frame * 0.05f;
+		const float middle = objects.worldSize * 0.5f;
+		Matrix4 view;
+		view.lookAt(Vector3(middle + cosf(angle) * middle, middle, middle + sinf(angle) * middle), Vector3(middle, middle, middle), Vector3(0.0f, 1.0f, 0.0f));
+		const Frustum frustum(proj * view);
+
+		start = Clock::now();
+		results.clear();
+		frustumHits += grid.queryFrustum(frustum, results);
+		frustumTime += Clock::now() - start;
+
+		// what the grid saves over rebuilding a tree every frame.
+		bvh.buildBoxes(&objects.boxes[0], objectCount, jobs);
+		bvhBuildTime += Milliseconds(bvh.getBuildTime());
+
+		start = Clock::now();
+		for (uint32_t i = 0; i < QueryCount; i++)
+		{
+			results.clear();
+			bvhHits += bvh.queryBox(queries[i], results);
+		}
+		bvhBoxTime += Clock::now() - start;
+	}
+
+	const double frames = (double)frameCount;
+	const double queries = (double)frameCount * QueryCount;
+	printf("  move %.3f ms, grid update %.3f ms a frame, %d objects too big for a cell.\n", moveTime.count() / frames, updateTime.count() / frames, grid.getLargeCount());
+	printf("  grid: box %.2f us (%.1f hits), sphere %.2f us (%.1f hits), frustum %.3f ms (%.0f hits).\n",
+		boxTime.count() * 1000.0 / queries, boxHits / queries, sphereTime.count() * 1000.0 / queries, sphereHits / queries,
+		frustumTime.count() / frames, frustumHits / frames);
+	printf("  bvh: rebuild %.3f ms a frame, box %.2f us (%.1f hits).\n", bvhBuildTime.count() / frames, bvhBoxTime.count() * 1000.0 / queries, bvhHits / queries);
+}
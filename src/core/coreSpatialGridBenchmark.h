@@ -0,0 +1,16 @@
+#ifndef CORESPATIALGRIDBENCHMARK_H_
+#define CORESPATIALGRIDBENCHMARK_H_
+
+#include <stdint.h>
+
+class CoreJobSystem;
+
+//-------------------------------------------------------------
+// Spatial grid benchmark
+//-------------------------------------------------------------
+// Moves objectCount boxes around every frame and prints the time the
+// spatial grid takes to follow them and to answer box, sphere and
+// frustum queries, next to rebuilding a BVH over the same boxes.
+void coreRunSpatialGridBenchmark(CoreJobSystem* jobs, uint32_t objectCount = 200000, uint32_t frameCount = 60);
+
+#endif
@@ -0,0 +1,68 @@
+#include "core/coreWorkStealingQueue.h"
+
+CoreWorkStealingQueue::CoreWorkStealingQueue()
+{
+	mTop.store(0, std::memory_order_relaxed);
+	mBottom.store(0, std::memory_order_relaxed);
+	for (uint32_t i = 0; i < Capacity; i++)
+		mJobs[i].store(NULL, std::memory_order_relaxed);
+}
+
+bool CoreWorkStealingQueue::push(CoreJob* job)
+{
+	const int64_t bottom = mBottom.load(std::memory_order_relaxed);
+	const int64_t top = mTop.load(std::memory_order_acquire);
+	if (bottom - top >= Capacity)
+		return false;
+
+	mJobs[bottom & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	mBottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+CoreJob* CoreWorkStealingQueue::pop()
+{
+	const int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+	mBottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = mTop.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// was empty.
+		mBottom.store(bottom + 1, std::memory_order_relaxed);
+		return NULL;
+	}
+
+	CoreJob* job = mJobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// last job, race the thieves for it.
+		if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = NULL;
+		mBottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+CoreJob* CoreWorkStealingQueue::steal()
+{
+	int64_t top = mTop.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	const int64_t bottom = mBottom.load(std::memory_order_acquire);
+	if (top >= bottom)
+		return NULL;
+
+	CoreJob* job = mJobs[top & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return NULL;
+
+	return job;
+}
+
+bool CoreWorkStealingQueue::isEmpty() const
+{
+	return mTop.load(std::memory_order_relaxed) >= mBottom.load(std::memory_order_relaxed);
+}
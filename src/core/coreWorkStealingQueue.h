@@ -0,0 +1,39 @@
+#ifndef COREWORKSTEALINGQUEUE_H_
+#define COREWORKSTEALINGQUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+struct CoreJob;
+
+//-------------------------------------------------------------
+// Work stealing queue
+//-------------------------------------------------------------
+// Chase-Lev deque of job pointers with a fixed power of two capacity.
+// The owning thread pushes and pops at the bottom, LIFO, which keeps
+// freshly split work hot in its cache; any other thread steals the
+// oldest job from the top. Memory orders follow Le et al., "Correct
+// and Efficient Work-Stealing for Weak Memory Models".
+class CoreWorkStealingQueue
+{
+public:
+	enum { Capacity = 4096 };
+
+	CoreWorkStealingQueue();
+
+	// owner only. push() fails when the queue is full.
+	bool		push(CoreJob* job);
+	CoreJob*	pop();
+
+	// any thread.
+	CoreJob*	steal();
+	bool		isEmpty() const;
+
+private:
+	std::atomic<int64_t>	mTop;
+	std::atomic<int64_t>	mBottom;
+	std::atomic<CoreJob*>	mJobs[Capacity];
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "gfx/gfxCommandBuffer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+GFXCommandBuffer::GFXCommandBuffer()
+{
+	mFirst = NULL;
+	mLast = NULL;
+	mCount = 0;
+	mFailed = false;
+}
+
+void GFXCommandBuffer::init(size_t blockSize)
+{
+	mArena.init(blockSize);
+	reset();
+}
+
+void GFXCommandBuffer::destroy()
+{
+	mArena.destroy();
+	mFirst = NULL;
+	mLast = NULL;
+	mCount = 0;
+	mFailed = false;
+}
+
+void GFXCommandBuffer::reset()
+{
+	mArena.reset();
+	mFirst = NULL;
+	mLast = NULL;
+	mCount = 0;
+	mFailed = false;
+}
+
+template<class T> T* GFXCommandBuffer::push(GFXCommandType type)
+{
+	// once a command is missing the ones after it would replay on the
+	// wrong state, so stop recording altogether.
+	if (mFailed)
+		return NULL;
+
+	T* command = (T*)mArena.allocate(sizeof(T), alignof(T));
+	if (!command)
+	{
+		printf("Command buffer out of memory after %u commands.\n", mCount);
+		mFailed = true;
+		return NULL;
+	}
+
+	command->type = type;
+	command->next = NULL;
+
+	if (mLast)
+		mLast->next = command;
+	else
+		mFirst = command;
+
+	mLast = command;
+	mCount++;
+	return command;
+}
+
+void GFXCommandBuffer::setProgram(uint32_t program)
+{
+	GFXSetProgramCommand* command = push<GFXSetProgramCommand>(GFXCommandSetProgram);
+	if (!command)
+		return;
+
+	command->program = program;
+}
+
+void GFXCommandBuffer::setVertexLayout(const GFXVertexFormat* format, const uint32_t* buffers, uint32_t indexBuffer)
+{
+	GFXSetVertexLayoutCommand* command = push<GFXSetVertexLayoutCommand>(GFXCommandSetVertexLayout);
+	if (!command)
+		return;
+
+	command->format = format;
+	memcpy(command->buffers, buffers, sizeof(command->buffers));
+	command->indexBuffer = indexBuffer;
+}
+
+void GFXCommandBuffer::setConstants(uint32_t binding, uint32_t buffer, uint64_t offset, uint64_t size)
+{
+	GFXSetConstantsCommand* command = push<GFXSetConstantsCommand>(GFXCommandSetConstants);
+	if (!command)
+		return;
+
+	command->binding = binding;
+	command->buffer = buffer;
+	command->offset = offset;
+	command->size = size;
+}
+
+void GFXCommandBuffer::drawIndexed(GFXPrimitive primitive, uint32_t indexSize, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex, uint32_t instanceCount)
+{
+	GFXDrawIndexedCommand* command = push<GFXDrawIndexedCommand>(GFXCommandDrawIndexed);
+	if (!command)
+		return;
+
+	command->primitive = primitive;
+	command->indexSize = indexSize;
+	command->indexCount = indexCount;
+	command->firstIndex = firstIndex;
+	command->baseVertex = baseVertex;
+	command->instanceCount = instanceCount;
+}
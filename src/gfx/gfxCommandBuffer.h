@@ -0,0 +1,102 @@
+#ifndef GFXCOMMANDBUFFER_H_
+#define GFXCOMMANDBUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "core/coreLinearArena.h"
+#include "gfx/gfxVertexFormat.h"
+
+enum GFXCommandType
+{
+	GFXCommandSetProgram,
+	GFXCommandSetVertexLayout,
+	GFXCommandSetConstants,
+	GFXCommandDrawIndexed,
+};
+
+enum GFXPrimitive
+{
+	GFXPrimitiveTriangles,
+	GFXPrimitiveLines,
+	GFXPrimitivePoints,
+};
+
+// Commands are plain structs chained in recording order. Handles are
+// the backend's object names.
+struct GFXCommand
+{
+	GFXCommandType		type;
+	const GFXCommand*	next;
+};
+
+struct GFXSetProgramCommand : GFXCommand
+{
+	uint32_t	program;
+};
+
+struct GFXSetVertexLayoutCommand : GFXCommand
+{
+	const GFXVertexFormat*	format;		///< has to outlive the replay.
+	uint32_t				buffers[GFXVertexFormat::MaxStreams];
+	uint32_t				indexBuffer;
+};
+
+struct GFXSetConstantsCommand : GFXCommand
+{
+	uint32_t	binding;
+	uint32_t	buffer;
+	uint64_t	offset;
+	uint64_t	size;
+};
+
+struct GFXDrawIndexedCommand : GFXCommand
+{
+	GFXPrimitive	primitive;
+	uint32_t		indexSize;		///< 1, 2 or 4 bytes.
+	uint32_t		indexCount;
+	uint32_t		firstIndex;
+	int32_t			baseVertex;
+	uint32_t		instanceCount;
+};
+
+//-------------------------------------------------------------
+// Command buffer
+//-------------------------------------------------------------
+// Records draw state and draws without touching the graphics API, so
+// any thread can fill one. Commands live in the buffer's own linear
+// arena; reset() rewinds it for the next frame and keeps the memory.
+// A buffer is written by one thread at a time and replayed by the
+// render thread once recording is done. If the arena can't get memory
+// the rest of the recording is dropped and hasFailed() says so until
+// the next reset().
+class GFXCommandBuffer
+{
+public:
+	GFXCommandBuffer();
+
+	void init(size_t blockSize = CoreLinearArena::DefaultBlockSize);
+	void destroy();
+	void reset();
+
+	void setProgram(uint32_t program);
+	void setVertexLayout(const GFXVertexFormat* format, const uint32_t* buffers, uint32_t indexBuffer);
+	void setConstants(uint32_t binding, uint32_t buffer, uint64_t offset, uint64_t size);
+	void drawIndexed(GFXPrimitive primitive, uint32_t indexSize, uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex, uint32_t instanceCount);
+
+	const GFXCommand*	getFirst() const { return mFirst; }
+	uint32_t			getCommandCount() const { return mCount; }
+	bool				hasFailed() const { return mFailed; }
+	size_t				getMemoryUsed() const { return mArena.getUsed(); }
+
+private:
+	template<class T> T* push(GFXCommandType type);
+
+	CoreLinearArena	mArena;
+	GFXCommand*		mFirst;
+	GFXCommand*		mLast;
+	uint32_t		mCount;
+	bool			mFailed;
+};
+
+#endif
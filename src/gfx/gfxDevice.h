@@ -0,0 +1,81 @@
+#ifndef GFXDEVICE_H_
+#define GFXDEVICE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+// optional features the renderer picks code paths on.
+enum GFXDeviceFeature
+{
+	GFXFeatureAnisotropy			= 1 << 0,
+	GFXFeatureBufferStorage			= 1 << 1,
+	GFXFeatureTextureStorage		= 1 << 2,
+	GFXFeatureCopyImage				= 1 << 3,
+	GFXFeatureVertexAttribBinding	= 1 << 4,
+	GFXFeatureComputeShader			= 1 << 5,
+	GFXFeatureShaderStorage			= 1 << 6,
+	GFXFeatureMultiDrawIndirect		= 1 << 7,
+	GFXFeatureParallelCompile		= 1 << 8,
+	GFXFeatureProgramBinary			= 1 << 9,
+	GFXFeatureDebugOutput			= 1 << 10,
+};
+
+// what the device can do. Plain data, it's saved to disk as is and
+// only trusted again for the same driver.
+struct GFXDeviceCaps
+{
+	char		vendor[128];
+	char		renderer[128];
+	char		version[128];		///< the driver's version string.
+	uint64_t	driverHash;			///< of the three strings above.
+
+	uint32_t	versionMajor;
+	uint32_t	versionMinor;
+	uint32_t	features;			///< GFXDeviceFeature bits.
+
+	int32_t		maxTextureSize;
+	int32_t		maxVertexAttribs;
+	int32_t		maxUniformBlockSize;
+	int32_t		maxUniformBufferBindings;
+	int32_t		uniformBufferAlignment;
+	int32_t		maxShaderStorageBlockSize;	///< 0 without GFXFeatureShaderStorage.
+	int32_t		maxShaderStorageBindings;
+	int32_t		shaderStorageAlignment;
+	int32_t		maxVertexShaderStorageBlocks;
+	int32_t		maxComputeInvocations;		///< 0 without GFXFeatureComputeShader.
+	int32_t		programBinaryFormats;
+	float		maxAnisotropy;				///< 1 without GFXFeatureAnisotropy.
+
+	GFXDeviceCaps() { memset(this, 0, sizeof(*this)); }
+
+	bool has(GFXDeviceFeature feature) const { return (features & feature) != 0; }
+};
+
+struct GFXAdapterLUID
+{
+	unsigned long LowPart;
+	long HighPart;
+};
+
+struct GFXDevice
+{
+	char mName[512];
+	char mOutputName[512];
+	GFXAdapterLUID mLUID;
+	uint32_t mIndex;
+	GFXDeviceCaps mCaps;
+
+	const char *getName() const { return mName; }
+	const char *getOutputName() const { return mOutputName; }
+	const GFXDeviceCaps& getCaps() const { return mCaps; }
+
+	GFXDevice()
+	{
+		mName[0] = 0;
+		mOutputName[0] = 0;
+		mIndex = 0;
+		memset(&mLUID, '\0', sizeof(mLUID));
+	}
+};
+
+#endif
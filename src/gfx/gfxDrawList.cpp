@@ -0,0 +1,59 @@
+#include "gfx/gfxDrawList.h"
+#include "core/coreRadixSort.h"
+
+#include <string.h>
+
+// the high bits of a positive float sort like the float itself.
+static uint32_t quantizeDepth(float depth)
+{
+	if (!(depth > 0.0f))
+		return 0;
+
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	return bits >> (31 - GFXDrawList::DepthBits);
+}
+
+GFXDrawList::GFXDrawList()
+{
+	mJobs = NULL;
+}
+
+uint64_t GFXDrawList::makeKey(uint32_t pass, uint32_t program, uint32_t layout, uint32_t material, float depth)
+{
+	const uint64_t passBits = pass & ((1u << PassBits) - 1);
+	const uint64_t programBits = program & ((1u << ProgramBits) - 1);
+	const uint64_t layoutBits = layout & ((1u << LayoutBits) - 1);
+	const uint64_t materialBits = material & ((1u << MaterialBits) - 1);
+	const uint64_t depthBits = quantizeDepth(depth);
+
+	if (pass == GFXDrawPassTransparent)
+	{
+		const uint64_t farFirst = ~depthBits & ((1u << DepthBits) - 1);
+		return (passBits << 60) | (farFirst << 36) | (programBits << 26) | (layoutBits << 16) | materialBits;
+	}
+
+	return (passBits << 60) | (programBits << 50) | (layoutBits << 40) | (materialBits << 24) | depthBits;
+}
+
+void GFXDrawList::clear()
+{
+	mKeys.clear();
+	mItems.clear();
+}
+
+void GFXDrawList::add(uint64_t key, uint32_t item)
+{
+	mKeys.push_back(key);
+	mItems.push_back(item);
+}
+
+void GFXDrawList::sort()
+{
+	if (mKeys.empty())
+		return;
+
+	mKeyScratch.resize(mKeys.size());
+	mItemScratch.resize(mItems.size());
+	coreRadixSort(&mKeys[0], &mItems[0], &mKeyScratch[0], &mItemScratch[0], mKeys.size(), mJobs);
+}
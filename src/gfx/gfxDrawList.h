@@ -0,0 +1,68 @@
+#ifndef GFXDRAWLIST_H_
+#define GFXDRAWLIST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class CoreJobSystem;
+
+enum GFXDrawPass
+{
+	GFXDrawPassOpaque = 0,
+	GFXDrawPassTransparent = 1,
+};
+
+//-------------------------------------------------------------
+// Draw list
+//-------------------------------------------------------------
+// Draws are recorded as a 64 bit sort key plus the index of the draw
+// in the caller's own array, then radix sorted so that draws sharing
+// state end up next to each other.
+//
+// Opaque keys, high to low bits:
+//   pass:4 | program:10 | layout:10 | material:16 | depth:24
+// so state changes are ordered by cost and, within identical state,
+// draws go front to back. Transparent keys put the inverted depth right
+// after the pass to get back to front order:
+//   pass:4 | ~depth:24 | program:10 | layout:10 | material:16
+//
+// program, layout and material are small sort ids chosen by the
+// caller, ids past their bit count wrap, which costs sort quality but
+// never correctness.
+class GFXDrawList
+{
+public:
+	enum
+	{
+		PassBits = 4,
+		ProgramBits = 10,
+		LayoutBits = 10,
+		MaterialBits = 16,
+		DepthBits = 24,
+	};
+
+	GFXDrawList();
+
+	static uint64_t makeKey(uint32_t pass, uint32_t program, uint32_t layout, uint32_t material, float depth);
+
+	// jobs used by sort(), NULL or small lists sort on the calling thread.
+	void setJobSystem(CoreJobSystem* jobs) { mJobs = jobs; }
+
+	void clear();
+	void add(uint64_t key, uint32_t item);
+	void sort();
+
+	uint32_t getCount() const { return (uint32_t)mKeys.size(); }
+	uint64_t getKey(uint32_t index) const { return mKeys[index]; }
+	uint32_t getItem(uint32_t index) const { return mItems[index]; }	///< in sorted order after sort().
+
+private:
+	std::vector<uint64_t>	mKeys;
+	std::vector<uint32_t>	mItems;
+	std::vector<uint64_t>	mKeyScratch;
+	std::vector<uint32_t>	mItemScratch;
+	CoreJobSystem*			mJobs;
+};
+
+#endif
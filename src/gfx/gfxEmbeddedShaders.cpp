@@ -0,0 +1,52 @@
+#include "gfx/gfxEmbeddedShaders.h"
+
+#include <string.h>
+
+// written by the pre-build step, see tools/embedShaders.py.
+#if defined(__has_include)
+#if __has_include("gfx/gfxEmbeddedShaderTable.inl")
+#include "gfx/gfxEmbeddedShaderTable.inl"
+#define GFX_EMBEDDED_SHADERS
+#endif
+#endif
+
+#ifdef GFX_EMBEDDED_SHADERS
+static const uint32_t sgEmbeddedShaderCount = sizeof(sgEmbeddedShaders) / sizeof(sgEmbeddedShaders[0]);
+#else
+static const GFXEmbeddedShader* const sgEmbeddedShaders = NULL;
+static const uint32_t sgEmbeddedShaderCount = 0;
+#endif
+
+const GFXEmbeddedShader* gfxFindEmbeddedShader(const char* name)
+{
+	const GFXNameHash hash = GFXHashName(name);
+	uint32_t low = 0;
+	uint32_t high = sgEmbeddedShaderCount;
+	while (low < high)
+	{
+		const uint32_t mid = (low + high) / 2;
+		if (sgEmbeddedShaders[mid].hash < hash)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	if (low < sgEmbeddedShaderCount && sgEmbeddedShaders[low].hash == hash && strcmp(sgEmbeddedShaders[low].name, name) == 0)
+		return &sgEmbeddedShaders[low];
+	return NULL;
+}
+
+uint32_t gfxGetEmbeddedShaderCount()
+{
+	return sgEmbeddedShaderCount;
+}
+
+bool gfxReadEmbeddedShader(const char* path, std::string& out)
+{
+	const GFXEmbeddedShader* shader = gfxFindEmbeddedShader(path);
+	if (!shader)
+		return false;
+
+	out.assign(shader->text, shader->size);
+	return true;
+}
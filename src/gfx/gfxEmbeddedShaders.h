@@ -0,0 +1,39 @@
+#ifndef GFXEMBEDDEDSHADERS_H_
+#define GFXEMBEDDEDSHADERS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "gfx/gfxNameHash.h"
+
+// a shader source built into the executable.
+struct GFXEmbeddedShader
+{
+	GFXNameHash	hash;		///< of name, the table is sorted by it.
+	const char*	name;		///< the loose file's name.
+	uint32_t	size;
+	const char*	text;		///< minified, same lines as the loose file.
+};
+
+//-------------------------------------------------------------
+// Embedded shaders
+//-------------------------------------------------------------
+// tools/embedShaders.py runs before every build and writes the shader
+// sources, comments and indentation stripped, into a constexpr table
+// in gfxEmbeddedShaderTable.inl. Loading a shader is then a lookup in
+// the executable's read only data, the file system isn't touched.
+//
+// Builds without the generated table, no Python say, get an empty one
+// and every lookup misses, so shaders come from the loose files as
+// before.
+
+// NULL when the shader isn't embedded.
+const GFXEmbeddedShader* gfxFindEmbeddedShader(const char* name);
+
+uint32_t gfxGetEmbeddedShaderCount();
+
+// a GFXShaderReadFunc over the table.
+bool gfxReadEmbeddedShader(const char* path, std::string& out);
+
+#endif
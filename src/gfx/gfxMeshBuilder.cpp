@@ -0,0 +1,598 @@
+#include "gfx/gfxMeshBuilder.h"
+#include "core/coreJobSystem.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+void GFXMeshData::getIndexData(std::vector<uint8_t>& out) const
+{
+	const uint32_t indexSize = getIndexSize();
+	out.resize(indices.size() * indexSize);
+	if (indices.empty())
+		return;
+
+	if (indexSize == 4)
+	{
+		memcpy(&out[0], &indices[0], out.size());
+		return;
+	}
+
+	uint16_t* dst = (uint16_t*)&out[0];
+	for (size_t i = 0; i < indices.size(); i++)
+		dst[i] = (uint16_t)indices[i];
+}
+
+GFXMeshBuilder::GFXMeshBuilder(uint32_t vertexStride)
+{
+	assert(vertexStride > 0);
+	mVertexStride = vertexStride;
+}
+
+void GFXMeshBuilder::addVertex(const float* vertex)
+{
+	mSoup.insert(mSoup.end(), vertex, vertex + mVertexStride);
+}
+
+void GFXMeshBuilder::addVertices(const float* vertices, uint32_t count)
+{
+	mSoup.insert(mSoup.end(), vertices, vertices + count * mVertexStride);
+}
+
+void GFXMeshBuilder::addStreams(uint32_t count, uint32_t streamCount, const float* const* streams, const uint32_t* streamWidths)
+{
+	size_t base = mSoup.size();
+	mSoup.resize(base + (size_t)count * mVertexStride);
+
+	for (uint32_t v = 0; v < count; v++)
+	{
+		float* dst = &mSoup[base + (size_t)v * mVertexStride];
+		for (uint32_t s = 0; s < streamCount; s++)
+		{
+			memcpy(dst, streams[s] + (size_t)v * streamWidths[s], streamWidths[s] * sizeof(float));
+			dst += streamWidths[s];
+		}
+	}
+}
+
+void GFXMeshBuilder::addIndexed(const float* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount)
+{
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		assert(indices[i] < vertexCount);
+		addVertex(vertices + (size_t)indices[i] * mVertexStride);
+	}
+}
+
+void GFXMeshBuilder::build(GFXMeshData& out, uint32_t cacheSize)
+{
+	const uint32_t soupCount = getSoupVertexCount();
+
+	weld(mSoup, mVertexStride, out);
+	float weldedACMR = computeACMR(out.indices.empty() ? NULL : &out.indices[0], out.getIndexCount(), cacheSize);
+
+	optimizeVertexCache(out, cacheSize);
+	optimizeVertexFetch(out);
+	float optimizedACMR = computeACMR(out.indices.empty() ? NULL : &out.indices[0], out.getIndexCount(), cacheSize);
+
+	printf("Mesh builder: %d vertices welded to %d, %d triangles, %d bit indices.\n", soupCount, out.getVertexCount(),
+		out.getTriangleCount(), out.getIndexSize() * 8);
+	printf("\tACMR (cache %d): 3.000 unindexed, %.3f welded, %.3f optimized.\n", cacheSize, weldedACMR, optimizedACMR);
+}
+
+//-------------------------------------------------------------
+// Welding
+//-------------------------------------------------------------
+// FNV-1a over the raw bits a float at a time, -0 read as +0, then
+// mixed so the top bits that pick a weld partition are as good as the
+// low ones.
+static uint32_t hashVertex(const float* v, uint32_t stride)
+{
+	uint32_t hash = 2166136261u;
+	for (uint32_t c = 0; c < stride; c++)
+	{
+		const float f = v[c] == 0.0f ? 0.0f : v[c];
+		uint32_t bits;
+		memcpy(&bits, &f, sizeof(bits));
+		hash ^= bits;
+		hash *= 16777619u;
+	}
+
+	hash ^= hash >> 16;
+	hash *= 0x85EBCA6Bu;
+	hash ^= hash >> 13;
+	hash *= 0xC2B2AE35u;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+namespace
+{
+	struct WeldJob
+	{
+		const float*	soup;
+		uint32_t		stride;
+		uint32_t		count;
+		uint32_t*		hashes;
+		uint32_t*		chunkOffsets;	///< per chunk and partition, counts and then where the chunk's vertices go.
+		uint32_t*		order;			///< soup indices by partition, in soup order within each.
+		float*			sorted;			///< the vertices in that order, -0 as +0.
+		uint32_t*		sortedHashes;
+		uint32_t*		partitionStart;	///< WeldPartitions + 1 of them.
+		uint32_t*		first;			///< per soup vertex, the first one equal to it.
+		uint32_t*		chunkFirsts;	///< per chunk, first vertices and then the output index of its first one.
+		float*			vertices;
+		uint32_t*		indices;
+	};
+}
+
+static uint32_t getWeldPartition(uint32_t hash)
+{
+	return hash >> 24;
+}
+
+static void weldHashJob(void* data, uint32_t begin, uint32_t end)
+{
+	WeldJob& job = *(WeldJob*)data;
+	for (uint32_t chunk = begin; chunk < end; chunk++)
+	{
+		uint32_t* counts = job.chunkOffsets + (size_t)chunk * GFXMeshBuilder::WeldPartitions;
+		const uint32_t last = std::min(job.count, (chunk + 1) * GFXMeshBuilder::WeldGrain);
+		for (uint32_t i = chunk * GFXMeshBuilder::WeldGrain; i < last; i++)
+		{
+			job.hashes[i] = hashVertex(job.soup + (size_t)i * job.stride, job.stride);
+			counts[getWeldPartition(job.hashes[i])]++;
+		}
+	}
+}
+
+static void weldScatterJob(void* data, uint32_t begin, uint32_t end)
+{
+	WeldJob& job = *(WeldJob*)data;
+	for (uint32_t chunk = begin; chunk < end; chunk++)
+	{
+		uint32_t* offsets = job.chunkOffsets + (size_t)chunk * GFXMeshBuilder::WeldPartitions;
+		const uint32_t last = std::min(job.count, (chunk + 1) * GFXMeshBuilder::WeldGrain);
+		for (uint32_t i = chunk * GFXMeshBuilder::WeldGrain; i < last; i++)
+		{
+			const uint32_t o = offsets[getWeldPartition(job.hashes[i])]++;
+			const float* src = job.soup + (size_t)i * job.stride;
+			float* dst = job.sorted + (size_t)o * job.stride;
+			for (uint32_t c = 0; c < job.stride; c++)
+				dst[c] = src[c] == 0.0f ? 0.0f : src[c];
+			job.order[o] = i;
+			job.sortedHashes[o] = job.hashes[i];
+		}
+	}
+}
+
+// the serial weld over one partition, it only finds the first of each
+// group of equal vertices. The partition's vertices were copied next to
+// each other by the scatter, so this doesn't hop around the soup.
+static void weldPartitionJob(void* data, uint32_t begin, uint32_t end)
+{
+	WeldJob& job = *(WeldJob*)data;
+	const size_t vertexSize = job.stride * sizeof(float);
+	std::vector<uint32_t> table;
+	for (uint32_t partition = begin; partition < end; partition++)
+	{
+		const uint32_t start = job.partitionStart[partition];
+		const uint32_t count = job.partitionStart[partition + 1] - start;
+
+		uint32_t tableSize = 1;
+		while (tableSize < count * 2)
+			tableSize <<= 1;
+		table.assign(tableSize, ~0u);
+
+		for (uint32_t o = start; o < start + count; o++)
+		{
+			const float* vertex = job.sorted + (size_t)o * job.stride;
+			uint32_t slot = job.sortedHashes[o] & (tableSize - 1);
+			while (1)
+			{
+				const uint32_t existing = table[slot];
+				if (existing == ~0u)
+				{
+					table[slot] = o;
+					job.first[job.order[o]] = job.order[o];
+					break;
+				}
+
+				if (memcmp(job.sorted + (size_t)existing * job.stride, vertex, vertexSize) == 0)
+				{
+					job.first[job.order[o]] = job.order[existing];
+					break;
+				}
+
+				slot = (slot + 1) & (tableSize - 1);
+			}
+		}
+	}
+}
+
+static void weldCountJob(void* data, uint32_t begin, uint32_t end)
+{
+	WeldJob& job = *(WeldJob*)data;
+	for (uint32_t chunk = begin; chunk < end; chunk++)
+	{
+		const uint32_t last = std::min(job.count, (chunk + 1) * GFXMeshBuilder::WeldGrain);
+		uint32_t firsts = 0;
+		for (uint32_t i = chunk * GFXMeshBuilder::WeldGrain; i < last; i++)
+			firsts += job.first[i] == i;
+		job.chunkFirsts[chunk] = firsts;
+	}
+}
+
+// first vertices go out in soup order and take their index.
+static void weldWriteJob(void* data, uint32_t begin, uint32_t end)
+{
+	WeldJob& job = *(WeldJob*)data;
+	for (uint32_t chunk = begin; chunk < end; chunk++)
+	{
+		uint32_t next = job.chunkFirsts[chunk];
+		const uint32_t last = std::min(job.count, (chunk + 1) * GFXMeshBuilder::WeldGrain);
+		for (uint32_t i = chunk * GFXMeshBuilder::WeldGrain; i < last; i++)
+		{
+			if (job.first[i] != i)
+				continue;
+
+			const float* src = job.soup + (size_t)i * job.stride;
+			float* dst = job.vertices + (size_t)next * job.stride;
+			for (uint32_t c = 0; c < job.stride; c++)
+				dst[c] = src[c] == 0.0f ? 0.0f : src[c];
+			job.indices[i] = next++;
+		}
+	}
+}
+
+// the rest look up the index their first vertex got.
+static void weldIndexJob(void* data, uint32_t begin, uint32_t end)
+{
+	WeldJob& job = *(WeldJob*)data;
+	for (uint32_t chunk = begin; chunk < end; chunk++)
+	{
+		const uint32_t last = std::min(job.count, (chunk + 1) * GFXMeshBuilder::WeldGrain);
+		for (uint32_t i = chunk * GFXMeshBuilder::WeldGrain; i < last; i++)
+		{
+			if (job.first[i] != i)
+				job.indices[i] = job.indices[job.first[i]];
+		}
+	}
+}
+
+static void weldParallel(const std::vector<float>& soup, uint32_t vertexStride, GFXMeshData& out, CoreJobSystem* jobs)
+{
+	const uint32_t count = (uint32_t)(soup.size() / vertexStride);
+	const uint32_t chunkCount = (count + GFXMeshBuilder::WeldGrain - 1) / GFXMeshBuilder::WeldGrain;
+
+	std::vector<uint32_t> hashes(count);
+	std::vector<uint32_t> chunkOffsets((size_t)chunkCount * GFXMeshBuilder::WeldPartitions, 0);
+	std::vector<uint32_t> order(count);
+	std::vector<float> sorted(soup.size());
+	std::vector<uint32_t> sortedHashes(count);
+	std::vector<uint32_t> partitionStart(GFXMeshBuilder::WeldPartitions + 1);
+	std::vector<uint32_t> first(count);
+	std::vector<uint32_t> chunkFirsts(chunkCount);
+	out.indices.resize(count);
+
+	WeldJob job;
+	job.soup = &soup[0];
+	job.stride = vertexStride;
+	job.count = count;
+	job.hashes = &hashes[0];
+	job.chunkOffsets = &chunkOffsets[0];
+	job.order = &order[0];
+	job.sorted = &sorted[0];
+	job.sortedHashes = &sortedHashes[0];
+	job.partitionStart = &partitionStart[0];
+	job.first = &first[0];
+	job.chunkFirsts = &chunkFirsts[0];
+	job.indices = &out.indices[0];
+
+	jobs->parallelFor(chunkCount, 1, weldHashJob, &job);
+
+	// counts to offsets, partition by partition and within one by chunk.
+	uint32_t offset = 0;
+	for (uint32_t p = 0; p < GFXMeshBuilder::WeldPartitions; p++)
+	{
+		partitionStart[p] = offset;
+		for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			uint32_t& slot = chunkOffsets[(size_t)chunk * GFXMeshBuilder::WeldPartitions + p];
+			const uint32_t vertices = slot;
+			slot = offset;
+			offset += vertices;
+		}
+	}
+	partitionStart[GFXMeshBuilder::WeldPartitions] = offset;
+
+	jobs->parallelFor(chunkCount, 1, weldScatterJob, &job);
+	jobs->parallelFor(GFXMeshBuilder::WeldPartitions, 1, weldPartitionJob, &job);
+	jobs->parallelFor(chunkCount, 1, weldCountJob, &job);
+
+	uint32_t vertexCount = 0;
+	for (uint32_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		const uint32_t firsts = chunkFirsts[chunk];
+		chunkFirsts[chunk] = vertexCount;
+		vertexCount += firsts;
+	}
+
+	out.vertices.resize((size_t)vertexCount * vertexStride);
+	job.vertices = &out.vertices[0];
+	jobs->parallelFor(chunkCount, 1, weldWriteJob, &job);
+	jobs->parallelFor(chunkCount, 1, weldIndexJob, &job);
+}
+
+void GFXMeshBuilder::weld(const std::vector<float>& soup, uint32_t vertexStride, GFXMeshData& out, CoreJobSystem* jobs)
+{
+	const uint32_t count = (uint32_t)(soup.size() / vertexStride);
+
+	out.vertexStride = vertexStride;
+	out.vertices.clear();
+	if (jobs && count > WeldGrain)
+	{
+		weldParallel(soup, vertexStride, out, jobs);
+		return;
+	}
+
+	out.indices.resize(count);
+
+	// open addressing table of output vertex indices, power of two sized.
+	uint32_t tableSize = 1;
+	while (tableSize < count * 2)
+		tableSize <<= 1;
+	std::vector<uint32_t> table(tableSize, ~0u);
+
+	std::vector<float> vert(vertexStride);
+	for (uint32_t i = 0; i < count; i++)
+	{
+		// -0 and +0 should weld.
+		for (uint32_t c = 0; c < vertexStride; c++)
+		{
+			float f = soup[(size_t)i * vertexStride + c];
+			vert[c] = f == 0.0f ? 0.0f : f;
+		}
+
+		uint32_t slot = hashVertex(&vert[0], vertexStride) & (tableSize - 1);
+		while (1)
+		{
+			uint32_t existing = table[slot];
+			if (existing == ~0u)
+			{
+				existing = (uint32_t)(out.vertices.size() / vertexStride);
+				out.vertices.insert(out.vertices.end(), vert.begin(), vert.end());
+				table[slot] = existing;
+				out.indices[i] = existing;
+				break;
+			}
+
+			if (memcmp(&out.vertices[(size_t)existing * vertexStride], &vert[0], vertexStride * sizeof(float)) == 0)
+			{
+				out.indices[i] = existing;
+				break;
+			}
+
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+}
+
+//-------------------------------------------------------------
+// Vertex cache optimization
+//-------------------------------------------------------------
+// Tom Forsyth, "Linear-Speed Vertex Cache Optimisation".
+static const float CacheDecayPower = 1.5f;
+static const float LastTriScore = 0.75f;
+static const float ValenceBoostScale = 2.0f;
+static const float ValenceBoostPower = 0.5f;
+
+static float scoreVertex(int cachePos, uint32_t liveTris, uint32_t cacheSize)
+{
+	if (liveTris == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if (cachePos >= 0)
+	{
+		// the last triangle's vertices get a fixed score so the next
+		// triangle doesn't just reuse the same edge.
+		if (cachePos < 3)
+			score = LastTriScore;
+		else
+		{
+			const float scaler = 1.0f / (cacheSize - 3);
+			score = powf(1.0f - (cachePos - 3) * scaler, CacheDecayPower);
+		}
+	}
+
+	// boost vertices with few triangles left so they get finished off.
+	score += ValenceBoostScale * powf((float)liveTris, -ValenceBoostPower);
+	return score;
+}
+
+void GFXMeshBuilder::optimizeVertexCache(GFXMeshData& mesh, uint32_t cacheSize)
+{
+	if (!mesh.indices.empty())
+		optimizeVertexCache(&mesh.indices[0], mesh.getIndexCount(), mesh.getVertexCount(), cacheSize);
+}
+
+void GFXMeshBuilder::optimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertCount, uint32_t cacheSize)
+{
+	const uint32_t triCount = indexCount / 3;
+	if (triCount == 0 || cacheSize <= 3)
+		return;
+
+	// per vertex list of triangles, live ones first.
+	std::vector<uint32_t> liveTris(vertCount, 0);
+	for (uint32_t i = 0; i < triCount * 3; i++)
+		liveTris[indices[i]]++;
+
+	std::vector<uint32_t> triStart(vertCount + 1, 0);
+	for (uint32_t v = 0; v < vertCount; v++)
+		triStart[v + 1] = triStart[v] + liveTris[v];
+
+	std::vector<uint32_t> triList(triCount * 3);
+	{
+		std::vector<uint32_t> fill(triStart.begin(), triStart.end() - 1);
+		for (uint32_t i = 0; i < triCount * 3; i++)
+			triList[fill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<int> cachePos(vertCount, -1);
+	std::vector<float> vertScore(vertCount);
+	for (uint32_t v = 0; v < vertCount; v++)
+		vertScore[v] = scoreVertex(-1, liveTris[v], cacheSize);
+
+	std::vector<float> triScore(triCount);
+	std::vector<uint8_t> emitted(triCount, 0);
+	int bestTri = 0;
+	for (uint32_t t = 0; t < triCount; t++)
+	{
+		triScore[t] = vertScore[indices[t * 3]] + vertScore[indices[t * 3 + 1]] + vertScore[indices[t * 3 + 2]];
+		if (triScore[t] > triScore[bestTri])
+			bestTri = t;
+	}
+
+	std::vector<uint32_t> cache;
+	std::vector<uint32_t> newCache;
+	cache.reserve(cacheSize + 3);
+	newCache.reserve(cacheSize + 3);
+
+	std::vector<uint32_t> result;
+	result.reserve(triCount * 3);
+	uint32_t scanCursor = 0;
+
+	for (uint32_t n = 0; n < triCount; n++)
+	{
+		if (bestTri < 0)
+		{
+			// nothing adjacent to the cache, take the next unused triangle.
+			while (emitted[scanCursor])
+				scanCursor++;
+			bestTri = scanCursor;
+		}
+
+		const uint32_t* tri = &indices[bestTri * 3];
+		result.push_back(tri[0]);
+		result.push_back(tri[1]);
+		result.push_back(tri[2]);
+		emitted[bestTri] = 1;
+
+		// drop the triangle from its vertices' live lists.
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = tri[k];
+			uint32_t* list = &triList[triStart[v]];
+			for (uint32_t i = 0; i < liveTris[v]; i++)
+			{
+				if (list[i] == (uint32_t)bestTri)
+				{
+					list[i] = list[liveTris[v] - 1];
+					list[liveTris[v] - 1] = bestTri;
+					break;
+				}
+			}
+			liveTris[v]--;
+		}
+
+		// LRU cache, emitted triangle's vertices go to the front.
+		newCache.clear();
+		newCache.push_back(tri[0]);
+		newCache.push_back(tri[1]);
+		newCache.push_back(tri[2]);
+		for (size_t i = 0; i < cache.size(); i++)
+		{
+			uint32_t v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				newCache.push_back(v);
+		}
+
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			uint32_t v = newCache[i];
+			cachePos[v] = i < cacheSize ? (int)i : -1;
+			vertScore[v] = scoreVertex(cachePos[v], liveTris[v], cacheSize);
+		}
+
+		// rescore triangles touching the cache and pick the best.
+		bestTri = -1;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			uint32_t v = newCache[i];
+			const uint32_t* list = &triList[triStart[v]];
+			for (uint32_t j = 0; j < liveTris[v]; j++)
+			{
+				uint32_t t = list[j];
+				float score = vertScore[indices[t * 3]] + vertScore[indices[t * 3 + 1]] + vertScore[indices[t * 3 + 2]];
+				triScore[t] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTri = t;
+				}
+			}
+		}
+
+		if (newCache.size() > cacheSize)
+			newCache.resize(cacheSize);
+		cache.swap(newCache);
+	}
+
+	memcpy(indices, &result[0], result.size() * sizeof(uint32_t));
+}
+
+void GFXMeshBuilder::optimizeVertexFetch(GFXMeshData& mesh)
+{
+	const uint32_t vertCount = mesh.getVertexCount();
+	const uint32_t stride = mesh.vertexStride;
+
+	// renumber vertices in order of first use.
+	std::vector<uint32_t> remap(vertCount, ~0u);
+	std::vector<float> vertices;
+	vertices.reserve(mesh.vertices.size());
+
+	uint32_t next = 0;
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		uint32_t v = mesh.indices[i];
+		if (remap[v] == ~0u)
+		{
+			remap[v] = next++;
+			vertices.insert(vertices.end(), mesh.vertices.begin() + (size_t)v * stride, mesh.vertices.begin() + (size_t)(v + 1) * stride);
+		}
+		mesh.indices[i] = remap[v];
+	}
+
+	// unreferenced vertices are dropped.
+	mesh.vertices.swap(vertices);
+}
+
+float GFXMeshBuilder::computeACMR(const uint32_t* indices, uint32_t indexCount, uint32_t cacheSize)
+{
+	if (indexCount < 3)
+		return 0.0f;
+
+	uint32_t maxIndex = 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+		maxIndex = indices[i] > maxIndex ? indices[i] : maxIndex;
+
+	// FIFO, a vertex is still cached if fewer than cacheSize misses
+	// happened since it was loaded.
+	std::vector<uint32_t> loadedAt(maxIndex + 1, 0);
+	uint32_t misses = 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		uint32_t v = indices[i];
+		if (loadedAt[v] == 0 || misses + 1 - loadedAt[v] > cacheSize)
+		{
+			misses++;
+			loadedAt[v] = misses;
+		}
+	}
+
+	return (float)misses / (indexCount / 3);
+}
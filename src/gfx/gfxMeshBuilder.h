@@ -0,0 +1,82 @@
+#ifndef GFXMESHBUILDER_H_
+#define GFXMESHBUILDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class CoreJobSystem;
+
+// Indexed triangle list with interleaved float vertices.
+struct GFXMeshData
+{
+	uint32_t				vertexStride;	///< floats per vertex.
+	std::vector<float>		vertices;
+	std::vector<uint32_t>	indices;
+
+	GFXMeshData() : vertexStride(0) {}
+
+	uint32_t	getVertexCount() const { return vertexStride ? (uint32_t)(vertices.size() / vertexStride) : 0; }
+	uint32_t	getIndexCount() const { return (uint32_t)indices.size(); }
+	uint32_t	getTriangleCount() const { return (uint32_t)indices.size() / 3; }
+	const float* getVertex(uint32_t index) const { return &vertices[index * vertexStride]; }
+
+	// 16 bit indices whenever the vertex count allows it.
+	uint32_t	getIndexSize() const { return getVertexCount() > 0xFFFF ? 4 : 2; }
+	void		getIndexData(std::vector<uint8_t>& out) const;
+};
+
+//-------------------------------------------------------------
+// Mesh builder
+//-------------------------------------------------------------
+// Takes triangle soup, welds identical vertices through a hash and
+// reorders the result for the post transform cache (Forsyth) and
+// then for vertex fetch locality.
+//
+// Given a job system, weld() splits the vertices into WeldPartitions by
+// their hash. Equal vertices always share a partition, so each one is
+// welded by a job of its own, and the output is the same as without.
+class GFXMeshBuilder
+{
+public:
+	enum
+	{
+		DefaultCacheSize = 32,
+		WeldPartitions = 256,		///< by the top 8 bits of the vertex hash.
+		WeldGrain = 32768,			///< soup vertices per hash and scatter job.
+	};
+
+	GFXMeshBuilder(uint32_t vertexStride);
+
+	// triangle soup, 3 vertices per triangle.
+	void addVertex(const float* vertex);
+	void addVertices(const float* vertices, uint32_t count);
+
+	// same, with each attribute in its own array. Attributes are
+	// interleaved in the order given.
+	void addStreams(uint32_t count, uint32_t streamCount, const float* const* streams, const uint32_t* streamWidths);
+
+	// indexed input, the vertices are welded again.
+	void addIndexed(const float* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount);
+
+	// weld, optimize and print the cache statistics.
+	void build(GFXMeshData& out, uint32_t cacheSize = DefaultCacheSize);
+
+	// individual steps.
+	static void weld(const std::vector<float>& soup, uint32_t vertexStride, GFXMeshData& out, CoreJobSystem* jobs = NULL);
+	static void optimizeVertexCache(GFXMeshData& mesh, uint32_t cacheSize = DefaultCacheSize);
+	static void optimizeVertexCache(uint32_t* indices, uint32_t indexCount, uint32_t vertexCount, uint32_t cacheSize = DefaultCacheSize);
+	static void optimizeVertexFetch(GFXMeshData& mesh);
+
+	// average cache miss ratio, transformed vertices per triangle with a
+	// FIFO cache of the given size. 3.0 is no reuse at all.
+	static float computeACMR(const uint32_t* indices, uint32_t indexCount, uint32_t cacheSize);
+
+	uint32_t getSoupVertexCount() const { return (uint32_t)(mSoup.size() / mVertexStride); }
+
+private:
+	uint32_t			mVertexStride;
+	std::vector<float>	mSoup;
+};
+
+#endif
@@ -0,0 +1,329 @@
+#include "gfx/gfxMeshFile.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static const uint64_t FNVOffset64 = 14695981039346656037ull;
+static const uint64_t FNVPrime64 = 1099511628211ull;
+
+static uint64_t hashBytes(const void* data, uint64_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint64_t hash = FNVOffset64;
+	for (uint64_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= FNVPrime64;
+	}
+	return hash;
+}
+
+static uint64_t alignOffset(uint64_t offset)
+{
+	return (offset + GFXMeshFile::SectionAlignment - 1) & ~(uint64_t)(GFXMeshFile::SectionAlignment - 1);
+}
+
+GFXMeshFile::GFXMeshFile()
+{
+	mData = NULL;
+	mSize = 0;
+	mHeader = NULL;
+	mSections = NULL;
+	mChecked = 0;
+	mValid = 0;
+}
+
+GFXMeshFile::~GFXMeshFile()
+{
+	close();
+}
+
+bool GFXMeshFile::open(const char* path)
+{
+	close();
+
+	if (!mFile.open(path))
+		return false;
+
+	if (!open(mFile.getData(), mFile.getSize()))
+	{
+		printf("Mesh file %s is not a version %d mesh.\n", path, FileVersion);
+		mFile.close();
+		return false;
+	}
+	return true;
+}
+
+bool GFXMeshFile::open(const void* data, uint64_t size)
+{
+	if (data != mFile.getData())
+		close();
+
+	// only the header is looked at here, sections are checked on use.
+	const Header* header = (const Header*)data;
+	const bool valid = data && size >= sizeof(Header) &&
+		header->magic == FileMagic && header->version == FileVersion &&
+		header->sectionCount <= 32 &&
+		header->headerSize == sizeof(Header) + header->sectionCount * sizeof(Section) &&
+		header->headerSize <= size && header->fileSize == size &&
+		(header->indexSize == 2 || header->indexSize == 4);
+
+	if (!valid)
+		return false;
+
+	mData = (const uint8_t*)data;
+	mSize = size;
+	mHeader = header;
+	mSections = (const Section*)(mData + sizeof(Header));
+	mChecked = 0;
+	mValid = 0;
+	return true;
+}
+
+void GFXMeshFile::close()
+{
+	mFile.close();
+	mData = NULL;
+	mSize = 0;
+	mHeader = NULL;
+	mSections = NULL;
+	mChecked = 0;
+	mValid = 0;
+}
+
+const void* GFXMeshFile::getSection(SectionType type, uint32_t elementSize, uint32_t* count, uint64_t* size) const
+{
+	if (!mHeader)
+		return NULL;
+
+	for (uint32_t i = 0; i < mHeader->sectionCount; i++)
+	{
+		const Section& section = mSections[i];
+		if (section.type != (uint32_t)type)
+			continue;
+
+		const uint32_t bit = 1u << i;
+		if (!(mChecked & bit))
+		{
+			mChecked |= bit;
+			if (section.elementSize == elementSize && section.size == (uint64_t)section.elementSize * section.count &&
+				section.offset >= mHeader->headerSize && (section.offset % SectionAlignment) == 0 &&
+				section.offset <= mSize && section.size <= mSize - section.offset)
+				mValid |= bit;
+			else
+				printf("Mesh file section %d is broken.\n", type);
+		}
+
+		if (!(mValid & bit))
+			return NULL;
+
+		if (count)
+			*count = section.count;
+		if (size)
+			*size = section.size;
+		return mData + section.offset;
+	}
+
+	return NULL;
+}
+
+bool GFXMeshFile::verify() const
+{
+	if (!mHeader)
+		return false;
+
+	for (uint32_t i = 0; i < mHeader->sectionCount; i++)
+	{
+		const Section& section = mSections[i];
+		if (section.offset > mSize || section.size > mSize - section.offset)
+			return false;
+		if (hashBytes(mData + section.offset, section.size) != section.hash)
+			return false;
+	}
+
+	return true;
+}
+
+const void* GFXMeshFile::getVertices(uint64_t* size) const
+{
+	uint32_t count = 0;
+	const void* data = mHeader ? getSection(SectionVertices, mHeader->vertexStride, &count, size) : NULL;
+	return data && count == mHeader->vertexCount ? data : NULL;
+}
+
+const void* GFXMeshFile::getIndices(uint64_t* size) const
+{
+	uint32_t count = 0;
+	const void* data = mHeader ? getSection(SectionIndices, mHeader->indexSize, &count, size) : NULL;
+	return data && count == mHeader->indexCount ? data : NULL;
+}
+
+const GFXMeshLOD* GFXMeshFile::getLODs(uint32_t* count) const
+{
+	*count = 0;
+	return (const GFXMeshLOD*)getSection(SectionLODs, sizeof(GFXMeshLOD), count, NULL);
+}
+
+const GFXMeshlet* GFXMeshFile::getMeshlets(uint32_t* count) const
+{
+	*count = 0;
+	return (const GFXMeshlet*)getSection(SectionMeshlets, sizeof(GFXMeshlet), count, NULL);
+}
+
+const GFXMeshlet* GFXMeshFile::getLODMeshlets(uint32_t lod, uint32_t* count) const
+{
+	uint32_t lodCount = 0;
+	uint32_t meshletCount = 0;
+	const GFXMeshLOD* lods = getLODs(&lodCount);
+	const GFXMeshlet* meshlets = getMeshlets(&meshletCount);
+	*count = 0;
+	if (!lods || !meshlets || lod >= lodCount)
+		return NULL;
+
+	// meshlets are sorted by firstIndex, find the first one in the LOD.
+	const uint32_t first = lods[lod].firstIndex;
+	const uint32_t end = first + lods[lod].indexCount;
+	uint32_t low = 0;
+	uint32_t high = meshletCount;
+	while (low < high)
+	{
+		const uint32_t mid = (low + high) / 2;
+		if (meshlets[mid].firstIndex < first)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	uint32_t last = low;
+	while (last < meshletCount && meshlets[last].firstIndex < end)
+		last++;
+
+	*count = last - low;
+	return meshlets + low;
+}
+
+bool GFXMeshFile::getVertexFormat(GFXVertexFormat& format) const
+{
+	uint32_t count = 0;
+	const ElementRecord* elements = (const ElementRecord*)getSection(SectionVertexFormat, sizeof(ElementRecord), &count, NULL);
+	if (!elements || count == 0)
+		return false;
+
+	format = GFXVertexFormat();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (elements[i].type > GFXVertexUInt || elements[i].stream >= GFXVertexFormat::MaxStreams)
+			return false;
+		format.addElement(elements[i].location, (GFXVertexElementType)elements[i].type, elements[i].components, elements[i].stream);
+
+		// the format is rebuilt from scratch, it has to come out the same.
+		if (format.getElement(i).offset != elements[i].offset)
+			return false;
+	}
+
+	return format.getStride() == mHeader->vertexStride;
+}
+
+bool GFXMeshFile::getBounds(Box3& bounds) const
+{
+	const float* extents = (const float*)getSection(SectionBounds, 6 * sizeof(float), NULL, NULL);
+	if (!extents)
+		return false;
+
+	bounds = Box3(Vector3(extents[0], extents[1], extents[2]), Vector3(extents[3], extents[4], extents[5]));
+	return true;
+}
+
+bool GFXMeshFile::write(const char* path, uint64_t sourceHash, const GFXMeshData& mesh, const GFXVertexFormat& format,
+	const uint32_t* srcWidths, const Box3& bounds, const GFXMeshLOD* lods, uint32_t lodCount,
+	const GFXMeshlet* meshlets, uint32_t meshletCount)
+{
+	if (mesh.getVertexCount() == 0 || mesh.getIndexCount() == 0 || format.getStreamCount() != 1)
+		return false;
+
+	std::vector<uint8_t> vertexData;
+	format.pack(&mesh.vertices[0], mesh.vertexStride, mesh.getVertexCount(), vertexData, srcWidths);
+
+	std::vector<uint8_t> indexData;
+	mesh.getIndexData(indexData);
+
+	std::vector<ElementRecord> elements(format.getElementCount());
+	for (uint32_t i = 0; i < format.getElementCount(); i++)
+	{
+		const GFXVertexElement& element = format.getElement(i);
+		elements[i].location = element.location;
+		elements[i].type = (uint32_t)element.type;
+		elements[i].components = element.components;
+		elements[i].stream = element.stream;
+		elements[i].offset = element.offset;
+	}
+
+	const float extents[6] = { bounds.minExtents.x, bounds.minExtents.y, bounds.minExtents.z,
+		bounds.maxExtents.x, bounds.maxExtents.y, bounds.maxExtents.z };
+
+	// biggest sections first, the vertices start right after the table.
+	const void* contents[SectionTypeCount] = { &vertexData[0], &indexData[0], &elements[0], extents, lods, meshlets };
+	Section sections[SectionTypeCount];
+	memset(sections, 0, sizeof(sections));
+	sections[SectionVertices].elementSize = format.getStride();
+	sections[SectionVertices].count = mesh.getVertexCount();
+	sections[SectionIndices].elementSize = mesh.getIndexSize();
+	sections[SectionIndices].count = mesh.getIndexCount();
+	sections[SectionVertexFormat].elementSize = sizeof(ElementRecord);
+	sections[SectionVertexFormat].count = (uint32_t)elements.size();
+	sections[SectionBounds].elementSize = sizeof(extents);
+	sections[SectionBounds].count = 1;
+	sections[SectionLODs].elementSize = sizeof(GFXMeshLOD);
+	sections[SectionLODs].count = lods ? lodCount : 0;
+	sections[SectionMeshlets].elementSize = sizeof(GFXMeshlet);
+	sections[SectionMeshlets].count = meshlets ? meshletCount : 0;
+
+	Header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = FileMagic;
+	header.version = FileVersion;
+	header.headerSize = sizeof(Header) + SectionTypeCount * sizeof(Section);
+	header.sectionCount = SectionTypeCount;
+	header.vertexCount = mesh.getVertexCount();
+	header.vertexStride = format.getStride();
+	header.indexCount = mesh.getIndexCount();
+	header.indexSize = mesh.getIndexSize();
+	header.sourceHash = sourceHash;
+
+	uint64_t offset = header.headerSize;
+	for (uint32_t i = 0; i < SectionTypeCount; i++)
+	{
+		sections[i].type = i;
+		sections[i].size = (uint64_t)sections[i].elementSize * sections[i].count;
+		sections[i].offset = alignOffset(offset);
+		sections[i].hash = hashBytes(contents[i], sections[i].size);
+		offset = sections[i].offset + sections[i].size;
+	}
+	header.fileSize = offset;
+
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		printf("Can't write mesh file %s.\n", path);
+		return false;
+	}
+
+	static const uint8_t padding[SectionAlignment] = { 0 };
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(sections, sizeof(sections), 1, file) == 1;
+	uint64_t position = header.headerSize;
+	for (uint32_t i = 0; i < SectionTypeCount && written; i++)
+	{
+		written = fwrite(padding, 1, (size_t)(sections[i].offset - position), file) == (size_t)(sections[i].offset - position) &&
+			(sections[i].size == 0 || fwrite(contents[i], (size_t)sections[i].size, 1, file) == 1);
+		position = sections[i].offset + sections[i].size;
+	}
+	fclose(file);
+
+	if (!written)
+	{
+		printf("Can't write mesh file %s.\n", path);
+		remove(path);
+	}
+	return written;
+}
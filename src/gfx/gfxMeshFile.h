@@ -0,0 +1,140 @@
+#ifndef GFXMESHFILE_H_
+#define GFXMESHFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gfx/gfxMeshBuilder.h"
+#include "gfx/gfxMeshSimplifier.h"
+#include "gfx/gfxMeshletBuilder.h"
+#include "gfx/gfxVertexFormat.h"
+#include "platform/platformMappedFile.h"
+#include "math/box3.h"
+
+//-------------------------------------------------------------
+// Mesh file
+//-------------------------------------------------------------
+// Binary mesh container laid out so a mapped file can be used as is:
+// a header, a table of sections and the sections themselves, each
+// starting on a SectionAlignment boundary. Vertices are stored already
+// packed in their vertex format and indices at their final size, so
+// getVertices() and getIndices() go straight to glBufferData without
+// a copy.
+//
+// open() maps the file, or takes one already in memory, and only
+// checks the header. A section's table entry is checked the first time
+// it's asked for, so loading a mesh never touches the pages of sections
+// it doesn't use. verify() hashes the contents too, for tools and after
+// a download.
+//
+// Everything is little endian. Bump FileVersion whenever the layout
+// of the header, a section entry or a stored struct changes.
+class GFXMeshFile
+{
+public:
+	enum SectionType
+	{
+		SectionVertices,		///< packed vertices, vertexStride bytes each.
+		SectionIndices,			///< indexSize bytes each.
+		SectionVertexFormat,	///< ElementRecord per vertex element.
+		SectionBounds,			///< min and max, 6 floats.
+		SectionLODs,			///< GFXMeshLOD, full detail first.
+		SectionMeshlets,		///< GFXMeshlet, sorted by firstIndex.
+		SectionTypeCount,
+	};
+
+	enum
+	{
+		FileMagic = 0x48534D47,		///< 'GMSH'
+		FileVersion = 1,
+		SectionAlignment = 64,
+	};
+
+	GFXMeshFile();
+	~GFXMeshFile();
+
+	bool open(const char* path);
+	void close();
+
+	// a file already in memory, e.g. streamed in. The memory has to stay
+	// around until close().
+	bool open(const void* data, uint64_t size);
+
+	// hashes every section and compares with the table.
+	bool verify() const;
+
+	bool		isOpen() const { return mHeader != NULL; }
+	uint64_t	getSourceHash() const { return mHeader->sourceHash; }
+	uint32_t	getVertexCount() const { return mHeader->vertexCount; }
+	uint32_t	getVertexStride() const { return mHeader->vertexStride; }
+	uint32_t	getIndexCount() const { return mHeader->indexCount; }
+	uint32_t	getIndexSize() const { return mHeader->indexSize; }
+
+	// pointers into the file, valid until close(). NULL when the
+	// section is missing or broken.
+	const void*	getVertices(uint64_t* size = NULL) const;
+	const void*	getIndices(uint64_t* size = NULL) const;
+	const GFXMeshLOD* getLODs(uint32_t* count) const;
+	const GFXMeshlet* getMeshlets(uint32_t* count) const;
+
+	// the meshlets covering a LOD's index range.
+	const GFXMeshlet* getLODMeshlets(uint32_t lod, uint32_t* count) const;
+
+	bool getVertexFormat(GFXVertexFormat& format) const;
+	bool getBounds(Box3& bounds) const;
+
+	// writes a mesh whose vertices pack into format, see
+	// GFXVertexFormat::pack() for srcWidths. sourceHash is stored as is,
+	// callers use it to tell whether the file is older than its source.
+	static bool write(const char* path, uint64_t sourceHash, const GFXMeshData& mesh, const GFXVertexFormat& format,
+		const uint32_t* srcWidths, const Box3& bounds, const GFXMeshLOD* lods, uint32_t lodCount,
+		const GFXMeshlet* meshlets, uint32_t meshletCount);
+
+private:
+	struct Header
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint32_t	headerSize;			///< header and section table, in bytes.
+		uint32_t	sectionCount;
+		uint32_t	vertexCount;
+		uint32_t	vertexStride;		///< bytes.
+		uint32_t	indexCount;
+		uint32_t	indexSize;			///< 2 or 4.
+		uint64_t	sourceHash;
+		uint64_t	fileSize;
+	};
+
+	struct Section
+	{
+		uint32_t	type;
+		uint32_t	elementSize;
+		uint32_t	count;
+		uint32_t	pad;
+		uint64_t	offset;				///< from the start of the file.
+		uint64_t	size;
+		uint64_t	hash;				///< FNV-1a of the contents.
+	};
+
+	struct ElementRecord
+	{
+		uint32_t	location;
+		uint32_t	type;
+		uint32_t	components;
+		uint32_t	stream;
+		uint32_t	offset;
+	};
+
+	const void*	getSection(SectionType type, uint32_t elementSize, uint32_t* count, uint64_t* size) const;
+
+	PlatformMappedFile	mFile;
+	const uint8_t*		mData;
+	uint64_t			mSize;
+	const Header*		mHeader;
+	const Section*		mSections;
+
+	mutable uint32_t	mChecked;		///< one bit per section entry checked so far.
+	mutable uint32_t	mValid;
+};
+
+#endif
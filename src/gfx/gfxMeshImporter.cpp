@@ -0,0 +1,1250 @@
+#include "gfx/gfxMeshImporter.h"
+#include "core/coreJobSystem.h"
+#include "platform/platformMappedFile.h"
+#include "math/Vector.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#if (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L) || __cplusplus >= 201703L
+#include <charconv>
+#endif
+
+// the float overloads of from_chars are what we're after, they came
+// late (gcc 11, VS 2019 16.4) and this macro only shows up with them.
+#ifdef __cpp_lib_to_chars
+#define GFX_FROM_CHARS 1
+#else
+#define GFX_FROM_CHARS 0
+#endif
+
+static const uint32_t InvalidIndex = 0xFFFFFFFF;
+
+//-------------------------------------------------------------
+// Parsing helpers
+//-------------------------------------------------------------
+static inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* skipBlanks(const char* p, const char* end)
+{
+	while (p < end && isBlank(*p))
+		p++;
+	return p;
+}
+
+static inline const char* findLineEnd(const char* p, const char* end)
+{
+	const char* eol = (const char*)memchr(p, '\n', end - p);
+	return eol ? eol : end;
+}
+
+#if !GFX_FROM_CHARS
+static const double PowersOf10[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static inline bool isDigit(char c)
+{
+	return (unsigned)(c - '0') < 10;
+}
+#endif
+
+// parse a number at p, return the end of it or NULL.
+static const char* parseFloat(const char* p, const char* end, float& value)
+{
+	if (p < end && *p == '+')
+		p++;
+
+#if GFX_FROM_CHARS
+	std::from_chars_result result = std::from_chars(p, end, value);
+	return result.ec == std::errc() ? result.ptr : NULL;
+#else
+	// up to 18 significant digits scaled by an exact power of ten, close
+	// enough to correctly rounded once it's a float.
+	const bool negative = p < end && *p == '-';
+	if (negative)
+		p++;
+
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digits = 0;
+	for (; p < end && isDigit(*p); p++, digits++)
+	{
+		if (mantissa < 100000000000000000ull)
+			mantissa = mantissa * 10 + (*p - '0');
+		else
+			exponent++;
+	}
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && isDigit(*p); p++, digits++)
+		{
+			if (mantissa < 100000000000000000ull)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				exponent--;
+			}
+		}
+	}
+	if (!digits)
+		return NULL;
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* q = p + 1;
+		const bool negativeExponent = q < end && *q == '-';
+		if (q < end && (*q == '-' || *q == '+'))
+			q++;
+		if (q < end && isDigit(*q))
+		{
+			int e = 0;
+			for (; q < end && isDigit(*q); q++)
+			{
+				if (e < 10000)
+					e = e * 10 + (*q - '0');
+			}
+			exponent += negativeExponent ? -e : e;
+			p = q;
+		}
+	}
+
+	double result = (double)mantissa;
+	if (exponent < 0)
+		result = exponent >= -22 ? result / PowersOf10[-exponent] : result * pow(10.0, exponent);
+	else if (exponent > 0)
+		result = exponent <= 22 ? result * PowersOf10[exponent] : result * pow(10.0, exponent);
+
+	value = (float)(negative ? -result : result);
+	return p;
+#endif
+}
+
+static const char* parseInt(const char* p, const char* end, int64_t& value)
+{
+	if (p < end && *p == '+')
+		p++;
+
+#if GFX_FROM_CHARS
+	std::from_chars_result result = std::from_chars(p, end, value);
+	return result.ec == std::errc() ? result.ptr : NULL;
+#else
+	const bool negative = p < end && *p == '-';
+	if (negative)
+		p++;
+
+	const char* start = p;
+	int64_t result = 0;
+	for (; p < end && isDigit(*p); p++)
+		result = result * 10 + (*p - '0');
+	if (p == start)
+		return NULL;
+
+	value = negative ? -result : result;
+	return p;
+#endif
+}
+
+// cut [begin, end) into pieces of about ChunkSize, each ending after a
+// newline.
+static void splitLines(const char* begin, const char* end, std::vector<const char*>& bounds)
+{
+	bounds.clear();
+	bounds.push_back(begin);
+	const char* p = begin;
+	while (end - p > GFXMeshImporter::ChunkSize)
+	{
+		const char* eol = findLineEnd(p + GFXMeshImporter::ChunkSize, end);
+		p = eol < end ? eol + 1 : end;
+		bounds.push_back(p);
+	}
+	if (p < end)
+		bounds.push_back(end);
+}
+
+static void runJobs(CoreJobSystem* jobs, uint32_t count, uint32_t grain, CoreJobFunc func, void* data)
+{
+	if (jobs && count > grain)
+		jobs->parallelFor(count, grain, func, data);
+	else if (count)
+		func(data, 0, count);
+}
+
+//-------------------------------------------------------------
+// Shared output
+//-------------------------------------------------------------
+// one triangle corner, indices into the arrays of ImportSource.
+struct ImportCorner
+{
+	uint32_t	position;
+	uint32_t	texcoord;	///< InvalidIndex when the file has none.
+	uint32_t	normal;
+};
+
+// everything parsed, before it's turned into vertices.
+struct ImportSource
+{
+	std::vector<float>	positions;	///< 3 floats each.
+	std::vector<float>	colors;		///< 3 floats per position, empty when the file has none.
+	std::vector<float>	normals;	///< 3 floats each.
+	std::vector<float>	texcoords;	///< 2 floats each.
+	std::vector<ImportCorner>	corners;	///< 3 per triangle.
+};
+
+struct EmitJob
+{
+	const ImportSource*	source;
+	uint32_t			attributes;
+	uint32_t			stride;
+	float*				soup;
+};
+
+static void emitJob(void* data, uint32_t begin, uint32_t end)
+{
+	const EmitJob& job = *(const EmitJob*)data;
+	const ImportSource& source = *job.source;
+	const float* positions = &source.positions[0];
+
+	for (uint32_t t = begin; t < end; t++)
+	{
+		const ImportCorner* corners = &source.corners[t * 3];
+
+		Vector3 faceNormal(0.0f, 0.0f, 0.0f);
+		if (job.attributes & GFXMeshImporter::AttribNormal)
+		{
+			const float* p0 = &positions[corners[0].position * 3];
+			const float* p1 = &positions[corners[1].position * 3];
+			const float* p2 = &positions[corners[2].position * 3];
+			const Vector3 e1(p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]);
+			const Vector3 e2(p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]);
+			faceNormal = e1.cross(e2);
+			const float length = faceNormal.length();
+			if (length > 0.0f)
+				faceNormal /= length;
+		}
+
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			const ImportCorner& corner = corners[k];
+			float* v = job.soup + ((size_t)t * 3 + k) * job.stride;
+			const float* p = &positions[corner.position * 3];
+			*v++ = p[0];
+			*v++ = p[1];
+			*v++ = p[2];
+
+			if (job.attributes & GFXMeshImporter::AttribNormal)
+			{
+				if (corner.normal != InvalidIndex)
+				{
+					const float* n = &source.normals[corner.normal * 3];
+					*v++ = n[0];
+					*v++ = n[1];
+					*v++ = n[2];
+				}
+				else
+				{
+					*v++ = faceNormal.x;
+					*v++ = faceNormal.y;
+					*v++ = faceNormal.z;
+				}
+			}
+
+			if (job.attributes & GFXMeshImporter::AttribTexCoord)
+			{
+				const float* uv = corner.texcoord != InvalidIndex ? &source.texcoords[corner.texcoord * 2] : NULL;
+				*v++ = uv ? uv[0] : 0.0f;
+				*v++ = uv ? uv[1] : 0.0f;
+			}
+
+			if (job.attributes & GFXMeshImporter::AttribColor)
+			{
+				const float* c = source.colors.empty() ? NULL : &source.colors[corner.position * 3];
+				*v++ = c ? c[0] : 1.0f;
+				*v++ = c ? c[1] : 1.0f;
+				*v++ = c ? c[2] : 1.0f;
+			}
+		}
+	}
+}
+
+// soup and weld in parallel, then the cache and fetch reordering when
+// it's asked for.
+static bool buildMesh(const ImportSource& source, uint32_t attributes, uint32_t stride, bool optimize, GFXMeshData& out,
+	CoreJobSystem* jobs, double& emitTime, double& weldTime)
+{
+	const uint32_t triangleCount = (uint32_t)(source.corners.size() / 3);
+	if (!triangleCount)
+	{
+		printf("Mesh importer: no triangles.\n");
+		return false;
+	}
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	std::vector<float> soup((size_t)triangleCount * 3 * stride);
+	EmitJob job = { &source, attributes, stride, &soup[0] };
+	runJobs(jobs, triangleCount, GFXMeshImporter::EmitGrain, emitJob, &job);
+	std::chrono::high_resolution_clock::time_point emitted = std::chrono::high_resolution_clock::now();
+	emitTime = std::chrono::duration<double, std::milli>(emitted - start).count();
+
+	GFXMeshBuilder::weld(soup, stride, out, jobs);
+	weldTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - emitted).count();
+
+	if (optimize)
+	{
+		GFXMeshBuilder::optimizeVertexCache(out);
+		GFXMeshBuilder::optimizeVertexFetch(out);
+	}
+	return true;
+}
+
+//-------------------------------------------------------------
+// Importer
+//-------------------------------------------------------------
+GFXMeshImporter::GFXMeshImporter()
+{
+	mAttributes = 0;
+	mOptimize = true;
+}
+
+uint32_t GFXMeshImporter::getVertexStride() const
+{
+	return 3 + ((mAttributes & AttribNormal) ? 3 : 0) + ((mAttributes & AttribTexCoord) ? 2 : 0) + ((mAttributes & AttribColor) ? 3 : 0);
+}
+
+static bool hasExtension(const char* path, const char* extension)
+{
+	const size_t length = strlen(path);
+	const size_t extensionLength = strlen(extension);
+	if (length < extensionLength)
+		return false;
+
+	for (size_t i = 0; i < extensionLength; i++)
+	{
+		if (tolower((unsigned char)path[length - extensionLength + i]) != extension[i])
+			return false;
+	}
+	return true;
+}
+
+bool GFXMeshImporter::load(const char* path, GFXMeshData& out, CoreJobSystem* jobs) const
+{
+	const bool obj = hasExtension(path, ".obj");
+	if (!obj && !hasExtension(path, ".ply"))
+	{
+		printf("Mesh importer: %s is neither OBJ nor PLY.\n", path);
+		return false;
+	}
+
+	// mapped, the parse jobs read straight from the page cache.
+	PlatformMappedFile file;
+	if (!file.open(path))
+	{
+		printf("Mesh importer: can't open %s.\n", path);
+		return false;
+	}
+	file.prefetch(0, file.getSize());
+
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	const char* data = (const char*)file.getData();
+	const bool loaded = obj ? loadOBJ(data, file.getSize(), out, jobs) : loadPLY(data, file.getSize(), out, jobs);
+	std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - start;
+
+	if (loaded)
+	{
+		printf("Imported %s: %d vertices, %d triangles, %.1f MB in %.1f ms (%.0f MB/s).\n", path, out.getVertexCount(),
+			out.getTriangleCount(), file.getSize() / (1024.0 * 1024.0), time.count(), file.getSize() / (1024.0 * 1024.0) / (time.count() / 1000.0));
+	}
+	return loaded;
+}
+
+//-------------------------------------------------------------
+// OBJ
+//-------------------------------------------------------------
+// a face corner as written, before chunks know where they start.
+// Negative OBJ indices count back from the current vertex, those are
+// kept relative to the chunk's first vertex and rebased later.
+struct ObjCorner
+{
+	int32_t		index[3];	///< position, texcoord, normal.
+	uint8_t		flags;		///< 2 bits per index, ObjIndexAbsolute or ObjIndexRelative.
+};
+
+enum
+{
+	ObjIndexAbsolute = 1,
+	ObjIndexRelative = 2,
+};
+
+struct ObjChunk
+{
+	const char*				begin;
+	const char*				end;
+	std::vector<float>		positions;
+	std::vector<float>		colors;		///< filled in white before the first colored vertex.
+	std::vector<float>		normals;
+	std::vector<float>		texcoords;
+	std::vector<ObjCorner>	corners;
+	uint32_t				positionBase;
+	uint32_t				normalBase;
+	uint32_t				texcoordBase;
+	uint32_t				cornerBase;
+	uint32_t				errors;
+};
+
+struct ObjJob
+{
+	std::vector<ObjChunk>*	chunks;
+	ImportSource*				source;
+	bool					hasColors;
+};
+
+static inline void setObjIndex(ObjCorner& corner, uint32_t slot, int64_t value, size_t localCount)
+{
+	if (value > 0)
+	{
+		corner.index[slot] = (int32_t)(value - 1);
+		corner.flags |= ObjIndexAbsolute << (slot * 2);
+	}
+	else
+	{
+		corner.index[slot] = (int32_t)((int64_t)localCount + value);
+		corner.flags |= ObjIndexRelative << (slot * 2);
+	}
+}
+
+// v/vt/vn, v//vn, v/vt or v.
+static const char* parseObjCorner(const char* p, const char* end, const ObjChunk& chunk, ObjCorner& corner)
+{
+	int64_t value = 0;
+	memset(&corner, 0, sizeof(corner));
+	p = parseInt(p, end, value);
+	if (!p || value == 0)
+		return NULL;
+	setObjIndex(corner, 0, value, chunk.positions.size() / 3);
+
+	if (p < end && *p == '/')
+	{
+		p++;
+		if (p < end && *p != '/')
+		{
+			p = parseInt(p, end, value);
+			if (!p || value == 0)
+				return NULL;
+			setObjIndex(corner, 1, value, chunk.texcoords.size() / 2);
+		}
+		if (p < end && *p == '/')
+		{
+			p = parseInt(p + 1, end, value);
+			if (!p || value == 0)
+				return NULL;
+			setObjIndex(corner, 2, value, chunk.normals.size() / 3);
+		}
+	}
+	return p;
+}
+
+static bool parseObjFloats(const char* p, const char* end, float* values, uint32_t required, uint32_t optional, uint32_t& count)
+{
+	count = 0;
+	for (uint32_t i = 0; i < required + optional; i++)
+	{
+		p = skipBlanks(p, end);
+		if (p == end || *p == '#')
+			break;
+		p = parseFloat(p, end, values[i]);
+		if (!p)
+			return false;
+		count++;
+	}
+	return count >= required;
+}
+
+static void parseObjChunk(ObjChunk& chunk)
+{
+	std::vector<ObjCorner> polygon;
+	const char* p = chunk.begin;
+	while (p < chunk.end)
+	{
+		const char* eol = findLineEnd(p, chunk.end);
+		const char* line = skipBlanks(p, eol);
+		p = eol + 1;
+
+		if (eol - line < 2)
+			continue;
+
+		// v, vn, vt and f, everything else is skipped.
+		const bool vertexData = line[0] == 'v' && eol - line > 2 && isBlank(line[2]);
+		float values[6];
+		uint32_t count = 0;
+		if (line[0] == 'v' && isBlank(line[1]))
+		{
+			// x y z, some exporters add r g b.
+			if (!parseObjFloats(line + 1, eol, values, 3, 3, count))
+			{
+				chunk.errors++;
+				values[0] = values[1] = values[2] = 0.0f;
+			}
+			chunk.positions.insert(chunk.positions.end(), values, values + 3);
+
+			if (count == 6 && chunk.colors.empty())
+				chunk.colors.assign(chunk.positions.size() - 3, 1.0f);
+			if (count == 6)
+				chunk.colors.insert(chunk.colors.end(), values + 3, values + 6);
+			else if (!chunk.colors.empty())
+				chunk.colors.insert(chunk.colors.end(), 3, 1.0f);
+		}
+		else if (vertexData && line[1] == 'n')
+		{
+			if (!parseObjFloats(line + 2, eol, values, 3, 0, count))
+			{
+				chunk.errors++;
+				values[0] = values[1] = values[2] = 0.0f;
+			}
+			chunk.normals.insert(chunk.normals.end(), values, values + 3);
+		}
+		else if (vertexData && line[1] == 't')
+		{
+			// u, v and w are all optional after the first.
+			values[1] = 0.0f;
+			if (!parseObjFloats(line + 2, eol, values, 1, 2, count))
+			{
+				chunk.errors++;
+				values[0] = 0.0f;
+			}
+			chunk.texcoords.insert(chunk.texcoords.end(), values, values + 2);
+		}
+		else if (line[0] == 'f' && isBlank(line[1]))
+		{
+			polygon.clear();
+			const char* q = skipBlanks(line + 1, eol);
+			while (q < eol && *q != '#')
+			{
+				ObjCorner corner;
+				q = parseObjCorner(q, eol, chunk, corner);
+				if (!q)
+					break;
+				polygon.push_back(corner);
+				q = skipBlanks(q, eol);
+			}
+
+			if (!q || polygon.size() < 3)
+			{
+				chunk.errors++;
+				continue;
+			}
+
+			for (size_t i = 1; i + 1 < polygon.size(); i++)
+			{
+				chunk.corners.push_back(polygon[0]);
+				chunk.corners.push_back(polygon[i]);
+				chunk.corners.push_back(polygon[i + 1]);
+			}
+		}
+	}
+}
+
+static void objParseJob(void* data, uint32_t begin, uint32_t end)
+{
+	std::vector<ObjChunk>& chunks = *((ObjJob*)data)->chunks;
+	for (uint32_t i = begin; i < end; i++)
+		parseObjChunk(chunks[i]);
+}
+
+static inline uint32_t resolveObjIndex(const ObjCorner& corner, uint32_t slot, uint32_t base, uint32_t count, uint32_t& errors)
+{
+	const uint32_t flags = (corner.flags >> (slot * 2)) & 3;
+	if (!flags)
+		return InvalidIndex;
+
+	const int64_t index = flags == ObjIndexRelative ? (int64_t)base + corner.index[slot] : corner.index[slot];
+	if (index < 0 || index >= count)
+	{
+		errors++;
+		return InvalidIndex;
+	}
+	return (uint32_t)index;
+}
+
+// copy a chunk's vertices to their final place and rebase its corners.
+static void objMergeJob(void* data, uint32_t begin, uint32_t end)
+{
+	ObjJob& job = *(ObjJob*)data;
+	ImportSource& source = *job.source;
+	const uint32_t positionCount = (uint32_t)(source.positions.size() / 3);
+	const uint32_t normalCount = (uint32_t)(source.normals.size() / 3);
+	const uint32_t texcoordCount = (uint32_t)(source.texcoords.size() / 2);
+
+	for (uint32_t i = begin; i < end; i++)
+	{
+		ObjChunk& chunk = (*job.chunks)[i];
+		if (!chunk.positions.empty())
+			memcpy(&source.positions[chunk.positionBase * 3], &chunk.positions[0], chunk.positions.size() * sizeof(float));
+		if (!chunk.normals.empty())
+			memcpy(&source.normals[chunk.normalBase * 3], &chunk.normals[0], chunk.normals.size() * sizeof(float));
+		if (!chunk.texcoords.empty())
+			memcpy(&source.texcoords[chunk.texcoordBase * 2], &chunk.texcoords[0], chunk.texcoords.size() * sizeof(float));
+		if (job.hasColors && !chunk.colors.empty())
+			memcpy(&source.colors[chunk.positionBase * 3], &chunk.colors[0], chunk.colors.size() * sizeof(float));
+		else if (job.hasColors)
+			std::fill(source.colors.begin() + chunk.positionBase * 3, source.colors.begin() + chunk.positionBase * 3 + chunk.positions.size(), 1.0f);
+
+		ImportCorner* corners = &source.corners[chunk.cornerBase];
+		for (size_t c = 0; c < chunk.corners.size(); c++)
+		{
+			const ObjCorner& corner = chunk.corners[c];
+			corners[c].position = resolveObjIndex(corner, 0, chunk.positionBase, positionCount, chunk.errors);
+			corners[c].texcoord = resolveObjIndex(corner, 1, chunk.texcoordBase, texcoordCount, chunk.errors);
+			corners[c].normal = resolveObjIndex(corner, 2, chunk.normalBase, normalCount, chunk.errors);
+
+			// a corner without a position can't be drawn, point it at
+			// the first vertex so the triangle collapses.
+			if (corners[c].position == InvalidIndex)
+				corners[c].position = 0;
+		}
+
+		std::vector<float>().swap(chunk.positions);
+		std::vector<float>().swap(chunk.colors);
+		std::vector<float>().swap(chunk.normals);
+		std::vector<float>().swap(chunk.texcoords);
+		std::vector<ObjCorner>().swap(chunk.corners);
+	}
+}
+
+bool GFXMeshImporter::loadOBJ(const char* text, uint64_t size, GFXMeshData& out, CoreJobSystem* jobs) const
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	std::vector<const char*> bounds;
+	splitLines(text, text + size, bounds);
+	const uint32_t chunkCount = (uint32_t)bounds.size() - 1;
+
+	std::vector<ObjChunk> chunks(chunkCount);
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		chunks[i].begin = bounds[i];
+		chunks[i].end = bounds[i + 1];
+		chunks[i].errors = 0;
+	}
+
+	ImportSource source;
+	ObjJob job = { &chunks, &source, false };
+	runJobs(jobs, chunkCount, 1, objParseJob, &job);
+	std::chrono::high_resolution_clock::time_point parsed = std::chrono::high_resolution_clock::now();
+
+	// where each chunk's vertices and corners go.
+	uint32_t positionCount = 0;
+	uint32_t normalCount = 0;
+	uint32_t texcoordCount = 0;
+	uint32_t cornerCount = 0;
+	for (uint32_t i = 0; i < chunkCount; i++)
+	{
+		ObjChunk& chunk = chunks[i];
+		chunk.positionBase = positionCount;
+		chunk.normalBase = normalCount;
+		chunk.texcoordBase = texcoordCount;
+		chunk.cornerBase = cornerCount;
+		positionCount += (uint32_t)(chunk.positions.size() / 3);
+		normalCount += (uint32_t)(chunk.normals.size() / 3);
+		texcoordCount += (uint32_t)(chunk.texcoords.size() / 2);
+		cornerCount += (uint32_t)chunk.corners.size();
+		job.hasColors |= !chunk.colors.empty();
+	}
+
+	if (!positionCount || !cornerCount)
+	{
+		printf("Mesh importer: OBJ has no faces.\n");
+		return false;
+	}
+
+	source.positions.resize((size_t)positionCount * 3);
+	source.normals.resize((size_t)normalCount * 3);
+	source.texcoords.resize((size_t)texcoordCount * 2);
+	source.colors.resize(job.hasColors ? (size_t)positionCount * 3 : 0);
+	source.corners.resize(cornerCount);
+	runJobs(jobs, chunkCount, 1, objMergeJob, &job);
+
+	uint32_t errors = 0;
+	for (uint32_t i = 0; i < chunkCount; i++)
+		errors += chunks[i].errors;
+	if (errors)
+		printf("Mesh importer: %d bad lines or indices in OBJ, skipped.\n", errors);
+
+	double emitTime = 0.0;
+	double weldTime = 0.0;
+	if (!buildMesh(source, mAttributes, getVertexStride(), mOptimize, out, jobs, emitTime, weldTime))
+		return false;
+
+	printf("\tOBJ: %d chunks parsed in %.1f ms, soup in %.1f ms, welded in %.1f ms, optimized in %.1f ms.\n", chunkCount,
+		std::chrono::duration<double, std::milli>(parsed - start).count(), emitTime, weldTime,
+		std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - parsed).count() - emitTime - weldTime);
+	return true;
+}
+
+//-------------------------------------------------------------
+// PLY
+//-------------------------------------------------------------
+enum PlyType
+{
+	PlyInt8,
+	PlyUInt8,
+	PlyInt16,
+	PlyUInt16,
+	PlyInt32,
+	PlyUInt32,
+	PlyFloat32,
+	PlyFloat64,
+	PlyTypeCount,
+};
+
+static const uint32_t PlyTypeSizes[PlyTypeCount] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+// where a vertex property goes.
+enum PlySlot
+{
+	PlySlotNone = -1,
+	PlySlotPosition = 0,	///< 3 slots.
+	PlySlotNormal = 3,		///< 3 slots.
+	PlySlotTexCoord = 6,	///< 2 slots.
+	PlySlotColor = 8,		///< 3 slots.
+};
+
+struct PlyProperty
+{
+	std::string	name;
+	PlyType		type;
+	PlyType		countType;
+	bool		list;
+	int			slot;
+	float		scale;		///< integer colors to 0..1.
+	uint32_t	offset;		///< in a binary row without lists.
+};
+
+struct PlyElement
+{
+	std::string					name;
+	uint32_t					count;
+	std::vector<PlyProperty>	properties;
+	uint32_t					stride;		///< binary row size, 0 with lists.
+	uint32_t					firstLine;	///< ascii line of the first row.
+	int							indexProperty;
+};
+
+struct PlyHeader
+{
+	bool					ascii;
+	std::vector<PlyElement>	elements;
+	int						vertexElement;
+	int						faceElement;
+	bool					hasNormals;
+	bool					hasTexCoords;
+	bool					hasColors;
+};
+
+static bool parsePlyType(const char* name, PlyType& type)
+{
+	static const char* const names[] = { "char", "uchar", "short", "ushort", "int", "uint", "float", "double" };
+	static const char* const sizedNames[] = { "int8", "uint8", "int16", "uint16", "int32", "uint32", "float32", "float64" };
+	for (uint32_t i = 0; i < PlyTypeCount; i++)
+	{
+		if (!strcmp(name, names[i]) || !strcmp(name, sizedNames[i]))
+		{
+			type = (PlyType)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static int getPlySlot(const std::string& name)
+{
+	struct SlotName
+	{
+		const char*	name;
+		int			slot;
+	};
+
+	static const SlotName names[] =
+	{
+		{ "x", PlySlotPosition }, { "y", PlySlotPosition + 1 }, { "z", PlySlotPosition + 2 },
+		{ "nx", PlySlotNormal }, { "ny", PlySlotNormal + 1 }, { "nz", PlySlotNormal + 2 },
+		{ "u", PlySlotTexCoord }, { "v", PlySlotTexCoord + 1 },
+		{ "s", PlySlotTexCoord }, { "t", PlySlotTexCoord + 1 },
+		{ "texture_u", PlySlotTexCoord }, { "texture_v", PlySlotTexCoord + 1 },
+		{ "red", PlySlotColor }, { "green", PlySlotColor + 1 }, { "blue", PlySlotColor + 2 },
+		{ "diffuse_red", PlySlotColor }, { "diffuse_green", PlySlotColor + 1 }, { "diffuse_blue", PlySlotColor + 2 },
+	};
+
+	for (uint32_t i = 0; i < sizeof(names) / sizeof(names[0]); i++)
+	{
+		if (name == names[i].name)
+			return names[i].slot;
+	}
+	return PlySlotNone;
+}
+
+// reads the header, returns the offset of the body or 0.
+static uint64_t parsePlyHeader(const char* data, uint64_t size, PlyHeader& header)
+{
+	header.ascii = false;
+	header.vertexElement = -1;
+	header.faceElement = -1;
+	header.hasNormals = false;
+	header.hasTexCoords = false;
+	header.hasColors = false;
+
+	const char* end = data + size;
+	const char* p = data;
+	bool format = false;
+	uint32_t line = 0;
+	while (p < end)
+	{
+		const char* eol = findLineEnd(p, end);
+		char text[256];
+		const size_t length = eol - p < (ptrdiff_t)sizeof(text) ? eol - p : sizeof(text) - 1;
+		memcpy(text, p, length);
+		text[length] = 0;
+		p = eol < end ? eol + 1 : end;
+
+		char word[3][64];
+		const int words = sscanf(text, "%63s %63s %63s", word[0], word[1], word[2]);
+		if (line++ == 0)
+		{
+			if (words < 1 || strcmp(word[0], "ply"))
+				return 0;
+			continue;
+		}
+		if (words < 1 || !strcmp(word[0], "comment") || !strcmp(word[0], "obj_info"))
+			continue;
+
+		if (!strcmp(word[0], "end_header"))
+		{
+			if (!format || header.vertexElement < 0 || header.faceElement < 0)
+				return 0;
+			return p - data;
+		}
+
+		if (!strcmp(word[0], "format") && words >= 2)
+		{
+			header.ascii = !strcmp(word[1], "ascii");
+			if (!header.ascii && strcmp(word[1], "binary_little_endian"))
+			{
+				printf("Mesh importer: PLY format %s isn't supported.\n", word[1]);
+				return 0;
+			}
+			format = true;
+		}
+		else if (!strcmp(word[0], "element") && words >= 3)
+		{
+			PlyElement element;
+			element.name = word[1];
+			element.count = (uint32_t)strtoul(word[2], NULL, 10);
+			element.stride = 0;
+			element.firstLine = 0;
+			element.indexProperty = -1;
+			if (element.name == "vertex")
+				header.vertexElement = (int)header.elements.size();
+			else if (element.name == "face")
+				header.faceElement = (int)header.elements.size();
+			header.elements.push_back(element);
+		}
+		else if (!strcmp(word[0], "property") && words >= 3 && !header.elements.empty())
+		{
+			PlyElement& element = header.elements.back();
+			PlyProperty property;
+			property.list = !strcmp(word[1], "list");
+			property.countType = PlyUInt8;
+			property.slot = PlySlotNone;
+			property.scale = 1.0f;
+			property.offset = 0;
+
+			char name[64];
+			if (property.list)
+			{
+				char valueType[64];
+				if (sscanf(text, "%*s %*s %63s %63s %63s", word[2], valueType, name) != 3 ||
+					!parsePlyType(word[2], property.countType) || !parsePlyType(valueType, property.type))
+					return 0;
+			}
+			else
+			{
+				if (!parsePlyType(word[1], property.type))
+					return 0;
+				strcpy(name, word[2]);
+			}
+			property.name = name;
+
+			if ((int)header.elements.size() - 1 == header.vertexElement && !property.list)
+			{
+				property.slot = getPlySlot(property.name);
+				if (property.slot >= PlySlotColor && property.type == PlyUInt8)
+					property.scale = 1.0f / 255.0f;
+				else if (property.slot >= PlySlotColor && property.type == PlyUInt16)
+					property.scale = 1.0f / 65535.0f;
+				header.hasNormals |= property.slot >= PlySlotNormal && property.slot < PlySlotTexCoord;
+				header.hasTexCoords |= property.slot >= PlySlotTexCoord && property.slot < PlySlotColor;
+				header.hasColors |= property.slot >= PlySlotColor;
+			}
+			if (property.list && (property.name == "vertex_indices" || property.name == "vertex_index"))
+				element.indexProperty = (int)element.properties.size();
+
+			element.properties.push_back(property);
+		}
+	}
+
+	return 0;
+}
+
+static inline double readPlyValue(const uint8_t* p, PlyType type)
+{
+	switch (type)
+	{
+	case PlyInt8:		return (int8_t)*p;
+	case PlyUInt8:		return *p;
+	case PlyInt16:		{ int16_t v; memcpy(&v, p, 2); return v; }
+	case PlyUInt16:		{ uint16_t v; memcpy(&v, p, 2); return v; }
+	case PlyInt32:		{ int32_t v; memcpy(&v, p, 4); return v; }
+	case PlyUInt32:		{ uint32_t v; memcpy(&v, p, 4); return v; }
+	case PlyFloat32:	{ float v; memcpy(&v, p, 4); return v; }
+	default:			{ double v; memcpy(&v, p, 8); return v; }
+	}
+}
+
+static inline void storePlyValue(ImportSource& source, uint32_t vertex, const PlyProperty& property, float value)
+{
+	value *= property.scale;
+	if (property.slot < PlySlotNormal)
+		source.positions[vertex * 3 + property.slot - PlySlotPosition] = value;
+	else if (property.slot < PlySlotTexCoord)
+		source.normals[vertex * 3 + property.slot - PlySlotNormal] = value;
+	else if (property.slot < PlySlotColor)
+		source.texcoords[vertex * 2 + property.slot - PlySlotTexCoord] = value;
+	else
+		source.colors[vertex * 3 + property.slot - PlySlotColor] = value;
+}
+
+static void addPlyPolygon(const uint32_t* indices, uint32_t count, uint32_t vertexCount, const PlyHeader& header,
+	std::vector<ImportCorner>& corners, uint32_t& errors)
+{
+	if (count < 3)
+	{
+		errors++;
+		return;
+	}
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (indices[i] >= vertexCount)
+		{
+			errors++;
+			return;
+		}
+	}
+
+	for (uint32_t i = 1; i + 1 < count; i++)
+	{
+		const uint32_t triangle[3] = { indices[0], indices[i], indices[i + 1] };
+		for (uint32_t k = 0; k < 3; k++)
+		{
+			ImportCorner corner;
+			corner.position = triangle[k];
+			corner.texcoord = header.hasTexCoords ? triangle[k] : InvalidIndex;
+			corner.normal = header.hasNormals ? triangle[k] : InvalidIndex;
+			corners.push_back(corner);
+		}
+	}
+}
+
+struct PlyChunk
+{
+	const char*			begin;
+	const char*			end;
+	uint32_t			firstLine;
+	uint32_t			lineCount;
+	std::vector<ImportCorner>	corners;
+	uint32_t			errors;
+};
+
+struct PlyJob
+{
+	const PlyHeader*		header;
+	std::vector<PlyChunk>*	chunks;
+	ImportSource*				source;
+	const uint8_t*			vertices;	///< binary vertex rows.
+};
+
+static void plyCountJob(void* data, uint32_t begin, uint32_t end)
+{
+	std::vector<PlyChunk>& chunks = *((PlyJob*)data)->chunks;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		PlyChunk& chunk = chunks[i];
+		chunk.lineCount = 0;
+		for (const char* p = chunk.begin; p < chunk.end; p = findLineEnd(p, chunk.end) + 1)
+			chunk.lineCount++;
+	}
+}
+
+static void parsePlyChunk(const PlyHeader& header, ImportSource& source, PlyChunk& chunk)
+{
+	const PlyElement& vertices = header.elements[header.vertexElement];
+	const PlyElement& faces = header.elements[header.faceElement];
+	std::vector<uint32_t> polygon;
+
+	uint32_t line = chunk.firstLine;
+	for (const char* p = chunk.begin; p < chunk.end; line++)
+	{
+		const char* eol = findLineEnd(p, chunk.end);
+		const char* q = p;
+		p = eol + 1;
+
+		const bool isVertex = line >= vertices.firstLine && line < vertices.firstLine + vertices.count;
+		const bool isFace = line >= faces.firstLine && line < faces.firstLine + faces.count;
+		if (!isVertex && !isFace)
+			continue;
+
+		const PlyElement& element = isVertex ? vertices : faces;
+		for (size_t i = 0; i < element.properties.size() && q; i++)
+		{
+			const PlyProperty& property = element.properties[i];
+			q = skipBlanks(q, eol);
+			if (!property.list)
+			{
+				float value = 0.0f;
+				q = parseFloat(q, eol, value);
+				if (q && isVertex && property.slot != PlySlotNone)
+					storePlyValue(source, line - vertices.firstLine, property, value);
+				continue;
+			}
+
+			int64_t count = 0;
+			q = parseInt(q, eol, count);
+			if (!q || count < 0)
+			{
+				q = NULL;
+				break;
+			}
+
+			const bool keep = isFace && (int)i == faces.indexProperty;
+			polygon.clear();
+			for (int64_t v = 0; v < count && q; v++)
+			{
+				int64_t index = 0;
+				q = parseInt(skipBlanks(q, eol), eol, index);
+				if (keep)
+					polygon.push_back(index >= 0 && index < 0xFFFFFFFF ? (uint32_t)index : InvalidIndex);
+			}
+			if (q && keep)
+				addPlyPolygon(polygon.empty() ? NULL : &polygon[0], (uint32_t)polygon.size(), vertices.count, header, chunk.corners, chunk.errors);
+		}
+
+		if (!q)
+			chunk.errors++;
+	}
+}
+
+static void plyParseJob(void* data, uint32_t begin, uint32_t end)
+{
+	PlyJob& job = *(PlyJob*)data;
+	for (uint32_t i = begin; i < end; i++)
+		parsePlyChunk(*job.header, *job.source, (*job.chunks)[i]);
+}
+
+// binary vertex rows have a fixed size, any range of them can be read.
+static void plyVertexJob(void* data, uint32_t begin, uint32_t end)
+{
+	PlyJob& job = *(PlyJob*)data;
+	const PlyElement& element = job.header->elements[job.header->vertexElement];
+	for (uint32_t v = begin; v < end; v++)
+	{
+		const uint8_t* row = job.vertices + (size_t)v * element.stride;
+		for (size_t i = 0; i < element.properties.size(); i++)
+		{
+			const PlyProperty& property = element.properties[i];
+			if (property.slot != PlySlotNone)
+				storePlyValue(*job.source, v, property, (float)readPlyValue(row + property.offset, property.type));
+		}
+	}
+}
+
+// walks binary rows of an element with lists, returns the end or NULL.
+static const uint8_t* readPlyBinaryElement(const uint8_t* p, const uint8_t* end, const PlyHeader& header, const PlyElement& element,
+	ImportSource& source, std::vector<ImportCorner>& corners, uint32_t& errors)
+{
+	const bool isVertex = &element == &header.elements[header.vertexElement];
+	const bool isFace = &element == &header.elements[header.faceElement];
+	const uint32_t vertexCount = header.elements[header.vertexElement].count;
+	std::vector<uint32_t> polygon;
+
+	for (uint32_t row = 0; row < element.count; row++)
+	{
+		for (size_t i = 0; i < element.properties.size(); i++)
+		{
+			const PlyProperty& property = element.properties[i];
+			if (!property.list)
+			{
+				if ((uint64_t)(end - p) < PlyTypeSizes[property.type])
+					return NULL;
+				if (isVertex && property.slot != PlySlotNone)
+					storePlyValue(source, row, property, (float)readPlyValue(p, property.type));
+				p += PlyTypeSizes[property.type];
+				continue;
+			}
+
+			if ((uint64_t)(end - p) < PlyTypeSizes[property.countType])
+				return NULL;
+			const double count = readPlyValue(p, property.countType);
+			p += PlyTypeSizes[property.countType];
+
+			const uint32_t valueSize = PlyTypeSizes[property.type];
+			if (count < 0.0 || (uint64_t)(end - p) < (uint64_t)count * valueSize)
+				return NULL;
+
+			if (isFace && (int)i == element.indexProperty)
+			{
+				polygon.resize((size_t)count);
+				for (size_t v = 0; v < polygon.size(); v++)
+				{
+					const double index = readPlyValue(p + v * valueSize, property.type);
+					polygon[v] = index >= 0.0 && index < 4294967295.0 ? (uint32_t)index : InvalidIndex;
+				}
+				addPlyPolygon(polygon.empty() ? NULL : &polygon[0], (uint32_t)polygon.size(), vertexCount, header, corners, errors);
+			}
+			p += (size_t)count * valueSize;
+		}
+	}
+	return p;
+}
+
+bool GFXMeshImporter::loadPLY(const char* data, uint64_t size, GFXMeshData& out, CoreJobSystem* jobs) const
+{
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+	PlyHeader header;
+	const uint64_t bodyOffset = parsePlyHeader(data, size, header);
+	if (!bodyOffset)
+	{
+		printf("Mesh importer: bad PLY header.\n");
+		return false;
+	}
+
+	PlyElement& vertices = header.elements[header.vertexElement];
+	ImportSource source;
+	source.positions.resize((size_t)vertices.count * 3, 0.0f);
+	source.normals.resize(header.hasNormals ? (size_t)vertices.count * 3 : 0, 0.0f);
+	source.texcoords.resize(header.hasTexCoords ? (size_t)vertices.count * 2 : 0, 0.0f);
+	source.colors.resize(header.hasColors ? (size_t)vertices.count * 3 : 0, 1.0f);
+
+	uint32_t errors = 0;
+	uint32_t chunkCount = 1;
+	if (header.ascii)
+	{
+		uint32_t line = 0;
+		for (size_t i = 0; i < header.elements.size(); i++)
+		{
+			header.elements[i].firstLine = line;
+			line += header.elements[i].count;
+		}
+
+		std::vector<const char*> bounds;
+		splitLines(data + bodyOffset, data + size, bounds);
+		chunkCount = (uint32_t)bounds.size() - 1;
+
+		std::vector<PlyChunk> chunks(chunkCount);
+		for (uint32_t i = 0; i < chunkCount; i++)
+		{
+			chunks[i].begin = bounds[i];
+			chunks[i].end = bounds[i + 1];
+			chunks[i].errors = 0;
+		}
+
+		// rows are lines, a chunk needs to know its first line number
+		// before it can tell what its rows are.
+		PlyJob job = { &header, &chunks, &source, NULL };
+		runJobs(jobs, chunkCount, 1, plyCountJob, &job);
+		uint32_t firstLine = 0;
+		for (uint32_t i = 0; i < chunkCount; i++)
+		{
+			chunks[i].firstLine = firstLine;
+			firstLine += chunks[i].lineCount;
+		}
+		runJobs(jobs, chunkCount, 1, plyParseJob, &job);
+
+		size_t cornerCount = 0;
+		for (uint32_t i = 0; i < chunkCount; i++)
+			cornerCount += chunks[i].corners.size();
+		source.corners.reserve(cornerCount);
+		for (uint32_t i = 0; i < chunkCount; i++)
+		{
+			source.corners.insert(source.corners.end(), chunks[i].corners.begin(), chunks[i].corners.end());
+			errors += chunks[i].errors;
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < header.elements.size(); i++)
+		{
+			PlyElement& element = header.elements[i];
+			for (size_t j = 0; j < element.properties.size(); j++)
+			{
+				if (element.properties[j].list)
+				{
+					element.stride = 0;
+					break;
+				}
+				element.properties[j].offset = element.stride;
+				element.stride += PlyTypeSizes[element.properties[j].type];
+			}
+		}
+
+		// fixed size rows are skipped over or, for vertices, read on
+		// every core. Rows with lists have to be walked.
+		const uint8_t* p = (const uint8_t*)data + bodyOffset;
+		const uint8_t* end = (const uint8_t*)data + size;
+		for (size_t i = 0; i < header.elements.size() && p; i++)
+		{
+			const PlyElement& element = header.elements[i];
+			if (element.stride && (uint64_t)(end - p) < (uint64_t)element.count * element.stride)
+				p = NULL;
+			else if (element.stride && (int)i == header.vertexElement)
+			{
+				PlyJob job = { &header, NULL, &source, p };
+				runJobs(jobs, element.count, EmitGrain, plyVertexJob, &job);
+				p += (size_t)element.count * element.stride;
+			}
+			else if (element.stride)
+				p += (size_t)element.count * element.stride;
+			else
+				p = readPlyBinaryElement(p, end, header, element, source, source.corners, errors);
+		}
+
+		if (!p)
+		{
+			printf("Mesh importer: PLY is cut short.\n");
+			return false;
+		}
+	}
+
+	if (errors)
+		printf("Mesh importer: %d bad rows or indices in PLY, skipped.\n", errors);
+	std::chrono::high_resolution_clock::time_point parsed = std::chrono::high_resolution_clock::now();
+
+	double emitTime = 0.0;
+	double weldTime = 0.0;
+	if (!buildMesh(source, mAttributes, getVertexStride(), mOptimize, out, jobs, emitTime, weldTime))
+		return false;
+
+	printf("\tPLY: %d chunks parsed in %.1f ms, soup in %.1f ms, welded in %.1f ms, optimized in %.1f ms.\n", chunkCount,
+		std::chrono::duration<double, std::milli>(parsed - start).count(), emitTime, weldTime,
+		std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - parsed).count() - emitTime - weldTime);
+	return true;
+}
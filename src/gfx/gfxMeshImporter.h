@@ -0,0 +1,65 @@
+#ifndef GFXMESHIMPORTER_H_
+#define GFXMESHIMPORTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "gfx/gfxMeshBuilder.h"
+
+class CoreJobSystem;
+
+//-------------------------------------------------------------
+// Mesh importer
+//-------------------------------------------------------------
+// Wavefront OBJ and PLY (ascii and binary little endian) to GFXMeshData.
+// The file is mapped and cut into ChunkSize pieces at line boundaries,
+// each parsed by its own job. Numbers go through std::from_chars when
+// the standard library parses floats with it and a local parser
+// otherwise, neither touches the locale. Chunks are stitched together
+// with prefix sums over their counts, then the triangle soup is written
+// and welded in parallel by GFXMeshBuilder. The vertex cache and fetch
+// passes are serial and take most of the time on a big mesh, a caller
+// that reorders the mesh later anyway can turn them off with
+// setOptimize(false).
+//
+// A vertex is the position followed by the attributes asked for with
+// setAttributes(), in the order normal, texcoord, color. Attributes the
+// file doesn't have are filled in: face normals, zero texcoords and
+// white. Polygons are triangulated as fans.
+class GFXMeshImporter
+{
+public:
+	enum Attribute
+	{
+		AttribNormal = 1 << 0,		///< 3 floats.
+		AttribTexCoord = 1 << 1,	///< 2 floats.
+		AttribColor = 1 << 2,		///< 3 floats, 0..1.
+	};
+
+	enum
+	{
+		ChunkSize = 4 << 20,		///< bytes of text a parse job gets.
+		EmitGrain = 16384,			///< triangles an emit job writes.
+	};
+
+	GFXMeshImporter();
+
+	void		setAttributes(uint32_t attributes) { mAttributes = attributes; }
+	uint32_t	getAttributes() const { return mAttributes; }
+	uint32_t	getVertexStride() const;
+
+	void		setOptimize(bool optimize) { mOptimize = optimize; }
+	bool		getOptimize() const { return mOptimize; }
+
+	// picks the parser from the file extension.
+	bool load(const char* path, GFXMeshData& out, CoreJobSystem* jobs = NULL) const;
+
+	bool loadOBJ(const char* text, uint64_t size, GFXMeshData& out, CoreJobSystem* jobs = NULL) const;
+	bool loadPLY(const char* data, uint64_t size, GFXMeshData& out, CoreJobSystem* jobs = NULL) const;
+
+private:
+	uint32_t	mAttributes;
+	bool		mOptimize;
+};
+
+#endif
@@ -0,0 +1,574 @@
+#include "gfx/gfxMeshSimplifier.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+static const uint32_t MaxDimensions = 3 + GFXMeshSimplifier::MaxAttributes;
+static const uint32_t InvalidVertex = 0xFFFFFFFF;
+
+// open borders are held in place by planes through them, weighted well
+// above the triangles so a border doesn't shrink into the mesh.
+static const float BorderWeight = 10.0f;
+
+enum VertexKind
+{
+	VertexManifold,		///< collapses into any neighbour.
+	VertexBorder,		///< collapses along its border only.
+	VertexLocked,		///< seams, corners and non-manifold vertices never move.
+};
+
+namespace
+{
+	struct Collapse
+	{
+		uint32_t	from;
+		uint32_t	to;
+		float		cost;
+
+		bool operator<(const Collapse& rhs) const { return cost < rhs.cost; }
+	};
+
+	// orders vertex indices by position, to find vertices sharing one.
+	struct PositionLess
+	{
+		const float*	vertices;
+		uint32_t		stride;
+
+		bool operator()(uint32_t a, uint32_t b) const
+		{
+			const float* pa = vertices + (size_t)a * stride;
+			const float* pb = vertices + (size_t)b * stride;
+			if (pa[0] != pb[0])
+				return pa[0] < pb[0];
+			if (pa[1] != pb[1])
+				return pa[1] < pb[1];
+			return pa[2] < pb[2];
+		}
+	};
+}
+
+//-------------------------------------------------------------
+// Quadrics
+//-------------------------------------------------------------
+// A quadric over n dimensions is v'Av + 2b'v + c, A symmetric and
+// stored as its upper triangle, followed by b, c and the total weight
+// of what was added so costs can be made an average distance.
+static uint32_t getQuadricSize(uint32_t n)
+{
+	return n * (n + 1) / 2 + n + 2;
+}
+
+// squared distance to the plane of the triangle, Garland and Heckbert's
+// generalized form for points with attributes.
+static void addTriangleQuadric(float* q, uint32_t n, const float* p0, const float* p1, const float* p2, float weight)
+{
+	float e1[MaxDimensions];
+	float e2[MaxDimensions];
+
+	// e1 along p0p1, e2 the part of p0p2 orthogonal to it.
+	float length1 = 0.0f;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		e1[i] = p1[i] - p0[i];
+		length1 += e1[i] * e1[i];
+	}
+	if (length1 <= 0.0f)
+		return;
+
+	length1 = 1.0f / sqrtf(length1);
+	float along = 0.0f;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		e1[i] *= length1;
+		e2[i] = p2[i] - p0[i];
+		along += e2[i] * e1[i];
+	}
+
+	float length2 = 0.0f;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		e2[i] -= along * e1[i];
+		length2 += e2[i] * e2[i];
+	}
+	if (length2 <= 0.0f)
+		return;
+
+	length2 = 1.0f / sqrtf(length2);
+	float p0e1 = 0.0f, p0e2 = 0.0f, p0p0 = 0.0f;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		e2[i] *= length2;
+		p0e1 += p0[i] * e1[i];
+		p0e2 += p0[i] * e2[i];
+		p0p0 += p0[i] * p0[i];
+	}
+
+	// A = I - e1e1' - e2e2', b = (p0.e1)e1 + (p0.e2)e2 - p0
+	float* a = q;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		for (uint32_t j = i; j < n; j++)
+			*a++ += weight * ((i == j ? 1.0f : 0.0f) - e1[i] * e1[j] - e2[i] * e2[j]);
+	}
+
+	float* b = a;
+	for (uint32_t i = 0; i < n; i++)
+		b[i] += weight * (p0e1 * e1[i] + p0e2 * e2[i] - p0[i]);
+
+	b[n] += weight * (p0p0 - p0e1 * p0e1 - p0e2 * p0e2);
+	b[n + 1] += weight;
+}
+
+// squared distance to the plane normal.x + d = 0, position only.
+static void addPlaneQuadric(float* q, uint32_t n, const Vector3& normal, float d, float weight)
+{
+	const float normalValues[3] = { normal.x, normal.y, normal.z };
+	float* a = q;
+	for (uint32_t i = 0; i < n; i++)
+	{
+		for (uint32_t j = i; j < n; j++, a++)
+		{
+			if (j < 3)
+				*a += weight * normalValues[i] * normalValues[j];
+		}
+	}
+
+	float* b = a;
+	for (uint32_t i = 0; i < 3; i++)
+		b[i] += weight * d * normalValues[i];
+
+	b[n] += weight * d * d;
+	b[n + 1] += weight;
+}
+
+// average squared distance of v to what the quadric was built from.
+static float evaluateQuadric(const float* q, uint32_t n, const float* v)
+{
+	const float* a = q;
+	const float* b = q + n * (n + 1) / 2;
+
+	float result = b[n];
+	for (uint32_t i = 0; i < n; i++)
+	{
+		float row = *a++ * v[i];
+		for (uint32_t j = i + 1; j < n; j++)
+			row += 2.0f * *a++ * v[j];
+		result += v[i] * row + 2.0f * b[i] * v[i];
+	}
+
+	// rounding can take a perfect fit slightly below zero.
+	const float weight = b[n + 1];
+	return result > 0.0f && weight > 0.0f ? result / weight : 0.0f;
+}
+
+//-------------------------------------------------------------
+// Simplifier
+//-------------------------------------------------------------
+GFXMeshSimplifier::GFXMeshSimplifier()
+{
+	mAttributeCount = 0;
+	memset(mAttributeWeights, 0, sizeof(mAttributeWeights));
+}
+
+void GFXMeshSimplifier::setAttributeWeights(const float* weights, uint32_t count)
+{
+	mAttributeCount = std::min(count, (uint32_t)MaxAttributes);
+	memset(mAttributeWeights, 0, sizeof(mAttributeWeights));
+	memcpy(mAttributeWeights, weights, mAttributeCount * sizeof(float));
+}
+
+static inline Vector3 getPosition(const float* points, uint32_t n, uint32_t vertex)
+{
+	const float* p = points + (size_t)vertex * n;
+	return Vector3(p[0], p[1], p[2]);
+}
+
+static inline uint64_t getEdgeKey(uint32_t a, uint32_t b)
+{
+	return a < b ? ((uint64_t)a << 32) | b : ((uint64_t)b << 32) | a;
+}
+
+// remember v as a border neighbour of u. A vertex with more than two
+// border edges joins several borders and stays put.
+static void addBorderLink(std::vector<uint8_t>& kinds, std::vector<uint32_t>& links, uint32_t u, uint32_t v)
+{
+	if (kinds[u] == VertexLocked)
+		return;
+
+	kinds[u] = VertexBorder;
+	if (links[u * 2] == InvalidVertex)
+		links[u * 2] = v;
+	else if (links[u * 2 + 1] == InvalidVertex)
+		links[u * 2 + 1] = v;
+	else
+		kinds[u] = VertexLocked;
+}
+
+float GFXMeshSimplifier::simplify(const GFXMeshData& mesh, const uint32_t* indices, uint32_t indexCount, uint32_t targetIndexCount,
+	float maxError, std::vector<uint32_t>& out) const
+{
+	out.assign(indices, indices + indexCount - indexCount % 3);
+
+	const uint32_t vertexCount = mesh.getVertexCount();
+	const uint32_t stride = mesh.vertexStride;
+	if (out.size() <= targetIndexCount || stride < 3)
+		return 0.0f;
+
+	// positions are scaled into the unit cube so float quadrics keep
+	// their precision whatever the mesh's size.
+	std::vector<uint8_t> used(vertexCount, 0);
+	Vector3 minPosition(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3 maxPosition(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (size_t i = 0; i < out.size(); i++)
+	{
+		const float* p = mesh.getVertex(out[i]);
+		used[out[i]] = 1;
+		minPosition.set(std::min(minPosition.x, p[0]), std::min(minPosition.y, p[1]), std::min(minPosition.z, p[2]));
+		maxPosition.set(std::max(maxPosition.x, p[0]), std::max(maxPosition.y, p[1]), std::max(maxPosition.z, p[2]));
+	}
+
+	const Vector3 size = maxPosition - minPosition;
+	const float extent = std::max(size.x, std::max(size.y, size.z));
+	if (extent <= 0.0f)
+		return 0.0f;
+
+	const float scale = 1.0f / extent;
+	const uint32_t attributeCount = std::min(mAttributeCount, stride - 3);
+	const uint32_t n = 3 + attributeCount;
+
+	std::vector<float> points((size_t)vertexCount * n);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		const float* src = mesh.getVertex(v);
+		float* dst = &points[(size_t)v * n];
+		dst[0] = (src[0] - minPosition.x) * scale;
+		dst[1] = (src[1] - minPosition.y) * scale;
+		dst[2] = (src[2] - minPosition.z) * scale;
+		for (uint32_t a = 0; a < attributeCount; a++)
+			dst[3 + a] = src[3 + a] * mAttributeWeights[a];
+	}
+
+	std::vector<uint8_t> kinds(vertexCount, VertexManifold);
+	std::vector<uint32_t> borderLinks((size_t)vertexCount * 2, InvalidVertex);
+
+	// vertices sharing a position differ in some attribute, moving one
+	// of them would tear the seam open.
+	{
+		std::vector<uint32_t> order;
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			if (used[v])
+				order.push_back(v);
+		}
+
+		PositionLess less = { &mesh.vertices[0], stride };
+		std::sort(order.begin(), order.end(), less);
+		for (size_t i = 1; i < order.size(); i++)
+		{
+			if (!less(order[i - 1], order[i]))
+			{
+				kinds[order[i - 1]] = VertexLocked;
+				kinds[order[i]] = VertexLocked;
+			}
+		}
+	}
+
+	// edges used by one triangle are borders, by more than two non-manifold.
+	std::vector<uint64_t> borderEdges;
+	{
+		std::vector<uint64_t> edges(out.size());
+		for (size_t t = 0; t < out.size(); t += 3)
+		{
+			edges[t] = getEdgeKey(out[t], out[t + 1]);
+			edges[t + 1] = getEdgeKey(out[t + 1], out[t + 2]);
+			edges[t + 2] = getEdgeKey(out[t + 2], out[t]);
+		}
+		std::sort(edges.begin(), edges.end());
+
+		for (size_t i = 0; i < edges.size();)
+		{
+			size_t end = i + 1;
+			while (end < edges.size() && edges[end] == edges[i])
+				end++;
+
+			const uint32_t a = (uint32_t)(edges[i] >> 32);
+			const uint32_t b = (uint32_t)edges[i];
+			if (end - i == 1)
+			{
+				borderEdges.push_back(edges[i]);
+				addBorderLink(kinds, borderLinks, a, b);
+				addBorderLink(kinds, borderLinks, b, a);
+			}
+			else if (end - i > 2)
+			{
+				kinds[a] = VertexLocked;
+				kinds[b] = VertexLocked;
+			}
+			i = end;
+		}
+
+		// a border has to continue on both sides.
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			if (kinds[v] == VertexBorder && borderLinks[v * 2 + 1] == InvalidVertex)
+				kinds[v] = VertexLocked;
+		}
+	}
+
+	// every vertex starts with the quadrics of its triangles, weighted by
+	// area, and of the border planes through its border edges.
+	const uint32_t quadricSize = getQuadricSize(n);
+	std::vector<float> quadrics((size_t)vertexCount * quadricSize, 0.0f);
+	std::vector<float> triangleQuadric(quadricSize);
+	for (size_t t = 0; t < out.size(); t += 3)
+	{
+		const uint32_t* tri = &out[t];
+		const Vector3 p0 = getPosition(&points[0], n, tri[0]);
+		const Vector3 p1 = getPosition(&points[0], n, tri[1]);
+		const Vector3 p2 = getPosition(&points[0], n, tri[2]);
+		const Vector3 normal = (p1 - p0).cross(p2 - p0);
+		const float area = normal.length() * 0.5f;
+
+		std::fill(triangleQuadric.begin(), triangleQuadric.end(), 0.0f);
+		addTriangleQuadric(&triangleQuadric[0], n, &points[(size_t)tri[0] * n], &points[(size_t)tri[1] * n], &points[(size_t)tri[2] * n], area);
+		for (int k = 0; k < 3; k++)
+		{
+			float* q = &quadrics[(size_t)tri[k] * quadricSize];
+			for (uint32_t i = 0; i < quadricSize; i++)
+				q[i] += triangleQuadric[i];
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32_t a = tri[k];
+			const uint32_t b = tri[(k + 1) % 3];
+			if (!std::binary_search(borderEdges.begin(), borderEdges.end(), getEdgeKey(a, b)))
+				continue;
+
+			// plane through the edge, at right angles to the triangle.
+			const Vector3 pa = getPosition(&points[0], n, a);
+			const Vector3 edge = getPosition(&points[0], n, b) - pa;
+			Vector3 planeNormal = edge.cross(normal);
+			const float length = planeNormal.length();
+			if (length <= 0.0f)
+				continue;
+
+			planeNormal /= length;
+			const float weight = edge.dot(edge) * BorderWeight;
+			addPlaneQuadric(&quadrics[(size_t)a * quadricSize], n, planeNormal, -planeNormal.dot(pa), weight);
+			addPlaneQuadric(&quadrics[(size_t)b * quadricSize], n, planeNormal, -planeNormal.dot(pa), weight);
+		}
+	}
+
+	const float scaledError = maxError * scale;
+	const float maxCost = scaledError < sqrtf(FLT_MAX) ? scaledError * scaledError : FLT_MAX;
+	const uint32_t targetTriangles = targetIndexCount / 3;
+	uint32_t triangleCount = (uint32_t)out.size() / 3;
+	float reachedCost = 0.0f;
+
+	std::vector<uint32_t> remap(vertexCount);
+	for (uint32_t v = 0; v < vertexCount; v++)
+		remap[v] = v;
+
+	std::vector<uint32_t> triangleStart(vertexCount + 1);
+	std::vector<uint32_t> triangleList;
+	std::vector<Collapse> collapses;
+	std::vector<uint8_t> touched(vertexCount);
+
+	while (triangleCount > targetTriangles)
+	{
+		// vertex to triangle adjacency of this pass.
+		std::fill(triangleStart.begin(), triangleStart.end(), 0);
+		for (size_t i = 0; i < out.size(); i++)
+			triangleStart[out[i] + 1]++;
+		for (uint32_t v = 0; v < vertexCount; v++)
+			triangleStart[v + 1] += triangleStart[v];
+
+		triangleList.resize(out.size());
+		{
+			std::vector<uint32_t> fill(triangleStart.begin(), triangleStart.end() - 1);
+			for (size_t i = 0; i < out.size(); i++)
+				triangleList[fill[out[i]]++] = (uint32_t)(i / 3);
+		}
+
+		// the cheaper direction of every edge that may collapse.
+		collapses.clear();
+		for (size_t t = 0; t < out.size(); t += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				const uint32_t a = out[t + k];
+				const uint32_t b = out[t + (k + 1) % 3];
+
+				Collapse collapse = { InvalidVertex, InvalidVertex, FLT_MAX };
+				for (int direction = 0; direction < 2; direction++)
+				{
+					const uint32_t from = direction ? b : a;
+					const uint32_t to = direction ? a : b;
+					if (kinds[from] == VertexLocked)
+						continue;
+
+					// a border vertex slides along its border, never inwards.
+					if (kinds[from] == VertexBorder &&
+						((borderLinks[from * 2] != to && borderLinks[from * 2 + 1] != to) || borderLinks[from * 2] == borderLinks[from * 2 + 1]))
+						continue;
+
+					const float cost = evaluateQuadric(&quadrics[(size_t)from * quadricSize], n, &points[(size_t)to * n]);
+					if (cost < collapse.cost)
+					{
+						collapse.from = from;
+						collapse.to = to;
+						collapse.cost = cost;
+					}
+				}
+
+				if (collapse.from != InvalidVertex)
+					collapses.push_back(collapse);
+			}
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		std::fill(touched.begin(), touched.end(), 0);
+		uint32_t performed = 0;
+		for (size_t c = 0; c < collapses.size() && triangleCount > targetTriangles; c++)
+		{
+			const Collapse& collapse = collapses[c];
+			if (collapse.cost > maxCost)
+				break;
+
+			// nothing around an earlier collapse of this pass moves, so
+			// the triangles below are still what they were.
+			const uint32_t from = collapse.from;
+			const uint32_t to = collapse.to;
+			if (touched[from] || touched[to])
+				continue;
+
+			const Vector3 fromPosition = getPosition(&points[0], n, from);
+			const Vector3 toPosition = getPosition(&points[0], n, to);
+			bool flips = false;
+			for (uint32_t i = triangleStart[from]; i < triangleStart[from + 1] && !flips; i++)
+			{
+				const uint32_t* tri = &out[triangleList[i] * 3];
+				if (tri[0] == to || tri[1] == to || tri[2] == to)
+					continue;
+
+				// rotate so from comes first.
+				const int k = tri[0] == from ? 0 : (tri[1] == from ? 1 : 2);
+				const Vector3 p1 = getPosition(&points[0], n, tri[(k + 1) % 3]);
+				const Vector3 p2 = getPosition(&points[0], n, tri[(k + 2) % 3]);
+				const Vector3 before = (p1 - fromPosition).cross(p2 - fromPosition);
+				const Vector3 after = (p1 - toPosition).cross(p2 - toPosition);
+				flips = before.dot(after) <= 0.0f;
+			}
+			if (flips)
+				continue;
+
+			for (uint32_t i = triangleStart[from]; i < triangleStart[from + 1]; i++)
+			{
+				const uint32_t* tri = &out[triangleList[i] * 3];
+				if (tri[0] == to || tri[1] == to || tri[2] == to)
+					triangleCount--;
+				touched[tri[0]] = 1;
+				touched[tri[1]] = 1;
+				touched[tri[2]] = 1;
+			}
+
+			float* fromQuadric = &quadrics[(size_t)from * quadricSize];
+			float* toQuadric = &quadrics[(size_t)to * quadricSize];
+			for (uint32_t i = 0; i < quadricSize; i++)
+				toQuadric[i] += fromQuadric[i];
+
+			// the border now runs from the other neighbour straight to to.
+			if (kinds[from] == VertexBorder)
+			{
+				const uint32_t other = borderLinks[from * 2] == to ? borderLinks[from * 2 + 1] : borderLinks[from * 2];
+				if (kinds[to] == VertexBorder)
+					borderLinks[to * 2 + (borderLinks[to * 2] == from ? 0 : 1)] = other;
+				if (kinds[other] == VertexBorder)
+					borderLinks[other * 2 + (borderLinks[other * 2] == from ? 0 : 1)] = to;
+			}
+
+			remap[from] = to;
+			reachedCost = std::max(reachedCost, collapse.cost);
+			performed++;
+		}
+
+		if (!performed)
+			break;
+
+		// apply the pass and drop the triangles that collapsed.
+		size_t write = 0;
+		for (size_t t = 0; t < out.size(); t += 3)
+		{
+			const uint32_t a = remap[out[t]];
+			const uint32_t b = remap[out[t + 1]];
+			const uint32_t c = remap[out[t + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			out[write++] = a;
+			out[write++] = b;
+			out[write++] = c;
+		}
+		out.resize(write);
+	}
+
+	return sqrtf(reachedCost) * extent;
+}
+
+void GFXMeshSimplifier::buildLODChain(GFXMeshData& mesh, std::vector<GFXMeshLOD>& lods, uint32_t maxLODs, float reduction, float maxError) const
+{
+	lods.clear();
+	if (mesh.indices.empty() || maxLODs == 0)
+		return;
+
+	const std::vector<uint32_t> full = mesh.indices;
+	GFXMeshLOD lod = { 0, (uint32_t)full.size(), 0.0f };
+	lods.push_back(lod);
+
+	// every level starts from the full mesh, so errors don't stack up.
+	std::vector<uint32_t> simplified;
+	while (lods.size() < maxLODs)
+	{
+		const GFXMeshLOD& previous = lods.back();
+		const uint32_t target = (uint32_t)(previous.indexCount / 3 * reduction) * 3;
+		const float error = simplify(mesh, &full[0], (uint32_t)full.size(), target, maxError, simplified);
+
+		// stuck on locked vertices or the error limit.
+		if (simplified.empty() || simplified.size() * 10 > (size_t)previous.indexCount * 9)
+			break;
+
+		GFXMeshBuilder::optimizeVertexCache(&simplified[0], (uint32_t)simplified.size(), mesh.getVertexCount());
+
+		lod.firstIndex = (uint32_t)mesh.indices.size();
+		lod.indexCount = (uint32_t)simplified.size();
+		lod.error = std::max(error, previous.error);
+		mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+		lods.push_back(lod);
+	}
+
+	// the full mesh comes first and uses every vertex, so this orders
+	// vertices for it while coarser LODs keep indexing the same ones.
+	GFXMeshBuilder::optimizeVertexFetch(mesh);
+}
+
+float GFXMeshSimplifier::getLODScale(const Matrix4& proj, float viewportHeight)
+{
+	// element 5 is cot(fovY / 2), transposed or not.
+	return proj[5] * viewportHeight * 0.5f;
+}
+
+uint32_t GFXMeshSimplifier::selectLOD(const GFXMeshLOD* lods, uint32_t lodCount, float distance, float lodScale, float pixelError, float scale)
+{
+	if (lodCount == 0)
+		return 0;
+
+	// errors only grow down the chain, take the last one that fits.
+	const float pixelsPerUnit = lodScale * scale / std::max(distance, 1e-6f);
+	uint32_t lod = 0;
+	while (lod + 1 < lodCount && lods[lod + 1].error * pixelsPerUnit <= pixelError)
+		lod++;
+
+	return lod;
+}
@@ -0,0 +1,81 @@
+#ifndef GFXMESHSIMPLIFIER_H_
+#define GFXMESHSIMPLIFIER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <float.h>
+#include <vector>
+
+#include "gfx/gfxMeshBuilder.h"
+#include "math/matrix.h"
+
+// One level of detail, a range of the mesh's index list.
+struct GFXMeshLOD
+{
+	uint32_t	firstIndex;
+	uint32_t	indexCount;
+	float		error;		///< how far the LOD may be off the full mesh, in mesh units.
+};
+
+//-------------------------------------------------------------
+// Mesh simplifier
+//-------------------------------------------------------------
+// Edge collapse simplification with quadric error metrics, Garland and
+// Heckbert, extended to vertex attributes as in "Simplifying surfaces
+// with color and texture using quadric error metrics". Every vertex is
+// a point of position plus weighted attributes and accumulates the
+// quadrics of its triangles, a collapse costs the quadric of the
+// vertex going away evaluated at the one it goes into.
+//
+// Vertices are never moved or added, an edge collapses into one of its
+// ends. The result indexes the input vertices, so every LOD of a mesh
+// can share one vertex buffer.
+//
+// Collapses run in passes: the cheapest valid collapse of each edge is
+// sorted by cost, then performed in order, skipping edges next to an
+// earlier collapse of the same pass and collapses that would flip a
+// triangle. Open borders only collapse along themselves and vertices
+// on attribute seams or non-manifold edges never move.
+//
+// Plain CPU code, usable offline from tools and at load time.
+class GFXMeshSimplifier
+{
+public:
+	enum { MaxAttributes = 8 };
+
+	GFXMeshSimplifier();
+
+	// cost of each float after the position. Positions are scaled to
+	// the mesh's size first, a weight of 1 makes the full range of an
+	// attribute cost as much as moving across the whole mesh. Floats
+	// without a weight don't cost anything but still split seams.
+	void setAttributeWeights(const float* weights, uint32_t count);
+
+	// simplifies the triangles of indices until at most targetIndexCount
+	// indices are left, or the next collapse would be off by more than
+	// maxError. Returns the error reached, in mesh units.
+	float simplify(const GFXMeshData& mesh, const uint32_t* indices, uint32_t indexCount, uint32_t targetIndexCount,
+		float maxError, std::vector<uint32_t>& out) const;
+
+	// replaces mesh.indices with lods of reduction times the triangles of
+	// the one before, back to back, full mesh first. Stops at maxLODs, at
+	// maxError or when the mesh won't get simpler. Each LOD is vertex
+	// cache optimized and vertices are reordered for fetch.
+	void buildLODChain(GFXMeshData& mesh, std::vector<GFXMeshLOD>& lods, uint32_t maxLODs = 6, float reduction = 0.5f,
+		float maxError = FLT_MAX) const;
+
+	// pixels a mesh unit covers at distance 1 through a perspective
+	// projection from Matrix4::setFrustum.
+	static float getLODScale(const Matrix4& proj, float viewportHeight);
+
+	// coarsest LOD whose error is under pixelError pixels on screen. scale
+	// is the largest scale of the object's transform.
+	static uint32_t selectLOD(const GFXMeshLOD* lods, uint32_t lodCount, float distance, float lodScale,
+		float pixelError = 1.0f, float scale = 1.0f);
+
+private:
+	uint32_t	mAttributeCount;
+	float		mAttributeWeights[MaxAttributes];
+};
+
+#endif
@@ -0,0 +1,241 @@
+#include "gfx/gfxMeshletBuilder.h"
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+
+// cones wider than this (normals more than about 84 degrees off the
+// axis) face every way and are never culled.
+static const float MinConeDot = 0.1f;
+
+// how far from a rotation times a uniform scale a model matrix may be
+// before cull() stops trusting the cones, relative to the scale squared.
+static const float ScaleTolerance = 1e-3f;
+
+static inline Vector3 getPosition(const GFXMeshData& mesh, uint32_t vertex)
+{
+	const float* p = mesh.getVertex(vertex);
+	return Vector3(p[0], p[1], p[2]);
+}
+
+// fills in bounds and cone from the meshlet's triangles.
+static void computeBounds(const GFXMeshData& mesh, const uint32_t* indices, const std::vector<Vector3>& normals,
+	const uint32_t* triangles, GFXMeshlet& meshlet)
+{
+	Vector3 minPosition(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vector3 maxPosition(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	Vector3 axis(0.0f, 0.0f, 0.0f);
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			const Vector3 p = getPosition(mesh, indices[triangles[t] * 3 + k]);
+			minPosition.set(std::min(minPosition.x, p.x), std::min(minPosition.y, p.y), std::min(minPosition.z, p.z));
+			maxPosition.set(std::max(maxPosition.x, p.x), std::max(maxPosition.y, p.y), std::max(maxPosition.z, p.z));
+		}
+		axis += normals[triangles[t]];
+	}
+
+	const Vector3 center = (minPosition + maxPosition) * 0.5f;
+	float radius = 0.0f;
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+	{
+		for (int k = 0; k < 3; k++)
+			radius = std::max(radius, center.distance(getPosition(mesh, indices[triangles[t] * 3 + k])));
+	}
+
+	const float axisLength = axis.length();
+	if (axisLength > 0.0f)
+		axis /= axisLength;
+
+	float minDot = axisLength > 0.0f ? 1.0f : -1.0f;
+	for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+		minDot = std::min(minDot, axis.dot(normals[triangles[t]]));
+
+	meshlet.center[0] = center.x;
+	meshlet.center[1] = center.y;
+	meshlet.center[2] = center.z;
+	meshlet.radius = radius;
+	meshlet.coneAxis[0] = axis.x;
+	meshlet.coneAxis[1] = axis.y;
+	meshlet.coneAxis[2] = axis.z;
+	meshlet.coneCutoff = minDot < MinConeDot ? 1.0f : sqrtf(1.0f - minDot * minDot);
+}
+
+void GFXMeshletBuilder::build(GFXMeshData& mesh, uint32_t firstIndex, uint32_t indexCount, std::vector<GFXMeshlet>& meshlets, float coneWeight)
+{
+	const uint32_t triangleCount = indexCount / 3;
+	const uint32_t vertexCount = mesh.getVertexCount();
+	if (triangleCount == 0)
+		return;
+
+	const uint32_t* indices = &mesh.indices[firstIndex];
+
+	std::vector<Vector3> normals(triangleCount);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		const Vector3 p0 = getPosition(mesh, indices[t * 3]);
+		const Vector3 normal = (getPosition(mesh, indices[t * 3 + 1]) - p0).cross(getPosition(mesh, indices[t * 3 + 2]) - p0);
+		const float length = normal.length();
+		normals[t] = length > 0.0f ? normal / length : Vector3(0.0f, 0.0f, 0.0f);
+	}
+
+	// vertex to triangle adjacency.
+	std::vector<uint32_t> triangleStart(vertexCount + 1, 0);
+	for (uint32_t i = 0; i < triangleCount * 3; i++)
+		triangleStart[indices[i] + 1]++;
+	for (uint32_t v = 0; v < vertexCount; v++)
+		triangleStart[v + 1] += triangleStart[v];
+
+	std::vector<uint32_t> triangleList(triangleCount * 3);
+	{
+		std::vector<uint32_t> fill(triangleStart.begin(), triangleStart.end() - 1);
+		for (uint32_t i = 0; i < triangleCount * 3; i++)
+			triangleList[fill[indices[i]]++] = i / 3;
+	}
+
+	// a vertex belongs to the meshlet being built when its stamp matches.
+	std::vector<uint32_t> vertexStamp(vertexCount, 0);
+	std::vector<uint8_t> emitted(triangleCount, 0);
+	std::vector<uint32_t> order;
+	order.reserve(triangleCount);
+
+	std::vector<uint32_t> vertices;
+	uint32_t seedCursor = 0;
+	uint32_t stamp = 0;
+	while (order.size() < triangleCount)
+	{
+		// seed with the next triangle in index order, the input is
+		// usually cache optimized and so already roughly local.
+		while (emitted[seedCursor])
+			seedCursor++;
+
+		GFXMeshlet meshlet;
+		meshlet.firstIndex = firstIndex + (uint32_t)order.size() * 3;
+		meshlet.triangleCount = 0;
+		meshlet.pad = 0;
+		const size_t meshletStart = order.size();
+
+		stamp++;
+		vertices.clear();
+		Vector3 normalSum(0.0f, 0.0f, 0.0f);
+		uint32_t next = seedCursor;
+		while (next != 0xFFFFFFFF)
+		{
+			const uint32_t* tri = &indices[next * 3];
+			for (int k = 0; k < 3; k++)
+			{
+				if (vertexStamp[tri[k]] != stamp)
+				{
+					vertexStamp[tri[k]] = stamp;
+					vertices.push_back(tri[k]);
+				}
+			}
+
+			emitted[next] = 1;
+			order.push_back(next);
+			normalSum += normals[next];
+			meshlet.triangleCount++;
+			if (meshlet.triangleCount == MaxTriangles)
+				break;
+
+			// the neighbour adding the fewest vertices, then the one
+			// facing most like the meshlet so far.
+			const float normalLength = normalSum.length();
+			const Vector3 axis = normalLength > 0.0f ? normalSum / normalLength : normalSum;
+			float bestScore = FLT_MAX;
+			next = 0xFFFFFFFF;
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				const uint32_t v = vertices[i];
+				for (uint32_t j = triangleStart[v]; j < triangleStart[v + 1]; j++)
+				{
+					const uint32_t candidate = triangleList[j];
+					if (emitted[candidate])
+						continue;
+
+					const uint32_t* candidateTri = &indices[candidate * 3];
+					const uint32_t newVertices = (vertexStamp[candidateTri[0]] != stamp) + (vertexStamp[candidateTri[1]] != stamp) + (vertexStamp[candidateTri[2]] != stamp);
+					if (vertices.size() + newVertices > MaxVertices)
+						continue;
+
+					const float score = newVertices + coneWeight * (1.0f - axis.dot(normals[candidate]));
+					if (score < bestScore)
+					{
+						bestScore = score;
+						next = candidate;
+					}
+				}
+			}
+		}
+
+		meshlet.vertexCount = (uint32_t)vertices.size();
+		computeBounds(mesh, indices, normals, &order[meshletStart], meshlet);
+		meshlets.push_back(meshlet);
+	}
+
+	// write the triangles back in meshlet order.
+	std::vector<uint32_t> reordered(triangleCount * 3);
+	for (uint32_t t = 0; t < triangleCount; t++)
+	{
+		reordered[t * 3] = indices[order[t] * 3];
+		reordered[t * 3 + 1] = indices[order[t] * 3 + 1];
+		reordered[t * 3 + 2] = indices[order[t] * 3 + 2];
+	}
+	std::copy(reordered.begin(), reordered.end(), mesh.indices.begin() + firstIndex);
+}
+
+uint32_t GFXMeshletBuilder::cull(const GFXMeshlet* meshlets, uint32_t count, const Matrix4& model, const Frustum& frustum,
+	const Vector3& cameraPosition, std::vector<GFXIndexRange>& ranges)
+{
+	// largest axis scale, radii grow with it.
+	const float* m = model.get();
+	const Vector3 axisX(m[0], m[1], m[2]);
+	const Vector3 axisY(m[4], m[5], m[6]);
+	const Vector3 axisZ(m[8], m[9], m[10]);
+	const float scale = std::max(axisX.length(), std::max(axisY.length(), axisZ.length()));
+
+	// the cones only survive rotation, translation and uniform scale.
+	// Normals of a non-uniformly scaled or sheared mesh don't follow the
+	// model matrix and the angles between them change, so the cutoff
+	// means nothing there, and a mirror turns every cone inside out.
+	// Those instances only get the frustum test.
+	const float scaleSq = scale * scale;
+	const float tolerance = ScaleTolerance * scaleSq;
+	const bool coneCulling = fabsf(axisX.dot(axisX) - scaleSq) <= tolerance && fabsf(axisY.dot(axisY) - scaleSq) <= tolerance &&
+		fabsf(axisZ.dot(axisZ) - scaleSq) <= tolerance && fabsf(axisX.dot(axisY)) <= tolerance &&
+		fabsf(axisY.dot(axisZ)) <= tolerance && fabsf(axisZ.dot(axisX)) <= tolerance && axisX.cross(axisY).dot(axisZ) > 0.0f;
+
+	uint32_t triangles = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const GFXMeshlet& meshlet = meshlets[i];
+		const Vector3 center = model * Vector3(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+		const float radius = meshlet.radius * scale;
+		if (!frustum.intersectsSphere(center, radius))
+			continue;
+
+		// back facing when the camera sits inside the cone's negative
+		// side, widened by the bounding sphere.
+		if (coneCulling && meshlet.coneCutoff < 1.0f)
+		{
+			Vector3 axis = axisX * meshlet.coneAxis[0] + axisY * meshlet.coneAxis[1] + axisZ * meshlet.coneAxis[2];
+			axis.normalize();
+			const Vector3 view = center - cameraPosition;
+			if (view.dot(axis) >= meshlet.coneCutoff * view.length() + radius)
+				continue;
+		}
+
+		triangles += meshlet.triangleCount;
+		const uint32_t indexCount = meshlet.triangleCount * 3;
+		if (!ranges.empty() && ranges.back().firstIndex + ranges.back().indexCount == meshlet.firstIndex)
+			ranges.back().indexCount += indexCount;
+		else
+		{
+			GFXIndexRange range = { meshlet.firstIndex, indexCount };
+			ranges.push_back(range);
+		}
+	}
+
+	return triangles;
+}
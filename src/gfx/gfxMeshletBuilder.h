@@ -0,0 +1,70 @@
+#ifndef GFXMESHLETBUILDER_H_
+#define GFXMESHLETBUILDER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "gfx/gfxMeshBuilder.h"
+#include "math/matrix.h"
+#include "math/frustum.h"
+
+// A cluster of neighbouring triangles, a contiguous range of the mesh's
+// index list. Bounds are in mesh space.
+struct GFXMeshlet
+{
+	float		center[3];
+	float		radius;
+	float		coneAxis[3];		///< average facing of the triangles.
+	float		coneCutoff;			///< sin of the cone's half angle, 1 when it can't be culled.
+	uint32_t	firstIndex;
+	uint32_t	triangleCount;
+	uint32_t	vertexCount;
+	uint32_t	pad;
+};
+
+// draw this many indices from firstIndex.
+struct GFXIndexRange
+{
+	uint32_t	firstIndex;
+	uint32_t	indexCount;
+};
+
+//-------------------------------------------------------------
+// Meshlet builder
+//-------------------------------------------------------------
+// Splits a mesh into clusters of at most MaxVertices vertices and
+// MaxTriangles triangles, sized for mesh shaders and small enough to
+// cull on the CPU. Meshlets grow greedily from a seed triangle, adding
+// the neighbour that brings the fewest new vertices and, among those,
+// the one facing most like the meshlet so its normal cone stays
+// narrow.
+//
+// cull() rejects meshlets outside the frustum and meshlets whose every
+// triangle faces away from the camera, tested with a cone around the
+// triangle normals as in "Optimizing the Graphics Pipeline with Compute"
+// (Wihlidal). Meshlets that are next to each other in the index list
+// come out as one range.
+class GFXMeshletBuilder
+{
+public:
+	enum
+	{
+		MaxVertices = 64,
+		MaxTriangles = 124,
+	};
+
+	// reorders the triangles of [firstIndex, firstIndex + indexCount) so
+	// each meshlet is a contiguous range and appends the meshlets. Positions
+	// are the first three floats of a vertex. coneWeight trades vertex
+	// reuse for tighter cones.
+	static void build(GFXMeshData& mesh, uint32_t firstIndex, uint32_t indexCount, std::vector<GFXMeshlet>& meshlets, float coneWeight = 0.5f);
+
+	// appends the index ranges of visible meshlets. model may rotate,
+	// translate and scale, the cone test is skipped unless the scale is
+	// uniform and there's no mirror. Returns the triangles kept.
+	static uint32_t cull(const GFXMeshlet* meshlets, uint32_t count, const Matrix4& model, const Frustum& frustum,
+		const Vector3& cameraPosition, std::vector<GFXIndexRange>& ranges);
+};
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef GFXNAMEHASH_H_
+#define GFXNAMEHASH_H_
+
+#include <stdint.h>
+
+// Shader resources are looked up by the 32 bit FNV-1a hash of their
+// name. GFXHashName is constexpr so names written in code are hashed by
+// the compiler, keep them in static constants and no string is touched
+// when drawing.
+typedef uint32_t GFXNameHash;
+
+constexpr GFXNameHash GFXHashName(const char* name, GFXNameHash hash = 2166136261u)
+{
+	return *name ? GFXHashName(name + 1, (hash ^ (uint8_t)*name) * 16777619u) : hash;
+}
+
+#endif
@@ -0,0 +1,200 @@
+#include "gfx/gfxScene.h"
+#include "core/coreJobSystem.h"
+
+static const uint32_t SlotMask = GFXScene::MaxObjects - 1;
+static const uint32_t GenerationMask = (1u << GFXScene::GenerationBits) - 1;
+static const uint32_t NoSlot = 0xFFFFFFFF;
+
+static inline uint32_t getSlot(GFXSceneHandle handle) { return handle & SlotMask; }
+static inline uint32_t getGeneration(GFXSceneHandle handle) { return handle >> GFXScene::SlotBits; }
+
+GFXScene::GFXScene()
+{
+	mFreeSlot = NoSlot;
+	mAnyMoved = false;
+}
+
+void GFXScene::init(uint32_t capacity)
+{
+	destroy();
+
+	mSlots.reserve(capacity);
+	mHandles.reserve(capacity);
+	mTransforms.reserve(capacity);
+	mLocalBounds.reserve(capacity);
+	mWorldBounds.reserve(capacity);
+	mMeshes.reserve(capacity);
+	mMaterials.reserve(capacity);
+	mMoved.reserve(capacity);
+}
+
+void GFXScene::destroy()
+{
+	mSlots.clear();
+	mFreeSlot = NoSlot;
+	mHandles.clear();
+	mTransforms.clear();
+	mLocalBounds.clear();
+	mWorldBounds.clear();
+	mMeshes.clear();
+	mMaterials.clear();
+	mMoved.clear();
+	mVisible.clear();
+	mAnyMoved = false;
+}
+
+GFXSceneHandle GFXScene::create(const Matrix4& transform, const Box3& localBounds, uint32_t mesh, uint32_t material)
+{
+	uint32_t slot = mFreeSlot;
+	if (slot != NoSlot)
+		mFreeSlot = mSlots[slot].index;
+	else
+	{
+		if (mSlots.size() >= MaxObjects)
+			return InvalidHandle;
+
+		// generations start at 1 so no handle is ever 0.
+		slot = (uint32_t)mSlots.size();
+		Slot newSlot = { 0, 1 };
+		mSlots.push_back(newSlot);
+	}
+
+	const GFXSceneHandle handle = (mSlots[slot].generation << SlotBits) | slot;
+	mSlots[slot].index = (uint32_t)mHandles.size();
+
+	mHandles.push_back(handle);
+	mTransforms.push_back(transform);
+	mLocalBounds.push_back(localBounds);
+	mWorldBounds.push_back(localBounds.transform(transform));
+	mMeshes.push_back(mesh);
+	mMaterials.push_back(material);
+	mMoved.push_back(0);
+	return handle;
+}
+
+void GFXScene::remove(GFXSceneHandle handle)
+{
+	const uint32_t index = getIndex(handle);
+	if (index == InvalidIndex)
+		return;
+
+	// move the last object into the hole.
+	const uint32_t last = (uint32_t)mHandles.size() - 1;
+	if (index != last)
+	{
+		mHandles[index] = mHandles[last];
+		mTransforms[index] = mTransforms[last];
+		mLocalBounds[index] = mLocalBounds[last];
+		mWorldBounds[index] = mWorldBounds[last];
+		mMeshes[index] = mMeshes[last];
+		mMaterials[index] = mMaterials[last];
+		mMoved[index] = mMoved[last];
+		mSlots[getSlot(mHandles[index])].index = index;
+	}
+
+	mHandles.pop_back();
+	mTransforms.pop_back();
+	mLocalBounds.pop_back();
+	mWorldBounds.pop_back();
+	mMeshes.pop_back();
+	mMaterials.pop_back();
+	mMoved.pop_back();
+
+	// skip generation 0 on wrap, handles stay non zero.
+	const uint32_t slot = getSlot(handle);
+	Slot& freed = mSlots[slot];
+	freed.generation = (freed.generation + 1) & GenerationMask;
+	if (freed.generation == 0)
+		freed.generation = 1;
+	freed.index = mFreeSlot;
+	mFreeSlot = slot;
+}
+
+uint32_t GFXScene::getIndex(GFXSceneHandle handle) const
+{
+	const uint32_t slot = getSlot(handle);
+	if (handle == InvalidHandle || slot >= mSlots.size() || mSlots[slot].generation != getGeneration(handle))
+		return InvalidIndex;
+
+	return mSlots[slot].index;
+}
+
+void GFXScene::setTransform(GFXSceneHandle handle, const Matrix4& transform)
+{
+	const uint32_t index = getIndex(handle);
+	if (index == InvalidIndex)
+		return;
+
+	mTransforms[index] = transform;
+	mMoved[index] = 1;
+	mAnyMoved = true;
+}
+
+void GFXScene::setMaterial(GFXSceneHandle handle, uint32_t material)
+{
+	const uint32_t index = getIndex(handle);
+	if (index != InvalidIndex)
+		mMaterials[index] = material;
+}
+
+void GFXScene::updateBoundsJob(void* data, uint32_t begin, uint32_t end)
+{
+	GFXScene* scene = (GFXScene*)data;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		if (!scene->mMoved[i])
+			continue;
+
+		scene->mWorldBounds[i] = scene->mLocalBounds[i].transform(scene->mTransforms[i]);
+		scene->mMoved[i] = 0;
+	}
+}
+
+void GFXScene::updateBounds(CoreJobSystem* jobs)
+{
+	if (!mAnyMoved)
+		return;
+
+	if (jobs)
+		jobs->parallelFor(getCount(), CullGrain, updateBoundsJob, this);
+	else
+		updateBoundsJob(this, 0, getCount());
+	mAnyMoved = false;
+}
+
+void GFXScene::cullJob(void* data, uint32_t begin, uint32_t end)
+{
+	CullJob* job = (CullJob*)data;
+	const Box3* bounds = &job->scene->mWorldBounds[0];
+	uint8_t* visible = &job->scene->mVisible[0];
+	for (uint32_t i = begin; i < end; i++)
+		visible[i] = job->frustum->intersectsBox(bounds[i].minExtents, bounds[i].maxExtents) ? 1 : 0;
+}
+
+uint32_t GFXScene::cull(const Frustum& frustum, std::vector<uint32_t>& visible, CoreJobSystem* jobs)
+{
+	visible.clear();
+
+	const uint32_t count = getCount();
+	if (!count)
+		return 0;
+
+	// moved objects have to be tested where they are now.
+	updateBounds(jobs);
+
+	// test in parallel into flags, then compact in order.
+	mVisible.resize(count);
+	CullJob job = { this, &frustum };
+	if (jobs)
+		jobs->parallelFor(count, CullGrain, cullJob, &job);
+	else
+		cullJob(&job, 0, count);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (mVisible[i])
+			visible.push_back(i);
+	}
+
+	return (uint32_t)visible.size();
+}
@@ -0,0 +1,112 @@
+#ifndef GFXSCENE_H_
+#define GFXSCENE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "math/matrix.h"
+#include "math/frustum.h"
+#include "math/box3.h"
+
+class CoreJobSystem;
+
+// generation:12 | slot:20, 0 is never a live object.
+typedef uint32_t GFXSceneHandle;
+
+//-------------------------------------------------------------
+// Scene
+//-------------------------------------------------------------
+// Renderable objects stored as parallel dense arrays, one entry per
+// live object in each: world transform, local and world bounds, mesh
+// and material. Loops over the scene walk each array front to back
+// and only touch the fields they need.
+//
+// Objects are named by generational handles. A handle picks a slot
+// that holds the object's dense index and a generation, removing the
+// object bumps the generation so old handles stop resolving. Removal
+// moves the last object into the hole, so create and remove are O(1)
+// and the arrays never have gaps, but dense indices of other objects
+// can change. Keep handles, not indices, across a remove.
+class GFXScene
+{
+public:
+	enum
+	{
+		SlotBits = 20,
+		GenerationBits = 12,
+		MaxObjects = 1 << SlotBits,
+		CullGrain = 256,	///< objects a cull or update job handles at least.
+	};
+
+	static const GFXSceneHandle InvalidHandle = 0;
+
+	GFXScene();
+
+	// capacity is a hint, the arrays grow as needed.
+	void init(uint32_t capacity);
+	void destroy();
+
+	// mesh and material are the caller's own ids. Returns InvalidHandle
+	// when the scene is full.
+	GFXSceneHandle create(const Matrix4& transform, const Box3& localBounds, uint32_t mesh, uint32_t material);
+	void remove(GFXSceneHandle handle);
+
+	bool isValid(GFXSceneHandle handle) const { return getIndex(handle) != InvalidIndex; }
+
+	// dense index of a live object, InvalidIndex for a stale handle.
+	uint32_t getIndex(GFXSceneHandle handle) const;
+
+	// world bounds follow on the next updateBounds().
+	void setTransform(GFXSceneHandle handle, const Matrix4& transform);
+	void setMaterial(GFXSceneHandle handle, uint32_t material);
+
+	// recomputes world bounds of moved objects.
+	void updateBounds(CoreJobSystem* jobs = NULL);
+
+	// dense indices of objects whose world bounds touch the frustum,
+	// in dense order. Returns the count.
+	uint32_t cull(const Frustum& frustum, std::vector<uint32_t>& visible, CoreJobSystem* jobs = NULL);
+
+	// dense arrays, getCount() entries each, valid until the next create/remove.
+	uint32_t getCount() const { return (uint32_t)mHandles.size(); }
+	const GFXSceneHandle* getHandles() const { return mHandles.empty() ? NULL : &mHandles[0]; }
+	const Matrix4* getTransforms() const { return mTransforms.empty() ? NULL : &mTransforms[0]; }
+	const Box3* getWorldBounds() const { return mWorldBounds.empty() ? NULL : &mWorldBounds[0]; }
+	const uint32_t* getMeshes() const { return mMeshes.empty() ? NULL : &mMeshes[0]; }
+	const uint32_t* getMaterials() const { return mMaterials.empty() ? NULL : &mMaterials[0]; }
+
+	static const uint32_t InvalidIndex = 0xFFFFFFFF;
+
+private:
+	struct Slot
+	{
+		uint32_t	index;		///< dense index when live, next free slot otherwise.
+		uint32_t	generation;
+	};
+
+	struct CullJob
+	{
+		GFXScene*		scene;
+		const Frustum*	frustum;
+	};
+
+	static void updateBoundsJob(void* data, uint32_t begin, uint32_t end);
+	static void cullJob(void* data, uint32_t begin, uint32_t end);
+
+	std::vector<Slot>		mSlots;
+	uint32_t				mFreeSlot;	///< head of the free slot list.
+
+	// dense, same order in all of them.
+	std::vector<GFXSceneHandle>	mHandles;		///< back to the slot, for remove.
+	std::vector<Matrix4>	mTransforms;
+	std::vector<Box3>		mLocalBounds;
+	std::vector<Box3>		mWorldBounds;
+	std::vector<uint32_t>	mMeshes;
+	std::vector<uint32_t>	mMaterials;
+	std::vector<uint8_t>	mMoved;			///< world bounds out of date.
+	std::vector<uint8_t>	mVisible;		///< cull() results before compaction.
+	bool					mAnyMoved;
+};
+
+#endif
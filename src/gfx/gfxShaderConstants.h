@@ -0,0 +1,31 @@
+#ifndef GFXSHADERCONSTANTS_H_
+#define GFXSHADERCONSTANTS_H_
+
+// CPU side copies of the uniform blocks declared in the shaders.
+// Layouts follow std140, keep them in sync with the GLSL.
+
+#include "gfx/gfxNameHash.h"
+
+enum GFXUniformBlockBinding
+{
+	GFXFrameConstantsBinding = 0,
+	GFXObjectConstantsBinding = 1,
+};
+
+constexpr GFXNameHash GFXFrameConstantsName = GFXHashName("FrameConstants");
+constexpr GFXNameHash GFXObjectConstantsName = GFXHashName("ObjectConstants");
+
+// FrameConstants, written once per frame.
+struct GFXFrameConstants
+{
+	float view[16];
+	float proj[16];
+};
+
+// ObjectConstants, written once per draw.
+struct GFXObjectConstants
+{
+	float model[16];
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "gfx/gfxShaderPreprocessor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static bool isIdentChar(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+// "#name" at the start of the line, whitespace allowed around the '#'.
+static bool isDirective(const std::string& line, const char* name)
+{
+	size_t pos = line.find_first_not_of(" \t");
+	if (pos == std::string::npos || line[pos] != '#')
+		return false;
+
+	pos = line.find_first_not_of(" \t", pos + 1);
+	size_t length = strlen(name);
+	return pos != std::string::npos && line.compare(pos, length, name) == 0 &&
+		(pos + length == line.size() || !isIdentChar(line[pos + length]));
+}
+
+static std::string getDirectory(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+GFXShaderPreprocessor::GFXShaderPreprocessor()
+{
+	mReadFunc = readFile;
+}
+
+uint64_t GFXShaderPreprocessor::hash(const void* data, size_t size, uint64_t seed)
+{
+	uint64_t h = seed;
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= bytes[i];
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+// text mode so line endings come out as '\n', read straight into out
+// without a stream in between.
+bool GFXShaderPreprocessor::readFile(const char* path, std::string& out)
+{
+	FILE* file = fopen(path, "r");
+	if (!file)
+		return false;
+
+	out.clear();
+	char buffer[4096];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		out.append(buffer, read);
+	fclose(file);
+	return true;
+}
+
+bool GFXShaderPreprocessor::mentions(const std::string& text, const char* name)
+{
+	const size_t length = strlen(name);
+	for (size_t pos = text.find(name); pos != std::string::npos; pos = text.find(name, pos + 1))
+	{
+		bool startOk = pos == 0 || !isIdentChar(text[pos - 1]);
+		bool endOk = pos + length == text.size() || !isIdentChar(text[pos + length]);
+		if (startOk && endOk)
+			return true;
+	}
+	return false;
+}
+
+bool GFXShaderPreprocessor::process(const char* path, const GFXShaderDefine* defines, uint32_t defineCount, GFXShaderSource& out)
+{
+	out.text.clear();
+	out.files.clear();
+	out.hash = 0;
+
+	out.files.push_back(path);
+	if (!expand(path, 0, out))
+		return false;
+
+	// defines go after #version, which has to stay the first directive.
+	size_t insertAt = 0;
+	uint32_t versionLine = 0;
+	{
+		size_t lineStart = 0;
+		uint32_t line = 1;
+		while (lineStart < out.text.size())
+		{
+			size_t lineEnd = out.text.find('\n', lineStart);
+			if (lineEnd == std::string::npos)
+				lineEnd = out.text.size();
+
+			if (isDirective(out.text.substr(lineStart, lineEnd - lineStart), "version"))
+			{
+				insertAt = lineEnd < out.text.size() ? lineEnd + 1 : lineEnd;
+				versionLine = line;
+				break;
+			}
+
+			lineStart = lineEnd + 1;
+			line++;
+		}
+	}
+
+	std::string header;
+	for (uint32_t i = 0; i < defineCount; i++)
+	{
+		if (!mentions(out.text, defines[i].name))
+			continue;
+
+		header += "#define ";
+		header += defines[i].name;
+		if (defines[i].value)
+		{
+			header += " ";
+			header += defines[i].value;
+		}
+		header += "\n";
+	}
+
+	if (!header.empty())
+	{
+		char lineDirective[32];
+		snprintf(lineDirective, sizeof(lineDirective), "#line %d 0\n", versionLine + 1);
+		header += lineDirective;
+		out.text.insert(insertAt, header);
+	}
+
+	out.hash = hash(out.text.data(), out.text.size());
+	return true;
+}
+
+bool GFXShaderPreprocessor::expand(const std::string& path, uint32_t depth, GFXShaderSource& out)
+{
+	if (depth > MaxIncludeDepth)
+	{
+		printf("%s: includes nested deeper than %d.\n", path.c_str(), MaxIncludeDepth);
+		return false;
+	}
+
+	std::string text;
+	if (!mReadFunc(path.c_str(), text))
+	{
+		printf("Impossible to open %s!\n", path.c_str());
+		return false;
+	}
+
+	const uint32_t fileIndex = (uint32_t)out.files.size() - 1;
+	const std::string directory = getDirectory(path);
+
+	size_t lineStart = 0;
+	uint32_t line = 1;
+	while (lineStart < text.size())
+	{
+		size_t lineEnd = text.find('\n', lineStart);
+		if (lineEnd == std::string::npos)
+			lineEnd = text.size();
+
+		std::string lineText = text.substr(lineStart, lineEnd - lineStart);
+		if (!isDirective(lineText, "include"))
+		{
+			out.text.append(text, lineStart, lineEnd - lineStart);
+			out.text += "\n";
+		}
+		else
+		{
+			size_t open = lineText.find('"');
+			size_t close = open == std::string::npos ? open : lineText.find('"', open + 1);
+			if (close == std::string::npos)
+			{
+				printf("%s(%d): malformed #include.\n", path.c_str(), line);
+				return false;
+			}
+
+			std::string includePath = directory + lineText.substr(open + 1, close - open - 1);
+
+			bool seen = false;
+			for (size_t i = 0; i < out.files.size() && !seen; i++)
+				seen = out.files[i] == includePath;
+
+			if (!seen)
+			{
+				char lineDirective[32];
+				snprintf(lineDirective, sizeof(lineDirective), "#line 1 %d\n", (int)out.files.size());
+				out.text += lineDirective;
+
+				out.files.push_back(includePath);
+				if (!expand(includePath, depth + 1, out))
+					return false;
+
+				snprintf(lineDirective, sizeof(lineDirective), "#line %d %d\n", line + 1, fileIndex);
+				out.text += lineDirective;
+			}
+			else
+				out.text += "\n";
+		}
+
+		lineStart = lineEnd + 1;
+		line++;
+	}
+
+	return true;
+}
@@ -0,0 +1,60 @@
+#ifndef GFXSHADERPREPROCESSOR_H_
+#define GFXSHADERPREPROCESSOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// A permutation define, value may be NULL for a plain #define NAME.
+struct GFXShaderDefine
+{
+	const char*	name;
+	const char*	value;
+};
+
+// Expanded shader text and the files it came from.
+struct GFXShaderSource
+{
+	std::string					text;
+	std::vector<std::string>	files;	///< index is the #line source string number.
+	uint64_t					hash;	///< hash of text.
+};
+
+typedef bool (*GFXShaderReadFunc)(const char* path, std::string& out);
+
+//-------------------------------------------------------------
+// Shader preprocessor
+//-------------------------------------------------------------
+// Runs before the GLSL compiler sees a stage:
+//  - #include "file" is replaced with the file, resolved relative to
+//    the including file. Each file is pulled in once, so includes need
+//    no guards and cycles are harmless.
+//  - permutation defines go right after #version. Defines the source
+//    never mentions are left out, so permutations that can't change
+//    the code expand to the same text and can share a program.
+//  - #line directives keep compiler errors pointing at the right file
+//    and line, files[n] names source string n.
+class GFXShaderPreprocessor
+{
+public:
+	enum { MaxIncludeDepth = 16 };
+
+	GFXShaderPreprocessor();
+
+	void setReadFunc(GFXShaderReadFunc readFunc) { mReadFunc = readFunc; }
+
+	bool process(const char* path, const GFXShaderDefine* defines, uint32_t defineCount, GFXShaderSource& out);
+
+	// 64 bit FNV-1a, for source and permutation keys.
+	static uint64_t hash(const void* data, size_t size, uint64_t seed = 14695981039346656037ull);
+	static bool readFile(const char* path, std::string& out);
+
+private:
+	bool expand(const std::string& path, uint32_t depth, GFXShaderSource& out);
+	static bool mentions(const std::string& text, const char* name);
+
+	GFXShaderReadFunc	mReadFunc;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "gfx/gfxVertexFormat.h"
+
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+GFXVertexFormat::GFXVertexFormat()
+{
+	mStreamCount = 0;
+	memset(mStrides, 0, sizeof(mStrides));
+	memset(mDivisors, 0, sizeof(mDivisors));
+	mHash = 0;
+}
+
+uint32_t GFXVertexFormat::getTypeSize(GFXVertexElementType type)
+{
+	switch (type)
+	{
+	case GFXVertexUByteNorm:
+		return 1;
+	case GFXVertexShortNorm:
+		return 2;
+	case GFXVertexFloat:
+	case GFXVertexUInt:
+	default:
+		return 4;
+	}
+}
+
+void GFXVertexFormat::addElement(uint32_t location, GFXVertexElementType type, uint32_t components, uint32_t stream)
+{
+	assert(stream < MaxStreams);
+	assert(components >= 1 && components <= 4);
+
+	GFXVertexElement element;
+	element.location = location;
+	element.type = type;
+	element.components = components;
+	element.stream = stream;
+
+	// keep every element 4 byte aligned.
+	element.offset = mStrides[stream];
+	mStrides[stream] += (getTypeSize(type) * components + 3) & ~3u;
+
+	mElements.push_back(element);
+	if (stream + 1 > mStreamCount)
+		mStreamCount = stream + 1;
+
+	updateHash();
+}
+
+void GFXVertexFormat::setStreamDivisor(uint32_t stream, uint32_t divisor)
+{
+	assert(stream < MaxStreams);
+	mDivisors[stream] = divisor;
+	updateHash();
+}
+
+void GFXVertexFormat::updateHash()
+{
+	// FNV-1a over the description.
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < mElements.size(); i++)
+	{
+		const GFXVertexElement& e = mElements[i];
+		const uint32_t fields[5] = { e.location, (uint32_t)e.type, e.components, e.stream, e.offset };
+		for (int f = 0; f < 5; f++)
+		{
+			hash ^= fields[f];
+			hash *= 16777619u;
+		}
+	}
+	for (uint32_t s = 0; s < MaxStreams; s++)
+	{
+		hash ^= mDivisors[s];
+		hash *= 16777619u;
+	}
+
+	mHash = hash;
+}
+
+bool GFXVertexFormat::operator==(const GFXVertexFormat& rhs) const
+{
+	if (mHash != rhs.mHash || mElements.size() != rhs.mElements.size() || mStreamCount != rhs.mStreamCount)
+		return false;
+
+	for (size_t i = 0; i < mElements.size(); i++)
+	{
+		const GFXVertexElement& a = mElements[i];
+		const GFXVertexElement& b = rhs.mElements[i];
+		if (a.location != b.location || a.type != b.type || a.components != b.components || a.stream != b.stream || a.offset != b.offset)
+			return false;
+	}
+
+	return memcmp(mDivisors, rhs.mDivisors, sizeof(mDivisors)) == 0;
+}
+
+void GFXVertexFormat::pack(const float* src, uint32_t srcStride, uint32_t count, std::vector<uint8_t>& out, const uint32_t* srcWidths) const
+{
+	const uint32_t stride = mStrides[0];
+	out.assign((size_t)count * stride, 0);
+
+	for (uint32_t v = 0; v < count; v++)
+	{
+		const float* in = src + (size_t)v * srcStride;
+		uint8_t* vert = &out[(size_t)v * stride];
+
+		for (size_t i = 0; i < mElements.size(); i++)
+		{
+			const GFXVertexElement& e = mElements[i];
+			if (e.stream != 0)
+				continue;
+
+			const uint32_t width = srcWidths ? srcWidths[i] : e.components;
+			uint8_t* dst = vert + e.offset;
+			for (uint32_t c = 0; c < e.components; c++)
+			{
+				// missing components default to 0, alpha to 1.
+				float f = c < width ? in[c] : (c == 3 ? 1.0f : 0.0f);
+				switch (e.type)
+				{
+				case GFXVertexFloat:
+					memcpy(dst + c * 4, &f, 4);
+					break;
+				case GFXVertexUByteNorm:
+					f = f < 0.0f ? 0.0f : (f > 1.0f ? 1.0f : f);
+					dst[c] = (uint8_t)(f * 255.0f + 0.5f);
+					break;
+				case GFXVertexShortNorm:
+				{
+					f = f < -1.0f ? -1.0f : (f > 1.0f ? 1.0f : f);
+					int16_t s = (int16_t)floorf(f * 32767.0f + 0.5f);
+					memcpy(dst + c * 2, &s, 2);
+					break;
+				}
+				case GFXVertexUInt:
+				{
+					uint32_t u = (uint32_t)f;
+					memcpy(dst + c * 4, &u, 4);
+					break;
+				}
+				}
+			}
+
+			in += width;
+		}
+	}
+}
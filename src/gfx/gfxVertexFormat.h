@@ -0,0 +1,80 @@
+#ifndef GFXVERTEXFORMAT_H_
+#define GFXVERTEXFORMAT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Fixed attribute locations, shaders declare these with layout(location).
+enum GFXVertexAttribLocation
+{
+	GFXAttribPosition = 0,
+	GFXAttribColor = 1,
+	GFXAttribInstanceModel = 2,		///< mat4, takes 4 locations.
+	GFXAttribInstanceColor = 6,
+	GFXAttribObjectId = 7,
+	GFXAttribNormal = 8,
+	GFXAttribTexCoord = 9,
+};
+
+enum GFXVertexElementType
+{
+	GFXVertexFloat,
+	GFXVertexUByteNorm,		///< 0..1 floats packed into bytes.
+	GFXVertexShortNorm,		///< -1..1 floats packed into shorts.
+	GFXVertexUInt,			///< integer attribute, read as uint in the shader.
+};
+
+struct GFXVertexElement
+{
+	uint32_t				location;
+	GFXVertexElementType	type;
+	uint32_t				components;
+	uint32_t				stream;
+	uint32_t				offset;		///< byte offset inside the stream's vertex.
+};
+
+//-------------------------------------------------------------
+// Vertex format
+//-------------------------------------------------------------
+// Describes where each attribute lives in one or more interleaved
+// vertex streams. Formats that compare equal can share a VAO, only
+// the buffer bindings change between meshes.
+class GFXVertexFormat
+{
+public:
+	enum { MaxStreams = 4 };
+
+	GFXVertexFormat();
+
+	void addElement(uint32_t location, GFXVertexElementType type, uint32_t components, uint32_t stream = 0);
+	void setStreamDivisor(uint32_t stream, uint32_t divisor);	///< 1 for per instance streams.
+
+	uint32_t	getElementCount() const { return (uint32_t)mElements.size(); }
+	const GFXVertexElement& getElement(uint32_t index) const { return mElements[index]; }
+	uint32_t	getStreamCount() const { return mStreamCount; }
+	uint32_t	getStride(uint32_t stream = 0) const { return mStrides[stream]; }
+	uint32_t	getStreamDivisor(uint32_t stream) const { return mDivisors[stream]; }
+	uint32_t	getHash() const { return mHash; }
+
+	// interleave float vertices into this format's stream 0. Each source
+	// vertex holds the elements in order, srcWidths gives the number of
+	// floats per element (NULL when it matches the element components).
+	void pack(const float* src, uint32_t srcStride, uint32_t count, std::vector<uint8_t>& out, const uint32_t* srcWidths = NULL) const;
+
+	bool operator==(const GFXVertexFormat& rhs) const;
+	bool operator!=(const GFXVertexFormat& rhs) const { return !(*this == rhs); }
+
+	static uint32_t getTypeSize(GFXVertexElementType type);
+
+private:
+	void updateHash();
+
+	std::vector<GFXVertexElement> mElements;
+	uint32_t	mStreamCount;
+	uint32_t	mStrides[MaxStreams];
+	uint32_t	mDivisors[MaxStreams];
+	uint32_t	mHash;
+};
+
+#endif
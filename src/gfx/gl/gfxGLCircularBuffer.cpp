@@ -0,0 +1,164 @@
+#include "gfx/gl/gfxGLCircularBuffer.h"
+#include "gfx/gl/gfxGLUtils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+GLCircularBuffer::GLCircularBuffer()
+{
+	mTarget = GL_UNIFORM_BUFFER;
+	mBuffer = 0;
+	mFrameSize = 0;
+	mAlignment = 16;
+	mPersistent = false;
+	mMapped = NULL;
+	mSegment = 0;
+	mHead = 0;
+	mFlushed = 0;
+	memset(mFences, 0, sizeof(mFences));
+}
+
+GLCircularBuffer::~GLCircularBuffer()
+{
+	destroy();
+}
+
+bool GLCircularBuffer::init(GLenum target, GLsizeiptr frameSize)
+{
+	destroy();
+
+	mTarget = target;
+	mAlignment = 16;
+	if (target == GL_UNIFORM_BUFFER)
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &mAlignment);
+	else if (target == GL_SHADER_STORAGE_BUFFER)
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &mAlignment);
+
+	// keep every segment start aligned as well.
+	mFrameSize = gglAlignOffset(frameSize, mAlignment);
+	const GLsizeiptr totalSize = mFrameSize * MaxFramesInFlight;
+
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(mTarget, mBuffer);
+
+	mPersistent = gglHasExtension(ARB_buffer_storage);
+	if (mPersistent)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(mTarget, totalSize, NULL, flags);
+		mMapped = (uint8_t*)glMapBufferRange(mTarget, 0, totalSize, flags);
+		if (!mMapped)
+		{
+			printf("Persistent map of the circular buffer failed, falling back to buffer sub data.\n");
+			glDeleteBuffers(1, &mBuffer);
+			glGenBuffers(1, &mBuffer);
+			glBindBuffer(mTarget, mBuffer);
+			mPersistent = false;
+		}
+	}
+
+	if (!mPersistent)
+	{
+		glBufferData(mTarget, totalSize, NULL, GL_STREAM_DRAW);
+		mShadow.resize(mFrameSize);
+	}
+
+	glBindBuffer(mTarget, 0);
+
+	printf("Circular buffer: %d KB per frame, %d frames, %s.\n", (int)(mFrameSize / 1024), (int)MaxFramesInFlight,
+		mPersistent ? "persistent mapped" : "buffer sub data");
+
+	return mBuffer != 0;
+}
+
+void GLCircularBuffer::destroy()
+{
+	for (int i = 0; i < MaxFramesInFlight; i++)
+	{
+		if (mFences[i])
+			glDeleteSync(mFences[i]);
+		mFences[i] = NULL;
+	}
+
+	if (mBuffer)
+	{
+		if (mMapped)
+		{
+			glBindBuffer(mTarget, mBuffer);
+			glUnmapBuffer(mTarget);
+			glBindBuffer(mTarget, 0);
+		}
+		glDeleteBuffers(1, &mBuffer);
+	}
+
+	mBuffer = 0;
+	mMapped = NULL;
+	mShadow.clear();
+	mSegment = 0;
+	mHead = 0;
+	mFlushed = 0;
+}
+
+void GLCircularBuffer::beginFrame()
+{
+	// the gpu may still be reading this segment from MaxFramesInFlight frames ago.
+	GLsync fence = mFences[mSegment];
+	if (fence)
+	{
+		while (1)
+		{
+			GLenum ret = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+			if (ret == GL_ALREADY_SIGNALED || ret == GL_CONDITION_SATISFIED || ret == GL_WAIT_FAILED)
+				break;
+		}
+
+		glDeleteSync(fence);
+		mFences[mSegment] = NULL;
+	}
+
+	mHead = 0;
+	mFlushed = 0;
+}
+
+bool GLCircularBuffer::allocate(GLsizeiptr size, Allocation& out)
+{
+	GLintptr start = gglAlignOffset(mHead, mAlignment);
+	if (start + size > mFrameSize)
+	{
+		printf("Circular buffer out of space! %d of %d bytes used this frame.\n", (int)mHead, (int)mFrameSize);
+		return false;
+	}
+
+	mHead = start + size;
+
+	out.offset = getSegmentOffset() + start;
+	out.size = size;
+	out.ptr = mPersistent ? (void*)(mMapped + out.offset) : (void*)(&mShadow[0] + start);
+
+	return true;
+}
+
+void GLCircularBuffer::flush()
+{
+	// coherent mapping, nothing to do.
+	if (mPersistent || mHead == mFlushed)
+		return;
+
+	glBindBuffer(mTarget, mBuffer);
+	glBufferSubData(mTarget, getSegmentOffset() + mFlushed, mHead - mFlushed, &mShadow[0] + mFlushed);
+	glBindBuffer(mTarget, 0);
+	mFlushed = mHead;
+}
+
+void GLCircularBuffer::endFrame()
+{
+	flush();
+
+	mFences[mSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	mSegment = (mSegment + 1) % MaxFramesInFlight;
+}
+
+void GLCircularBuffer::bindRange(GLuint index, const Allocation& alloc) const
+{
+	glBindBufferRange(mTarget, index, mBuffer, alloc.offset, alloc.size);
+}
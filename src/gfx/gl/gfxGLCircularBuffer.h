@@ -0,0 +1,74 @@
+#ifndef GFXGLCIRCULARBUFFER_H_
+#define GFXGLCIRCULARBUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glad/gl.h>
+
+//-------------------------------------------------------------
+// Circular buffer
+//-------------------------------------------------------------
+// One buffer object split into a segment per frame in flight. With
+// ARB_buffer_storage the whole buffer is mapped once (persistent and
+// coherent) and every segment is guarded by a fence, so writes go
+// straight to memory the GPU reads. Without it the frame is staged in
+// a CPU shadow and uploaded with glBufferSubData on flush().
+class GLCircularBuffer
+{
+public:
+	enum { MaxFramesInFlight = 3 };
+
+	struct Allocation
+	{
+		void*		ptr;		///< Write pointer, valid until endFrame().
+		GLintptr	offset;		///< Offset into the buffer, for glBindBufferRange.
+		GLsizeiptr	size;
+
+		Allocation() : ptr(NULL), offset(0), size(0) {}
+	};
+
+	GLCircularBuffer();
+	~GLCircularBuffer();
+
+	// frameSize is the space available to a single frame.
+	bool init(GLenum target, GLsizeiptr frameSize);
+	void destroy();
+
+	void beginFrame();						// waits for the segment we are about to reuse.
+	bool allocate(GLsizeiptr size, Allocation& out);
+	void flush();							// make writes so far visible to the GPU.
+	void endFrame();
+
+	template<class T> T* allocate(Allocation& out)
+	{
+		return allocate(sizeof(T), out) ? static_cast<T*>(out.ptr) : NULL;
+	}
+
+	void bindRange(GLuint index, const Allocation& alloc) const;
+
+	GLuint		getBuffer() const { return mBuffer; }
+	GLsizeiptr	getFrameSize() const { return mFrameSize; }
+	GLsizeiptr	getFrameUsed() const { return mHead; }
+	bool		isPersistent() const { return mPersistent; }
+
+private:
+	GLintptr	getSegmentOffset() const { return (GLintptr)mSegment * mFrameSize; }
+
+	GLenum		mTarget;
+	GLuint		mBuffer;
+	GLsizeiptr	mFrameSize;
+	GLint		mAlignment;
+	bool		mPersistent;
+
+	uint8_t*	mMapped;				///< Persistent mapping of the whole buffer.
+	std::vector<uint8_t> mShadow;		///< Staging for the non persistent path.
+
+	GLsync		mFences[MaxFramesInFlight];
+	uint32_t	mSegment;
+	GLsizeiptr	mHead;
+	GLsizeiptr	mFlushed;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "gfx/gl/gfxGLCommandExecutor.h"
+#include "gfx/gl/gfxGLVertexLayout.h"
+
+static GLenum getGLPrimitive(GFXPrimitive primitive)
+{
+	switch (primitive)
+	{
+	case GFXPrimitiveLines:		return GL_LINES;
+	case GFXPrimitivePoints:	return GL_POINTS;
+	default:					return GL_TRIANGLES;
+	}
+}
+
+GLCommandExecutor::GLCommandExecutor()
+{
+	mLayouts = NULL;
+	mDrawCount = 0;
+	mCommandCount = 0;
+}
+
+void GLCommandExecutor::init(GLVertexLayoutCache* layouts)
+{
+	mLayouts = layouts;
+	resetStats();
+}
+
+void GLCommandExecutor::resetStats()
+{
+	mDrawCount = 0;
+	mCommandCount = 0;
+}
+
+void GLCommandExecutor::execute(const GFXCommandBuffer* buffers, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+		execute(buffers[i]);
+}
+
+void GLCommandExecutor::execute(const GFXCommandBuffer& buffer)
+{
+	// a buffer that ran out of memory is missing commands, replaying the
+	// part that made it in would draw with the wrong state.
+	if (buffer.hasFailed())
+		return;
+
+	for (const GFXCommand* command = buffer.getFirst(); command; command = command->next)
+	{
+		mCommandCount++;
+		switch (command->type)
+		{
+		case GFXCommandSetProgram:
+		{
+			const GFXSetProgramCommand* setProgram = (const GFXSetProgramCommand*)command;
+			glUseProgram(setProgram->program);
+			break;
+		}
+
+		case GFXCommandSetVertexLayout:
+		{
+			const GFXSetVertexLayoutCommand* setLayout = (const GFXSetVertexLayoutCommand*)command;
+			mLayouts->bind(*setLayout->format, setLayout->buffers, NULL, setLayout->indexBuffer);
+			break;
+		}
+
+		case GFXCommandSetConstants:
+		{
+			const GFXSetConstantsCommand* setConstants = (const GFXSetConstantsCommand*)command;
+			glBindBufferRange(GL_UNIFORM_BUFFER, setConstants->binding, setConstants->buffer, (GLintptr)setConstants->offset, (GLsizeiptr)setConstants->size);
+			break;
+		}
+
+		case GFXCommandDrawIndexed:
+		{
+			const GFXDrawIndexedCommand* draw = (const GFXDrawIndexedCommand*)command;
+			if (draw->instanceCount == 0)
+				break;
+
+			const GLenum mode = getGLPrimitive(draw->primitive);
+			const GLenum indexType = draw->indexSize == 4 ? GL_UNSIGNED_INT : (draw->indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE);
+			const void* offset = (const void*)(uintptr_t)(draw->firstIndex * draw->indexSize);
+
+			if (draw->instanceCount > 1)
+			{
+				if (draw->baseVertex)
+					glDrawElementsInstancedBaseVertex(mode, draw->indexCount, indexType, offset, draw->instanceCount, draw->baseVertex);
+				else
+					glDrawElementsInstanced(mode, draw->indexCount, indexType, offset, draw->instanceCount);
+			}
+			else if (draw->baseVertex)
+				glDrawElementsBaseVertex(mode, draw->indexCount, indexType, offset, draw->baseVertex);
+			else
+				glDrawElements(mode, draw->indexCount, indexType, offset);
+
+			mDrawCount++;
+			break;
+		}
+		}
+	}
+}
@@ -0,0 +1,40 @@
+#ifndef GFXGLCOMMANDEXECUTOR_H_
+#define GFXGLCOMMANDEXECUTOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <glad/gl.h>
+
+#include "gfx/gfxCommandBuffer.h"
+
+class GLVertexLayoutCache;
+
+//-------------------------------------------------------------
+// GL command executor
+//-------------------------------------------------------------
+// Replays recorded command buffers on the thread that owns the
+// context. Buffers go out in the order they're passed, so recording
+// can be split across threads by slicing the work and handing the
+// slices' buffers over in slice order.
+class GLCommandExecutor
+{
+public:
+	GLCommandExecutor();
+
+	void init(GLVertexLayoutCache* layouts);
+
+	void execute(const GFXCommandBuffer& buffer);
+	void execute(const GFXCommandBuffer* buffers, uint32_t count);
+
+	uint32_t getDrawCount() const { return mDrawCount; }		///< since the last resetStats().
+	uint32_t getCommandCount() const { return mCommandCount; }
+	void resetStats();
+
+private:
+	GLVertexLayoutCache*	mLayouts;
+	uint32_t				mDrawCount;
+	uint32_t				mCommandCount;
+};
+
+#endif
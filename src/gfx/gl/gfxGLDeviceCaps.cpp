@@ -0,0 +1,214 @@
+#include "gfx/gl/gfxGLDeviceCaps.h"
+#include "gfx/gl/gfxGLUtils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const uint64_t FNVOffset64 = 14695981039346656037ull;
+static const uint64_t FNVPrime64 = 1099511628211ull;
+
+static const uint32_t FileMagic = 0x50434447;	///< 'GDCP'
+static const uint32_t FileVersion = 1;
+
+struct CapsFileHeader
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint32_t	capsSize;		///< sizeof(GFXDeviceCaps), catches a forgotten version bump.
+	uint32_t	pad;
+	uint64_t	driverHash;
+};
+
+static uint64_t hashString(uint64_t hash, const char* str)
+{
+	// include the length so "ab" + "c" and "a" + "bc" differ.
+	uint32_t length = str ? (uint32_t)strlen(str) : 0;
+	const uint8_t* bytes = (const uint8_t*)&length;
+	for (size_t i = 0; i < sizeof(length); i++)
+	{
+		hash ^= bytes[i];
+		hash *= FNVPrime64;
+	}
+	for (uint32_t i = 0; i < length; i++)
+	{
+		hash ^= (uint8_t)str[i];
+		hash *= FNVPrime64;
+	}
+	return hash;
+}
+
+static void copyString(char* dst, size_t size, const char* src)
+{
+	strncpy(dst, src ? src : "", size - 1);
+	dst[size - 1] = 0;
+}
+
+// the strings that tell drivers apart, the whole strings are hashed in
+// case the copies are cut short.
+static void getIdentity(GFXDeviceCaps& caps)
+{
+	const char* vendor = (const char*)glGetString(GL_VENDOR);
+	const char* renderer = (const char*)glGetString(GL_RENDERER);
+	const char* version = (const char*)glGetString(GL_VERSION);
+
+	copyString(caps.vendor, sizeof(caps.vendor), vendor);
+	copyString(caps.renderer, sizeof(caps.renderer), renderer);
+	copyString(caps.version, sizeof(caps.version), version);
+	caps.driverHash = hashString(hashString(hashString(FNVOffset64, vendor), renderer), version);
+}
+
+static int32_t getInteger(GLenum name)
+{
+	GLint value = 0;
+	glGetIntegerv(name, &value);
+	return value;
+}
+
+void gglProbeDeviceCaps(GFXDeviceCaps& caps)
+{
+	caps = GFXDeviceCaps();
+	getIdentity(caps);
+
+	caps.versionMajor = (uint32_t)getInteger(GL_MAJOR_VERSION);
+	caps.versionMinor = (uint32_t)getInteger(GL_MINOR_VERSION);
+
+	const bool gl43 = gglHasExtension(VERSION_4_3) != 0;
+	uint32_t features = 0;
+	if (gglHasExtension(EXT_texture_filter_anisotropic) || gglHasExtension(ARB_texture_filter_anisotropic))
+		features |= GFXFeatureAnisotropy;
+	if (gglHasExtension(ARB_buffer_storage))
+		features |= GFXFeatureBufferStorage;
+	if (gglHasExtension(ARB_texture_storage) || gglHasExtension(VERSION_4_2))
+		features |= GFXFeatureTextureStorage;
+	if (gglHasExtension(ARB_copy_image) || gl43)
+		features |= GFXFeatureCopyImage;
+	if (gglHasExtension(ARB_vertex_attrib_binding) || gl43)
+		features |= GFXFeatureVertexAttribBinding;
+	if (gglHasExtension(ARB_compute_shader) || gl43)
+		features |= GFXFeatureComputeShader;
+	if (gglHasExtension(ARB_shader_storage_buffer_object) || gl43)
+		features |= GFXFeatureShaderStorage;
+	if (gglHasExtension(ARB_multi_draw_indirect) || gl43)
+		features |= GFXFeatureMultiDrawIndirect;
+	if (gglHasExtension(KHR_parallel_shader_compile) || gglHasExtension(ARB_parallel_shader_compile))
+		features |= GFXFeatureParallelCompile;
+	if (gglHasExtension(KHR_debug) || gl43)
+		features |= GFXFeatureDebugOutput;
+	if (gglHasExtension(ARB_get_program_binary) || gglHasExtension(VERSION_4_1))
+	{
+		caps.programBinaryFormats = getInteger(GL_NUM_PROGRAM_BINARY_FORMATS);
+		if (caps.programBinaryFormats > 0)
+			features |= GFXFeatureProgramBinary;
+	}
+	caps.features = features;
+
+	caps.maxTextureSize = getInteger(GL_MAX_TEXTURE_SIZE);
+	caps.maxVertexAttribs = getInteger(GL_MAX_VERTEX_ATTRIBS);
+	caps.maxUniformBlockSize = getInteger(GL_MAX_UNIFORM_BLOCK_SIZE);
+	caps.maxUniformBufferBindings = getInteger(GL_MAX_UNIFORM_BUFFER_BINDINGS);
+	caps.uniformBufferAlignment = getInteger(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT);
+
+	if (caps.has(GFXFeatureShaderStorage))
+	{
+		caps.maxShaderStorageBlockSize = getInteger(GL_MAX_SHADER_STORAGE_BLOCK_SIZE);
+		caps.maxShaderStorageBindings = getInteger(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS);
+		caps.shaderStorageAlignment = getInteger(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT);
+		caps.maxVertexShaderStorageBlocks = getInteger(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS);
+	}
+
+	if (caps.has(GFXFeatureComputeShader))
+		caps.maxComputeInvocations = getInteger(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS);
+
+	caps.maxAnisotropy = 1.0f;
+	if (caps.has(GFXFeatureAnisotropy))
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &caps.maxAnisotropy);
+}
+
+bool gglSaveDeviceCaps(const char* path, const GFXDeviceCaps& caps)
+{
+	FILE* file = fopen(path, "wb");
+	if (!file)
+	{
+		printf("Can't write device caps %s.\n", path);
+		return false;
+	}
+
+	CapsFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.magic = FileMagic;
+	header.version = FileVersion;
+	header.capsSize = sizeof(GFXDeviceCaps);
+	header.driverHash = caps.driverHash;
+
+	const bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&caps, sizeof(caps), 1, file) == 1;
+	fclose(file);
+
+	if (!written)
+	{
+		printf("Can't write device caps %s.\n", path);
+		remove(path);
+	}
+	return written;
+}
+
+bool gglLoadDeviceCaps(const char* path, GFXDeviceCaps& caps)
+{
+	GFXDeviceCaps current;
+	getIdentity(current);
+
+	FILE* file = path ? fopen(path, "rb") : NULL;
+	if (file)
+	{
+		CapsFileHeader header;
+		GFXDeviceCaps saved;
+		bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+			header.magic == FileMagic && header.version == FileVersion && header.capsSize == sizeof(GFXDeviceCaps) &&
+			header.driverHash == current.driverHash &&
+			fread(&saved, sizeof(saved), 1, file) == 1;
+		fclose(file);
+
+		// the strings too, a hash alone could hand another driver's caps over.
+		if (valid && saved.driverHash == current.driverHash && strcmp(saved.vendor, current.vendor) == 0 &&
+			strcmp(saved.renderer, current.renderer) == 0 && strcmp(saved.version, current.version) == 0)
+		{
+			caps = saved;
+			return true;
+		}
+	}
+
+	gglProbeDeviceCaps(caps);
+	if (path)
+		gglSaveDeviceCaps(path, caps);
+	return false;
+}
+
+void gglPrintDeviceCaps(const GFXDeviceCaps& caps)
+{
+	printf("Renderer: %s, %s\n", caps.renderer, caps.vendor);
+	printf("Capabilities:\n");
+	printf("\tSupports: OPENGL %d.%d (%s)\n", caps.versionMajor, caps.versionMinor, caps.version);
+	printf("\tMax Texture Size: %d\n", caps.maxTextureSize);
+	printf("\tUniform blocks: %d bytes, %d bindings, offsets aligned to %d.\n",
+		caps.maxUniformBlockSize, caps.maxUniformBufferBindings, caps.uniformBufferAlignment);
+
+	if (caps.has(GFXFeatureAnisotropy))
+		printf("\tAnisotropic filtering supported, up to %.0fx.\n", caps.maxAnisotropy);
+	if (caps.has(GFXFeatureBufferStorage))
+		printf("\tBuffer storage supported.\n");
+	if (caps.has(GFXFeatureTextureStorage))
+		printf("\tTexture storage supported.\n");
+	if (caps.has(GFXFeatureCopyImage))
+		printf("\tCopy image supported.\n");
+	if (caps.has(GFXFeatureVertexAttribBinding))
+		printf("\tVertex attrib binding supported.\n");
+	if (caps.has(GFXFeatureShaderStorage))
+		printf("\tShader storage supported, %d bindings.\n", caps.maxShaderStorageBindings);
+	if (caps.has(GFXFeatureComputeShader))
+		printf("\tCompute shaders supported, %d invocations a group.\n", caps.maxComputeInvocations);
+	if (caps.has(GFXFeatureMultiDrawIndirect))
+		printf("\tMulti draw indirect supported.\n");
+	if (caps.has(GFXFeatureParallelCompile))
+		printf("\tParallel shader compile supported.\n");
+	if (caps.has(GFXFeatureProgramBinary))
+		printf("\tProgram binaries supported, %d formats.\n", caps.programBinaryFormats);
+}
@@ -0,0 +1,30 @@
+#ifndef GFXGLDEVICECAPS_H_
+#define GFXGLDEVICECAPS_H_
+
+#include "gfx/gfxDevice.h"
+
+//-------------------------------------------------------------
+// Device capability cache
+//-------------------------------------------------------------
+// Probing means a glGet per limit and a check per extension, against
+// a context that's only just been made. The result only changes with
+// the driver, so gglLoadDeviceCaps() saves it to a file stamped with
+// the vendor, renderer and version strings. On a warm start those
+// three strings are the only thing asked of the driver. A missing
+// file, another driver or an old FileVersion probes again and
+// overwrites the file.
+//
+// All of these need the context current and GL loaded.
+
+// returns true when the caps came from path. A NULL path always
+// probes and saves nothing.
+bool gglLoadDeviceCaps(const char* path, GFXDeviceCaps& caps);
+
+// queries everything, for the current context.
+void gglProbeDeviceCaps(GFXDeviceCaps& caps);
+
+bool gglSaveDeviceCaps(const char* path, const GFXDeviceCaps& caps);
+
+void gglPrintDeviceCaps(const GFXDeviceCaps& caps);
+
+#endif
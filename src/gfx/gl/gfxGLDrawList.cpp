@@ -0,0 +1,236 @@
+#include "gfx/gl/gfxGLDrawList.h"
+#include "core/coreJobSystem.h"
+
+#include <string.h>
+
+static uint32_t getIndexSize(GLenum indexType)
+{
+	switch (indexType)
+	{
+	case GL_UNSIGNED_BYTE:	return 1;
+	case GL_UNSIGNED_SHORT:	return 2;
+	default:				return 4;
+	}
+}
+
+static GFXPrimitive getPrimitive(GLenum mode)
+{
+	switch (mode)
+	{
+	case GL_LINES:	return GFXPrimitiveLines;
+	case GL_POINTS:	return GFXPrimitivePoints;
+	default:		return GFXPrimitiveTriangles;
+	}
+}
+
+GLDrawList::GLDrawList()
+{
+	mConstantsBinding = 0;
+	mJobs = NULL;
+	mSliceCount = 0;
+	memset(&mSliceStats, 0, sizeof(mSliceStats));
+	memset(&mStats, 0, sizeof(mStats));
+}
+
+GLDrawList::~GLDrawList()
+{
+	destroy();
+}
+
+void GLDrawList::init(GLVertexLayoutCache* layouts, GLuint constantsBinding, CoreJobSystem* jobs)
+{
+	mConstantsBinding = constantsBinding;
+	mJobs = jobs;
+	mList.setJobSystem(jobs);
+	mExecutor.init(layouts);
+
+	for (uint32_t i = 0; i < MaxRecordSlices; i++)
+		mBuffers[i].init();
+
+	clear();
+}
+
+void GLDrawList::destroy()
+{
+	for (uint32_t i = 0; i < MaxRecordSlices; i++)
+		mBuffers[i].destroy();
+
+	mList.clear();
+	mItems.clear();
+	mProgramIds.clear();
+	mLayoutIds.clear();
+	mSliceCount = 0;
+}
+
+void GLDrawList::clear()
+{
+	mList.clear();
+	mItems.clear();
+}
+
+uint64_t GLDrawList::getLayoutHash(const GLDrawItem& item)
+{
+	// 64 bit FNV-1a over the format hash and the buffers.
+	uint64_t hash = 14695981039346656037ull;
+	uint32_t words[2 + GFXVertexFormat::MaxStreams];
+	words[0] = item.format->getHash();
+	words[1] = item.indexBuffer;
+	for (uint32_t s = 0; s < GFXVertexFormat::MaxStreams; s++)
+		words[2 + s] = item.buffers[s];
+
+	const uint8_t* bytes = (const uint8_t*)words;
+	for (size_t i = 0; i < sizeof(words); i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+void GLDrawList::add(const GLDrawItem& item, uint32_t pass, float depth)
+{
+	std::unordered_map<GLuint, uint32_t>::iterator program = mProgramIds.find(item.program);
+	if (program == mProgramIds.end())
+		program = mProgramIds.insert(std::make_pair(item.program, (uint32_t)mProgramIds.size())).first;
+
+	const uint64_t layoutHash = getLayoutHash(item);
+	std::unordered_map<uint64_t, uint32_t>::iterator layout = mLayoutIds.find(layoutHash);
+	if (layout == mLayoutIds.end())
+		layout = mLayoutIds.insert(std::make_pair(layoutHash, (uint32_t)mLayoutIds.size())).first;
+
+	mList.add(GFXDrawList::makeKey(pass, program->second, layout->second, item.material, depth), (uint32_t)mItems.size());
+	mItems.push_back(item);
+}
+
+bool GLDrawList::sameLayout(const GLDrawItem& a, const GLDrawItem& b)
+{
+	return (a.format == b.format || *a.format == *b.format) && a.indexBuffer == b.indexBuffer &&
+		memcmp(a.buffers, b.buffers, sizeof(a.buffers)) == 0;
+}
+
+bool GLDrawList::sameConstants(const GLDrawItem& a, const GLDrawItem& b)
+{
+	return a.constantsBuffer == b.constantsBuffer && a.constantsOffset == b.constantsOffset && a.constantsSize == b.constantsSize;
+}
+
+void GLDrawList::recordDraw(GFXCommandBuffer& buffer, const GLDrawItem& item, uint32_t indexCount)
+{
+	buffer.drawIndexed(getPrimitive(item.mode), getIndexSize(item.indexType), indexCount, item.firstIndex, item.baseVertex, item.instanceCount);
+}
+
+void GLDrawList::recordSlice(uint32_t slice, uint32_t begin, uint32_t end)
+{
+	GFXCommandBuffer& buffer = mBuffers[slice];
+	SliceStats& stats = mSliceStats[slice];
+	buffer.reset();
+	memset(&stats, 0, sizeof(stats));
+
+	// every slice starts from unknown state, the replay can't assume
+	// anything about what the previous slice left bound.
+	const GLDrawItem* previous = NULL;
+	const GLDrawItem* pending = NULL;
+	uint32_t pendingCount = 0;
+	for (uint32_t i = begin; i < end; i++)
+	{
+		const GLDrawItem& item = mItems[mList.getItem(i)];
+
+		bool programChange = !previous || previous->program != item.program;
+		bool layoutChange = !previous || !sameLayout(*previous, item);
+		bool constantsChange = !previous || !sameConstants(*previous, item);
+
+		// same state and the index range picks up where the last one
+		// stopped, grow the pending draw.
+		if (pending && !programChange && !layoutChange && !constantsChange &&
+			item.mode == pending->mode && item.indexType == pending->indexType &&
+			item.baseVertex == pending->baseVertex && item.instanceCount == pending->instanceCount &&
+			item.firstIndex == pending->firstIndex + pendingCount)
+		{
+			pendingCount += item.indexCount;
+			stats.merged++;
+			previous = &item;
+			continue;
+		}
+
+		if (pending)
+			recordDraw(buffer, *pending, pendingCount);
+
+		if (programChange)
+		{
+			buffer.setProgram(item.program);
+			stats.programChanges++;
+		}
+
+		if (layoutChange)
+		{
+			buffer.setVertexLayout(item.format, item.buffers, item.indexBuffer);
+			stats.layoutChanges++;
+		}
+
+		if (constantsChange && item.constantsBuffer)
+			buffer.setConstants(mConstantsBinding, item.constantsBuffer, item.constantsOffset, item.constantsSize);
+
+		pending = &item;
+		pendingCount = item.indexCount;
+		previous = &item;
+	}
+
+	if (pending)
+		recordDraw(buffer, *pending, pendingCount);
+}
+
+void GLDrawList::recordSlices(void* data, uint32_t first, uint32_t last)
+{
+	GLDrawList* list = (GLDrawList*)data;
+	const uint32_t count = list->mList.getCount();
+	const uint32_t perSlice = (count + list->mSliceCount - 1) / list->mSliceCount;
+	for (uint32_t s = first; s < last; s++)
+	{
+		const uint32_t begin = s * perSlice < count ? s * perSlice : count;
+		const uint32_t end = begin + perSlice < count ? begin + perSlice : count;
+		list->recordSlice(s, begin, end);
+	}
+}
+
+uint32_t GLDrawList::record()
+{
+	memset(&mStats, 0, sizeof(mStats));
+	mSliceCount = 0;
+
+	const uint32_t count = mList.getCount();
+	if (!count)
+		return 0;
+
+	mList.sort();
+
+	const uint32_t threads = mJobs ? mJobs->getThreadCount() : 1;
+	uint32_t slices = (count + MinDrawsPerSlice - 1) / MinDrawsPerSlice;
+	if (slices > threads)
+		slices = threads;
+	if (slices > (uint32_t)MaxRecordSlices)
+		slices = MaxRecordSlices;
+
+	mSliceCount = slices;
+	if (slices > 1)
+		mJobs->parallelFor(slices, 1, recordSlices, this);
+	else
+		recordSlices(this, 0, 1);
+
+	for (uint32_t s = 0; s < slices; s++)
+	{
+		mStats.merged += mSliceStats[s].merged;
+		mStats.programChanges += mSliceStats[s].programChanges;
+		mStats.layoutChanges += mSliceStats[s].layoutChanges;
+	}
+
+	return slices;
+}
+
+uint32_t GLDrawList::submit()
+{
+	mExecutor.resetStats();
+	if (!record())
+		return 0;
+
+	mExecutor.execute(mBuffers, mSliceCount);
+	return mExecutor.getDrawCount();
+}
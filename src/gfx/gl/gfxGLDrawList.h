@@ -0,0 +1,122 @@
+#ifndef GFXGLDRAWLIST_H_
+#define GFXGLDRAWLIST_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#include <glad/gl.h>
+
+#include "gfx/gfxDrawList.h"
+#include "gfx/gfxVertexFormat.h"
+#include "gfx/gfxCommandBuffer.h"
+#include "gfx/gl/gfxGLCommandExecutor.h"
+
+class GLVertexLayoutCache;
+class CoreJobSystem;
+
+// Everything one indexed draw needs. The format has to outlive the
+// frame's submit().
+struct GLDrawItem
+{
+	GLuint					program;
+	const GFXVertexFormat*	format;
+	GLuint					buffers[GFXVertexFormat::MaxStreams];
+	GLuint					indexBuffer;
+	GLenum					mode;
+	GLenum					indexType;
+	uint32_t				indexCount;
+	uint32_t				firstIndex;
+	int32_t					baseVertex;
+	uint32_t				instanceCount;
+	uint32_t				material;			///< sort id, draws with equal ids sort together.
+	GLuint					constantsBuffer;	///< per draw uniform block range, 0 for none.
+	GLintptr				constantsOffset;
+	GLsizeiptr				constantsSize;
+};
+
+//-------------------------------------------------------------
+// GL draw list
+//-------------------------------------------------------------
+// Collects a frame's draws, sorts them by state through GFXDrawList
+// and submits them in order. Program and vertex layout sort ids are
+// handed out per distinct program / format plus buffers the first
+// time they're seen and stay stable from frame to frame.
+//
+// The sorted list is cut into contiguous slices that are recorded into
+// one command buffer each, a job per slice, and the buffers are
+// replayed in slice order on the calling thread. Only
+// the replay touches GL.
+//
+// Recording only emits what differs from the previous draw of the
+// slice, and consecutive draws with identical state over adjacent
+// index ranges become a single draw.
+class GLDrawList
+{
+public:
+	enum
+	{
+		MaxRecordSlices = 16,
+		MinDrawsPerSlice = 256,	///< smaller slices aren't worth a job.
+	};
+
+	GLDrawList();
+	~GLDrawList();
+
+	// constantsBinding is the uniform block binding the per draw
+	// constants go to. jobs sorts and records, NULL does it all on the
+	// calling thread.
+	void init(GLVertexLayoutCache* layouts, GLuint constantsBinding, CoreJobSystem* jobs);
+	void destroy();
+
+	void clear();
+	void add(const GLDrawItem& item, uint32_t pass, float depth);
+
+	// sorts and records the command buffers, from the job system's
+	// owning thread or a job. Returns the number of buffers filled.
+	uint32_t record();
+
+	// records and replays, context thread only. Returns the number of
+	// draw calls issued.
+	uint32_t submit();
+
+	uint32_t getItemCount() const { return (uint32_t)mItems.size(); }
+	uint32_t getDrawCount() const { return mExecutor.getDrawCount(); }
+	uint32_t getMergedCount() const { return mStats.merged; }			///< draws folded into the previous one.
+	uint32_t getProgramChanges() const { return mStats.programChanges; }
+	uint32_t getLayoutChanges() const { return mStats.layoutChanges; }
+	uint32_t getSliceCount() const { return mSliceCount; }
+
+private:
+	struct SliceStats
+	{
+		uint32_t	merged;
+		uint32_t	programChanges;
+		uint32_t	layoutChanges;
+	};
+
+	static bool sameLayout(const GLDrawItem& a, const GLDrawItem& b);
+	static bool sameConstants(const GLDrawItem& a, const GLDrawItem& b);
+	static uint64_t getLayoutHash(const GLDrawItem& item);
+
+	static void recordSlices(void* data, uint32_t first, uint32_t last);
+	void recordSlice(uint32_t slice, uint32_t begin, uint32_t end);
+	void recordDraw(GFXCommandBuffer& buffer, const GLDrawItem& item, uint32_t indexCount);
+
+	GLuint					mConstantsBinding;
+	GFXDrawList				mList;
+	std::vector<GLDrawItem>	mItems;
+	CoreJobSystem*			mJobs;
+
+	std::unordered_map<GLuint, uint32_t>	mProgramIds;
+	std::unordered_map<uint64_t, uint32_t>	mLayoutIds;
+
+	GFXCommandBuffer		mBuffers[MaxRecordSlices];
+	SliceStats				mSliceStats[MaxRecordSlices];
+	uint32_t				mSliceCount;
+	GLCommandExecutor		mExecutor;
+	SliceStats				mStats;
+};
+
+#endif
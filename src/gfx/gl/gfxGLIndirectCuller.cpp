@@ -0,0 +1,237 @@
+#include "gfx/gl/gfxGLIndirectCuller.h"
+#include "gfx/gl/gfxGLUtils.h"
+#include "math/frustum.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static constexpr GFXNameHash FrustumPlanesName = GFXHashName("frustumPlanes");
+static constexpr GFXNameHash ObjectCountName = GFXHashName("objectCount");
+
+GLIndirectCuller::GLIndirectCuller()
+{
+	mObjectBuffer = 0;
+	mDrawObjectBuffer = 0;
+	mMeshBuffer = 0;
+	mCommandBuffer = 0;
+	mStatsBuffer = 0;
+	mObjectIdBuffer = 0;
+	mMaxObjects = 0;
+	mObjectCount = 0;
+	mMeshesDirty = false;
+}
+
+GLIndirectCuller::~GLIndirectCuller()
+{
+	destroy();
+}
+
+bool GLIndirectCuller::isSupported()
+{
+	if (!gglHasExtension(VERSION_4_3) &&
+		!(gglHasExtension(ARB_compute_shader) && gglHasExtension(ARB_shader_storage_buffer_object) && gglHasExtension(ARB_multi_draw_indirect)))
+		return false;
+
+	// GL 4.3 allows zero storage blocks in the vertex stage.
+	GLint vertexBlocks = 0;
+	glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexBlocks);
+	return vertexBlocks > 0;
+}
+
+bool GLIndirectCuller::init(const GLProgramReflection& cullProgram, uint32_t maxObjects)
+{
+	destroy();
+
+	if (!cullProgram.getProgram())
+		return false;
+
+	setCullProgram(cullProgram);
+	mMaxObjects = maxObjects;
+
+	GLuint buffers[6];
+	glGenBuffers(6, buffers);
+	mObjectBuffer = buffers[0];
+	mDrawObjectBuffer = buffers[1];
+	mMeshBuffer = buffers[2];
+	mCommandBuffer = buffers[3];
+	mStatsBuffer = buffers[4];
+	mObjectIdBuffer = buffers[5];
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mObjectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maxObjects * sizeof(CullObject), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDrawObjectBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maxObjects * sizeof(DrawObject), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCommandBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, maxObjects * sizeof(DrawCommand), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mStatsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(uint32_t), NULL, GL_DYNAMIC_READ);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// object ids never change, baseInstance picks the right one.
+	std::vector<uint32_t> ids(maxObjects);
+	for (uint32_t i = 0; i < maxObjects; i++)
+		ids[i] = i;
+
+	glBindBuffer(GL_ARRAY_BUFFER, mObjectIdBuffer);
+	glBufferData(GL_ARRAY_BUFFER, maxObjects * sizeof(uint32_t), &ids[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return true;
+}
+
+void GLIndirectCuller::setCullProgram(const GLProgramReflection& cullProgram)
+{
+	mCullProgram = cullProgram;
+}
+
+void GLIndirectCuller::destroy()
+{
+	if (mObjectBuffer)
+	{
+		GLuint buffers[6] = { mObjectBuffer, mDrawObjectBuffer, mMeshBuffer, mCommandBuffer, mStatsBuffer, mObjectIdBuffer };
+		glDeleteBuffers(6, buffers);
+	}
+
+	mObjectBuffer = mDrawObjectBuffer = mMeshBuffer = mCommandBuffer = mStatsBuffer = mObjectIdBuffer = 0;
+	mMaxObjects = 0;
+	mObjectCount = 0;
+	mMeshes.clear();
+	mCullProgram.clear();
+	mObjects.clear();
+}
+
+uint32_t GLIndirectCuller::addMesh(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex)
+{
+	MeshDraw mesh;
+	mesh.indexCount = indexCount;
+	mesh.firstIndex = firstIndex;
+	mesh.baseVertex = baseVertex;
+	mesh.pad = 0;
+	mMeshes.push_back(mesh);
+	mMeshesDirty = true;
+
+	return (uint32_t)mMeshes.size() - 1;
+}
+
+void GLIndirectCuller::uploadMeshes()
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mMeshBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, mMeshes.size() * sizeof(MeshDraw), &mMeshes[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	mMeshesDirty = false;
+}
+
+void GLIndirectCuller::setObjects(uint32_t count, const CullObject* objects, const DrawObject* drawObjects)
+{
+	if (count > mMaxObjects)
+	{
+		printf("Indirect culler only holds %d objects, %d requested.\n", mMaxObjects, count);
+		count = mMaxObjects;
+	}
+
+	mObjectCount = count;
+	mObjects.assign(objects, objects + count);
+
+	if (!count)
+		return;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mObjectBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(CullObject), objects);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mDrawObjectBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(DrawObject), drawObjects);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GLIndirectCuller::cull(const Matrix4& viewProj)
+{
+	if (!mObjectCount || mMeshes.empty())
+		return;
+
+	if (mMeshesDirty)
+		uploadMeshes();
+
+	const uint32_t zero = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mStatsBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	Frustum frustum(viewProj);
+
+	glUseProgram(mCullProgram.getProgram());
+	mCullProgram.setUniform4fv(FrustumPlanesName, Frustum::PlaneCount, frustum.get());
+	mCullProgram.setUniform1ui(ObjectCountName, mObjectCount);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ObjectBinding, mObjectBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MeshBinding, mMeshBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CommandBinding, mCommandBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, StatsBinding, mStatsBuffer);
+
+	glDispatchCompute((mObjectCount + WorkGroupSize - 1) / WorkGroupSize, 1, 1);
+
+	// the commands are consumed as indirect arguments, and validate()
+	// and readVisibleCount() read the buffers back.
+	glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void GLIndirectCuller::draw(GLenum mode, GLenum indexType)
+{
+	if (!mObjectCount)
+		return;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DrawObjectBinding, mDrawObjectBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+	glMultiDrawElementsIndirect(mode, indexType, (void*)0, mObjectCount, sizeof(DrawCommand));
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GLIndirectCuller::addObjectIdAttribute(GFXVertexFormat& format, uint32_t stream)
+{
+	format.addElement(GFXAttribObjectId, GFXVertexUInt, 1, stream);
+	format.setStreamDivisor(stream, 1);
+}
+
+uint32_t GLIndirectCuller::readVisibleCount()
+{
+	uint32_t visible = 0;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mStatsBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(visible), &visible);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return visible;
+}
+
+bool GLIndirectCuller::validate(const Matrix4& viewProj)
+{
+	if (!mObjectCount)
+		return true;
+
+	std::vector<DrawCommand> commands(mObjectCount);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCommandBuffer);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, mObjectCount * sizeof(DrawCommand), &commands[0]);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	// run the same test on the cpu and compare.
+	Frustum frustum(viewProj);
+	uint32_t mismatches = 0;
+	uint32_t visible = 0;
+	for (uint32_t i = 0; i < mObjectCount; i++)
+	{
+		const CullObject& obj = mObjects[i];
+		const MeshDraw& mesh = mMeshes[obj.meshIndex];
+		bool cpuVisible = frustum.intersectsSphere(Vector3(obj.sphere[0], obj.sphere[1], obj.sphere[2]), obj.sphere[3]);
+		const DrawCommand& cmd = commands[i];
+
+		visible += cpuVisible ? 1 : 0;
+		if (cmd.instanceCount != (cpuVisible ? 1u : 0u) || cmd.count != mesh.indexCount ||
+			cmd.firstIndex != mesh.firstIndex || cmd.baseVertex != mesh.baseVertex || cmd.baseInstance != i)
+		{
+			if (mismatches < 8)
+				printf("Indirect cull mismatch on object %d: gpu %d, cpu %d.\n", i, cmd.instanceCount, cpuVisible ? 1 : 0);
+			mismatches++;
+		}
+	}
+
+	uint32_t gpuVisible = readVisibleCount();
+	printf("Indirect cull validation: %d of %d visible (gpu counted %d), %d mismatches.\n", visible, mObjectCount, gpuVisible, mismatches);
+
+	return mismatches == 0 && gpuVisible == visible;
+}
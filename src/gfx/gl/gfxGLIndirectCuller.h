@@ -0,0 +1,125 @@
+#ifndef GFXGLINDIRECTCULLER_H_
+#define GFXGLINDIRECTCULLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "gfx/gfxVertexFormat.h"
+#include "gfx/gl/gfxGLProgramReflection.h"
+
+class Matrix4;
+
+//-------------------------------------------------------------
+// GPU driven culling
+//-------------------------------------------------------------
+// Object bounds, transforms and tints live in shader storage buffers. Each
+// frame a compute shader tests every bounding sphere against the
+// frustum and writes one DrawElementsIndirectCommand per object
+// (instanceCount 0 when culled), then a single
+// glMultiDrawElementsIndirect call renders whatever survived.
+//
+// Every command uses baseInstance = object index, the vertex shader
+// gets it back through an instanced object id attribute and uses it to
+// fetch its transform and tint.
+class GLIndirectCuller
+{
+public:
+	// storage buffer bindings, must match the shaders.
+	enum
+	{
+		ObjectBinding = 0,
+		DrawObjectBinding = 1,
+		MeshBinding = 2,
+		CommandBinding = 3,
+		StatsBinding = 4,
+	};
+
+	enum { WorkGroupSize = 64 };
+
+	// std430 layouts, keep in sync with FrustumCullComputeShader.
+	struct CullObject
+	{
+		float		sphere[4];	///< world space center and radius.
+		uint32_t	meshIndex;
+		uint32_t	pad[3];
+	};
+
+	// what the vertex shader needs of an object, keep in sync with
+	// TransformIndirectVertexShader.
+	struct DrawObject
+	{
+		float		transform[16];
+		float		tint[4];	///< multiplies the vertex color.
+	};
+
+	struct MeshDraw
+	{
+		uint32_t	indexCount;
+		uint32_t	firstIndex;
+		int32_t		baseVertex;
+		uint32_t	pad;
+	};
+
+	struct DrawCommand
+	{
+		uint32_t	count;
+		uint32_t	instanceCount;
+		uint32_t	firstIndex;
+		int32_t		baseVertex;
+		uint32_t	baseInstance;
+	};
+
+	GLIndirectCuller();
+	~GLIndirectCuller();
+
+	// true when the context has compute, storage buffers in the vertex
+	// stage and multi draw indirect.
+	static bool isSupported();
+
+	bool init(const GLProgramReflection& cullProgram, uint32_t maxObjects);
+	void destroy();
+
+	// swap the compute program, e.g. after a shader reload.
+	void setCullProgram(const GLProgramReflection& cullProgram);
+
+	uint32_t addMesh(uint32_t indexCount, uint32_t firstIndex, int32_t baseVertex);
+	void setObjects(uint32_t count, const CullObject* objects, const DrawObject* drawObjects);
+
+	void cull(const Matrix4& viewProj);
+	void draw(GLenum mode, GLenum indexType);
+
+	// the object id attribute the vertex shader indexes with, added to
+	// a vertex format as the given stream. getObjectIdBuffer() feeds it.
+	static void addObjectIdAttribute(GFXVertexFormat& format, uint32_t stream);
+	GLuint getObjectIdBuffer() const { return mObjectIdBuffer; }
+
+	// reads back results, stalls the pipeline. Debugging only.
+	uint32_t readVisibleCount();
+	bool validate(const Matrix4& viewProj);
+
+	uint32_t getObjectCount() const { return mObjectCount; }
+
+private:
+	void uploadMeshes();
+
+	GLProgramReflection	mCullProgram;
+
+	GLuint		mObjectBuffer;
+	GLuint		mDrawObjectBuffer;
+	GLuint		mMeshBuffer;
+	GLuint		mCommandBuffer;
+	GLuint		mStatsBuffer;
+	GLuint		mObjectIdBuffer;
+
+	uint32_t	mMaxObjects;
+	uint32_t	mObjectCount;
+	bool		mMeshesDirty;
+
+	std::vector<MeshDraw>	mMeshes;
+	std::vector<CullObject>	mObjects;	///< CPU copy for validate().
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "gfx/gl/gfxGLInstanceBuffer.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+GLInstanceBuffer::GLInstanceBuffer()
+{
+	mBuffer = 0;
+	mMaxInstances = 0;
+	mCount = 0;
+	mDirty = false;
+}
+
+GLInstanceBuffer::~GLInstanceBuffer()
+{
+	destroy();
+}
+
+bool GLInstanceBuffer::init(uint32_t maxInstances)
+{
+	destroy();
+
+	mMaxInstances = maxInstances;
+	mInstances.resize(maxInstances);
+
+	const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (uint32_t i = 0; i < maxInstances; i++)
+		memcpy(mInstances[i].color, white, sizeof(white));
+
+	glGenBuffers(1, &mBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+	glBufferData(GL_ARRAY_BUFFER, maxInstances * sizeof(GFXInstanceData), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	return mBuffer != 0;
+}
+
+void GLInstanceBuffer::destroy()
+{
+	if (mBuffer)
+		glDeleteBuffers(1, &mBuffer);
+
+	mBuffer = 0;
+	mMaxInstances = 0;
+	mCount = 0;
+	mInstances.clear();
+}
+
+void GLInstanceBuffer::setCount(uint32_t count)
+{
+	if (count > mMaxInstances)
+	{
+		printf("Instance buffer only holds %d instances, %d requested.\n", mMaxInstances, count);
+		count = mMaxInstances;
+	}
+
+	mCount = count;
+	mDirty = true;
+}
+
+void GLInstanceBuffer::set(uint32_t index, const float model[16])
+{
+	memcpy(mInstances[index].model, model, sizeof(mInstances[index].model));
+	mDirty = true;
+}
+
+void GLInstanceBuffer::set(uint32_t index, const float model[16], const float color[4])
+{
+	memcpy(mInstances[index].model, model, sizeof(mInstances[index].model));
+	memcpy(mInstances[index].color, color, sizeof(mInstances[index].color));
+	mDirty = true;
+}
+
+void GLInstanceBuffer::upload()
+{
+	if (!mDirty || mCount == 0)
+		return;
+
+	// orphan the old storage so we never wait on draws still using it.
+	glBindBuffer(GL_ARRAY_BUFFER, mBuffer);
+	glBufferData(GL_ARRAY_BUFFER, mMaxInstances * sizeof(GFXInstanceData), NULL, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, mCount * sizeof(GFXInstanceData), &mInstances[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	mDirty = false;
+}
+
+void GLInstanceBuffer::addAttributes(GFXVertexFormat& format, uint32_t stream)
+{
+	// a mat4 attribute is fed as 4 vec4 columns.
+	for (uint32_t i = 0; i < 4; i++)
+		format.addElement(ModelAttribLocation + i, GFXVertexFloat, 4, stream);
+
+	format.addElement(ColorAttribLocation, GFXVertexFloat, 4, stream);
+	format.setStreamDivisor(stream, 1);
+
+	assert(format.getStride(stream) == sizeof(GFXInstanceData));
+}
+
+void GLInstanceBuffer::drawArrays(GLenum mode, GLint first, GLsizei vertCount)
+{
+	if (mCount)
+		glDrawArraysInstanced(mode, first, vertCount, mCount);
+}
+
+void GLInstanceBuffer::drawElements(GLenum mode, GLsizei indexCount, GLenum indexType, const void* indexOffset)
+{
+	if (mCount)
+		glDrawElementsInstanced(mode, indexCount, indexType, indexOffset, mCount);
+}
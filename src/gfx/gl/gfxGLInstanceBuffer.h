@@ -0,0 +1,70 @@
+#ifndef GFXGLINSTANCEBUFFER_H_
+#define GFXGLINSTANCEBUFFER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "gfx/gfxVertexFormat.h"
+
+// Per instance vertex data, one entry per drawn copy of the mesh.
+struct GFXInstanceData
+{
+	float model[16];	///< column major model matrix.
+	float color[4];		///< tint multiplied with the vertex color.
+};
+
+//-------------------------------------------------------------
+// Instance buffer
+//-------------------------------------------------------------
+// Holds an array of GFXInstanceData and feeds it to the vertex shader
+// as instanced attributes (divisor 1), so N copies of a mesh go out
+// in a single glDraw*Instanced call.
+class GLInstanceBuffer
+{
+public:
+	// attribute slots used by the instanced vertex shader, the matrix
+	// takes 4 consecutive locations.
+	enum
+	{
+		ModelAttribLocation = GFXAttribInstanceModel,
+		ColorAttribLocation = GFXAttribInstanceColor,
+	};
+
+	GLInstanceBuffer();
+	~GLInstanceBuffer();
+
+	// colors start out white, untinted instances just never set them.
+	bool init(uint32_t maxInstances);
+	void destroy();
+
+	void setCount(uint32_t count);
+	void set(uint32_t index, const float model[16]);
+	void set(uint32_t index, const float model[16], const float color[4]);
+	GFXInstanceData* getData() { return mInstances.empty() ? NULL : &mInstances[0]; }
+	void markDirty() { mDirty = true; }
+
+	// send dirty instance data to the gpu.
+	void upload();
+
+	// append the per instance attributes to a vertex format as the given
+	// stream, with divisor 1. The buffer goes in that stream's binding.
+	static void addAttributes(GFXVertexFormat& format, uint32_t stream);
+
+	void drawArrays(GLenum mode, GLint first, GLsizei vertCount);
+	void drawElements(GLenum mode, GLsizei indexCount, GLenum indexType, const void* indexOffset);
+
+	uint32_t getCount() const { return mCount; }
+	GLuint getBuffer() const { return mBuffer; }
+
+private:
+	GLuint		mBuffer;
+	uint32_t	mMaxInstances;
+	uint32_t	mCount;
+	bool		mDirty;
+	std::vector<GFXInstanceData> mInstances;
+};
+
+#endif
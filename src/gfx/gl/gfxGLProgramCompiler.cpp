@@ -0,0 +1,443 @@
+#include "gfx/gl/gfxGLProgramCompiler.h"
+#include "gfx/gl/gfxGLShaderCache.h"
+#include "gfx/gl/gfxGLUtils.h"
+
+#include <stdio.h>
+
+typedef std::chrono::high_resolution_clock CompileClock;
+
+//-------------------------------------------------------------
+// Program future
+//-------------------------------------------------------------
+bool GLProgramFuture::ready() const
+{
+	if (!mCompiler)
+		return false;
+
+	const GLProgramCompiler::Request& request = mCompiler->mRequests[mIndex];
+	if (request.state != GLProgramCompiler::RequestPending)
+		return true;
+
+	return mCompiler->isComplete(request);
+}
+
+bool GLProgramFuture::failed() const
+{
+	return !mCompiler || get() == 0;
+}
+
+GLuint GLProgramFuture::get() const
+{
+	if (!mCompiler)
+		return 0;
+
+	mCompiler->wait(mIndex);
+	return mCompiler->mRequests[mIndex].program;
+}
+
+//-------------------------------------------------------------
+// Program compiler
+//-------------------------------------------------------------
+GLProgramCompiler::GLProgramCompiler()
+{
+	mParallel = false;
+	mCache = NULL;
+	mPendingCount = 0;
+	mVariantHits = 0;
+	mSourceHits = 0;
+	mSubmitTime = mSubmitTime.zero();
+	mWaitTime = mWaitTime.zero();
+}
+
+GLProgramCompiler::~GLProgramCompiler()
+{
+	destroy();
+}
+
+void GLProgramCompiler::init(GLShaderCache* cache)
+{
+	mCache = cache;
+
+	// let the driver use as many threads as it likes.
+	if (gglHasExtension(KHR_parallel_shader_compile))
+	{
+		glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+		mParallel = true;
+	}
+	else if (gglHasExtension(ARB_parallel_shader_compile))
+	{
+		glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+		mParallel = true;
+	}
+}
+
+void GLProgramCompiler::destroy()
+{
+	for (size_t i = 0; i < mRequests.size(); i++)
+	{
+		Request& request = mRequests[i];
+		if (request.state == RequestPending)
+		{
+			for (uint32_t s = 0; s < request.stageCount; s++)
+				glDeleteShader(request.shaders[s]);
+			if (request.fence)
+				glDeleteSync(request.fence);
+		}
+
+		if (request.state != RequestReleased && request.program)
+			glDeleteProgram(request.program);
+	}
+
+	mRequests.clear();
+	mVariants.clear();
+	mSources.clear();
+	mPendingCount = 0;
+}
+
+GLProgramFuture GLProgramCompiler::submit(const char* vertexPath, const char* fragmentPath, const GFXShaderDefine* defines, uint32_t defineCount)
+{
+	const GLShaderStageDesc stages[2] = { { GL_VERTEX_SHADER, vertexPath }, { GL_FRAGMENT_SHADER, fragmentPath } };
+	return submit(stages, 2, defines, defineCount);
+}
+
+GLProgramFuture GLProgramCompiler::submitCompute(const char* computePath, const GFXShaderDefine* defines, uint32_t defineCount)
+{
+	const GLShaderStageDesc stage = { GL_COMPUTE_SHADER, computePath };
+	return submit(&stage, 1, defines, defineCount);
+}
+
+GLProgramFuture GLProgramCompiler::submit(const GLShaderStageDesc* stages, uint32_t stageCount, const GFXShaderDefine* defines, uint32_t defineCount)
+{
+	Request request;
+	request.stageCount = stageCount < (uint32_t)MaxStages ? stageCount : (uint32_t)MaxStages;
+	for (uint32_t s = 0; s < request.stageCount; s++)
+	{
+		request.types[s] = stages[s].type;
+		request.paths[s] = stages[s].path;
+	}
+
+	for (uint32_t i = 0; i < defineCount; i++)
+	{
+		request.defineNames.push_back(defines[i].name);
+		request.defineValues.push_back(defines[i].value ? defines[i].value : "");
+	}
+
+	return submitRequest(request, true);
+}
+
+GLProgramFuture GLProgramCompiler::rebuild(const GLProgramFuture& program)
+{
+	const Request& old = mRequests[program.mIndex];
+
+	Request request;
+	request.stageCount = old.stageCount;
+	for (uint32_t s = 0; s < old.stageCount; s++)
+	{
+		request.types[s] = old.types[s];
+		request.paths[s] = old.paths[s];
+	}
+	request.defineNames = old.defineNames;
+	request.defineValues = old.defineValues;
+
+	return submitRequest(request, false);
+}
+
+uint64_t GLProgramCompiler::computePermutationKey(const Request& request)
+{
+	uint64_t key = GFXShaderPreprocessor::hash(&request.stageCount, sizeof(request.stageCount));
+	for (uint32_t s = 0; s < request.stageCount; s++)
+	{
+		key = GFXShaderPreprocessor::hash(&request.types[s], sizeof(request.types[s]), key);
+		key = GFXShaderPreprocessor::hash(request.paths[s].c_str(), request.paths[s].size() + 1, key);
+	}
+
+	// define order doesn't matter, so their hashes are summed.
+	uint64_t defineSum = 0;
+	for (size_t i = 0; i < request.defineNames.size(); i++)
+	{
+		uint64_t h = GFXShaderPreprocessor::hash(request.defineNames[i].c_str(), request.defineNames[i].size() + 1);
+		defineSum += GFXShaderPreprocessor::hash(request.defineValues[i].c_str(), request.defineValues[i].size() + 1, h);
+	}
+
+	return GFXShaderPreprocessor::hash(&defineSum, sizeof(defineSum), key);
+}
+
+GLProgramFuture GLProgramCompiler::addRef(uint32_t index)
+{
+	mRequests[index].refs++;
+	return GLProgramFuture(this, index);
+}
+
+GLProgramFuture GLProgramCompiler::submitRequest(Request& request, bool lookupVariant)
+{
+	CompileClock::time_point start = CompileClock::now();
+
+	request.state = RequestFailed;
+	request.program = 0;
+	request.fence = NULL;
+	request.refs = 1;
+	request.sourceHash = 0;
+	request.cacheHash = 0;
+	for (uint32_t s = 0; s < MaxStages; s++)
+		request.shaders[s] = 0;
+
+	request.permutationKey = computePermutationKey(request);
+	if (lookupVariant)
+	{
+		std::unordered_map<uint64_t, uint32_t>::iterator it = mVariants.find(request.permutationKey);
+		if (it != mVariants.end())
+		{
+			mVariantHits++;
+			mSubmitTime += CompileClock::now() - start;
+			return addRef(it->second);
+		}
+	}
+
+	// expand every stage.
+	std::vector<GFXShaderDefine> defines(request.defineNames.size());
+	for (size_t i = 0; i < defines.size(); i++)
+	{
+		defines[i].name = request.defineNames[i].c_str();
+		defines[i].value = request.defineValues[i].empty() ? NULL : request.defineValues[i].c_str();
+	}
+
+	std::string sources[MaxStages];
+	bool expanded = true;
+	request.sourceHash = GFXShaderPreprocessor::hash(&request.stageCount, sizeof(request.stageCount));
+	for (uint32_t s = 0; s < request.stageCount && expanded; s++)
+	{
+		request.name += s ? "|" : "";
+		request.name += request.paths[s];
+
+		GFXShaderSource source;
+		expanded = mPreprocessor.process(request.paths[s].c_str(), defines.empty() ? NULL : &defines[0], (uint32_t)defines.size(), source);
+		sources[s].swap(source.text);
+		request.stageFiles[s] = source.files;
+
+		request.sourceHash = GFXShaderPreprocessor::hash(&request.types[s], sizeof(request.types[s]), request.sourceHash);
+		request.sourceHash = GFXShaderPreprocessor::hash(&source.hash, sizeof(source.hash), request.sourceHash);
+		for (size_t f = 0; f < source.files.size(); f++)
+		{
+			bool known = false;
+			for (size_t k = 0; k < request.files.size() && !known; k++)
+				known = request.files[k] == source.files[f];
+			if (!known)
+				request.files.push_back(source.files[f]);
+		}
+	}
+
+	// variants need their own cache entry.
+	for (size_t i = 0; i < request.defineNames.size(); i++)
+		request.name += "|" + request.defineNames[i] + "=" + request.defineValues[i];
+
+	const uint32_t index = (uint32_t)mRequests.size();
+	if (!expanded)
+	{
+		mRequests.push_back(request);
+		mSubmitTime += CompileClock::now() - start;
+		return GLProgramFuture(this, index);
+	}
+
+	// another permutation already expanded to the same code.
+	std::unordered_map<uint64_t, uint32_t>::iterator same = mSources.find(request.sourceHash);
+	if (same != mSources.end())
+	{
+		mSourceHits++;
+		mVariants[request.permutationKey] = same->second;
+		mSubmitTime += CompileClock::now() - start;
+		return addRef(same->second);
+	}
+
+	mVariants[request.permutationKey] = index;
+	mSources[request.sourceHash] = index;
+
+	// a cached binary skips the compile entirely.
+	if (mCache)
+	{
+		request.cacheHash = mCache->computeHash(sources, request.stageCount);
+		request.program = mCache->load(request.name.c_str(), request.cacheHash);
+		if (request.program)
+		{
+			printf("Loaded cached program : %s\n", request.name.c_str());
+			request.reflection.reflect(request.program);
+			request.state = RequestReady;
+			mRequests.push_back(request);
+			mSubmitTime += CompileClock::now() - start;
+			return GLProgramFuture(this, index);
+		}
+	}
+
+	// compile and link without asking for any status, the driver only
+	// has to sync when we do.
+	request.program = glCreateProgram();
+	for (uint32_t s = 0; s < request.stageCount; s++)
+	{
+		const char* source = sources[s].c_str();
+		request.shaders[s] = glCreateShader(request.types[s]);
+		glShaderSource(request.shaders[s], 1, &source, NULL);
+		glCompileShader(request.shaders[s]);
+		glAttachShader(request.program, request.shaders[s]);
+	}
+
+	if (mCache)
+		mCache->prepareProgram(request.program);
+	glLinkProgram(request.program);
+
+	// nothing to poll without the extension, the fence is the closest
+	// thing to a zero wait on the compile.
+	if (!mParallel)
+		request.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	request.state = RequestPending;
+	mRequests.push_back(request);
+	mPendingCount++;
+
+	mSubmitTime += CompileClock::now() - start;
+	return GLProgramFuture(this, index);
+}
+
+void GLProgramCompiler::release(GLProgramFuture& program)
+{
+	if (!program.isValid())
+		return;
+
+	const uint32_t index = program.mIndex;
+	program = GLProgramFuture();
+
+	Request& request = mRequests[index];
+	if (request.refs == 0 || --request.refs > 0)
+		return;
+
+	wait(index);
+	if (request.program)
+		glDeleteProgram(request.program);
+	request.program = 0;
+	request.reflection.clear();
+	request.state = RequestReleased;
+
+	// forget the lookups that lead here.
+	for (std::unordered_map<uint64_t, uint32_t>::iterator it = mVariants.begin(); it != mVariants.end(); )
+	{
+		if (it->second == index)
+			it = mVariants.erase(it);
+		else
+			++it;
+	}
+
+	std::unordered_map<uint64_t, uint32_t>::iterator source = mSources.find(request.sourceHash);
+	if (source != mSources.end() && source->second == index)
+		mSources.erase(source);
+}
+
+const GLProgramReflection& GLProgramCompiler::getReflection(const GLProgramFuture& program)
+{
+	wait(program.mIndex);
+	return mRequests[program.mIndex].reflection;
+}
+
+bool GLProgramCompiler::isComplete(const Request& request) const
+{
+	// without the extension the status query itself is the wait, so
+	// hold off until the driver got past the link.
+	if (!mParallel)
+	{
+		if (!request.fence)
+			return true;
+
+		GLenum ret = glClientWaitSync(request.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		return ret != GL_TIMEOUT_EXPIRED;
+	}
+
+	GLint complete = GL_FALSE;
+	glGetProgramiv(request.program, GL_COMPLETION_STATUS_KHR, &complete);
+	return complete == GL_TRUE;
+}
+
+void GLProgramCompiler::finish(Request& request)
+{
+	CompileClock::time_point start = CompileClock::now();
+
+	if (request.fence)
+	{
+		glDeleteSync(request.fence);
+		request.fence = NULL;
+	}
+
+	// compile logs, warnings included. Errors read "n(line)" where n
+	// is the source number of one of the stage's files, listed below.
+	for (uint32_t s = 0; s < request.stageCount; s++)
+	{
+		GLint logLength = 0;
+		glGetShaderiv(request.shaders[s], GL_INFO_LOG_LENGTH, &logLength);
+		if (logLength > 1)
+		{
+			std::vector<char> log(logLength + 1);
+			glGetShaderInfoLog(request.shaders[s], logLength, NULL, &log[0]);
+			printf("%s:\n%s\n", request.paths[s].c_str(), &log[0]);
+			for (size_t f = 0; f < request.stageFiles[s].size(); f++)
+				printf("\tsource %d: %s\n", (int)f, request.stageFiles[s][f].c_str());
+		}
+	}
+
+	GLint linked = GL_FALSE;
+	glGetProgramiv(request.program, GL_LINK_STATUS, &linked);
+
+	GLint logLength = 0;
+	glGetProgramiv(request.program, GL_INFO_LOG_LENGTH, &logLength);
+	if (logLength > 1)
+	{
+		std::vector<char> log(logLength + 1);
+		glGetProgramInfoLog(request.program, logLength, NULL, &log[0]);
+		printf("Linking %s:\n%s\n", request.name.c_str(), &log[0]);
+	}
+
+	for (uint32_t s = 0; s < request.stageCount; s++)
+	{
+		glDetachShader(request.program, request.shaders[s]);
+		glDeleteShader(request.shaders[s]);
+		request.shaders[s] = 0;
+	}
+
+	if (linked == GL_TRUE)
+	{
+		printf("Built program : %s\n", request.name.c_str());
+		if (mCache)
+			mCache->store(request.name.c_str(), request.cacheHash, request.program);
+		request.reflection.reflect(request.program);
+		request.state = RequestReady;
+	}
+	else
+	{
+		glDeleteProgram(request.program);
+		request.program = 0;
+		request.state = RequestFailed;
+	}
+
+	mPendingCount--;
+	mWaitTime += CompileClock::now() - start;
+}
+
+void GLProgramCompiler::wait(uint32_t index)
+{
+	Request& request = mRequests[index];
+	if (request.state == RequestPending)
+		finish(request);
+}
+
+uint32_t GLProgramCompiler::poll()
+{
+	for (size_t i = 0; i < mRequests.size() && mPendingCount; i++)
+	{
+		Request& request = mRequests[i];
+		if (request.state == RequestPending && isComplete(request))
+			finish(request);
+	}
+
+	return mPendingCount;
+}
+
+void GLProgramCompiler::finishAll()
+{
+	for (size_t i = 0; i < mRequests.size() && mPendingCount; i++)
+		wait((uint32_t)i);
+}
@@ -0,0 +1,172 @@
+#ifndef GFXGLPROGRAMCOMPILER_H_
+#define GFXGLPROGRAMCOMPILER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <unordered_map>
+
+#include <glad/gl.h>
+
+#include "gfx/gfxShaderPreprocessor.h"
+#include "gfx/gl/gfxGLProgramReflection.h"
+
+class GLShaderCache;
+class GLProgramCompiler;
+
+// One shader stage of a program, the source is read from path.
+struct GLShaderStageDesc
+{
+	GLenum		type;		///< GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER...
+	const char*	path;
+};
+
+//-------------------------------------------------------------
+// Program future
+//-------------------------------------------------------------
+// Handle to a submitted program. ready() never blocks, get() waits for
+// the link to finish and returns the program (0 when it failed).
+class GLProgramFuture
+{
+public:
+	GLProgramFuture() : mCompiler(NULL), mIndex(0) {}
+
+	bool	isValid() const { return mCompiler != NULL; }
+	bool	ready() const;
+	bool	failed() const;
+	GLuint	get() const;
+
+private:
+	friend class GLProgramCompiler;
+	GLProgramFuture(GLProgramCompiler* compiler, uint32_t index) : mCompiler(compiler), mIndex(index) {}
+
+	GLProgramCompiler*	mCompiler;
+	uint32_t			mIndex;
+};
+
+//-------------------------------------------------------------
+// Program compiler
+//-------------------------------------------------------------
+// Splits program creation into submit and poll. submit() issues the
+// compiles and the link without querying any status, so the driver is
+// free to build many programs at once. With KHR/ARB_parallel_shader_compile
+// poll() checks GL_COMPLETION_STATUS_KHR and only finishes programs
+// that are done. Otherwise a fence goes in after the link and poll()
+// waits on it with a zero timeout, a program counts as done once the
+// driver has worked through its commands. Finishing a program before
+// that blocks until the driver is done with it.
+//
+// Stages go through the shader preprocessor first. Programs are then
+// shared two ways: by permutation key (stage paths plus defines) so
+// asking for the same variant again is free, and by the hash of the
+// expanded sources so permutations that expand to the same code are
+// only compiled once. Programs found in the shader cache are ready
+// right away.
+//
+// Linked programs are reflected once, see getReflection().
+//
+// The compiler owns the programs. Each submit() takes a reference,
+// release() drops it and the last one deletes the program.
+class GLProgramCompiler
+{
+public:
+	enum { MaxStages = 3 };
+
+	GLProgramCompiler();
+	~GLProgramCompiler();
+
+	// cache may be NULL.
+	void init(GLShaderCache* cache);
+	void destroy();
+
+	GLProgramFuture submit(const GLShaderStageDesc* stages, uint32_t stageCount, const GFXShaderDefine* defines = NULL, uint32_t defineCount = 0);
+	GLProgramFuture submit(const char* vertexPath, const char* fragmentPath, const GFXShaderDefine* defines = NULL, uint32_t defineCount = 0);
+	GLProgramFuture submitCompute(const char* computePath, const GFXShaderDefine* defines = NULL, uint32_t defineCount = 0);
+
+	// builds the program again from the files on disk, skipping the
+	// permutation lookup. The old program keeps its reference.
+	GLProgramFuture rebuild(const GLProgramFuture& program);
+	void release(GLProgramFuture& program);
+
+	// uniforms, inputs and blocks of the program, waits for the link.
+	// Empty when it failed. Only valid until the next submit, copy it
+	// to keep it around.
+	const GLProgramReflection& getReflection(const GLProgramFuture& program);
+
+	// every file the program was expanded from, includes too.
+	const std::vector<std::string>& getFiles(const GLProgramFuture& program) const { return mRequests[program.mIndex].files; }
+
+	// finish whatever completed, never blocks with parallel compile.
+	// Returns the number of programs still building.
+	uint32_t poll();
+
+	// blocks until every submitted program is finished.
+	void finishAll();
+
+	GFXShaderPreprocessor& getPreprocessor() { return mPreprocessor; }
+
+	bool		isParallel() const { return mParallel; }
+	uint32_t	getPendingCount() const { return mPendingCount; }
+	uint32_t	getVariantHits() const { return mVariantHits; }		///< same permutation asked for again.
+	uint32_t	getSourceHits() const { return mSourceHits; }		///< different permutation, same expanded code.
+	double		getSubmitTime() const { return mSubmitTime.count(); }	///< ms spent in submit().
+	double		getWaitTime() const { return mWaitTime.count(); }		///< ms spent finishing programs.
+
+private:
+	friend class GLProgramFuture;
+
+	enum RequestState
+	{
+		RequestPending,
+		RequestReady,
+		RequestFailed,
+		RequestReleased,
+	};
+
+	struct Request
+	{
+		RequestState	state;
+		GLuint			program;
+		GLsync			fence;		///< after the link, without parallel compile.
+		uint32_t		refs;
+		GLuint			shaders[MaxStages];
+		GLenum			types[MaxStages];
+		std::string		paths[MaxStages];
+		uint32_t		stageCount;
+		std::vector<std::string>	defineNames;
+		std::vector<std::string>	defineValues;
+		std::vector<std::string>	files;		///< all stages, for watching.
+		std::vector<std::string>	stageFiles[MaxStages];	///< #line source numbers.
+		std::string		name;		///< cache entry name.
+		uint64_t		permutationKey;
+		uint64_t		sourceHash;
+		uint64_t		cacheHash;
+		GLProgramReflection	reflection;
+	};
+
+	GLProgramFuture submitRequest(Request& request, bool lookupVariant);
+	GLProgramFuture addRef(uint32_t index);
+	bool isComplete(const Request& request) const;
+	void finish(Request& request);
+	void wait(uint32_t index);
+
+	static uint64_t computePermutationKey(const Request& request);
+
+	bool					mParallel;
+	GLShaderCache*			mCache;
+	GFXShaderPreprocessor	mPreprocessor;
+	std::vector<Request>	mRequests;
+	uint32_t				mPendingCount;
+
+	std::unordered_map<uint64_t, uint32_t>	mVariants;	///< permutation key to request.
+	std::unordered_map<uint64_t, uint32_t>	mSources;	///< expanded source hash to request.
+	uint32_t				mVariantHits;
+	uint32_t				mSourceHits;
+
+	std::chrono::duration<double, std::milli> mSubmitTime;
+	std::chrono::duration<double, std::milli> mWaitTime;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#include "gfx/gl/gfxGLProgramReflection.h"
+#include "gfx/gl/gfxGLUtils.h"
+
+#include <stdio.h>
+#include <string.h>
+
+GLProgramReflection::GLProgramReflection()
+{
+	mProgram = 0;
+	mCount = 0;
+}
+
+void GLProgramReflection::clear()
+{
+	mProgram = 0;
+	mTable.clear();
+	mCount = 0;
+}
+
+bool GLProgramReflection::reflect(GLuint program)
+{
+	clear();
+	if (!program)
+		return false;
+
+	mProgram = program;
+	if (gglHasExtension(VERSION_4_3) || gglHasExtension(ARB_program_interface_query))
+		reflectInterface(program);
+	else
+		reflectActive(program);
+
+	return true;
+}
+
+void GLProgramReflection::reflectInterface(GLuint program)
+{
+	GLint maxLength = 0;
+	GLint count = 0;
+	std::vector<char> name;
+
+	// loose uniforms, block members have no location of their own.
+	glGetProgramInterfaceiv(program, GL_UNIFORM, GL_ACTIVE_RESOURCES, &count);
+	glGetProgramInterfaceiv(program, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		const GLenum props[4] = { GL_BLOCK_INDEX, GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+		GLint values[4];
+		glGetProgramResourceiv(program, GL_UNIFORM, i, 4, props, 4, NULL, values);
+		if (values[0] != -1)
+			continue;
+
+		glGetProgramResourceName(program, GL_UNIFORM, i, (GLsizei)name.size(), NULL, &name[0]);
+		add(ResourceUniform, &name[0], values[1], values[2], values[3]);
+	}
+
+	// vertex inputs, built-ins have no location.
+	glGetProgramInterfaceiv(program, GL_PROGRAM_INPUT, GL_ACTIVE_RESOURCES, &count);
+	glGetProgramInterfaceiv(program, GL_PROGRAM_INPUT, GL_MAX_NAME_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		const GLenum props[3] = { GL_LOCATION, GL_TYPE, GL_ARRAY_SIZE };
+		GLint values[3];
+		glGetProgramResourceiv(program, GL_PROGRAM_INPUT, i, 3, props, 3, NULL, values);
+		if (values[0] == -1)
+			continue;
+
+		glGetProgramResourceName(program, GL_PROGRAM_INPUT, i, (GLsizei)name.size(), NULL, &name[0]);
+		add(ResourceAttribute, &name[0], values[0], values[1], values[2]);
+	}
+
+	glGetProgramInterfaceiv(program, GL_UNIFORM_BLOCK, GL_ACTIVE_RESOURCES, &count);
+	glGetProgramInterfaceiv(program, GL_UNIFORM_BLOCK, GL_MAX_NAME_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		const GLenum prop = GL_BUFFER_DATA_SIZE;
+		GLint size = 0;
+		glGetProgramResourceiv(program, GL_UNIFORM_BLOCK, i, 1, &prop, 1, NULL, &size);
+		glGetProgramResourceName(program, GL_UNIFORM_BLOCK, i, (GLsizei)name.size(), NULL, &name[0]);
+		add(ResourceUniformBlock, &name[0], i, 0, size);
+	}
+
+	if (!gglHasExtension(VERSION_4_3) && !gglHasExtension(ARB_shader_storage_buffer_object))
+		return;
+
+	glGetProgramInterfaceiv(program, GL_SHADER_STORAGE_BLOCK, GL_ACTIVE_RESOURCES, &count);
+	glGetProgramInterfaceiv(program, GL_SHADER_STORAGE_BLOCK, GL_MAX_NAME_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		const GLenum prop = GL_BUFFER_DATA_SIZE;
+		GLint size = 0;
+		glGetProgramResourceiv(program, GL_SHADER_STORAGE_BLOCK, i, 1, &prop, 1, NULL, &size);
+		glGetProgramResourceName(program, GL_SHADER_STORAGE_BLOCK, i, (GLsizei)name.size(), NULL, &name[0]);
+		add(ResourceStorageBlock, &name[0], i, 0, size);
+	}
+}
+
+void GLProgramReflection::reflectActive(GLuint program)
+{
+	GLint maxLength = 0;
+	GLint count = 0;
+	std::vector<char> name;
+
+	// names only get looked up here, once per link.
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(program, i, (GLsizei)name.size(), NULL, &size, &type, &name[0]);
+
+		GLint location = glGetUniformLocation(program, &name[0]);
+		if (location != -1)
+			add(ResourceUniform, &name[0], location, type, size);
+	}
+
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveAttrib(program, i, (GLsizei)name.size(), NULL, &size, &type, &name[0]);
+
+		GLint location = glGetAttribLocation(program, &name[0]);
+		if (location != -1)
+			add(ResourceAttribute, &name[0], location, type, size);
+	}
+
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+	name.resize(maxLength + 1);
+	for (GLint i = 0; i < count; i++)
+	{
+		GLint size = 0;
+		glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+		glGetActiveUniformBlockName(program, i, (GLsizei)name.size(), NULL, &name[0]);
+		add(ResourceUniformBlock, &name[0], i, 0, size);
+	}
+}
+
+void GLProgramReflection::add(ResourceKind kind, char* name, GLint location, GLenum type, GLint size)
+{
+	// arrays report "name[0]", look them up by the plain name.
+	char* bracket = strchr(name, '[');
+	if (bracket && strcmp(bracket, "[0]") == 0)
+		*bracket = 0;
+
+	Resource resource;
+	resource.name = GFXHashName(name);
+	resource.kind = kind;
+	resource.location = location;
+	resource.type = type;
+	resource.size = size;
+
+	if (find(kind, resource.name))
+	{
+		printf("Program %d: %s collides with another name of the same kind, it can't be looked up.\n", mProgram, name);
+		return;
+	}
+
+	// keep the table at most half full.
+	if ((mCount + 1) * 2 > mTable.size())
+		grow();
+
+	const size_t mask = mTable.size() - 1;
+	size_t slot = resource.name & mask;
+	while (mTable[slot].kind != ResourceNone)
+		slot = (slot + 1) & mask;
+
+	mTable[slot] = resource;
+	mCount++;
+}
+
+void GLProgramReflection::grow()
+{
+	std::vector<Resource> old;
+	old.swap(mTable);
+
+	Resource empty;
+	memset(&empty, 0, sizeof(empty));
+	mTable.resize(old.empty() ? 16 : old.size() * 2, empty);
+
+	const size_t mask = mTable.size() - 1;
+	for (size_t i = 0; i < old.size(); i++)
+	{
+		if (old[i].kind == ResourceNone)
+			continue;
+
+		size_t slot = old[i].name & mask;
+		while (mTable[slot].kind != ResourceNone)
+			slot = (slot + 1) & mask;
+		mTable[slot] = old[i];
+	}
+}
+
+const GLProgramReflection::Resource* GLProgramReflection::find(ResourceKind kind, GFXNameHash name) const
+{
+	if (mTable.empty())
+		return NULL;
+
+	const size_t mask = mTable.size() - 1;
+	for (size_t slot = name & mask; mTable[slot].kind != ResourceNone; slot = (slot + 1) & mask)
+	{
+		const Resource& resource = mTable[slot];
+		if (resource.name == name && resource.kind == (uint32_t)kind)
+			return &resource;
+	}
+	return NULL;
+}
+
+GLint GLProgramReflection::getUniformLocation(GFXNameHash name) const
+{
+	const Resource* resource = find(ResourceUniform, name);
+	return resource ? resource->location : -1;
+}
+
+GLint GLProgramReflection::getAttribLocation(GFXNameHash name) const
+{
+	const Resource* resource = find(ResourceAttribute, name);
+	return resource ? resource->location : -1;
+}
+
+GLuint GLProgramReflection::getUniformBlockIndex(GFXNameHash name) const
+{
+	const Resource* resource = find(ResourceUniformBlock, name);
+	return resource ? (GLuint)resource->location : GL_INVALID_INDEX;
+}
+
+GLuint GLProgramReflection::getStorageBlockIndex(GFXNameHash name) const
+{
+	const Resource* resource = find(ResourceStorageBlock, name);
+	return resource ? (GLuint)resource->location : GL_INVALID_INDEX;
+}
+
+bool GLProgramReflection::bindUniformBlock(GFXNameHash name, GLuint binding) const
+{
+	GLuint index = getUniformBlockIndex(name);
+	if (index == GL_INVALID_INDEX)
+		return false;
+
+	glUniformBlockBinding(mProgram, index, binding);
+	return true;
+}
@@ -0,0 +1,83 @@
+#ifndef GFXGLPROGRAMREFLECTION_H_
+#define GFXGLPROGRAMREFLECTION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "gfx/gfxNameHash.h"
+
+//-------------------------------------------------------------
+// Program reflection
+//-------------------------------------------------------------
+// Everything a linked program exposes, read once after the link: loose
+// uniforms, vertex inputs, uniform blocks and storage blocks. Uses
+// glGetProgramResource* when the context has program interface queries
+// and the older glGetActive* calls otherwise.
+//
+// Resources sit in a flat open addressed table keyed by name hash, so
+// lookups and the set-uniform calls below are a couple of compares with
+// no string work. Arrays are found by their plain name, "planes" rather
+// than "planes[0]".
+class GLProgramReflection
+{
+public:
+	enum ResourceKind
+	{
+		ResourceNone,
+		ResourceUniform,
+		ResourceAttribute,
+		ResourceUniformBlock,
+		ResourceStorageBlock,
+	};
+
+	struct Resource
+	{
+		GFXNameHash	name;
+		uint32_t	kind;
+		GLint		location;	///< uniform/attribute location, block index for blocks.
+		GLenum		type;		///< GL_FLOAT_VEC4... 0 for blocks.
+		GLint		size;		///< array length, byte size for blocks.
+	};
+
+	GLProgramReflection();
+
+	bool reflect(GLuint program);
+	void clear();
+
+	GLuint		getProgram() const { return mProgram; }
+	uint32_t	getResourceCount() const { return mCount; }
+
+	const Resource* find(ResourceKind kind, GFXNameHash name) const;
+
+	// -1 / GL_INVALID_INDEX when the program doesn't use it.
+	GLint	getUniformLocation(GFXNameHash name) const;
+	GLint	getAttribLocation(GFXNameHash name) const;
+	GLuint	getUniformBlockIndex(GFXNameHash name) const;
+	GLuint	getStorageBlockIndex(GFXNameHash name) const;
+
+	// points the block at a binding slot, false when the program has no
+	// such block.
+	bool bindUniformBlock(GFXNameHash name, GLuint binding) const;
+
+	// set uniforms of the bound program, unknown names are ignored.
+	void setUniform1i(GFXNameHash name, GLint value) const { glUniform1i(getUniformLocation(name), value); }
+	void setUniform1ui(GFXNameHash name, GLuint value) const { glUniform1ui(getUniformLocation(name), value); }
+	void setUniform1f(GFXNameHash name, GLfloat value) const { glUniform1f(getUniformLocation(name), value); }
+	void setUniform4fv(GFXNameHash name, GLsizei count, const GLfloat* values) const { glUniform4fv(getUniformLocation(name), count, values); }
+	void setUniformMatrix4fv(GFXNameHash name, GLsizei count, const GLfloat* values) const { glUniformMatrix4fv(getUniformLocation(name), count, GL_FALSE, values); }
+
+private:
+	void reflectInterface(GLuint program);
+	void reflectActive(GLuint program);
+	void add(ResourceKind kind, char* name, GLint location, GLenum type, GLint size);
+	void grow();
+
+	GLuint					mProgram;
+	std::vector<Resource>	mTable;		///< power of two, empty slots are ResourceNone.
+	uint32_t				mCount;
+};
+
+#endif
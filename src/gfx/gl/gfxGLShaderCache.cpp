@@ -0,0 +1,187 @@
+#include "gfx/gl/gfxGLShaderCache.h"
+#include "gfx/gl/gfxGLUtils.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#define gglMakeDir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define gglMakeDir(path) mkdir(path, 0755)
+#endif
+
+static const uint64_t FNVOffset64 = 14695981039346656037ull;
+static const uint64_t FNVPrime64 = 1099511628211ull;
+
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= FNVPrime64;
+	}
+	return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const char* str)
+{
+	// include the length so "ab" + "c" and "a" + "bc" differ.
+	uint32_t length = str ? (uint32_t)strlen(str) : 0;
+	hash = hashBytes(hash, &length, sizeof(length));
+	return hashBytes(hash, str, length);
+}
+
+GLShaderCache::GLShaderCache()
+{
+	mEnabled = false;
+	mDriverHash = FNVOffset64;
+	mHits = 0;
+	mMisses = 0;
+	mStale = 0;
+}
+
+bool GLShaderCache::init(const char* directory, bool enabled)
+{
+	mEnabled = false;
+	mDirectory = directory;
+
+	if (!enabled)
+		return false;
+
+	if (!gglHasExtension(VERSION_4_1) && !gglHasExtension(ARB_get_program_binary))
+		return false;
+
+	GLint formatCount = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+	if (formatCount <= 0)
+	{
+		printf("Shader cache disabled, the driver has no program binary formats.\n");
+		return false;
+	}
+
+	// binaries are only valid for the driver that produced them.
+	mDriverHash = FNVOffset64;
+	mDriverHash = hashString(mDriverHash, (const char*)glGetString(GL_VENDOR));
+	mDriverHash = hashString(mDriverHash, (const char*)glGetString(GL_RENDERER));
+	mDriverHash = hashString(mDriverHash, (const char*)glGetString(GL_VERSION));
+
+	gglMakeDir(directory);
+	mEnabled = true;
+	return true;
+}
+
+uint64_t GLShaderCache::computeHash(const std::string* sources, uint32_t sourceCount) const
+{
+	uint64_t hash = mDriverHash;
+	for (uint32_t i = 0; i < sourceCount; i++)
+		hash = hashString(hash, sources[i].c_str());
+
+	return hash;
+}
+
+std::string GLShaderCache::getPath(const char* name) const
+{
+	// one entry per program, a changed source overwrites it.
+	char file[32];
+	snprintf(file, sizeof(file), "/%016llx.glbin", (unsigned long long)hashString(FNVOffset64, name));
+	return mDirectory + file;
+}
+
+GLuint GLShaderCache::load(const char* name, uint64_t hash)
+{
+	if (!mEnabled)
+		return 0;
+
+	std::string path = getPath(name);
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		mMisses++;
+		return 0;
+	}
+
+	FileHeader header;
+	std::vector<uint8_t> binary;
+	bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+		header.magic == FileMagic && header.version == FileVersion && header.hash == hash && header.binaryLength > 0;
+
+	if (valid)
+	{
+		binary.resize(header.binaryLength);
+		valid = fread(&binary[0], 1, binary.size(), file) == binary.size();
+	}
+	fclose(file);
+
+	if (!valid)
+	{
+		mStale++;
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glProgramBinary(program, header.binaryFormat, &binary[0], header.binaryLength);
+
+	// the driver may still refuse it, e.g. after an update that kept
+	// the version string.
+	GLint linked = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (linked != GL_TRUE)
+	{
+		glDeleteProgram(program);
+		remove(path.c_str());
+		mStale++;
+		return 0;
+	}
+
+	mHits++;
+	return program;
+}
+
+void GLShaderCache::prepareProgram(GLuint program)
+{
+	if (mEnabled)
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+bool GLShaderCache::store(const char* name, uint64_t hash, GLuint program)
+{
+	if (!mEnabled || !program)
+		return false;
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return false;
+
+	std::vector<uint8_t> binary(length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, &binary[0]);
+
+	FileHeader header;
+	header.magic = FileMagic;
+	header.version = FileVersion;
+	header.hash = hash;
+	header.binaryFormat = format;
+	header.binaryLength = (uint32_t)length;
+
+	std::string path = getPath(name);
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		printf("Shader cache can't write %s.\n", path.c_str());
+		return false;
+	}
+
+	bool written = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(&binary[0], 1, length, file) == (size_t)length;
+	fclose(file);
+
+	// never leave a truncated entry behind.
+	if (!written)
+		remove(path.c_str());
+
+	return written;
+}
@@ -0,0 +1,73 @@
+#ifndef GFXGLSHADERCACHE_H_
+#define GFXGLSHADERCACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include <glad/gl.h>
+
+//-------------------------------------------------------------
+// Program binary cache
+//-------------------------------------------------------------
+// Linked programs are saved with glGetProgramBinary and loaded back
+// with glProgramBinary on the next run, skipping compile and link.
+//
+// Each program gets one file named after its shader paths. The file
+// header stores a 64 bit hash of the shader sources and of the
+// driver's vendor/renderer/version strings. When the sources or the
+// driver change the hash no longer matches, the entry is treated as
+// stale and overwritten once the program has been rebuilt. Drivers can
+// also reject a binary, which is handled the same way.
+class GLShaderCache
+{
+public:
+	GLShaderCache();
+
+	// directory is created if missing. Returns false (cache disabled)
+	// when the driver has no program binary formats.
+	bool init(const char* directory, bool enabled);
+
+	bool isEnabled() const { return mEnabled; }
+
+	// hash of the given sources combined with the driver identity.
+	uint64_t computeHash(const std::string* sources, uint32_t sourceCount) const;
+
+	// a linked program, or 0 on a miss.
+	GLuint load(const char* name, uint64_t hash);
+
+	// call before glLinkProgram on programs that will be stored.
+	void prepareProgram(GLuint program);
+	bool store(const char* name, uint64_t hash, GLuint program);
+
+	uint32_t getHits() const { return mHits; }
+	uint32_t getMisses() const { return mMisses; }
+	uint32_t getStale() const { return mStale; }
+
+private:
+	struct FileHeader
+	{
+		uint32_t	magic;
+		uint32_t	version;
+		uint64_t	hash;
+		uint32_t	binaryFormat;
+		uint32_t	binaryLength;
+	};
+
+	enum
+	{
+		FileMagic = 0x42505347,	///< 'GSPB'
+		FileVersion = 1,
+	};
+
+	std::string getPath(const char* name) const;
+
+	bool		mEnabled;
+	std::string	mDirectory;
+	uint64_t	mDriverHash;
+	uint32_t	mHits;
+	uint32_t	mMisses;
+	uint32_t	mStale;
+};
+
+#endif
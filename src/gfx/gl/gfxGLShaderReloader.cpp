@@ -0,0 +1,140 @@
+#include "gfx/gl/gfxGLShaderReloader.h"
+
+#include <stdio.h>
+
+GLShaderReloader::GLShaderReloader()
+{
+	mCompiler = NULL;
+}
+
+GLShaderReloader::~GLShaderReloader()
+{
+	destroy();
+}
+
+bool GLShaderReloader::init(GLProgramCompiler* compiler, const char* directory)
+{
+	destroy();
+	mCompiler = compiler;
+	return mWatcher.init(directory);
+}
+
+void GLShaderReloader::destroy()
+{
+	// hand every reference back, rebuilds in flight included.
+	if (mCompiler)
+	{
+		for (size_t i = 0; i < mEntries.size(); i++)
+		{
+			mCompiler->release(mEntries[i].pending);
+			mCompiler->release(mEntries[i].live);
+		}
+	}
+
+	mWatcher.destroy();
+	mEntries.clear();
+	mCompiler = NULL;
+}
+
+void GLShaderReloader::add(GLuint* slot, const GLProgramFuture& program, GLProgramReloadCallback callback, void* userData)
+{
+	if (!mWatcher.isActive() || !program.isValid())
+		return;
+
+	Entry entry;
+	entry.slot = slot;
+	entry.callback = callback;
+	entry.userData = userData;
+	entry.live = program;
+	entry.resubmit = false;
+	watchFiles(entry);
+
+	mEntries.push_back(entry);
+}
+
+bool GLShaderReloader::usesFile(const Entry& entry, const std::string& file) const
+{
+	const std::vector<std::string>& files = mCompiler->getFiles(entry.live);
+	for (size_t f = 0; f < files.size(); f++)
+	{
+		if (files[f] == file)
+			return true;
+	}
+	return false;
+}
+
+void GLShaderReloader::watchFiles(const Entry& entry)
+{
+	const std::vector<std::string>& files = mCompiler->getFiles(entry.live);
+	for (size_t f = 0; f < files.size(); f++)
+		mWatcher.watch(files[f].c_str());
+}
+
+uint32_t GLShaderReloader::update()
+{
+	if (!mCompiler)
+		return 0;
+
+	// kick off rebuilds for edited files. A program already rebuilding
+	// goes again once that build is done.
+	mChanged.clear();
+	if (mWatcher.poll(mChanged))
+	{
+		for (size_t i = 0; i < mEntries.size(); i++)
+		{
+			Entry& entry = mEntries[i];
+			for (size_t c = 0; c < mChanged.size(); c++)
+			{
+				if (usesFile(entry, mChanged[c]))
+				{
+					printf("Reloading %s\n", mChanged[c].c_str());
+					if (entry.pending.isValid())
+						entry.resubmit = true;
+					else
+						entry.pending = mCompiler->rebuild(entry.live);
+					break;
+				}
+			}
+		}
+	}
+
+	// swap finished programs in, between frames nothing is using them.
+	// get() only blocks on a build that isn't ready(), skip those until
+	// a later frame.
+	uint32_t swapped = 0;
+	for (size_t i = 0; i < mEntries.size(); i++)
+	{
+		Entry& entry = mEntries[i];
+		if (!entry.pending.isValid() || !entry.pending.ready())
+			continue;
+
+		GLuint program = entry.pending.get();
+		if (program)
+		{
+			if (entry.callback)
+				entry.callback(mCompiler->getReflection(entry.pending), entry.userData);
+
+			mCompiler->release(entry.live);
+			entry.live = entry.pending;
+			entry.pending = GLProgramFuture();
+			*entry.slot = program;
+
+			// the edit may have added includes.
+			watchFiles(entry);
+			swapped++;
+		}
+		else
+		{
+			printf("Shader reload failed, keeping the old program.\n");
+			mCompiler->release(entry.pending);
+		}
+
+		if (entry.resubmit)
+		{
+			entry.resubmit = false;
+			entry.pending = mCompiler->rebuild(entry.live);
+		}
+	}
+
+	return swapped;
+}
@@ -0,0 +1,65 @@
+#ifndef GFXGLSHADERRELOADER_H_
+#define GFXGLSHADERRELOADER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "gfx/gl/gfxGLProgramCompiler.h"
+#include "platform/platformFileWatcher.h"
+
+// called with a freshly built program before it replaces the old one,
+// for uniform block bindings and cached locations.
+typedef void (*GLProgramReloadCallback)(const GLProgramReflection& program, void* userData);
+
+//-------------------------------------------------------------
+// Shader hot reload
+//-------------------------------------------------------------
+// Watches the shader files of registered programs, includes too. An
+// edit submits a rebuild to the program compiler and rendering carries
+// on with the old program. update() runs once a frame, before anything
+// is drawn, and only looks at rebuilds that ready() says are done, so
+// it never waits on the compile. Finished programs are swapped into
+// their slot and the old ones released. A program that fails to build
+// is dropped and the old one stays.
+class GLShaderReloader
+{
+public:
+	GLShaderReloader();
+	~GLShaderReloader();
+
+	bool init(GLProgramCompiler* compiler, const char* directory);
+	void destroy();
+
+	// slot holds the live program and is rewritten on every swap. The
+	// reloader takes over the reference held by program, shader paths
+	// are relative to the watched directory.
+	void add(GLuint* slot, const GLProgramFuture& program, GLProgramReloadCallback callback = NULL, void* userData = NULL);
+
+	// frame boundary, returns the number of programs swapped.
+	uint32_t update();
+
+private:
+	struct Entry
+	{
+		GLuint*					slot;
+		GLProgramReloadCallback	callback;
+		void*					userData;
+		GLProgramFuture			live;
+		GLProgramFuture			pending;
+		bool					resubmit;	///< edited again while building.
+	};
+
+	bool usesFile(const Entry& entry, const std::string& file) const;
+	void watchFiles(const Entry& entry);
+
+	GLProgramCompiler*			mCompiler;
+	PlatformFileWatcher			mWatcher;
+	std::vector<Entry>			mEntries;
+	std::vector<std::string>	mChanged;
+};
+
+#endif
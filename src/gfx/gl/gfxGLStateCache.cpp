@@ -0,0 +1,529 @@
+#include "gfx/gl/gfxGLStateCache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+// shadowed names start out unknown so the first call always goes through.
+static const GLuint UnknownName = 0xFFFFFFFF;
+
+GLStateCache* GLStateCache::sActive = NULL;
+
+uint32_t GLStateStats::getIssued() const
+{
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < GLStateCategoryCount; i++)
+		total += issued[i];
+	return total;
+}
+
+uint32_t GLStateStats::getEliminated() const
+{
+	uint32_t total = 0;
+	for (uint32_t i = 0; i < GLStateCategoryCount; i++)
+		total += eliminated[i];
+	return total;
+}
+
+GLStateCache::GLStateCache()
+{
+	memset(&mEntries, 0, sizeof(mEntries));
+	memset(&mFrame, 0, sizeof(mFrame));
+	memset(&mLastFrame, 0, sizeof(mLastFrame));
+	memset(&mTotal, 0, sizeof(mTotal));
+	mFrameCount = 0;
+	invalidate();
+}
+
+GLStateCache::~GLStateCache()
+{
+	destroy();
+}
+
+void GLStateCache::init()
+{
+	destroy();
+	if (sActive)
+	{
+		printf("Another GL state cache is already active.\n");
+		return;
+	}
+
+	sActive = this;
+	invalidate();
+
+	mEntries.useProgram = glad_glUseProgram;
+	mEntries.linkProgram = glad_glLinkProgram;
+	mEntries.programBinary = glad_glProgramBinary;
+	mEntries.deleteProgram = glad_glDeleteProgram;
+	mEntries.bindVertexArray = glad_glBindVertexArray;
+	mEntries.deleteVertexArrays = glad_glDeleteVertexArrays;
+	mEntries.bindBuffer = glad_glBindBuffer;
+	mEntries.bindBufferBase = glad_glBindBufferBase;
+	mEntries.bindBufferRange = glad_glBindBufferRange;
+	mEntries.deleteBuffers = glad_glDeleteBuffers;
+	mEntries.activeTexture = glad_glActiveTexture;
+	mEntries.bindTexture = glad_glBindTexture;
+	mEntries.deleteTextures = glad_glDeleteTextures;
+	mEntries.uniform1i = glad_glUniform1i;
+	mEntries.uniform1ui = glad_glUniform1ui;
+	mEntries.uniform1f = glad_glUniform1f;
+	mEntries.uniform4fv = glad_glUniform4fv;
+	mEntries.uniformMatrix4fv = glad_glUniformMatrix4fv;
+
+	glad_glUseProgram = useProgram;
+	glad_glLinkProgram = linkProgram;
+	if (mEntries.programBinary)
+		glad_glProgramBinary = programBinary;
+	glad_glDeleteProgram = deleteProgram;
+	glad_glBindVertexArray = bindVertexArray;
+	glad_glDeleteVertexArrays = deleteVertexArrays;
+	glad_glBindBuffer = bindBuffer;
+	glad_glBindBufferBase = bindBufferBase;
+	glad_glBindBufferRange = bindBufferRange;
+	glad_glDeleteBuffers = deleteBuffers;
+	glad_glActiveTexture = activeTexture;
+	glad_glBindTexture = bindTexture;
+	glad_glDeleteTextures = deleteTextures;
+	glad_glUniform1i = uniform1i;
+	glad_glUniform1ui = uniform1ui;
+	glad_glUniform1f = uniform1f;
+	glad_glUniform4fv = uniform4fv;
+	glad_glUniformMatrix4fv = uniformMatrix4fv;
+}
+
+void GLStateCache::destroy()
+{
+	if (sActive != this)
+		return;
+
+	glad_glUseProgram = mEntries.useProgram;
+	glad_glLinkProgram = mEntries.linkProgram;
+	glad_glProgramBinary = mEntries.programBinary;
+	glad_glDeleteProgram = mEntries.deleteProgram;
+	glad_glBindVertexArray = mEntries.bindVertexArray;
+	glad_glDeleteVertexArrays = mEntries.deleteVertexArrays;
+	glad_glBindBuffer = mEntries.bindBuffer;
+	glad_glBindBufferBase = mEntries.bindBufferBase;
+	glad_glBindBufferRange = mEntries.bindBufferRange;
+	glad_glDeleteBuffers = mEntries.deleteBuffers;
+	glad_glActiveTexture = mEntries.activeTexture;
+	glad_glBindTexture = mEntries.bindTexture;
+	glad_glDeleteTextures = mEntries.deleteTextures;
+	glad_glUniform1i = mEntries.uniform1i;
+	glad_glUniform1ui = mEntries.uniform1ui;
+	glad_glUniform1f = mEntries.uniform1f;
+	glad_glUniform4fv = mEntries.uniform4fv;
+	glad_glUniformMatrix4fv = mEntries.uniformMatrix4fv;
+
+	memset(&mEntries, 0, sizeof(mEntries));
+	sActive = NULL;
+}
+
+void GLStateCache::invalidate()
+{
+	mProgram = UnknownName;
+	mVertexArray = UnknownName;
+	for (uint32_t t = 0; t < BufferTargetCount; t++)
+		mBuffers[t] = UnknownName;
+
+	for (uint32_t t = 0; t < IndexedTargetCount; t++)
+	{
+		for (uint32_t i = 0; i < MaxIndexedBindings; i++)
+		{
+			mIndexed[t][i].buffer = UnknownName;
+			mIndexed[t][i].offset = 0;
+			mIndexed[t][i].size = 0;
+		}
+	}
+
+	mActiveUnit = UnknownName;
+	for (uint32_t u = 0; u < MaxTextureUnits; u++)
+	{
+		for (uint32_t t = 0; t < TextureTargetCount; t++)
+			mTextures[u][t] = UnknownName;
+	}
+
+	mUniforms.clear();
+}
+
+void GLStateCache::beginFrame()
+{
+	// whatever ran before the first frame is loading, not a frame.
+	if (mFrameCount > 0)
+	{
+		mLastFrame = mFrame;
+		for (uint32_t i = 0; i < GLStateCategoryCount; i++)
+		{
+			mTotal.issued[i] += mFrame.issued[i];
+			mTotal.eliminated[i] += mFrame.eliminated[i];
+		}
+	}
+
+	memset(&mFrame, 0, sizeof(mFrame));
+	mFrameCount++;
+}
+
+bool GLStateCache::filter(GLStateCategory category, bool redundant)
+{
+	if (redundant)
+		mFrame.eliminated[category]++;
+	else
+		mFrame.issued[category]++;
+	return redundant;
+}
+
+int GLStateCache::getBufferTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:				return BufferArray;
+	case GL_ELEMENT_ARRAY_BUFFER:		return BufferElementArray;
+	case GL_UNIFORM_BUFFER:				return BufferUniform;
+	case GL_SHADER_STORAGE_BUFFER:		return BufferShaderStorage;
+	case GL_DRAW_INDIRECT_BUFFER:		return BufferDrawIndirect;
+	case GL_DISPATCH_INDIRECT_BUFFER:	return BufferDispatchIndirect;
+	case GL_COPY_READ_BUFFER:			return BufferCopyRead;
+	case GL_COPY_WRITE_BUFFER:			return BufferCopyWrite;
+	case GL_PIXEL_PACK_BUFFER:			return BufferPixelPack;
+	case GL_PIXEL_UNPACK_BUFFER:		return BufferPixelUnpack;
+	default:							return -1;
+	}
+}
+
+int GLStateCache::getIndexedTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_UNIFORM_BUFFER:			return 0;
+	case GL_SHADER_STORAGE_BUFFER:	return 1;
+	default:						return -1;
+	}
+}
+
+int GLStateCache::getTextureTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:			return Texture2D;
+	case GL_TEXTURE_2D_ARRAY:	return Texture2DArray;
+	case GL_TEXTURE_3D:			return Texture3D;
+	case GL_TEXTURE_CUBE_MAP:	return TextureCubeMap;
+	case GL_TEXTURE_BUFFER:		return TextureBuffer;
+	default:					return -1;
+	}
+}
+
+//-------------------------------------------------------------
+// Programs
+//-------------------------------------------------------------
+void GLAD_API_PTR GLStateCache::useProgram(GLuint program)
+{
+	GLStateCache* cache = sActive;
+	if (cache->filter(GLStateProgram, cache->mProgram == program))
+		return;
+
+	cache->mProgram = program;
+	cache->mEntries.useProgram(program);
+}
+
+// linking resets every uniform of the program.
+void GLAD_API_PTR GLStateCache::linkProgram(GLuint program)
+{
+	GLStateCache* cache = sActive;
+	cache->mUniforms.erase(program);
+	cache->mEntries.linkProgram(program);
+}
+
+void GLAD_API_PTR GLStateCache::programBinary(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length)
+{
+	GLStateCache* cache = sActive;
+	cache->mUniforms.erase(program);
+	cache->mEntries.programBinary(program, binaryFormat, binary, length);
+}
+
+// the name can come back for a new program once it's really gone.
+void GLAD_API_PTR GLStateCache::deleteProgram(GLuint program)
+{
+	GLStateCache* cache = sActive;
+	cache->mUniforms.erase(program);
+	cache->mEntries.deleteProgram(program);
+}
+
+//-------------------------------------------------------------
+// Vertex arrays and buffers
+//-------------------------------------------------------------
+void GLAD_API_PTR GLStateCache::bindVertexArray(GLuint vao)
+{
+	GLStateCache* cache = sActive;
+	if (cache->filter(GLStateVertexArray, cache->mVertexArray == vao))
+		return;
+
+	// the index buffer binding belongs to the VAO.
+	cache->mVertexArray = vao;
+	cache->mBuffers[BufferElementArray] = UnknownName;
+	cache->mEntries.bindVertexArray(vao);
+}
+
+void GLAD_API_PTR GLStateCache::deleteVertexArrays(GLsizei n, const GLuint* vaos)
+{
+	GLStateCache* cache = sActive;
+	for (GLsizei i = 0; i < n; i++)
+	{
+		if (vaos[i] == cache->mVertexArray)
+		{
+			cache->mVertexArray = 0;
+			cache->mBuffers[BufferElementArray] = UnknownName;
+		}
+	}
+	cache->mEntries.deleteVertexArrays(n, vaos);
+}
+
+void GLAD_API_PTR GLStateCache::bindBuffer(GLenum target, GLuint buffer)
+{
+	GLStateCache* cache = sActive;
+	int t = getBufferTarget(target);
+	if (t < 0)
+	{
+		cache->filter(GLStateBuffer, false);
+		cache->mEntries.bindBuffer(target, buffer);
+		return;
+	}
+
+	if (cache->filter(GLStateBuffer, cache->mBuffers[t] == buffer))
+		return;
+
+	cache->mBuffers[t] = buffer;
+	cache->mEntries.bindBuffer(target, buffer);
+}
+
+// indexed binds also set the generic binding point.
+void GLAD_API_PTR GLStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+	GLStateCache* cache = sActive;
+	int t = getIndexedTarget(target);
+	if (t < 0 || index >= MaxIndexedBindings)
+	{
+		int generic = getBufferTarget(target);
+		if (generic >= 0)
+			cache->mBuffers[generic] = buffer;
+
+		cache->filter(GLStateBuffer, false);
+		cache->mEntries.bindBufferBase(target, index, buffer);
+		return;
+	}
+
+	IndexedBinding& binding = cache->mIndexed[t][index];
+	bool redundant = binding.buffer == buffer && binding.offset == 0 && binding.size == 0 && cache->mBuffers[getBufferTarget(target)] == buffer;
+	if (cache->filter(GLStateBuffer, redundant))
+		return;
+
+	binding.buffer = buffer;
+	binding.offset = 0;
+	binding.size = 0;
+	cache->mBuffers[getBufferTarget(target)] = buffer;
+	cache->mEntries.bindBufferBase(target, index, buffer);
+}
+
+void GLAD_API_PTR GLStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	GLStateCache* cache = sActive;
+	int t = getIndexedTarget(target);
+	if (t < 0 || index >= MaxIndexedBindings)
+	{
+		int generic = getBufferTarget(target);
+		if (generic >= 0)
+			cache->mBuffers[generic] = buffer;
+
+		cache->filter(GLStateBuffer, false);
+		cache->mEntries.bindBufferRange(target, index, buffer, offset, size);
+		return;
+	}
+
+	IndexedBinding& binding = cache->mIndexed[t][index];
+	bool redundant = binding.buffer == buffer && binding.offset == offset && binding.size == size && cache->mBuffers[getBufferTarget(target)] == buffer;
+	if (cache->filter(GLStateBuffer, redundant))
+		return;
+
+	binding.buffer = buffer;
+	binding.offset = offset;
+	binding.size = size;
+	cache->mBuffers[getBufferTarget(target)] = buffer;
+	cache->mEntries.bindBufferRange(target, index, buffer, offset, size);
+}
+
+// deleted buffers drop out of every binding they were in.
+void GLStateCache::forgetBuffer(GLuint buffer)
+{
+	for (uint32_t t = 0; t < BufferTargetCount; t++)
+	{
+		if (mBuffers[t] == buffer)
+			mBuffers[t] = 0;
+	}
+
+	for (uint32_t t = 0; t < IndexedTargetCount; t++)
+	{
+		for (uint32_t i = 0; i < MaxIndexedBindings; i++)
+		{
+			if (mIndexed[t][i].buffer == buffer)
+			{
+				mIndexed[t][i].buffer = 0;
+				mIndexed[t][i].offset = 0;
+				mIndexed[t][i].size = 0;
+			}
+		}
+	}
+
+	// VAOs other than the bound one still reference it.
+	mBuffers[BufferElementArray] = UnknownName;
+}
+
+void GLAD_API_PTR GLStateCache::deleteBuffers(GLsizei n, const GLuint* buffers)
+{
+	GLStateCache* cache = sActive;
+	for (GLsizei i = 0; i < n; i++)
+		cache->forgetBuffer(buffers[i]);
+	cache->mEntries.deleteBuffers(n, buffers);
+}
+
+//-------------------------------------------------------------
+// Textures
+//-------------------------------------------------------------
+void GLAD_API_PTR GLStateCache::activeTexture(GLenum unit)
+{
+	GLStateCache* cache = sActive;
+	GLuint index = unit - GL_TEXTURE0;
+	if (cache->filter(GLStateTexture, cache->mActiveUnit == index))
+		return;
+
+	cache->mActiveUnit = index;
+	cache->mEntries.activeTexture(unit);
+}
+
+void GLAD_API_PTR GLStateCache::bindTexture(GLenum target, GLuint texture)
+{
+	GLStateCache* cache = sActive;
+	int t = getTextureTarget(target);
+	if (t < 0 || cache->mActiveUnit >= MaxTextureUnits)
+	{
+		cache->filter(GLStateTexture, false);
+		cache->mEntries.bindTexture(target, texture);
+		return;
+	}
+
+	GLuint& bound = cache->mTextures[cache->mActiveUnit][t];
+	if (cache->filter(GLStateTexture, bound == texture))
+		return;
+
+	bound = texture;
+	cache->mEntries.bindTexture(target, texture);
+}
+
+void GLAD_API_PTR GLStateCache::deleteTextures(GLsizei n, const GLuint* textures)
+{
+	GLStateCache* cache = sActive;
+	for (GLsizei i = 0; i < n; i++)
+	{
+		for (uint32_t u = 0; u < MaxTextureUnits; u++)
+		{
+			for (uint32_t t = 0; t < TextureTargetCount; t++)
+			{
+				if (cache->mTextures[u][t] == textures[i])
+					cache->mTextures[u][t] = 0;
+			}
+		}
+	}
+	cache->mEntries.deleteTextures(n, textures);
+}
+
+//-------------------------------------------------------------
+// Uniforms
+//-------------------------------------------------------------
+// clears the write starting at first from every location it covers.
+void GLStateCache::forgetUniform(UniformValues& values, GLint first)
+{
+	const GLint end = std::min<GLint>(first + values[first].count, (GLint)values.size());
+	for (GLint location = first; location < end; location++)
+		values[location].first = -1;
+	values[first].data.clear();
+}
+
+// true when the bound program already has this value at location.
+bool GLStateCache::setUniform(GLint location, GLenum type, GLboolean transpose, GLsizei count, const void* data, size_t size)
+{
+	// -1 is ignored by GL anyway. It's a missing uniform rather than a
+	// redundant upload, so it stays out of the stats.
+	if (location < 0)
+		return true;
+
+	if (mProgram == UnknownName || mProgram == 0 || count <= 0 || location >= MaxUniformLocations)
+		return filter(GLStateUniform, false);
+
+	UniformValues& values = mUniforms[mProgram];
+	if (location < (GLint)values.size())
+	{
+		const UniformValue& value = values[location];
+		if (value.first == location && value.type == type && value.transpose == transpose &&
+			value.count == count && value.data.size() == size && memcmp(&value.data[0], data, size) == 0)
+			return filter(GLStateUniform, true);
+	}
+
+	// arrays cover several locations, drop whatever this write overlaps.
+	const GLint end = std::min<GLint>(location + count, MaxUniformLocations);
+	if ((GLint)values.size() < end)
+		values.resize(end);
+	for (GLint covered = location; covered < end; covered++)
+	{
+		if (values[covered].first >= 0)
+			forgetUniform(values, values[covered].first);
+	}
+
+	// an array running past the last cached location isn't kept.
+	if (location + count > MaxUniformLocations)
+		return filter(GLStateUniform, false);
+
+	UniformValue& value = values[location];
+	value.first = location;
+	value.type = type;
+	value.transpose = transpose;
+	value.count = count;
+	value.data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+	for (GLint covered = location + 1; covered < end; covered++)
+		values[covered].first = location;
+	return filter(GLStateUniform, false);
+}
+
+void GLAD_API_PTR GLStateCache::uniform1i(GLint location, GLint v0)
+{
+	GLStateCache* cache = sActive;
+	if (!cache->setUniform(location, GL_INT, GL_FALSE, 1, &v0, sizeof(v0)))
+		cache->mEntries.uniform1i(location, v0);
+}
+
+void GLAD_API_PTR GLStateCache::uniform1ui(GLint location, GLuint v0)
+{
+	GLStateCache* cache = sActive;
+	if (!cache->setUniform(location, GL_UNSIGNED_INT, GL_FALSE, 1, &v0, sizeof(v0)))
+		cache->mEntries.uniform1ui(location, v0);
+}
+
+void GLAD_API_PTR GLStateCache::uniform1f(GLint location, GLfloat v0)
+{
+	GLStateCache* cache = sActive;
+	if (!cache->setUniform(location, GL_FLOAT, GL_FALSE, 1, &v0, sizeof(v0)))
+		cache->mEntries.uniform1f(location, v0);
+}
+
+void GLAD_API_PTR GLStateCache::uniform4fv(GLint location, GLsizei count, const GLfloat* value)
+{
+	GLStateCache* cache = sActive;
+	if (!cache->setUniform(location, GL_FLOAT_VEC4, GL_FALSE, count, value, count * 4 * sizeof(GLfloat)))
+		cache->mEntries.uniform4fv(location, count, value);
+}
+
+void GLAD_API_PTR GLStateCache::uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value)
+{
+	GLStateCache* cache = sActive;
+	if (!cache->setUniform(location, GL_FLOAT_MAT4, transpose, count, value, count * 16 * sizeof(GLfloat)))
+		cache->mEntries.uniformMatrix4fv(location, count, transpose, value);
+}
@@ -0,0 +1,191 @@
+#ifndef GFXGLSTATECACHE_H_
+#define GFXGLSTATECACHE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#include <glad/gl.h>
+
+enum GLStateCategory
+{
+	GLStateProgram,
+	GLStateVertexArray,
+	GLStateBuffer,
+	GLStateTexture,
+	GLStateUniform,
+	GLStateCategoryCount,
+};
+
+struct GLStateStats
+{
+	uint32_t	issued[GLStateCategoryCount];		///< calls that reached the driver.
+	uint32_t	eliminated[GLStateCategoryCount];	///< calls dropped as redundant.
+
+	uint32_t getIssued() const;
+	uint32_t getEliminated() const;
+};
+
+//-------------------------------------------------------------
+// GL state cache
+//-------------------------------------------------------------
+// Shadows the bind and uniform state the renderer touches and drops
+// calls that wouldn't change anything. init() swaps the glad entry
+// points for filtering ones, so every glUseProgram, glBindVertexArray,
+// glBindBuffer(Base/Range), glActiveTexture/glBindTexture and
+// glUniform* call in the program goes through it without any change at
+// the call sites. Deletes, links and program binaries are hooked as
+// well to keep the shadow honest.
+//
+// Only one cache can be active, and only for the current context. Code
+// that changes state behind glad's back (another library, a second
+// context) has to call invalidate().
+class GLStateCache
+{
+public:
+	enum
+	{
+		MaxTextureUnits = 32,
+		MaxIndexedBindings = 16,	///< per uniform/storage buffer target.
+		MaxUniformLocations = 1024,	///< the GL minimum, values past it aren't cached.
+	};
+
+	GLStateCache();
+	~GLStateCache();
+
+	// after glad is loaded, with the context current.
+	void init();
+	void destroy();
+
+	// forget everything shadowed, the next call of each kind goes through.
+	void invalidate();
+
+	// starts a new frame of counters, the last one stays readable.
+	void beginFrame();
+
+	const GLStateStats&	getFrameStats() const { return mLastFrame; }	///< last complete frame.
+	const GLStateStats&	getTotalStats() const { return mTotal; }
+	uint32_t			getFrameCount() const { return mFrameCount; }
+	bool				isActive() const { return sActive == this; }
+
+private:
+	enum BufferTarget
+	{
+		BufferArray,
+		BufferElementArray,
+		BufferUniform,
+		BufferShaderStorage,
+		BufferDrawIndirect,
+		BufferDispatchIndirect,
+		BufferCopyRead,
+		BufferCopyWrite,
+		BufferPixelPack,
+		BufferPixelUnpack,
+		BufferTargetCount,
+	};
+
+	enum TextureTarget
+	{
+		Texture2D,
+		Texture2DArray,
+		Texture3D,
+		TextureCubeMap,
+		TextureBuffer,
+		TextureTargetCount,
+	};
+
+	struct IndexedBinding
+	{
+		GLuint		buffer;
+		GLintptr	offset;
+		GLsizeiptr	size;		///< 0 for glBindBufferBase.
+	};
+
+	enum { IndexedTargetCount = 2 };	///< uniform, shader storage.
+
+	struct UniformValue
+	{
+		GLint					first;		///< location of the write covering this one, -1 for none.
+		GLenum					type;		///< GL_FLOAT_VEC4... which call set it.
+		GLboolean				transpose;
+		GLsizei					count;		///< locations covered, arrays take one per element.
+		std::vector<uint8_t>	data;		///< the rest is only valid where first is this location.
+
+		UniformValue() : first(-1), type(0), transpose(GL_FALSE), count(0) {}
+	};
+
+	// per program, indexed by location. A write covering several
+	// locations keeps its value at the first one and points the rest
+	// there, so a lookup and dropping an overlapped write don't scan.
+	typedef std::vector<UniformValue> UniformValues;
+
+	static int getBufferTarget(GLenum target);
+	static int getIndexedTarget(GLenum target);
+	static int getTextureTarget(GLenum target);
+
+	bool filter(GLStateCategory category, bool redundant);
+	bool setUniform(GLint location, GLenum type, GLboolean transpose, GLsizei count, const void* data, size_t size);
+	static void forgetUniform(UniformValues& values, GLint first);
+	void forgetBuffer(GLuint buffer);
+
+	static void GLAD_API_PTR useProgram(GLuint program);
+	static void GLAD_API_PTR linkProgram(GLuint program);
+	static void GLAD_API_PTR programBinary(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+	static void GLAD_API_PTR deleteProgram(GLuint program);
+	static void GLAD_API_PTR bindVertexArray(GLuint vao);
+	static void GLAD_API_PTR deleteVertexArrays(GLsizei n, const GLuint* vaos);
+	static void GLAD_API_PTR bindBuffer(GLenum target, GLuint buffer);
+	static void GLAD_API_PTR bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+	static void GLAD_API_PTR bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	static void GLAD_API_PTR deleteBuffers(GLsizei n, const GLuint* buffers);
+	static void GLAD_API_PTR activeTexture(GLenum unit);
+	static void GLAD_API_PTR bindTexture(GLenum target, GLuint texture);
+	static void GLAD_API_PTR deleteTextures(GLsizei n, const GLuint* textures);
+	static void GLAD_API_PTR uniform1i(GLint location, GLint v0);
+	static void GLAD_API_PTR uniform1ui(GLint location, GLuint v0);
+	static void GLAD_API_PTR uniform1f(GLint location, GLfloat v0);
+	static void GLAD_API_PTR uniform4fv(GLint location, GLsizei count, const GLfloat* value);
+	static void GLAD_API_PTR uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat* value);
+
+	// the real entry points.
+	struct Entries
+	{
+		PFNGLUSEPROGRAMPROC				useProgram;
+		PFNGLLINKPROGRAMPROC			linkProgram;
+		PFNGLPROGRAMBINARYPROC			programBinary;
+		PFNGLDELETEPROGRAMPROC			deleteProgram;
+		PFNGLBINDVERTEXARRAYPROC		bindVertexArray;
+		PFNGLDELETEVERTEXARRAYSPROC		deleteVertexArrays;
+		PFNGLBINDBUFFERPROC				bindBuffer;
+		PFNGLBINDBUFFERBASEPROC			bindBufferBase;
+		PFNGLBINDBUFFERRANGEPROC		bindBufferRange;
+		PFNGLDELETEBUFFERSPROC			deleteBuffers;
+		PFNGLACTIVETEXTUREPROC			activeTexture;
+		PFNGLBINDTEXTUREPROC			bindTexture;
+		PFNGLDELETETEXTURESPROC			deleteTextures;
+		PFNGLUNIFORM1IPROC				uniform1i;
+		PFNGLUNIFORM1UIPROC				uniform1ui;
+		PFNGLUNIFORM1FPROC				uniform1f;
+		PFNGLUNIFORM4FVPROC				uniform4fv;
+		PFNGLUNIFORMMATRIX4FVPROC		uniformMatrix4fv;
+	};
+
+	static GLStateCache*	sActive;
+
+	Entries			mEntries;
+	GLuint			mProgram;		///< ~0 when not known.
+	GLuint			mVertexArray;
+	GLuint			mBuffers[BufferTargetCount];
+	IndexedBinding	mIndexed[IndexedTargetCount][MaxIndexedBindings];
+	GLuint			mActiveUnit;
+	GLuint			mTextures[MaxTextureUnits][TextureTargetCount];
+	std::unordered_map<GLuint, UniformValues>	mUniforms;
+
+	GLStateStats	mFrame;
+	GLStateStats	mLastFrame;
+	GLStateStats	mTotal;
+	uint32_t		mFrameCount;
+};
+
+#endif
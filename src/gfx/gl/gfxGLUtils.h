@@ -0,0 +1,14 @@
+#ifndef GFXGLUTILS_H_
+#define GFXGLUTILS_H_
+
+#include <glad/gl.h>
+
+#define gglHasExtension(EXTENSION) GLAD_GL_##EXTENSION
+
+// round offset up to the next multiple of alignment.
+inline GLintptr gglAlignOffset(GLintptr offset, GLintptr alignment)
+{
+	return alignment > 1 ? ((offset + alignment - 1) / alignment) * alignment : offset;
+}
+
+#endif
@@ -0,0 +1,164 @@
+#include "gfx/gl/gfxGLVertexLayout.h"
+#include "gfx/gl/gfxGLUtils.h"
+
+#include <string.h>
+
+static GLenum getGLType(GFXVertexElementType type)
+{
+	switch (type)
+	{
+	case GFXVertexUByteNorm:
+		return GL_UNSIGNED_BYTE;
+	case GFXVertexShortNorm:
+		return GL_SHORT;
+	case GFXVertexUInt:
+		return GL_UNSIGNED_INT;
+	case GFXVertexFloat:
+	default:
+		return GL_FLOAT;
+	}
+}
+
+GLVertexLayoutCache::GLVertexLayoutCache()
+{
+	mAttribBinding = false;
+}
+
+GLVertexLayoutCache::~GLVertexLayoutCache()
+{
+	destroy();
+}
+
+void GLVertexLayoutCache::init()
+{
+	destroy();
+	mAttribBinding = gglHasExtension(ARB_vertex_attrib_binding) || gglHasExtension(VERSION_4_3);
+}
+
+void GLVertexLayoutCache::destroy()
+{
+	for (size_t i = 0; i < mLayouts.size(); i++)
+		glDeleteVertexArrays(1, &mLayouts[i].vao);
+
+	mLayouts.clear();
+}
+
+GLVertexLayoutCache::Layout* GLVertexLayoutCache::find(const GFXVertexFormat& format, const GLuint* buffers, const GLintptr* offsets, GLuint indexBuffer)
+{
+	for (size_t i = 0; i < mLayouts.size(); i++)
+	{
+		Layout& layout = mLayouts[i];
+		if (layout.format != format)
+			continue;
+
+		// with separate formats any buffers can go on the same VAO.
+		if (mAttribBinding)
+			return &layout;
+
+		bool same = layout.indexBuffer == indexBuffer;
+		for (uint32_t s = 0; s < format.getStreamCount() && same; s++)
+			same = layout.buffers[s] == buffers[s] && layout.offsets[s] == (offsets ? offsets[s] : 0);
+
+		if (same)
+			return &layout;
+	}
+
+	return NULL;
+}
+
+GLuint GLVertexLayoutCache::bind(const GFXVertexFormat& format, const GLuint* buffers, const GLintptr* offsets, GLuint indexBuffer)
+{
+	Layout* layout = find(format, buffers, offsets, indexBuffer);
+	if (!layout)
+	{
+		Layout created;
+		created.format = format;
+		glGenVertexArrays(1, &created.vao);
+		for (uint32_t s = 0; s < GFXVertexFormat::MaxStreams; s++)
+		{
+			created.buffers[s] = s < format.getStreamCount() ? buffers[s] : 0;
+			created.offsets[s] = s < format.getStreamCount() && offsets ? offsets[s] : 0;
+		}
+		created.indexBuffer = indexBuffer;
+
+		glBindVertexArray(created.vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		if (mAttribBinding)
+			setupFormat(created);
+		else
+			setupPointers(created);
+
+		mLayouts.push_back(created);
+		return created.vao;
+	}
+
+	glBindVertexArray(layout->vao);
+	if (!mAttribBinding)
+		return layout->vao;
+
+	// the VAO remembers its bindings, only touch what changed.
+	for (uint32_t s = 0; s < format.getStreamCount(); s++)
+	{
+		GLintptr offset = offsets ? offsets[s] : 0;
+		if (layout->buffers[s] != buffers[s] || layout->offsets[s] != offset)
+		{
+			glBindVertexBuffer(s, buffers[s], offset, format.getStride(s));
+			layout->buffers[s] = buffers[s];
+			layout->offsets[s] = offset;
+		}
+	}
+
+	if (layout->indexBuffer != indexBuffer)
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		layout->indexBuffer = indexBuffer;
+	}
+
+	return layout->vao;
+}
+
+void GLVertexLayoutCache::setupFormat(const Layout& layout)
+{
+	const GFXVertexFormat& format = layout.format;
+
+	for (uint32_t i = 0; i < format.getElementCount(); i++)
+	{
+		const GFXVertexElement& e = format.getElement(i);
+		if (e.type == GFXVertexUInt)
+			glVertexAttribIFormat(e.location, e.components, GL_UNSIGNED_INT, e.offset);
+		else
+			glVertexAttribFormat(e.location, e.components, getGLType(e.type), e.type != GFXVertexFloat, e.offset);
+
+		glVertexAttribBinding(e.location, e.stream);
+		glEnableVertexAttribArray(e.location);
+	}
+
+	for (uint32_t s = 0; s < format.getStreamCount(); s++)
+	{
+		glVertexBindingDivisor(s, format.getStreamDivisor(s));
+		glBindVertexBuffer(s, layout.buffers[s], layout.offsets[s], format.getStride(s));
+	}
+}
+
+void GLVertexLayoutCache::setupPointers(const Layout& layout)
+{
+	const GFXVertexFormat& format = layout.format;
+
+	for (uint32_t i = 0; i < format.getElementCount(); i++)
+	{
+		const GFXVertexElement& e = format.getElement(i);
+		const GLsizei stride = format.getStride(e.stream);
+		const void* pointer = (const void*)(layout.offsets[e.stream] + e.offset);
+
+		glBindBuffer(GL_ARRAY_BUFFER, layout.buffers[e.stream]);
+		if (e.type == GFXVertexUInt)
+			glVertexAttribIPointer(e.location, e.components, GL_UNSIGNED_INT, stride, pointer);
+		else
+			glVertexAttribPointer(e.location, e.components, getGLType(e.type), e.type != GFXVertexFloat, stride, pointer);
+
+		glVertexAttribDivisor(e.location, format.getStreamDivisor(e.stream));
+		glEnableVertexAttribArray(e.location);
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
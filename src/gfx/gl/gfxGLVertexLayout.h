@@ -0,0 +1,55 @@
+#ifndef GFXGLVERTEXLAYOUT_H_
+#define GFXGLVERTEXLAYOUT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "gfx/gfxVertexFormat.h"
+
+//-------------------------------------------------------------
+// Vertex layout cache
+//-------------------------------------------------------------
+// Hands out VAOs for vertex formats. With ARB_vertex_attrib_binding
+// the attribute layout is set once per format through
+// glVertexAttribFormat/glVertexAttribBinding, and switching meshes
+// only rebinds the vertex buffers on the shared VAO. Without it the
+// buffers are baked into the attribute pointers, so each buffer set
+// gets its own VAO.
+class GLVertexLayoutCache
+{
+public:
+	GLVertexLayoutCache();
+	~GLVertexLayoutCache();
+
+	void init();
+	void destroy();
+
+	// bind a VAO for the format with one buffer (and base offset) per
+	// stream, offsets may be NULL. Returns the bound VAO.
+	GLuint bind(const GFXVertexFormat& format, const GLuint* buffers, const GLintptr* offsets, GLuint indexBuffer);
+
+	bool		hasAttribBinding() const { return mAttribBinding; }
+	uint32_t	getVAOCount() const { return (uint32_t)mLayouts.size(); }
+
+private:
+	struct Layout
+	{
+		GFXVertexFormat	format;
+		GLuint			vao;
+		GLuint			buffers[GFXVertexFormat::MaxStreams];	///< currently bound.
+		GLintptr		offsets[GFXVertexFormat::MaxStreams];
+		GLuint			indexBuffer;
+	};
+
+	Layout* find(const GFXVertexFormat& format, const GLuint* buffers, const GLintptr* offsets, GLuint indexBuffer);
+	void setupFormat(const Layout& layout);
+	void setupPointers(const Layout& layout);
+
+	bool				mAttribBinding;
+	std::vector<Layout>	mLayouts;
+};
+
+#endif
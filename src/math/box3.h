@@ -0,0 +1,49 @@
+#ifndef BOX3_H_
+#define BOX3_H_
+
+#ifndef MATRIX_H_
+#include "matrix.h"
+#endif
+
+// axis aligned bounding box.
+struct Box3
+{
+	Vector3 minExtents;
+	Vector3 maxExtents;
+
+	Box3() {}
+	Box3(const Vector3& minExtents, const Vector3& maxExtents) : minExtents(minExtents), maxExtents(maxExtents) {}
+
+	Vector3     getCenter() const { return (minExtents + maxExtents) * 0.5f; }
+	Vector3     getHalfSize() const { return (maxExtents - minExtents) * 0.5f; }
+	float       getRadius() const { return getHalfSize().length(); }   // bounding sphere around the center
+
+	Box3        transform(const Matrix4& m) const;                  // box around the transformed box
+	Box3&       merge(const Box3& box);                             // grow to contain box
+};
+
+inline Box3 Box3::transform(const Matrix4& mat) const
+{
+	// Arvo, the new half size is the absolute 3x3 applied to the old one.
+	const float* m = mat.get();
+	const Vector3 c = getCenter();
+	const Vector3 h = getHalfSize();
+
+	const Vector3 center(m[0] * c.x + m[4] * c.y + m[8] * c.z + m[12],
+		m[1] * c.x + m[5] * c.y + m[9] * c.z + m[13],
+		m[2] * c.x + m[6] * c.y + m[10] * c.z + m[14]);
+	const Vector3 half(fabsf(m[0]) * h.x + fabsf(m[4]) * h.y + fabsf(m[8]) * h.z,
+		fabsf(m[1]) * h.x + fabsf(m[5]) * h.y + fabsf(m[9]) * h.z,
+		fabsf(m[2]) * h.x + fabsf(m[6]) * h.y + fabsf(m[10]) * h.z);
+
+	return Box3(center - half, center + half);
+}
+
+inline Box3& Box3::merge(const Box3& box)
+{
+	minExtents.set(std::min(minExtents.x, box.minExtents.x), std::min(minExtents.y, box.minExtents.y), std::min(minExtents.z, box.minExtents.z));
+	maxExtents.set(std::max(maxExtents.x, box.maxExtents.x), std::max(maxExtents.y, box.maxExtents.y), std::max(maxExtents.z, box.maxExtents.z));
+	return *this;
+}
+
+#endif
@@ -0,0 +1,85 @@
+#include "frustum.h"
+
+#include <cmath>
+
+void Frustum::set(const Matrix4& viewProj)
+{
+	// Gribb/Hartmann, rows of the column major matrix.
+	const float* m = viewProj.get();
+	Vector4 row0(m[0], m[4], m[8], m[12]);
+	Vector4 row1(m[1], m[5], m[9], m[13]);
+	Vector4 row2(m[2], m[6], m[10], m[14]);
+	Vector4 row3(m[3], m[7], m[11], m[15]);
+
+	planes[PlaneLeft] = row3 + row0;
+	planes[PlaneRight] = row3 - row0;
+	planes[PlaneBottom] = row3 + row1;
+	planes[PlaneTop] = row3 - row1;
+	planes[PlaneNear] = row3 + row2;
+	planes[PlaneFar] = row3 - row2;
+
+	for (int i = 0; i < PlaneCount; i++)
+	{
+		Vector4& p = planes[i];
+		float invLength = 1.0f / sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+		p *= invLength;
+	}
+}
+
+bool Frustum::intersectsSphere(const Vector3& center, float radius) const
+{
+	for (int i = 0; i < PlaneCount; i++)
+	{
+		const Vector4& p = planes[i];
+		if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+			return false;
+	}
+
+	return true;
+}
+
+bool Frustum::intersectsBox(const Vector3& minExtents, const Vector3& maxExtents) const
+{
+	for (int i = 0; i < PlaneCount; i++)
+	{
+		// test the corner furthest along the plane normal.
+		const Vector4& p = planes[i];
+		float x = p.x >= 0.0f ? maxExtents.x : minExtents.x;
+		float y = p.y >= 0.0f ? maxExtents.y : minExtents.y;
+		float z = p.z >= 0.0f ? maxExtents.z : minExtents.z;
+		if (p.x * x + p.y * y + p.z * z + p.w < 0.0f)
+			return false;
+	}
+
+	return true;
+}
+
+// point where three planes meet, false when two of them are parallel.
+static bool intersectPlanes(const Vector4& a, const Vector4& b, const Vector4& c, Vector3& point)
+{
+	const Vector3 na(a.x, a.y, a.z);
+	const Vector3 nb(b.x, b.y, b.z);
+	const Vector3 nc(c.x, c.y, c.z);
+	const Vector3 bc = nb.cross(nc);
+	const float denom = na.dot(bc);
+	if (fabsf(denom) < 1e-12f)
+		return false;
+
+	point = (bc * -a.w + nc.cross(na) * -b.w + na.cross(nb) * -c.w) / denom;
+	return true;
+}
+
+bool Frustum::getCorners(Vector3 corners[8]) const
+{
+	// bit 0 picks right over left, bit 1 top over bottom, bit 2 far over near.
+	for (int i = 0; i < 8; i++)
+	{
+		const Vector4& x = planes[(i & 1) ? PlaneRight : PlaneLeft];
+		const Vector4& y = planes[(i & 2) ? PlaneTop : PlaneBottom];
+		const Vector4& z = planes[(i & 4) ? PlaneFar : PlaneNear];
+		if (!intersectPlanes(x, y, z, corners[i]))
+			return false;
+	}
+
+	return true;
+}
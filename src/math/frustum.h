@@ -0,0 +1,34 @@
+#ifndef FRUSTUM_H_
+#define FRUSTUM_H_
+
+#ifndef MATRIX_H_
+#include "matrix.h"
+#endif
+
+// view frustum as 6 inward facing planes (xyz = normal, w = distance).
+struct Frustum
+{
+	enum
+	{
+		PlaneLeft = 0,
+		PlaneRight,
+		PlaneBottom,
+		PlaneTop,
+		PlaneNear,
+		PlaneFar,
+		PlaneCount
+	};
+
+	Vector4 planes[PlaneCount];
+
+	Frustum() {}
+	Frustum(const Matrix4& viewProj) { set(viewProj); }
+
+	void        set(const Matrix4& viewProj);              // extract planes from a column major view projection
+	bool        intersectsSphere(const Vector3& center, float radius) const;
+	bool        intersectsBox(const Vector3& minExtents, const Vector3& maxExtents) const;
+	bool        getCorners(Vector3 corners[8]) const;       // near then far, false if planes are parallel
+	const float* get() const { return &planes[0].x; }
+};
+
+#endif
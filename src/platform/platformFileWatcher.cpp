@@ -0,0 +1,202 @@
+#include "platform/platformFileWatcher.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+PlatformFileWatcher::PlatformFileWatcher()
+{
+#ifdef _WIN32
+	mChangeHandle = NULL;
+#else
+	mNotifyFd = -1;
+	mWatchFd = -1;
+#endif
+}
+
+PlatformFileWatcher::~PlatformFileWatcher()
+{
+	destroy();
+}
+
+void PlatformFileWatcher::addUnique(std::vector<std::string>& list, const std::string& name)
+{
+	for (size_t i = 0; i < list.size(); i++)
+	{
+		if (list[i] == name)
+			return;
+	}
+	list.push_back(name);
+}
+
+#ifdef _WIN32
+
+bool PlatformFileWatcher::init(const char* directory)
+{
+	destroy();
+	mDirectory = directory;
+
+	HANDLE handle = FindFirstChangeNotificationA(directory, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		printf("Can't watch %s for changes.\n", directory);
+		return false;
+	}
+
+	mChangeHandle = handle;
+	return true;
+}
+
+void PlatformFileWatcher::destroy()
+{
+	if (mChangeHandle)
+		FindCloseChangeNotification((HANDLE)mChangeHandle);
+
+	mChangeHandle = NULL;
+	mFiles.clear();
+}
+
+bool PlatformFileWatcher::isActive() const
+{
+	return mChangeHandle != NULL;
+}
+
+uint64_t PlatformFileWatcher::getLastWrite(const std::string& name) const
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	std::string path = mDirectory + "/" + name;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+		return 0;
+
+	return ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+}
+
+bool PlatformFileWatcher::poll(std::vector<std::string>& changed)
+{
+	if (!mChangeHandle)
+		return false;
+
+	// the handle only says something in the directory was written.
+	if (WaitForSingleObject((HANDLE)mChangeHandle, 0) != WAIT_OBJECT_0)
+		return false;
+
+	FindNextChangeNotification((HANDLE)mChangeHandle);
+
+	bool any = false;
+	for (size_t i = 0; i < mFiles.size(); i++)
+	{
+		uint64_t lastWrite = getLastWrite(mFiles[i].name);
+		if (lastWrite != mFiles[i].lastWrite)
+		{
+			mFiles[i].lastWrite = lastWrite;
+			addUnique(changed, mFiles[i].name);
+			any = true;
+		}
+	}
+
+	return any;
+}
+
+#else
+
+bool PlatformFileWatcher::init(const char* directory)
+{
+	destroy();
+	mDirectory = directory;
+
+	mNotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (mNotifyFd < 0)
+	{
+		printf("inotify_init1 failed: %s\n", strerror(errno));
+		return false;
+	}
+
+	// editors either rewrite the file or rename a new one over it.
+	mWatchFd = inotify_add_watch(mNotifyFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (mWatchFd < 0)
+	{
+		printf("Can't watch %s for changes: %s\n", directory, strerror(errno));
+		destroy();
+		return false;
+	}
+
+	return true;
+}
+
+void PlatformFileWatcher::destroy()
+{
+	if (mNotifyFd >= 0)
+		close(mNotifyFd);
+
+	mNotifyFd = -1;
+	mWatchFd = -1;
+	mFiles.clear();
+}
+
+bool PlatformFileWatcher::isActive() const
+{
+	return mNotifyFd >= 0;
+}
+
+uint64_t PlatformFileWatcher::getLastWrite(const std::string&) const
+{
+	return 0;
+}
+
+bool PlatformFileWatcher::poll(std::vector<std::string>& changed)
+{
+	if (mNotifyFd < 0)
+		return false;
+
+	bool any = false;
+	char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while (1)
+	{
+		ssize_t length = read(mNotifyFd, buffer, sizeof(buffer));
+		if (length <= 0)
+			break;
+
+		for (char* ptr = buffer; ptr < buffer + length; )
+		{
+			const struct inotify_event* event = (const struct inotify_event*)ptr;
+			ptr += sizeof(struct inotify_event) + event->len;
+
+			if (!event->len)
+				continue;
+
+			for (size_t i = 0; i < mFiles.size(); i++)
+			{
+				if (mFiles[i].name == event->name)
+				{
+					addUnique(changed, mFiles[i].name);
+					any = true;
+				}
+			}
+		}
+	}
+
+	return any;
+}
+
+#endif
+
+void PlatformFileWatcher::watch(const char* file)
+{
+	for (size_t i = 0; i < mFiles.size(); i++)
+	{
+		if (mFiles[i].name == file)
+			return;
+	}
+
+	WatchedFile watched;
+	watched.name = file;
+	watched.lastWrite = getLastWrite(watched.name);
+	mFiles.push_back(watched);
+}
@@ -0,0 +1,54 @@
+#ifndef PLATFORMFILEWATCHER_H_
+#define PLATFORMFILEWATCHER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+//-------------------------------------------------------------
+// File watcher
+//-------------------------------------------------------------
+// Reports writes to files in one directory. inotify on Linux, a
+// change notification handle plus last write times on Win32. poll()
+// never blocks, call it once a frame.
+class PlatformFileWatcher
+{
+public:
+	PlatformFileWatcher();
+	~PlatformFileWatcher();
+
+	bool init(const char* directory);
+	void destroy();
+
+	// file name relative to the watched directory.
+	void watch(const char* file);
+
+	// appends every watched file written since the last poll, each
+	// name at most once. Returns true when something changed.
+	bool poll(std::vector<std::string>& changed);
+
+	bool isActive() const;
+
+private:
+	struct WatchedFile
+	{
+		std::string	name;
+		uint64_t	lastWrite;	///< Win32 only.
+	};
+
+	static void addUnique(std::vector<std::string>& list, const std::string& name);
+	uint64_t getLastWrite(const std::string& name) const;
+
+	std::string					mDirectory;
+	std::vector<WatchedFile>	mFiles;
+
+#ifdef _WIN32
+	void*	mChangeHandle;
+#else
+	int		mNotifyFd;
+	int		mWatchFd;
+#endif
+};
+
+#endif
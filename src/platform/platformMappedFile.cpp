@@ -0,0 +1,157 @@
+#include "platform/platformMappedFile.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+PlatformMappedFile::PlatformMappedFile()
+{
+	mData = NULL;
+	mSize = 0;
+#ifdef _WIN32
+	mFile = NULL;
+	mMapping = NULL;
+#else
+	mFd = -1;
+#endif
+}
+
+PlatformMappedFile::~PlatformMappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool PlatformMappedFile::open(const char* path)
+{
+	close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+	{
+		printf("Can't map %s.\n", path);
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		printf("Can't map %s.\n", path);
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mFile = file;
+	mMapping = mapping;
+	mData = (const uint8_t*)view;
+	mSize = (uint64_t)size.QuadPart;
+	return true;
+}
+
+void PlatformMappedFile::close()
+{
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMapping)
+		CloseHandle((HANDLE)mMapping);
+	if (mFile)
+		CloseHandle((HANDLE)mFile);
+
+	mData = NULL;
+	mSize = 0;
+	mFile = NULL;
+	mMapping = NULL;
+}
+
+// PrefetchVirtualMemory only exists from Windows 8 on.
+typedef BOOL (WINAPI *PrefetchVirtualMemoryFunc)(HANDLE process, ULONG_PTR entryCount, PWIN32_MEMORY_RANGE_ENTRY entries, ULONG flags);
+
+void PlatformMappedFile::prefetch(uint64_t offset, uint64_t size) const
+{
+	static PrefetchVirtualMemoryFunc prefetchMemory = (PrefetchVirtualMemoryFunc)(void*)GetProcAddress(GetModuleHandleA("kernel32.dll"), "PrefetchVirtualMemory");
+	if (!prefetchMemory || !mData || offset >= mSize)
+		return;
+
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = (PVOID)(mData + offset);
+	range.NumberOfBytes = (SIZE_T)(size < mSize - offset ? size : mSize - offset);
+	prefetchMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool PlatformMappedFile::open(const char* path)
+{
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (view == MAP_FAILED)
+	{
+		printf("Can't map %s.\n", path);
+		::close(fd);
+		return false;
+	}
+
+	mFd = fd;
+	mData = (const uint8_t*)view;
+	mSize = (uint64_t)info.st_size;
+	return true;
+}
+
+void PlatformMappedFile::close()
+{
+	if (mData)
+		munmap((void*)mData, (size_t)mSize);
+	if (mFd >= 0)
+		::close(mFd);
+
+	mData = NULL;
+	mSize = 0;
+	mFd = -1;
+}
+
+void PlatformMappedFile::prefetch(uint64_t offset, uint64_t size) const
+{
+	if (!mData || offset >= mSize)
+		return;
+
+	// madvise wants a page aligned start.
+	const uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+	const uint64_t start = offset & ~(pageSize - 1);
+	const uint64_t end = size < mSize - offset ? offset + size : mSize;
+	madvise((void*)(mData + start), (size_t)(end - start), MADV_WILLNEED);
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PLATFORMMAPPEDFILE_H_
+#define PLATFORMMAPPEDFILE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+//-------------------------------------------------------------
+// Mapped file
+//-------------------------------------------------------------
+// Read only view of a whole file, mmap on Linux and a file mapping on
+// Win32. Nothing is read up front, pages fault in as they're touched,
+// so the data can go straight to buffer uploads without a copy.
+class PlatformMappedFile
+{
+public:
+	PlatformMappedFile();
+	~PlatformMappedFile();
+
+	bool open(const char* path);
+	void close();
+
+	// hint that a range will be read soon, so the OS can read ahead.
+	void prefetch(uint64_t offset, uint64_t size) const;
+
+	bool			isOpen() const { return mData != NULL; }
+	const uint8_t*	getData() const { return mData; }
+	uint64_t		getSize() const { return mSize; }
+
+private:
+	// not copyable, the mapping is owned.
+	PlatformMappedFile(const PlatformMappedFile&);
+	PlatformMappedFile& operator=(const PlatformMappedFile&);
+
+	const uint8_t*	mData;
+	uint64_t		mSize;
+
+#ifdef _WIN32
+	void*	mFile;
+	void*	mMapping;
+#else
+	int		mFd;
+#endif
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "platform/platformThread.h"
+
+#include <string.h>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+
+// SetThreadDescription only exists from Windows 10 1607 on.
+typedef HRESULT (WINAPI *SetThreadDescriptionFunc)(HANDLE thread, PCWSTR description);
+
+void platformSetThreadName(const char* name)
+{
+	static SetThreadDescriptionFunc setDescription = (SetThreadDescriptionFunc)(void*)GetProcAddress(GetModuleHandleA("kernel32.dll"), "SetThreadDescription");
+	if (!setDescription)
+		return;
+
+	wchar_t wideName[64];
+	MultiByteToWideChar(CP_UTF8, 0, name, -1, wideName, 64);
+	wideName[63] = 0;
+	setDescription(GetCurrentThread(), wideName);
+}
+
+bool platformPinThread(uint32_t core)
+{
+	if (core >= sizeof(DWORD_PTR) * 8)
+		return false;
+
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << core) != 0;
+}
+
+#else
+#include <pthread.h>
+#include <sched.h>
+
+void platformSetThreadName(const char* name)
+{
+	char shortName[16];
+	strncpy(shortName, name, sizeof(shortName) - 1);
+	shortName[sizeof(shortName) - 1] = 0;
+	pthread_setname_np(pthread_self(), shortName);
+}
+
+bool platformPinThread(uint32_t core)
+{
+	if (core >= CPU_SETSIZE)
+		return false;
+
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#endif
+
+uint32_t platformGetCoreCount()
+{
+	uint32_t count = std::thread::hardware_concurrency();
+	return count ? count : 1;
+}
@@ -0,0 +1,17 @@
+#ifndef PLATFORMTHREAD_H_
+#define PLATFORMTHREAD_H_
+
+#include <stdint.h>
+
+// Thread helpers, all of them act on the calling thread.
+
+// name shown in debuggers and profilers. Linux keeps 15 characters.
+void platformSetThreadName(const char* name);
+
+// restrict the thread to one logical core, false when the OS refused.
+bool platformPinThread(uint32_t core);
+
+// logical cores, at least 1.
+uint32_t platformGetCoreCount();
+
+#endif
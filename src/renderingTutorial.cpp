@@ -1,7 +1,9 @@
 
 #define no_init_all deprecated
 #include <stdio.h>
+#include <float.h>
 #include <assert.h>
+#include <string.h>
 #include <chrono>
 #include <vector>
 #include <fstream>
@@ -14,6 +16,34 @@
 #pragma warning(disable : 4996)
 
 #include "math/matrix.h"
+#include "math/frustum.h"
+#include "gfx/gfxShaderConstants.h"
+#include "gfx/gfxMeshBuilder.h"
+#include "gfx/gfxMeshSimplifier.h"
+#include "gfx/gfxMeshletBuilder.h"
+#include "gfx/gfxMeshFile.h"
+#include "gfx/gfxMeshImporter.h"
+#include "gfx/gfxEmbeddedShaders.h"
+#include "core/coreAssetStreamer.h"
+#include "core/coreArchive.h"
+#include "gfx/gfxVertexFormat.h"
+#include "gfx/gl/gfxGLUtils.h"
+#include "gfx/gl/gfxGLDeviceCaps.h"
+#include "gfx/gl/gfxGLCircularBuffer.h"
+#include "gfx/gl/gfxGLInstanceBuffer.h"
+#include "gfx/gl/gfxGLIndirectCuller.h"
+#include "gfx/gl/gfxGLVertexLayout.h"
+#include "gfx/gl/gfxGLShaderCache.h"
+#include "gfx/gl/gfxGLProgramCompiler.h"
+#include "gfx/gl/gfxGLShaderReloader.h"
+#include "gfx/gl/gfxGLStateCache.h"
+#include "gfx/gl/gfxGLDrawList.h"
+#include "gfx/gfxScene.h"
+#include "core/coreJobSystem.h"
+#include "core/coreJobBenchmark.h"
+#include "core/coreBVH.h"
+#include "core/coreBVHBenchmark.h"
+#include "core/coreSpatialGridBenchmark.h"
 
 #ifndef NDEBUG
 #   define assertFatal(Expr, Msg) \
@@ -270,172 +300,29 @@ static void InitWindow()
 //-------------------------------------------------------------
 // Opengl loading
 //-------------------------------------------------------------
-struct GFXAdapterLUID
-{
-	unsigned long LowPart;
-	long HighPart;
-};
-
-struct GFXDevice {
-	char mName[512];
-	char mOutputName[512];
-	GFXAdapterLUID mLUID;
-	const char *getName() const { return mName; }
-	const char *getOutputName() const { return mOutputName; }
-	UINT32 mIndex;
-
-	GFXDevice()
-	{
-		mName[0] = 0;
-		mOutputName[0] = 0;
-		mIndex = 0;
-		memset(&mLUID, '\0', sizeof(mLUID));
-	}
-	~GFXDevice() {}
-
-};
-
 void* mContext;
 
 #define gglHasWExtension(EXTENSION) GLAD_WGL_##EXTENSION
-#define gglHasExtension(EXTENSION) GLAD_GL_##EXTENSION
 
 void gglPerformBinds()
 {
 	printf("Load Glad binds. \n");
 	if (!gladLoaderLoadGL())
-	{
-		return;
-	}
+		assertFatal(false, "Failed to load OpenGL.");
 }
 
 void gglPerformExtensionBinds(void *context)
 {
 	printf("Load WGL binds. \n");
 	if (!gladLoaderLoadWGL((HDC)context))
-	{
-		return;
-	}
-}
-
-void loadGLCore()
-{
-	printf("Load glad core.\n");
-	static bool coreLoaded = false; // Guess what this is for.
-	if (coreLoaded)
-		return;
-	coreLoaded = true;
-
-	// Make sure we've got our GL bindings.
-	gglPerformBinds();
-}
-
-void loadGLExtensions(void *context)
-{
-	printf("Load extensions for wgl. \n");
-	static bool extensionsLoaded = false;
-	if (extensionsLoaded)
-		return;
-	extensionsLoaded = true;
-
-	gglPerformExtensionBinds(context);
-}
-
-GFXDevice* initOpenGL()
-{
-	printf("Temp init OpenGL for hardware initializing and capabilities.\n\n");
-	printf("--------------------------------------------\n");
-	WNDCLASS windowClass;
-	memset(&windowClass, 0, sizeof(WNDCLASS));
-
-	windowClass.lpszClassName = L"GFX-OpenGL";
-	windowClass.style = CS_OWNDC;
-	windowClass.lpfnWndProc = DefWindowProc;
-	windowClass.hInstance = winState.appInstance;
-
-	if (!RegisterClass(&windowClass))
-		assertFatal(false, "Failed to register the window.");
-
-	// create test window.
-	HWND hwnd = CreateWindow(L"GFX-OpenGL", L"", WS_POPUP, 0, 0, 640, 480,
-		NULL, NULL, winState.appInstance, NULL);
-
-	assertFatal(hwnd != NULL, "Failed to create test window.");
-
-	// create device context
-	HDC tempDC = GetDC(hwnd);
-	assertFatal(tempDC != NULL, "Failed to create device context.");
-
-	PIXELFORMATDESCRIPTOR pfd; 
-	CreatePixelFormat(&pfd, 32, 0, 0, false);
-	if (!SetPixelFormat(tempDC, ChoosePixelFormat(tempDC, &pfd), &pfd))
-		assertFatal(false, "Failed to set pixel format");
-
-	// rendering context
-	HGLRC tempGLRC = wglCreateContext(tempDC);
-	if (!wglMakeCurrent(tempDC, tempGLRC))
-		assertFatal(false, "Failed to create windows rendering context and make it current.");
-
-	// Add the GL renderer
-	loadGLCore();
-	loadGLExtensions(tempDC);
-
-	GFXDevice *toAdd = new GFXDevice();
-	toAdd->mIndex = 0;
-
-	GLint maj, min;
-	glGetIntegerv(GL_MAJOR_VERSION, &maj);
-	glGetIntegerv(GL_MINOR_VERSION, &min);
-
-	const char* renderer = (const char*)glGetString(GL_RENDERER);
-	assertFatal(renderer != NULL, "GL_RENDERER returned NULL!");
-	if (renderer)
-	{
-		strncpy(toAdd->mName, renderer, 512);
-		strncat(toAdd->mName, " OpenGL", 512);
-	}
-	else
-		strncpy(toAdd->mName, "OpenGL", 512);
-
-	printf("Renderer: %s \n", toAdd->mName);
-	printf("Capabilities:\n");
-	printf("\tSupports: OPENGL %d.%d \n", maj, min);
-	GLint maxTexSize;
-	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTexSize);
-	printf("\tMax Texture Size: %d \n", maxTexSize);
-
-	if (gglHasExtension(EXT_texture_filter_anisotropic))
-	{
-		printf("\tAnistropic filtering supported.\n");
-	}
-	if (gglHasExtension(ARB_buffer_storage))
-	{
-		printf("\tBuffer storage supported.\n");
-	}
-	if (gglHasExtension(ARB_texture_storage))
-	{
-		printf("\tTexture storage supported.\n");
-	}
-	if (gglHasExtension(ARB_copy_image))
-	{
-		printf("\tCopy image supported.\n");
-	}
-	if (gglHasExtension(ARB_vertex_attrib_binding))
-	{
-		printf("\tVertex attrib binding supported.\n");
-	}
-	printf("--------------------------------------------\n\n");
-
-	// Cleanup our window
-	wglMakeCurrent(NULL, NULL);
-	wglDeleteContext(tempGLRC);
-	ReleaseDC(hwnd, tempDC);
-	DestroyWindow(hwnd);
-	UnregisterClass(L"GFX-OpenGL", winState.appInstance);
-
-	return toAdd;
+		assertFatal(false, "Failed to load WGL.");
 }
 
+// Makes the one context we render with, on the window itself, and
+// loads WGL and GL once each. wglCreateContextAttribsARB only comes
+// out of WGL through a current context, so a legacy context on the
+// window's DC loads WGL and is then swapped for the real one. Without
+// ARB_create_context the legacy context is the real one.
 void initFinalState(HWND window)
 {
 	printf("Actually make our opengl context we will use \n");
@@ -459,11 +346,13 @@ void initFinalState(HWND window)
 	int debugFlag = 0;
 #endif
 
-	// Create a temp rendering context, needed a current context to use wglCreateContextAttribsARB
-	HGLRC tempGLRC = wglCreateContext(hdcGL);
-	if (!wglMakeCurrent(hdcGL, tempGLRC))
-		assertFatal(false, "Couldn't make temp GL context.");
+	HGLRC legacyGLRC = wglCreateContext(hdcGL);
+	if (!wglMakeCurrent(hdcGL, legacyGLRC))
+		assertFatal(false, "Couldn't make legacy GL context.");
+
+	gglPerformExtensionBinds(hdcGL);
 
+	mContext = legacyGLRC;
 	if (gglHasWExtension(ARB_create_context))
 	{
 		int const create_attribs[] = {
@@ -480,107 +369,330 @@ void initFinalState(HWND window)
 		{
 			assertFatal(0, "");
 		}
+
+		wglMakeCurrent(NULL, NULL);
+		wglDeleteContext(legacyGLRC);
+		if (!wglMakeCurrent(hdcGL, (HGLRC)mContext))
+			assertFatal(false, "Cannot make our context current.");
+	}
+
+	// GL entry points are loaded against the context we keep.
+	gglPerformBinds();
+}
+
+// the device behind the current context. Its caps are read from
+// capsPath when they were saved for this driver, probed and saved
+// there otherwise.
+GFXDevice* initOpenGL(const char* capsPath)
+{
+	printf("--------------------------------------------\n");
+	GFXDevice *device = new GFXDevice();
+	device->mIndex = 0;
+
+	const bool cached = gglLoadDeviceCaps(capsPath, device->mCaps);
+	const GFXDeviceCaps& caps = device->getCaps();
+	assertFatal(caps.renderer[0] != 0, "GL_RENDERER returned NULL!");
+	snprintf(device->mName, sizeof(device->mName), "%s OpenGL", caps.renderer[0] ? caps.renderer : "");
+
+	printf("Device caps %s.\n", cached ? "loaded from the cache" : "probed");
+	gglPrintDeviceCaps(caps);
+	printf("--------------------------------------------\n\n");
+
+	return device;
+}
+
+// point whichever of our uniform blocks the program uses at their slots.
+static void BindUniformBlocks(const GLProgramReflection& program, void* userData)
+{
+	program.bindUniformBlock(GFXFrameConstantsName, GFXFrameConstantsBinding);
+	program.bindUniformBlock(GFXObjectConstantsName, GFXObjectConstantsBinding);
+}
+
+static void SetCullProgram(const GLProgramReflection& program, void* userData)
+{
+	((GLIndirectCuller*)userData)->setCullProgram(program);
+}
+
+// world space ray through the center of a window pixel, starting on the near plane.
+static void GetPickRay(const Matrix4& invViewProj, int x, int y, int width, int height, Vector3& origin, Vector3& direction)
+{
+	const float ndcX = 2.0f * (x + 0.5f) / width - 1.0f;
+	const float ndcY = 1.0f - 2.0f * (y + 0.5f) / height;
+	const Vector4 nearPoint = invViewProj * Vector4(ndcX, ndcY, -1.0f, 1.0f);
+	const Vector4 farPoint = invViewProj * Vector4(ndcX, ndcY, 1.0f, 1.0f);
+
+	origin = Vector3(nearPoint.x, nearPoint.y, nearPoint.z) / nearPoint.w;
+	direction = Vector3(farPoint.x, farPoint.y, farPoint.z) / farPoint.w - origin;
+}
+
+// lumpy sphere, position and color interleaved. One vertex per pole
+// and the seam columns shared, so it simplifies without locked seams.
+static void BuildBlobMesh(GFXMeshData& mesh, UINT32 rings, UINT32 segments)
+{
+	mesh.vertexStride = 6;
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	for (UINT32 r = 0; r <= rings; r++)
+	{
+		for (UINT32 s = 0; s < segments; s++)
+		{
+			if ((r == 0 || r == rings) && s > 0)
+				continue;
+
+			const float theta = PI * r / rings;
+			const float phi = 2.0f * PI * s / segments;
+			const Vector3 dir(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+			const float radius = 1.0f + 0.15f * sinf(5.0f * dir.x) * sinf(4.0f * dir.y) * sinf(3.0f * dir.z);
+			const float vertex[6] = { dir.x * radius, dir.y * radius, dir.z * radius, dir.x * 0.5f + 0.5f, dir.y * 0.5f + 0.5f, dir.z * 0.5f + 0.5f };
+			mesh.vertices.insert(mesh.vertices.end(), vertex, vertex + 6);
+		}
+	}
+
+	// ring r, segment s, poles are a single vertex.
+	const UINT32 southPole = 1 + (rings - 1) * segments;
+	for (UINT32 r = 0; r < rings; r++)
+	{
+		for (UINT32 s = 0; s < segments; s++)
+		{
+			const UINT32 next = (s + 1) % segments;
+			const UINT32 a = r == 0 ? 0 : 1 + (r - 1) * segments + s;
+			const UINT32 b = r == 0 ? 0 : 1 + (r - 1) * segments + next;
+			const UINT32 c = r + 1 == rings ? southPole : 1 + r * segments + s;
+			const UINT32 d = r + 1 == rings ? southPole : 1 + r * segments + next;
+			if (r != 0)
+			{
+				const UINT32 tri[3] = { a, b, c };
+				mesh.indices.insert(mesh.indices.end(), tri, tri + 3);
+			}
+			if (r + 1 != rings)
+			{
+				const UINT32 tri[3] = { b, d, c };
+				mesh.indices.insert(mesh.indices.end(), tri, tri + 3);
+			}
+		}
+	}
+}
+
+// orders the mesh for the vertex cache, adds a LOD chain and meshlets
+// and writes it out in the format the renderer draws. Slow, meant to
+// run once per asset.
+static bool WriteMeshFile(const char* path, UINT64 sourceHash, GFXMeshData& mesh, const GFXVertexFormat& format,
+	const UINT32* srcWidths, UINT32 maxLODs)
+{
+	if (mesh.indices.empty())
+	{
+		printf("Can't write %s, the mesh has no triangles.\n", path);
+		return false;
 	}
-	else
-		mContext = wglCreateContext(hdcGL);
 
-	wglMakeCurrent(NULL, NULL);
-	wglDeleteContext(tempGLRC);
-	if (!wglMakeCurrent(hdcGL, (HGLRC)mContext))
-		assertFatal(false, "Cannot make our context current.");
+	std::chrono::high_resolution_clock::time_point buildStart = std::chrono::high_resolution_clock::now();
 
-	loadGLCore();
-	loadGLExtensions(hdcGL);
+	// the LOD chain reorders the coarser levels and the vertices itself.
+	GFXMeshBuilder::optimizeVertexCache(mesh);
+
+	// color counts towards the error so the gradient survives.
+	const float colorWeights[3] = { 0.5f, 0.5f, 0.5f };
+	GFXMeshSimplifier simplifier;
+	simplifier.setAttributeWeights(colorWeights, 3);
+	std::vector<GFXMeshLOD> lods;
+	simplifier.buildLODChain(mesh, lods, maxLODs);
+
+	// every LOD is split into meshlets so back facing and off screen
+	// clusters can be skipped before they reach the gpu.
+	std::vector<GFXMeshlet> meshlets;
+	for (size_t i = 0; i < lods.size(); i++)
+		GFXMeshletBuilder::build(mesh, lods[i].firstIndex, lods[i].indexCount, meshlets);
+
+	Box3 bounds(Vector3(FLT_MAX, FLT_MAX, FLT_MAX), Vector3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+	for (UINT32 i = 0; i < mesh.getVertexCount(); i++)
+	{
+		const float* p = mesh.getVertex(i);
+		bounds.merge(Box3(Vector3(p[0], p[1], p[2]), Vector3(p[0], p[1], p[2])));
+	}
+
+	std::chrono::duration<double, std::milli> buildTime = std::chrono::high_resolution_clock::now() - buildStart;
+	printf("Built %s: %d LODs, %d meshlets in %.1f ms.\n", path, (int)lods.size(), (int)meshlets.size(), buildTime.count());
+
+	if (!GFXMeshFile::write(path, sourceHash, mesh, format, srcWidths, bounds, lods.empty() ? NULL : &lods[0], (UINT32)lods.size(),
+		meshlets.empty() ? NULL : &meshlets[0], (UINT32)meshlets.size()))
+		return false;
+
+	// the full hash check happens here, once, loads only check sections.
+	GFXMeshFile written;
+	if (!written.open(path) || !written.verify())
+	{
+		printf("Mesh file %s doesn't read back.\n", path);
+		return false;
+	}
+	return true;
 }
 
-GLuint LoadShaders(const char * vertex_file_path, const char * fragment_file_path) {
-
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
-
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if (VertexShaderStream.is_open()) {
-		std::stringstream sstr;
-		sstr << VertexShaderStream.rdbuf();
-		VertexShaderCode = sstr.str();
-		VertexShaderStream.close();
-	}
-	else {
-		printf("Impossible to open %s!\n", vertex_file_path);
-		getchar();
-		return 0;
-	}
-
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if (FragmentShaderStream.is_open()) {
-		std::stringstream sstr;
-		sstr << FragmentShaderStream.rdbuf();
-		FragmentShaderCode = sstr.str();
-		FragmentShaderStream.close();
-	}
-
-	GLint Result = GL_FALSE;
-	int InfoLogLength;
-
-
-	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer, NULL);
-	glCompileShader(VertexShaderID);
-
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if (InfoLogLength > 0) {
-		std::vector<char> VertexShaderErrorMessage(InfoLogLength + 1);
-		glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-		printf("%s\n", &VertexShaderErrorMessage[0]);
-	}
-
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer, NULL);
-	glCompileShader(FragmentShaderID);
-
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if (InfoLogLength > 0) {
-		std::vector<char> FragmentShaderErrorMessage(InfoLogLength + 1);
-		glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-		printf("%s\n", &FragmentShaderErrorMessage[0]);
-	}
-
-	// Link the program
-	printf("Linking program\n\n");
-	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
-
-	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	if (InfoLogLength > 0) {
-		std::vector<char> ProgramErrorMessage(InfoLogLength + 1);
-		glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-		printf("%s\n", &ProgramErrorMessage[0]);
-	}
-
-	glDetachShader(ProgramID, VertexShaderID);
-	glDetachShader(ProgramID, FragmentShaderID);
-
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
-
-	return ProgramID;
+// value of "-option value" or "-option "some value"" on the command line.
+static bool GetCommandLineValue(const char* cmdLine, const char* option, char* value, size_t size)
+{
+	const char* p = strstr(cmdLine, option);
+	if (!p || size == 0)
+		return false;
+
+	p += strlen(option);
+	while (*p == ' ')
+		p++;
+
+	const char terminator = *p == '"' ? '"' : ' ';
+	if (*p == '"')
+		p++;
+
+	size_t length = 0;
+	while (p[length] && p[length] != terminator && length + 1 < size)
+		length++;
+
+	memcpy(value, p, length);
+	value[length] = 0;
+	return length > 0;
+}
+
+// shaders are built into the executable, then come out of the asset
+// archive when it's open and has them, from loose files otherwise.
+// -looseassets goes straight to the loose files. While the reloader
+// watches the loose files they come before the archive, or a saved
+// edit would rebuild the program from the stale packed copy.
+static const CoreArchive* sgAssetArchive;
+static bool sgLooseAssets;
+static bool sgHotReload;
+
+static bool ReadAssetText(const char* path, std::string& out)
+{
+	if (!sgLooseAssets && gfxReadEmbeddedShader(path, out))
+		return true;
+	if (sgHotReload && GFXShaderPreprocessor::readFile(path, out))
+		return true;
+	if (sgAssetArchive && sgAssetArchive->read(path, out))
+		return true;
+	return !sgHotReload && GFXShaderPreprocessor::readFile(path, out);
+}
+
+// wall time of each startup phase, printed with the first frame.
+struct StartupTimer
+{
+	enum { MaxPhases = 16 };
+
+	std::chrono::high_resolution_clock::time_point start;
+	std::chrono::high_resolution_clock::time_point last;
+	const char*	names[MaxPhases];
+	double		times[MaxPhases];
+	UINT32		count;
+
+	StartupTimer()
+	{
+		start = last = std::chrono::high_resolution_clock::now();
+		count = 0;
+	}
+
+	// the time since the last mark goes to phase name.
+	void mark(const char* name)
+	{
+		std::chrono::high_resolution_clock::time_point now = std::chrono::high_resolution_clock::now();
+		if (count < MaxPhases)
+		{
+			names[count] = name;
+			times[count] = std::chrono::duration<double, std::milli>(now - last).count();
+			count++;
+		}
+		last = now;
+	}
+
+	void print() const
+	{
+		std::chrono::duration<double, std::milli> total = last - start;
+		printf("Startup: %.1f ms total", total.count());
+		for (UINT32 i = 0; i < count; i++)
+			printf(", %s %.1f", names[i], times[i]);
+		printf(".\n");
+	}
+};
+
+// a mesh file streamed into its own buffers, drawable once loaded.
+struct StreamedMesh
+{
+	const GFXVertexFormat*	format;		///< the file has to be in this format.
+	GFXMeshFile				file;		///< over the streamed data.
+	GLuint					vertexBuffer;
+	GLuint					indexBuffer;
+	GLenum					indexType;
+	bool					loaded;
+	std::chrono::high_resolution_clock::time_point requestTime;
+};
+
+enum StreamedMeshTarget
+{
+	StreamVertices,
+	StreamIndices,
+};
+
+// on a job worker. Only the header and the section entries used here
+// are checked, the contents were verified when the file was written or
+// packed, so a load costs no more than touching the pages it uploads.
+static bool DecodeMeshAsset(CoreAsset& asset)
+{
+	StreamedMesh& mesh = *(StreamedMesh*)asset.userData;
+	if (!mesh.file.open(asset.data, asset.size))
+		return false;
+
+	GFXVertexFormat format;
+	UINT32 lodCount = 0;
+	uint64_t vertexSize = 0;
+	uint64_t indexSize = 0;
+	const void* vertices = mesh.file.getVertices(&vertexSize);
+	const void* indices = mesh.file.getIndices(&indexSize);
+	if (!vertices || !indices || !mesh.file.getLODs(&lodCount) || !lodCount ||
+		!mesh.file.getVertexFormat(format) || format != *mesh.format)
+		return false;
+
+	// straight from the file data, the driver's copy is the only one.
+	const CoreAssetUpload uploads[2] =
+	{
+		{ StreamVertices, (const UINT8*)vertices, vertexSize },
+		{ StreamIndices, (const UINT8*)indices, indexSize },
+	};
+	asset.uploads.insert(asset.uploads.end(), uploads, uploads + 2);
+	return true;
+}
+
+static void UploadMeshAsset(CoreAsset& asset, const CoreAssetUpload& upload, uint64_t offset, uint64_t size)
+{
+	StreamedMesh& mesh = *(StreamedMesh*)asset.userData;
+
+	// the copy target leaves the bound VAO's index buffer alone.
+	glBindBuffer(GL_COPY_WRITE_BUFFER, upload.target == StreamVertices ? mesh.vertexBuffer : mesh.indexBuffer);
+	if (offset == 0)
+		glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)upload.size, NULL, GL_STATIC_DRAW);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)offset, (GLsizeiptr)size, upload.data + offset);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+static void MeshAssetDone(CoreAsset& asset, bool loaded)
+{
+	StreamedMesh& mesh = *(StreamedMesh*)asset.userData;
+	std::chrono::duration<double, std::milli> time = std::chrono::high_resolution_clock::now() - mesh.requestTime;
+	if (!loaded)
+	{
+		printf("Can't stream %s.\n", asset.path);
+		return;
+	}
+
+	mesh.indexType = mesh.file.getIndexSize() == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+	mesh.loaded = true;
+
+	UINT32 lodCount = 0;
+	const GFXMeshLOD* lods = mesh.file.getLODs(&lodCount);
+	printf("Streamed %s: %d KB in %.2f ms.\n", asset.path, (int)(asset.size / 1024), time.count());
+	for (UINT32 i = 0; i < lodCount; i++)
+	{
+		UINT32 meshletCount = 0;
+		mesh.file.getLODMeshlets(i, &meshletCount);
+		printf("\tLOD %d: %d triangles, error %.4f, %d meshlets.\n", (int)i, lods[i].indexCount / 3, lods[i].error, (int)meshletCount);
+	}
 }
 
 //-------------------------------------------------------------
@@ -595,15 +707,21 @@ int main()
 
 INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine, INT nCmdShow)
 {
+	StartupTimer startup;
 	InitWindowClass();
 	Resolution res = getDesktopResolution();
-	GFXDevice* dev = new GFXDevice();
-	dev = initOpenGL();
 	InitWindow();
 
 	HWND window;
 	window = CreateOpenGLWindow(res.w, res.h,false,true);
+	startup.mark("window");
+
 	initFinalState(window);
+	startup.mark("context");
+
+	// -nocapscache probes the device every run.
+	GFXDevice* dev = initOpenGL(strstr(lpCmdLine, "-nocapscache") == NULL ? "devicecaps.bin" : NULL);
+	startup.mark("caps");
 	ShowWindow(window, SW_SHOW);
 
 	// setup vsync if we have it.
@@ -631,15 +749,73 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 	MSG msg = {};
 	sgQueueEvents = true;
 
+	// a worker per core, frame work runs on these and this thread.
+	CoreJobSystem jobs;
+	jobs.init(0, true);
+	printf("Job system: %d threads.\n", jobs.getThreadCount());
+
+	// drop redundant binds and uniform writes, -nostatecache to compare.
+	GLStateCache stateCache;
+	if (strstr(lpCmdLine, "-nostatecache") == NULL)
+		stateCache.init();
+	startup.mark("jobs");
+
+	// the shaders and meshes packed into one file that's mapped once,
+	// -packassets rebuilds it. -looseassets reads the loose files
+	// instead of it and the embedded shaders, for editing shaders under
+	// the reloader.
+	const char* archivePath = "assets.pak";
+	const bool packAssets = strstr(lpCmdLine, "-packassets") != NULL;
+	sgLooseAssets = strstr(lpCmdLine, "-looseassets") != NULL;
+	CoreArchive assetArchive;
+	if (!packAssets && !sgLooseAssets && assetArchive.open(archivePath))
+		printf("Asset archive: %d entries.\n", assetArchive.getEntryCount());
+	sgAssetArchive = &assetArchive;
+
+	// without embedded shaders they're reloaded when saved, decided
+	// before the first read so every program starts from the same text.
+	const bool embeddedShaders = !sgLooseAssets && gfxGetEmbeddedShaderCount() > 0;
+	sgHotReload = !embeddedShaders;
+	if (embeddedShaders)
+		printf("Shaders: %d embedded.\n", gfxGetEmbeddedShaderCount());
+
 	printf("-------------------------\n");
 	printf("LOAD SHADER\n");
 	printf("-------------------------\n");
-	GLuint programID = LoadShaders("TransformVertexShader.vertexshader", "ColorFragmentShader.fragmentshader");
 
-	// get the id from our shader for our matrix uniform locations.
-	GLuint modelID = glGetUniformLocation(programID, "model");
-	GLuint viewID = glGetUniformLocation(programID, "view");
-	GLuint projID = glGetUniformLocation(programID, "proj");
+	// run with -noshadercache to time a cold start.
+	GLShaderCache shaderCache;
+	shaderCache.init("shadercache", strstr(lpCmdLine, "-noshadercache") == NULL);
+
+	// submit every program up front, the driver builds them while we
+	// set up the rest and we only wait when one is first used.
+	GLProgramCompiler shaderCompiler;
+	shaderCompiler.init(shaderCache.isEnabled() ? &shaderCache : NULL);
+	shaderCompiler.getPreprocessor().setReadFunc(ReadAssetText);
+
+	bool useIndirectField = GLIndirectCuller::isSupported();
+	GLProgramFuture mainProgram = shaderCompiler.submit("TransformVertexShader.vertexshader", "ColorFragmentShader.fragmentshader");
+	const GFXShaderDefine instancedDefines[] = { { "INSTANCED", NULL } };
+	GLProgramFuture instancedProgram = shaderCompiler.submit("TransformVertexShader.vertexshader", "ColorFragmentShader.fragmentshader", instancedDefines, 1);
+	GLProgramFuture cullProgram;
+	GLProgramFuture indirectProgram;
+	if (useIndirectField)
+	{
+		cullProgram = shaderCompiler.submitCompute("FrustumCullComputeShader.computeshader");
+		indirectProgram = shaderCompiler.submit("TransformIndirectVertexShader.vertexshader", "ColorFragmentShader.fragmentshader");
+	}
+
+	startup.mark("shader submit");
+
+	GLuint programID = mainProgram.get();
+	startup.mark("shader wait");
+
+	// point the shader's uniform blocks at our binding slots.
+	BindUniformBlocks(shaderCompiler.getReflection(mainProgram), NULL);
+
+	// ring buffer all our per frame and per object constants are written into.
+	GLCircularBuffer uniformRing;
+	uniformRing.init(GL_UNIFORM_BUFFER, 1024 * 1024);
 
 	// create our projection matrix.
 	Matrix4 proj;
@@ -653,7 +829,8 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 	// create our view matrix (our camera)
 	Matrix4 view;
 	view.identity();
-	view.lookAt(Vector3(4.0f, 3.0f, -3.0f), Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f));
+	const Vector3 cameraPos(4.0f, 3.0f, -3.0f);
+	view.lookAt(cameraPos, Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 1.0f, 0.0f));
 	printf("-------------------------\n");
 	printf("VIEW MATRIX\n");
 	printf("-------------------------\n");
@@ -706,76 +883,370 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 							0, 0, 1,   0, 0, 0,   0, 1, 0,      // v4-v7-v6 (back)
 							0, 1, 0,   0, 1, 1,   0, 0, 1 };    // v6-v5-v4
 
-	// Generate vertex array object.
-	GLuint VAO;
-	glGenVertexArrays(1, &VAO);
-
-	// bind the vertex array object first, then bind and set vertex buffers.
-	glBindVertexArray(VAO);
-
 	// enable our frame buffer.
 	glEnable(GL_FRAMEBUFFER_SRGB);
 
-	// Generate vertex buffer for position attribute.
-	GLuint boxVertbuffer;
-	glGenBuffers(1, &boxVertbuffer);
+	// weld the box into an indexed mesh, position and color interleaved.
+	const float* boxStreams[2] = { boxVerts, boxColors };
+	const UINT32 boxStreamWidths[2] = { 3, 3 };
+	GFXMeshBuilder boxBuilder(6);
+	boxBuilder.addStreams(36, 2, boxStreams, boxStreamWidths);
+
+	GFXMeshData boxMesh;
+	boxBuilder.build(boxMesh);
+
+	std::vector<UINT8> boxIndexData;
+	boxMesh.getIndexData(boxIndexData);
+	const GLsizei boxIndexCount = boxMesh.getIndexCount();
+	const GLenum boxIndexType = boxMesh.getIndexSize() == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+
+	// float3 position + normalized ubyte4 color, 16 bytes a vertex.
+	GFXVertexFormat boxFormat;
+	boxFormat.addElement(GFXAttribPosition, GFXVertexFloat, 3);
+	boxFormat.addElement(GFXAttribColor, GFXVertexUByteNorm, 4);
+
+	std::vector<UINT8> boxVertexData;
+	boxFormat.pack(&boxMesh.vertices[0], boxMesh.vertexStride, boxMesh.getVertexCount(), boxVertexData, boxStreamWidths);
 
 	// now set the viewport.
 	glViewport(0, 0, res.w, res.h);
 
-	// bind the vbuffer
+	// one interleaved vertex buffer for the box.
+	GLuint boxVertbuffer;
+	glGenBuffers(1, &boxVertbuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, boxVertbuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(boxVerts), boxVerts, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, boxVertexData.size(), &boxVertexData[0], GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	GLuint boxIndexBuffer;
+	glGenBuffers(1, &boxIndexBuffer);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxIndexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, boxIndexData.size(), &boxIndexData[0], GL_STATIC_DRAW);
+
+	// a dense blob with a chain of simplified LODs, all in one index
+	// buffer over the same vertices, and the meshlets of every LOD. It's
+	// built once into Blob.mesh, after that the file is mapped and its
+	// sections go straight to the gpu.
+	const char* blobPath = "Blob.mesh";
+	const UINT32 blobRings = 64;
+	const UINT32 blobSegments = 128;
+	const UINT32 blobMaxLODs = 8;
+	// bump the low byte when the blob or its processing changes.
+	const UINT64 blobSourceHash = ((UINT64)blobRings << 32) | (blobSegments << 16) | (blobMaxLODs << 8) | 2;
+
+	// -import <file> turns an OBJ or PLY into <file>.mesh, vertex colors
+	// and all, with LODs and meshlets like the blob's.
+	char importPath[512];
+	if (GetCommandLineValue(lpCmdLine, "-import", importPath, sizeof(importPath) - 5))
+	{
+		GFXMeshImporter importer;
+		importer.setAttributes(GFXMeshImporter::AttribColor);
+		// WriteMeshFile() does the reordering.
+		importer.setOptimize(false);
+		GFXMeshData importedMesh;
+		if (importer.load(importPath, importedMesh, &jobs))
+		{
+			strcat(importPath, ".mesh");
+			WriteMeshFile(importPath, 0, importedMesh, boxFormat, boxStreamWidths, blobMaxLODs);
+		}
+	}
 
-	// gernerate color buffer for color attribute.
-	GLuint boxColorbuffer;
-	glGenBuffers(1, &boxColorbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, boxColorbuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(boxColors), boxColors, GL_STATIC_DRAW);
+	// only the header and bounds are read here, the scene needs them up
+	// front. The rest streams in, blobs show up once it's uploaded.
+	// A stale or compressed copy in the archive is skipped for the loose
+	// file, the packed one is streamed straight from the mapping.
+	Box3 blobBounds(Vector3(-1.15f, -1.15f, -1.15f), Vector3(1.15f, 1.15f, 1.15f));
+	bool blobPacked = false;
+	{
+		GFXMeshFile blobFile;
+		const UINT32 blobEntry = assetArchive.find(blobPath);
+		if (blobEntry != CoreArchive::NotFound && assetArchive.getData(blobEntry))
+		{
+			blobPacked = blobFile.open(assetArchive.getData(blobEntry), assetArchive.getSize(blobEntry)) &&
+				blobFile.getSourceHash() == blobSourceHash;
+			if (!blobPacked)
+				blobFile.close();
+		}
 
-	// position attribute in shader
-	GLuint loc1;
-	loc1 = glGetAttribLocation(programID, "position");
-	glBindBuffer(GL_ARRAY_BUFFER, boxVertbuffer);
-	glVertexAttribPointer(
-		loc1,               // match with shader.
-		3,                  // size
-		GL_FLOAT,           // type
-		GL_FALSE,           // normalized?
-		0,					// stride
-		(void*)0			// array buffer offset
-	);
-	glEnableVertexAttribArray(loc1);
-
-	// color attribute in shader.
-	GLuint loc2;
-	loc2 = glGetAttribLocation(programID, "color");
-	glBindBuffer(GL_ARRAY_BUFFER, boxColorbuffer);
-	glVertexAttribPointer(
-		loc2,								// must match the layout in the shader.
-		3,									// size
-		GL_FLOAT,							// type
-		GL_FALSE,							// normalized?
-		0,									// stride
-		(void*)0							// array buffer offset
-	);
-	glEnableVertexAttribArray(loc2);
-	BOOL bRet;
+		if (!blobPacked && (!blobFile.open(blobPath) || blobFile.getSourceHash() != blobSourceHash))
+		{
+			blobFile.close();
+			GFXMeshData blobMesh;
+			BuildBlobMesh(blobMesh, blobRings, blobSegments);
+			if (WriteMeshFile(blobPath, blobSourceHash, blobMesh, boxFormat, boxStreamWidths, blobMaxLODs))
+				blobFile.open(blobPath);
+		}
+		blobFile.getBounds(blobBounds);
+	}
+
+	// shaders are compressed, meshes stay as they are so they can be
+	// uploaded from the mapping.
+	if (packAssets)
+	{
+		const CoreArchiveSource packedAssets[] =
+		{
+			{ "TransformVertexShader.vertexshader", "TransformVertexShader.vertexshader", true },
+			{ "TransformIndirectVertexShader.vertexshader", "TransformIndirectVertexShader.vertexshader", true },
+			{ "ColorFragmentShader.fragmentshader", "ColorFragmentShader.fragmentshader", true },
+			{ "FrustumCullComputeShader.computeshader", "FrustumCullComputeShader.computeshader", true },
+			{ "ShaderConstants.glsl", "ShaderConstants.glsl", true },
+			{ blobPath, blobPath, false },
+		};
+		const UINT32 packedAssetCount = sizeof(packedAssets) / sizeof(packedAssets[0]);
+
+		// streaming trusts the packed mesh's contents, check them first.
+		GFXMeshFile packedBlob;
+		if (!packedBlob.open(blobPath) || !packedBlob.verify())
+			printf("Not packing, %s is broken.\n", blobPath);
+		else if (CoreArchive::write(archivePath, packedAssets, packedAssetCount, &jobs))
+			printf("Packed %d assets into %s.\n", packedAssetCount, archivePath);
+	}
+
+	// files are read on IO threads, decoded on the job workers and
+	// uploaded here a slice a frame, -uploadbudget <KB> to change it.
+	char uploadBudgetValue[32];
+	const UINT64 streamUploadBudget = GetCommandLineValue(lpCmdLine, "-uploadbudget", uploadBudgetValue, sizeof(uploadBudgetValue)) ?
+		(UINT64)atoi(uploadBudgetValue) * 1024 : 256 * 1024;
+	CoreAssetStreamer assetStreamer;
+	assetStreamer.init(&jobs, 16);
+
+	StreamedMesh blobStream;
+	blobStream.format = &boxFormat;
+	blobStream.indexType = GL_UNSIGNED_SHORT;
+	blobStream.loaded = false;
+	blobStream.requestTime = std::chrono::high_resolution_clock::now();
+	glGenBuffers(1, &blobStream.vertexBuffer);
+	glGenBuffers(1, &blobStream.indexBuffer);
+
+	const CoreAssetDesc blobAsset = { blobPath, blobPacked ? &assetArchive : NULL, true, DecodeMeshAsset, UploadMeshAsset, MeshAssetDone, &blobStream };
+	const UINT32 blobAssetId = assetStreamer.request(blobAsset);
+
+	startup.mark("meshes");
+
+	// VAOs come from the layout cache, meshes sharing a format share one.
+	GLVertexLayoutCache vertexLayouts;
+	vertexLayouts.init();
+	printf("Vertex layouts: %s.\n", vertexLayouts.hasAttribBinding() ? "separate attribute formats, one VAO per format" : "attribute pointers, one VAO per buffer set");
+
+	// the scene is the main box, a field of boxes underneath it and a
+	// row of blobs running away from the camera. A material is just a
+	// tint here, 0 leaves the object untinted.
+	const UINT32 boxGridDim = 64;
+	const UINT32 boxFieldCount = boxGridDim * boxGridDim;
+	const UINT32 boxMeshId = 0;
+	const UINT32 blobMeshId = 1;
+	const UINT32 blobCount = 16;
+	const Box3 boxBounds(Vector3(-1.0f, -1.0f, -1.0f), Vector3(1.0f, 1.0f, 1.0f));
+
+	GFXScene scene;
+	scene.init(boxFieldCount + blobCount + 1);
+	std::vector<Vector4> materialTints;
+	materialTints.push_back(Vector4(1.0f, 1.0f, 1.0f, 1.0f));
+
+	const GFXSceneHandle mainBox = scene.create(model, boxBounds, boxMeshId, 0);
+	for (UINT32 z = 0; z < boxGridDim; z++)
+	{
+		for (UINT32 x = 0; x < boxGridDim; x++)
+		{
+			Matrix4 instanceModel;
+			instanceModel.translate(((float)x - boxGridDim / 2) * 3.0f, -4.0f, ((float)z - boxGridDim / 2) * 3.0f);
+			scene.create(instanceModel, boxBounds, boxMeshId, (UINT32)materialTints.size());
+			materialTints.push_back(Vector4((float)x / boxGridDim, 1.0f, (float)z / boxGridDim, 1.0f));
+		}
+	}
+
+	for (UINT32 i = 0; i < blobCount; i++)
+	{
+		const float along = 6.0f * (i + 1);
+		Matrix4 blobModel;
+		blobModel.translate(-0.8f * along, 1.0f, 0.6f * along);
+		scene.create(blobModel, blobBounds, blobMeshId, 0);
+	}
+
+	// -jobtest checks every job runs exactly once under a flood of them.
+	if (strstr(lpCmdLine, "-jobtest") != NULL)
+		coreRunJobStressTest();
+
+	// -jobbench times the job system on scene sized transform and cull work.
+	if (strstr(lpCmdLine, "-jobbench") != NULL)
+	{
+		coreRunJobBenchmark(boxFieldCount);
+		coreRunJobBenchmark(boxFieldCount * 16);
+	}
+
+	// -bvhbench builds and ray casts a couple million triangles.
+	if (strstr(lpCmdLine, "-bvhbench") != NULL)
+		coreRunBVHBenchmark(&jobs);
+
+	// -gridbench keeps a spatial grid over 200k moving boxes up to date.
+	if (strstr(lpCmdLine, "-gridbench") != NULL)
+		coreRunSpatialGridBenchmark(&jobs);
+
+	// click picking goes through a bvh over the scene's world bounds.
+	// Its primitives are dense indices, rebuild it when the scene changes.
+	CoreBVH sceneBVH;
+	sceneBVH.buildBoxes(scene.getWorldBounds(), scene.getCount(), &jobs);
+	printf("Scene BVH: %d nodes, built in %.2f ms.\n", sceneBVH.getNodeCount(), sceneBVH.getBuildTime());
+
+	// with compute and multi draw indirect the gpu culls and draws the field,
+	// otherwise it goes out as one instanced draw.
+	GLIndirectCuller boxFieldCuller;
+	GLuint cullProgramID = 0;
+	GLuint indirectProgramID = 0;
+	GFXVertexFormat indirectFormat = boxFormat;
+	GLIndirectCuller::addObjectIdAttribute(indirectFormat, 1);
+	if (useIndirectField)
+	{
+		cullProgramID = cullProgram.get();
+		indirectProgramID = indirectProgram.get();
+		useIndirectField = indirectProgramID && boxFieldCuller.init(shaderCompiler.getReflection(cullProgram), boxFieldCount);
+	}
+
+	if (useIndirectField)
+	{
+		BindUniformBlocks(shaderCompiler.getReflection(indirectProgram), NULL);
+
+		UINT32 boxMeshIndex = boxFieldCuller.addMesh(boxIndexCount, 0, 0);
+
+		// everything but the main box, straight from the scene arrays.
+		std::vector<GLIndirectCuller::CullObject> cullObjects;
+		std::vector<GLIndirectCuller::DrawObject> drawObjects;
+		const GFXSceneHandle* handles = scene.getHandles();
+		const Matrix4* transforms = scene.getTransforms();
+		const Box3* bounds = scene.getWorldBounds();
+		const UINT32* meshes = scene.getMeshes();
+		const UINT32* materials = scene.getMaterials();
+		for (UINT32 i = 0; i < scene.getCount(); i++)
+		{
+			if (handles[i] == mainBox || meshes[i] != boxMeshId)
+				continue;
+
+			GLIndirectCuller::CullObject obj;
+			memset(&obj, 0, sizeof(obj));
+			const Vector3 center = bounds[i].getCenter();
+			obj.sphere[0] = center.x;
+			obj.sphere[1] = center.y;
+			obj.sphere[2] = center.z;
+			obj.sphere[3] = bounds[i].getRadius();
+			obj.meshIndex = boxMeshIndex;
+			cullObjects.push_back(obj);
+
+			GLIndirectCuller::DrawObject draw;
+			memcpy(draw.transform, transforms[i].get(), sizeof(draw.transform));
+			memcpy(draw.tint, &materialTints[materials[i]].x, sizeof(draw.tint));
+			drawObjects.push_back(draw);
+		}
+		boxFieldCuller.setObjects((UINT32)cullObjects.size(), &cullObjects[0], &drawObjects[0]);
+
+	}
+	printf("Box field: %d boxes, %s.\n", boxFieldCount, useIndirectField ? "gpu culled multi draw indirect" : "instanced");
+
+	GLuint instancedProgramID = instancedProgram.get();
+	BindUniformBlocks(shaderCompiler.getReflection(instancedProgram), NULL);
+
+	// refilled every frame with the field boxes that survive culling.
+	GLInstanceBuffer boxInstances;
+	boxInstances.init(boxFieldCount);
+
+	// box vertices in stream 0, per instance data in stream 1.
+	GFXVertexFormat instancedFormat = boxFormat;
+	GLInstanceBuffer::addAttributes(instancedFormat, 1);
+
+	const GLuint indirectBuffers[2] = { boxVertbuffer, boxFieldCuller.getObjectIdBuffer() };
+
+	// what every box draw shares, the loop fills in the rest.
+	GLDrawItem boxDrawTemplate;
+	memset(&boxDrawTemplate, 0, sizeof(boxDrawTemplate));
+	boxDrawTemplate.format = &boxFormat;
+	boxDrawTemplate.buffers[0] = boxVertbuffer;
+	boxDrawTemplate.indexBuffer = boxIndexBuffer;
+	boxDrawTemplate.mode = GL_TRIANGLES;
+	boxDrawTemplate.indexType = boxIndexType;
+	boxDrawTemplate.indexCount = boxIndexCount;
+	boxDrawTemplate.instanceCount = 1;
+
+	// blobs draw the visible meshlet ranges of one LOD.
+	GLDrawItem blobDrawTemplate = boxDrawTemplate;
+	blobDrawTemplate.buffers[0] = blobStream.vertexBuffer;
+	blobDrawTemplate.indexBuffer = blobStream.indexBuffer;
+
+	// LODs are picked by their error in pixels at the object's distance.
+	const float lodScale = GFXMeshSimplifier::getLODScale(proj, (float)res.h);
+	bool printBlobLODs = true;
+	std::vector<GFXIndexRange> blobRanges;
+
+	GLDrawList drawList;
+	drawList.init(&vertexLayouts, GFXObjectConstantsBinding, &jobs);
+
+	// view projection for culling, our projection matrix is stored transposed.
+	Matrix4 viewProj = proj;
+	viewProj.transpose();
+	viewProj = viewProj * view;
+	const Frustum frustum(viewProj);
+	Matrix4 invViewProj = viewProj;
+	invViewProj.invert();
+	std::vector<UINT32> visibleObjects;
+	bool validateIndirectField = useIndirectField;
+
+	printf("Shader startup: %.2f ms submitting, %.2f ms waiting, %s compile, cache %s (%d hits, %d misses, %d stale), %d variant and %d source hits.\n",
+		shaderCompiler.getSubmitTime(), shaderCompiler.getWaitTime(), shaderCompiler.isParallel() ? "parallel" : "serial",
+		shaderCache.isEnabled() ? "on" : "off", shaderCache.getHits(), shaderCache.getMisses(), shaderCache.getStale(),
+		shaderCompiler.getVariantHits(), shaderCompiler.getSourceHits());
+
+	// rebuild programs when their shader files are saved, only when
+	// they're read from those files.
+	GLShaderReloader shaderReloader;
+	if (sgHotReload && shaderReloader.init(&shaderCompiler, "."))
+	{
+		shaderReloader.add(&programID, mainProgram, BindUniformBlocks);
+		shaderReloader.add(&instancedProgramID, instancedProgram, BindUniformBlocks);
+		if (useIndirectField)
+		{
+			shaderReloader.add(&indirectProgramID, indirectProgram, BindUniformBlocks);
+			shaderReloader.add(&cullProgramID, cullProgram, SetCullProgram, &boxFieldCuller);
+		}
+	}
+
+	startup.mark("scene");
+	bool firstFrame = true;
+	bool running = true;
 
 	// main loop
-	while (1)
+	while (running)
 	{
-		// handle window messages.
-		bRet = GetMessage(&msg, NULL, 0, 0);
-		if (bRet > 0)
+		// handle window messages, don't block so the frame keeps going.
+		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE))
 		{
+			if (msg.message == WM_QUIT)
+				running = false;
+
+			if (msg.message == WM_LBUTTONDOWN)
+			{
+				Vector3 rayOrigin, rayDirection;
+				GetPickRay(invViewProj, (short)LOWORD(msg.lParam), (short)HIWORD(msg.lParam), res.w, res.h, rayOrigin, rayDirection);
+
+				std::chrono::high_resolution_clock::time_point pickStart = std::chrono::high_resolution_clock::now();
+				CoreBVHHit hit;
+				const bool picked = sceneBVH.raycast(rayOrigin, rayDirection, FLT_MAX, hit);
+				std::chrono::duration<double, std::micro> pickTime = std::chrono::high_resolution_clock::now() - pickStart;
+
+				if (picked)
+					printf("Picked object %08x, material %d, in %.2f us.\n", scene.getHandles()[hit.primitive], scene.getMaterials()[hit.primitive], pickTime.count());
+				else
+					printf("Picked nothing in %.2f us.\n", pickTime.count());
+			}
+
 			TranslateMessage(&msg);
 			DispatchMessage(&msg);
 		}
-		else
-		{
+
+		if (!running)
 			break;
-		}
+
+		// frame boundary, swap in any rebuilt shaders.
+		stateCache.beginFrame();
+		shaderReloader.update();
+		assetStreamer.update(streamUploadBudget);
 
 		// clear our screen
 		glClearColor(0.011f, 0.01f, 0.01f, 1.0f);
@@ -785,30 +1256,189 @@ INT WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PSTR lpCmdLine,
 		//glEnable(GL_DEPTH_TEST);
 		//glDepthFunc(GL_LESS);
 
-		// send our matrix info to the shader.
-		glUniformMatrix4fv(modelID, 1, GL_TRUE, model.get());
-		glUniformMatrix4fv(viewID, 1, GL_FALSE, view.get());
-		glUniformMatrix4fv(projID, 1, GL_TRUE, proj.get());
+		// write our matrix info into this frame's part of the ring.
+		uniformRing.beginFrame();
+
+		GLCircularBuffer::Allocation frameAlloc;
+		GFXFrameConstants* frameConsts = uniformRing.allocate<GFXFrameConstants>(frameAlloc);
+		if (!frameConsts)
+		{
+			// nothing draws without them, show the cleared frame.
+			uniformRing.endFrame();
+			SwapBuffers(winState.appDC);
+			continue;
+		}
+		memcpy(frameConsts->view, view.get(), sizeof(frameConsts->view));
+		memcpy(frameConsts->proj, proj.getTranspose(), sizeof(frameConsts->proj));
+
+		// queue the frame's draws, they go out sorted by state.
+		drawList.clear();
+
+		// cull the scene on the cpu. Visible field boxes go into the
+		// instance buffer unless the gpu culls and draws the field.
+		scene.cull(frustum, visibleObjects, &jobs);
+
+		const GFXSceneHandle* handles = scene.getHandles();
+		const Matrix4* transforms = scene.getTransforms();
+		const Box3* bounds = scene.getWorldBounds();
+		const UINT32* meshes = scene.getMeshes();
+		const UINT32* materials = scene.getMaterials();
+		UINT32 fieldCount = 0;
+		UINT32 blobsDrawn = 0;
+		UINT32 blobFullTriangles = 0;
+		UINT32 blobLODTriangles = 0;
+		UINT32 blobTrianglesDrawn = 0;
+		for (size_t v = 0; v < visibleObjects.size(); v++)
+		{
+			const UINT32 i = visibleObjects[v];
+			if (meshes[i] == boxMeshId && handles[i] != mainBox)
+			{
+				if (!useIndirectField)
+					boxInstances.set(fieldCount++, transforms[i].get(), &materialTints[materials[i]].x);
+				continue;
+			}
+
+			// streamed meshes draw once they're uploaded.
+			if (meshes[i] == blobMeshId && !blobStream.loaded)
+				continue;
+
+			GLCircularBuffer::Allocation objectAlloc;
+			GFXObjectConstants* objectConsts = uniformRing.allocate<GFXObjectConstants>(objectAlloc);
+			// the ring is full for this frame, allocate() said so.
+			if (!objectConsts)
+				continue;
+			memcpy(objectConsts->model, transforms[i].get(), sizeof(objectConsts->model));
+
+			const float distance = cameraPos.distance(bounds[i].getCenter());
+			GLDrawItem draw = meshes[i] == blobMeshId ? blobDrawTemplate : boxDrawTemplate;
+			draw.program = programID;
+			draw.material = materials[i];
+			draw.constantsBuffer = uniformRing.getBuffer();
+			draw.constantsOffset = objectAlloc.offset;
+			draw.constantsSize = objectAlloc.size;
+
+			if (meshes[i] != blobMeshId)
+			{
+				drawList.add(draw, GFXDrawPassOpaque, distance);
+				continue;
+			}
+
+			// pick the LOD, then draw what's left of it after cluster culling.
+			draw.indexType = blobStream.indexType;
+			UINT32 lodCount = 0;
+			const GFXMeshLOD* lods = blobStream.file.getLODs(&lodCount);
+			const UINT32 lodIndex = GFXMeshSimplifier::selectLOD(lods, lodCount, distance, lodScale);
+			UINT32 meshletCount = 0;
+			const GFXMeshlet* meshlets = blobStream.file.getLODMeshlets(lodIndex, &meshletCount);
+			blobRanges.clear();
+			blobTrianglesDrawn += GFXMeshletBuilder::cull(meshlets, meshletCount, transforms[i], frustum, cameraPos, blobRanges);
+			blobLODTriangles += lods[lodIndex].indexCount / 3;
+			blobFullTriangles += lods[0].indexCount / 3;
+			blobsDrawn++;
+
+			for (size_t r = 0; r < blobRanges.size(); r++)
+			{
+				draw.firstIndex = blobRanges[r].firstIndex;
+				draw.indexCount = blobRanges[r].indexCount;
+				drawList.add(draw, GFXDrawPassOpaque, distance);
+			}
+		}
+
+		if (printBlobLODs && blobsDrawn)
+		{
+			printf("Blobs: %d visible, %d triangles at full detail, %d after LOD selection, %d after meshlet culling.\n",
+				blobsDrawn, blobFullTriangles, blobLODTriangles, blobTrianglesDrawn);
+			printBlobLODs = false;
+		}
+
+		// no-op when persistently mapped.
+		uniformRing.flush();
+		uniformRing.bindRange(GFXFrameConstantsBinding, frameAlloc);
+
+		if (!useIndirectField && fieldCount)
+		{
+			boxInstances.setCount(fieldCount);
+			boxInstances.upload();
+
+			// every visible box in the field in one call.
+			GLDrawItem fieldDraw = boxDrawTemplate;
+			fieldDraw.program = instancedProgramID;
+			fieldDraw.format = &instancedFormat;
+			fieldDraw.buffers[1] = boxInstances.getBuffer();
+			fieldDraw.instanceCount = boxInstances.getCount();
+			drawList.add(fieldDraw, GFXDrawPassOpaque, cameraPos.distance(Vector3(0.0f, -4.0f, 0.0f)));
+		}
+
+		drawList.submit();
 
-		// use the shader
-		glUseProgram(programID);
+		if (useIndirectField)
+		{
+			// cull on the gpu, then one multi draw for the survivors.
+			boxFieldCuller.cull(viewProj);
+			glUseProgram(indirectProgramID);
+			vertexLayouts.bind(indirectFormat, indirectBuffers, NULL, boxIndexBuffer);
+			boxFieldCuller.draw(GL_TRIANGLES, boxIndexType);
+
+			// check the first frame against the cpu.
+			if (validateIndirectField)
+			{
+				boxFieldCuller.validate(viewProj);
+				validateIndirectField = false;
+			}
+		}
 
-		// DRAW HERE PLEASE!!!!!!
-		glDrawArrays(GL_TRIANGLES, 0, 36); // 
+		// fence this frame's constants.
+		uniformRing.endFrame();
 
 		// swap the window buffers.
 		SwapBuffers(winState.appDC);
+
+		if (firstFrame)
+		{
+			startup.mark("first frame");
+			startup.print();
+			firstFrame = false;
+		}
+	}
+
+	if (stateCache.isActive() && stateCache.getFrameCount() > 1)
+	{
+		const GLStateStats& total = stateCache.getTotalStats();
+		const uint32_t frames = stateCache.getFrameCount() - 1;
+		printf("State cache: %.1f of %.1f calls eliminated per frame (program %.1f, vao %.1f, buffer %.1f, texture %.1f, uniform %.1f).\n",
+			(float)total.getEliminated() / frames, (float)(total.getEliminated() + total.getIssued()) / frames,
+			(float)total.eliminated[GLStateProgram] / frames, (float)total.eliminated[GLStateVertexArray] / frames,
+			(float)total.eliminated[GLStateBuffer] / frames, (float)total.eliminated[GLStateTexture] / frames,
+			(float)total.eliminated[GLStateUniform] / frames);
 	}
 
-	// Cleanup VBO and shader
+	// Cleanup VBO and shader, the compiler owns the programs.
+	shaderReloader.destroy();
+	shaderCompiler.destroy();
+	uniformRing.destroy();
 	glDeleteBuffers(1, &boxVertbuffer);
-	glDeleteBuffers(1, &boxColorbuffer);
-	glDeleteProgram(programID);
-	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &boxIndexBuffer);
+	blobStream.file.close();
+	assetStreamer.release(blobAssetId);
+	assetStreamer.destroy();
+	sgAssetArchive = NULL;
+	sgHotReload = false;
+	assetArchive.close();
+	glDeleteBuffers(1, &blobStream.vertexBuffer);
+	glDeleteBuffers(1, &blobStream.indexBuffer);
+	vertexLayouts.destroy();
+	boxInstances.destroy();
+	boxFieldCuller.destroy();
+	drawList.destroy();
+	sceneBVH.destroy();
+	scene.destroy();
+	jobs.destroy();
+	stateCache.destroy();
 
 	// clean up windows.
 	sgQueueEvents = false;
 	wglDeleteContext((HGLRC)mContext);
+	delete dev;
 	ReleaseDC(window, winState.appDC);
 	DestroyWindow(window);
 }
@@ -0,0 +1,144 @@
+# Embeds the shader sources into the executable, run as a pre-build step:
+#
+#   python embedShaders.py <shader directory> <output .inl>
+#
+# Every shader in the directory is minified and written out as a
+# constexpr table that gfxEmbeddedShaders.cpp includes. Includes and
+# permutation defines are still expanded at runtime by the shader
+# preprocessor, so the text here is only stripped of comments and extra
+# whitespace. Line breaks are kept, compiler errors give the same line
+# numbers as the loose files.
+#
+# The output is only rewritten when it changes, so an untouched shader
+# doesn't rebuild anything.
+
+import os
+import sys
+
+SHADER_EXTENSIONS = ('.vertexshader', '.fragmentshader', '.computeshader', '.glsl')
+
+# whitespace around these is dropped outside preprocessor lines.
+PUNCTUATION = set('{}()[];,=')
+
+# MSVC limits a string literal, pieces and all, to 64KB.
+MAX_SHADER_SIZE = 65535
+
+
+def hash_name(name):
+	# GFXHashName(), the table is sorted by it.
+	h = 2166136261
+	for c in name.encode('utf-8'):
+		h = ((h ^ c) * 16777619) & 0xFFFFFFFF
+	return h
+
+
+def strip_comments(text):
+	out = []
+	i = 0
+	in_string = False
+	while i < len(text):
+		c = text[i]
+		if in_string:
+			out.append(c)
+			if c == '"' or c == '\n':
+				in_string = False
+			i += 1
+		elif c == '"':
+			in_string = True
+			out.append(c)
+			i += 1
+		elif text.startswith('//', i):
+			end = text.find('\n', i)
+			i = len(text) if end < 0 else end
+		elif text.startswith('/*', i):
+			end = text.find('*/', i + 2)
+			end = len(text) if end < 0 else end + 2
+			# keep the line breaks inside the comment.
+			out.append('\n' * text.count('\n', i, end))
+			if text.count('\n', i, end) == 0:
+				out.append(' ')
+			i = end
+		else:
+			out.append(c)
+			i += 1
+	return ''.join(out)
+
+
+def minify_line(line):
+	line = ' '.join(line.split())
+	if line.startswith('#'):
+		# '#define F (x)' and '#define F(x)' aren't the same thing.
+		return line
+
+	out = []
+	for i, c in enumerate(line):
+		if c == ' ':
+			prev = out[-1] if out else ''
+			next = line[i + 1] if i + 1 < len(line) else ''
+			if prev in PUNCTUATION or next in PUNCTUATION:
+				continue
+		out.append(c)
+	return ''.join(out)
+
+
+def minify(text):
+	text = text.replace('\r\n', '\n').replace('\r', '\n')
+	lines = [minify_line(line) for line in strip_comments(text).split('\n')]
+	while lines and not lines[-1]:
+		lines.pop()
+	return '\n'.join(lines) + '\n'
+
+
+def escape(line):
+	return line.replace('\\', '\\\\').replace('"', '\\"').replace('\t', '\\t')
+
+
+def main():
+	if len(sys.argv) != 3:
+		print('usage: embedShaders.py <shader directory> <output .inl>')
+		return 1
+
+	directory, output = sys.argv[1], sys.argv[2]
+	shaders = []
+	for name in sorted(os.listdir(directory)):
+		if not name.endswith(SHADER_EXTENSIONS):
+			continue
+		with open(os.path.join(directory, name), 'r') as f:
+			text = minify(f.read())
+		if len(text) > MAX_SHADER_SIZE:
+			print('embedShaders: %s is too big to embed.' % name)
+			return 1
+		shaders.append((hash_name(name), name, text))
+
+	hashes = [shader[0] for shader in shaders]
+	if len(set(hashes)) != len(hashes):
+		print('embedShaders: two shader names hash the same.')
+		return 1
+	shaders.sort()
+
+	out = []
+	out.append('// generated by tools/embedShaders.py from the loose shaders, don\'t edit.\n')
+	out.append('static constexpr GFXEmbeddedShader sgEmbeddedShaders[] =\n{\n')
+	for h, name, text in shaders:
+		out.append('\t{ GFXHashName("%s"), "%s", %d,\n' % (name, name, len(text)))
+		for line in text.split('\n')[:-1]:
+			out.append('\t\t"%s\\n"\n' % escape(line))
+		out.append('\t},\n')
+	out.append('};\n')
+	out = ''.join(out)
+
+	try:
+		with open(output, 'r') as f:
+			if f.read() == out:
+				return 0
+	except IOError:
+		pass
+
+	with open(output, 'w') as f:
+		f.write(out)
+	print('embedShaders: %d shaders embedded.' % len(shaders))
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main())